@@ -0,0 +1,117 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include <stdio.h>
+
+#ifdef __linux__
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/net/connect.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+
+/*
+ * Measures how fast we can receive from a local loopback sender, using
+ * on_data() and using on_drain(). The sender runs in a background thread.
+ *
+ * Usage: ./example/bench/drain [seconds]
+ */
+
+using namespace mk;
+using namespace mk::net;
+
+static int listen_loopback(int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    if (bind(fd, (sockaddr *)&sin, len) != 0 || listen(fd, 8) != 0 ||
+        getsockname(fd, (sockaddr *)&sin, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(sin.sin_port);
+    return fd;
+}
+
+// Sends to each accepted connection until the peer closes it
+static void sender(int listener, int rounds) {
+    std::string block(1 << 16, 'x');
+    for (int i = 0; i < rounds; ++i) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd == -1) {
+            return;
+        }
+        while (send(fd, block.data(), block.size(), MSG_NOSIGNAL) > 0) {
+            /* NOTHING */;
+        }
+        close(fd);
+    }
+}
+
+static void bench(const char *name, int port, double seconds, bool drain) {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Logger> logger = Logger::make();
+    size_t total = 0;
+    double begin = 0.0;
+    reactor->run_with_initial_event([&]() {
+        connect("127.0.0.1", port, [&](Error err, SharedPtr<Transport> txp) {
+            if (err) {
+                fprintf(stderr, "%s: cannot connect: %s\n", name, err.what());
+                reactor->stop();
+                return;
+            }
+            begin = mk::time_now();
+            if (drain) {
+                txp->on_drain([&](size_t count) { total += count; });
+            } else {
+                txp->on_data([&](Buffer data) { total += data.length(); });
+            }
+            reactor->call_later(seconds, [=]() {
+                txp->close([=]() { reactor->stop(); });
+            });
+        }, {}, reactor, logger);
+    });
+    double elapsed = mk::time_now() - begin;
+    printf("%-8s %10.2f Gbit/s (%lu bytes)\n", name,
+           (total * 8) / elapsed / 1e09, (unsigned long)total);
+}
+
+int main(int argc, char **argv) {
+    double seconds = (argc > 1) ? atof(argv[1]) : 5.0;
+    int port = 0;
+    int listener = listen_loopback(&port);
+    if (listener == -1) {
+        fprintf(stderr, "cannot listen: %s\n", strerror(errno));
+        exit(1);
+    }
+    std::thread thread{sender, listener, 2};
+    bench("on_data", port, seconds, false);
+    bench("on_drain", port, seconds, true);
+    thread.join();
+    close(listener);
+}
+
+#else
+
+int main() {
+    fprintf(stderr, "this benchmark only works on Linux\n");
+    return 1;
+}
+
+#endif
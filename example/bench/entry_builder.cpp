@@ -0,0 +1,76 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/report/entry_builder.hpp"
+
+#include <measurement_kit/internal/vendor/mkuuid4.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Measures how many entries per second we can build, using EntryBuilder
+ * and using the code that Runnable used before EntryBuilder existed.
+ *
+ * Usage: ./example/bench/entry_builder [iterations]
+ */
+
+using namespace mk;
+using namespace mk::report;
+
+static nlohmann::json make_test_keys() {
+    return {{"failure", nullptr}, {"blocking", false}, {"accessible", true}};
+}
+
+template <typename Func> static void bench(const char *name, long n, Func f) {
+    double begin = mk::time_now();
+    size_t bytes = 0;
+    for (long i = 0; i < n; ++i) {
+        bytes += f().dump().size(); // Make sure we really use the entry
+    }
+    double elapsed = mk::time_now() - begin;
+    printf("%-16s %10.0f entries/s (%lu bytes)\n", name, n / elapsed,
+           (unsigned long)bytes);
+}
+
+int main(int argc, char **argv) {
+    long n = (argc > 1) ? atol(argv[1]) : 100000;
+    ReportLegacy report;
+    report.test_name = "web_connectivity";
+    report.test_version = "0.0.1";
+    report.probe_ip = "127.0.0.1";
+    report.probe_asn = "AS0";
+    report.probe_cc = "ZZ";
+    report.report_id = "20170101T000000Z_AS0_xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx";
+    mk::utc_time_now(&report.test_start_time);
+    std::map<std::string, std::string> annotations{{"network_type", "wifi"}};
+    nlohmann::json test_helpers{{"backend", "https://a.web-connectivity.th"}};
+    tm start_time{};
+    mk::utc_time_now(&start_time);
+
+    bench("legacy", n, [&]() {
+        nlohmann::json entry;
+        entry["input"] = "https://www.example.com/";
+        entry["test_keys"] = make_test_keys();
+        entry["test_keys"]["client_resolver"] = "8.8.8.8";
+        entry["measurement_start_time"] = *mk::timestamp(&start_time);
+        entry["test_runtime"] = 1.0;
+        entry["id"] = mk::uuid4::gen();
+        entry["options"] = nlohmann::json::array();
+        entry["probe_city"] = nullptr;
+        entry["test_helpers"] = test_helpers;
+        entry["input_hashes"] = nlohmann::json::array();
+        entry["annotations"] = annotations;
+        report.fill_entry(entry);
+        return entry;
+    });
+
+    EntryBuilder builder{report, annotations, test_helpers};
+    bench("entry_builder", n, [&]() {
+        return builder.build("https://www.example.com/", make_test_keys(),
+                             "8.8.8.8", start_time, 1.0, report.report_id);
+    });
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/regexp/regexp.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <regex>
+
+/*
+ * Measures how many calls per second html_extract_title() and private_ipv4()
+ * can do, compared with the std::regex code they replaced.
+ *
+ * Usage: ./example/bench/regexp [iterations]
+ */
+
+using namespace mk;
+
+template <typename Func> static void bench(const char *name, long n, Func f) {
+    double begin = mk::time_now();
+    long matches = 0;
+    for (long i = 0; i < n; ++i) {
+        matches += f() ? 1 : 0; // Make sure we really use the result
+    }
+    double elapsed = mk::time_now() - begin;
+    printf("%-24s %12.0f calls/s (%ld matches)\n", name, n / elapsed,
+           matches);
+}
+
+int main(int argc, char **argv) {
+    long n = (argc > 1) ? atol(argv[1]) : 1000;
+    std::string body = "<html><head>" + std::string(64 * 1024, 'x') +
+                       "<title>Example Domain</title></head></html>";
+
+    bench("html_extract_title", n, [&]() {
+        return regexp::html_extract_title(body) == "Example Domain";
+    });
+    bench("html_extract_title/regex", n, [&]() {
+        std::smatch match;
+        std::regex re{R"(<title>([^<]{1,128})<\/title>)", std::regex::icase};
+        return std::regex_search(body, match, re) &&
+               match[1] == "Example Domain";
+    });
+
+    bench("private_ipv4", n, []() {
+        return regexp::private_ipv4("172.20.1.1");
+    });
+    bench("private_ipv4/regex", n, []() {
+        return std::regex_match(
+              "172.20.1.1",
+              std::regex{R"(^(?:(?:127\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"((?:192\.168\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"((?:10\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"((?:172\.1[6-9]\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"((?:172\.2[0-9]\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"((?:172\.3[0-1]\.[0-9]{1,3}\.[0-9]{1,3})|)"
+                         R"(localhost)$)"});
+    });
+    return 0;
+}
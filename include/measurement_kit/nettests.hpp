@@ -374,6 +374,8 @@ class MK_NETTESTS_DEPRECATED BaseTest {
             // NOTHING
         } else if (key == "status.measurement_uploaded") {
             // NOTHING
+        } else if (key == "status.measurement_spooled") {
+            // NOTHING
         } else if (key == "status.measurement_done") {
             // NOTHING
         } else if (key == "status.report_created") {
@@ -382,6 +384,8 @@ class MK_NETTESTS_DEPRECATED BaseTest {
             for (auto &cb : tip->begin_cbs) {
                 MK_NETTESTS_CALL_AND_SUPPRESS(cb, ());
             }
+        } else if (key == "status.startup_phase") {
+            // NOTHING
         } else if (key == "status.update.performance") {
             std::string direction = ev.at("value").at("direction");
             double elapsed = ev.at("value").at("elapsed");
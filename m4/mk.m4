@@ -71,6 +71,45 @@ AC_DEFUN([MK_AM_LIBCURL], [
   fi
 ])
 
+AC_DEFUN([MK_AM_ZLIB], [
+  mk_not_needed=0
+  mk_required=0
+  AC_ARG_WITH([zlib],
+              [AS_HELP_STRING([--with-zlib],
+                [zlib library, used to write .gz reports @<:@default=check@:>@])
+              ],
+              [
+                if test "$withval" = "no"; then
+                  mk_not_needed=1
+                elif test "$withval" != "yes"; then
+                  CPPFLAGS="$CPPFLAGS -I$withval/include"
+                  LDFLAGS="$LDFLAGS -L$withval/lib"
+                  mk_required=1
+                else
+                  mk_required=1
+                fi
+              ],
+              [])
+  if test $mk_not_needed -eq 0; then
+    mk_not_found=""
+    AC_CHECK_HEADERS(zlib.h, [], [mk_not_found=1])
+    AC_CHECK_LIB(z, gzdopen, [], [mk_not_found=1])
+    if test "$mk_not_found" = "1"; then
+      AC_MSG_WARN([Failed to find dependency: zlib])
+      echo "    - to install on Debian: sudo apt-get install zlib1g-dev"
+      echo "    - to install on OSX: brew install zlib"
+      if test $mk_required -eq 1; then
+        AC_MSG_ERROR([Please, install zlib and run configure again])
+      fi
+      AC_MSG_WARN([Building without zlib: .gz reports will not be supported])
+      mk_not_needed=1
+    fi
+  fi
+  if test $mk_not_needed -eq 1; then
+    CPPFLAGS="$CPPFLAGS -DMK_WITHOUT_ZLIB"
+  fi
+])
+
 AC_DEFUN([MK_AM_LIBMAXMINDDB], [
   AC_ARG_WITH([libmaxminddb],
               [AS_HELP_STRING([--with-libmaxminddb],
@@ -170,6 +170,10 @@ MK_DEFINE_ERR(16, TimeoutError, "generic_timeout_error")
 /// `JsonProcessingError` indicates an error processing a JSON.
 MK_DEFINE_ERR(17, JsonProcessingError, "json_processing_error")
 
+/// \brief `OperationCancelledError` indicates that an operation was not
+/// started because it was cancelled, e.g. by a deadline.
+MK_DEFINE_ERR(18, OperationCancelledError, "operation_cancelled")
+
 /// \brief `MK_ERR_NET` takes a relative error code and returns an error code
 /// inside of the error codes space reserved for the net sub-library.
 #define MK_ERR_NET(x) (1000 + x)
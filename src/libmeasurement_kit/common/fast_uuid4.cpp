@@ -0,0 +1,68 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/fast_uuid4.hpp"
+
+#include <measurement_kit/internal/vendor/mkuuid4.hpp>
+
+#include <openssl/rand.h>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace mk {
+
+namespace {
+
+class RandomPool {
+  public:
+    // Returns false if OpenSSL cannot give us random bytes
+    bool read(uint8_t *out, size_t count) {
+        if (offset_ + count > sizeof(buffer_)) {
+            if (RAND_bytes(buffer_, (int)sizeof(buffer_)) != 1) {
+                return false;
+            }
+            offset_ = 0;
+        }
+        memcpy(out, buffer_ + offset_, count);
+        // Do not leave around bytes that we have already used
+        memset(buffer_ + offset_, 0, count);
+        offset_ += count;
+        return true;
+    }
+
+  private:
+    uint8_t buffer_[1024];
+    size_t offset_ = sizeof(buffer_);
+};
+
+} // namespace
+
+std::string fast_uuid4() {
+    // See the comment in libssl.hpp about thread_local on iOS armv7
+#ifndef MK_NO_THREAD_LOCAL
+    static thread_local
+#endif
+          RandomPool pool;
+    uint8_t bytes[16];
+    if (!pool.read(bytes, sizeof(bytes))) {
+        return mk::uuid4::gen();
+    }
+    // See <https://tools.ietf.org/html/rfc4122#section-4.4>
+    bytes[6] = (uint8_t)((bytes[6] & 0x0f) | 0x40);
+    bytes[8] = (uint8_t)((bytes[8] & 0x3f) | 0x80);
+    static const char digits[] = "0123456789abcdef";
+    std::string result(36, '-');
+    size_t pos = 0;
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            pos += 1; // Skip the dash
+        }
+        result[pos++] = digits[bytes[i] >> 4];
+        result[pos++] = digits[bytes[i] & 0x0f];
+    }
+    return result;
+}
+
+} // namespace mk
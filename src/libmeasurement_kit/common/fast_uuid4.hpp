@@ -0,0 +1,17 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_FAST_UUID4_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_FAST_UUID4_HPP
+
+#include <string>
+
+namespace mk {
+
+/// \brief `fast_uuid4()` returns a random UUID4 like mk::uuid4::gen() does
+/// but reads the random bytes from OpenSSL's CSPRNG in batches, using a
+/// buffer per thread, rather than opening a random device for each UUID.
+std::string fast_uuid4();
+
+} // namespace mk
+#endif
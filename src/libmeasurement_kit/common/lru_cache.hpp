@@ -0,0 +1,67 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_LRU_CACHE_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_LRU_CACHE_HPP
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <utility>
+
+namespace mk {
+
+/// \brief `LruCache` maps keys to values and keeps at most `capacity`
+/// of them, discarding the least recently used one when full. It is not
+/// thread safe: callers must serialize access.
+template <typename Key, typename Value> class LruCache {
+  public:
+    explicit LruCache(size_t capacity) : capacity_{capacity} {}
+
+    /// `get()` returns a pointer to the value bound to \p key, which is
+    /// valid until the next modification of the cache, or nullptr.
+    Value *get(const Key &key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        items_.splice(items_.begin(), items_, it->second);
+        return &it->second->second;
+    }
+
+    void put(const Key &key, Value value) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            it->second->second = std::move(value);
+            items_.splice(items_.begin(), items_, it->second);
+            return;
+        }
+        if (capacity_ <= 0) {
+            return;
+        }
+        if (items_.size() >= capacity_) {
+            index_.erase(items_.back().first);
+            items_.pop_back();
+        }
+        items_.emplace_front(key, std::move(value));
+        index_[key] = items_.begin();
+    }
+
+    void clear() {
+        index_.clear();
+        items_.clear();
+    }
+
+    size_t size() const { return items_.size(); }
+
+  private:
+    using Items = std::list<std::pair<Key, Value>>;
+
+    size_t capacity_ = 0;
+    Items items_;
+    std::map<Key, typename Items::iterator> index_;
+};
+
+} // namespace mk
+#endif
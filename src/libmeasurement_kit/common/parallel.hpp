@@ -9,60 +9,196 @@
 #include "src/libmeasurement_kit/common/continuation.hpp"
 #include "src/libmeasurement_kit/common/error.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
 namespace mk {
 
-static inline void run(size_t idx, std::vector<Continuation<Error>> input,
-                       Callback<Error> cb, SharedPtr<Error> overall,
-                       SharedPtr<size_t> completed, size_t parallelism) {
-    if (idx < input.size()) {
-        input[idx]([=](Error error) {
-            // XXX: code not thread safe, to make thread safe we could
-            // share a mutex or use call_later() to serialize
-            if (error && *overall == NoError()) {
-                static const Error template_error = ParallelOperationError();
-                overall->code = template_error.code;
-                overall->reason = template_error.reason;
-                // FALLTHROUGH
+/// \brief `ParallelPolicy` controls how parallel() schedules continuations.
+/// By default all of them run at once and we wait for all of them.
+class ParallelPolicy {
+  public:
+    /// Maximum number of continuations in flight; zero means no limit.
+    size_t parallelism = 0;
+
+    /// Whether to stop starting continuations after the first error.
+    bool abort_on_error = false;
+
+    /// Seconds after which we stop starting continuations; negative
+    /// means that there is no deadline.
+    double deadline = -1.0;
+
+    /// Set to true to stop starting continuations (e.g. from another
+    /// continuation or from another thread).
+    SharedPtr<std::atomic<bool>> cancelled{new std::atomic<bool>(false)};
+};
+
+/*
+    Lanes take the next continuation from a shared cursor when they become
+    free, so a slow continuation does not delay the ones that would have
+    followed it in its lane. We stop starting continuations when cancelled,
+    past the deadline, or after an error if so requested; the ones that did
+    not start fail with OperationCancelledError. In any case, we call back
+    once all started continuations have completed.
+
+    Completions may happen in any thread, because we serialize access to
+    the state using a mutex that is never held when calling user code. A
+    continuation completing immediately does not recurse: the lane loop
+    that started it also starts the next one.
+*/
+class ParallelState {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<Continuation<Error>> input;
+    Callback<Error> callback;
+    ParallelPolicy policy;
+    Clock::time_point deadline;
+    std::mutex mutex;
+    Error overall = NoError();
+    size_t cursor = 0;
+    size_t completed = 0;
+    bool stopped = false;
+
+    // Must be called with the mutex held
+    bool should_stop() {
+        if (!stopped &&
+            (*policy.cancelled ||
+             (policy.abort_on_error && overall != NoError()) ||
+             (policy.deadline >= 0.0 && Clock::now() >= deadline))) {
+            stopped = true;
+        }
+        return stopped;
+    }
+
+    // Must be called with the mutex held; returns true when this call
+    // completed the last continuation, hence we should call back
+    bool cancel_remaining() {
+        static const Error cancelled = OperationCancelledError();
+        if (cursor >= input.size()) {
+            return false;
+        }
+        if (overall == NoError()) {
+            static const Error template_error = ParallelOperationError();
+            overall.code = template_error.code;
+            overall.reason = template_error.reason;
+        }
+        while (cursor < input.size()) {
+            overall.child_errors[cursor++] = cancelled;
+            completed += 1;
+        }
+        return completed == input.size();
+    }
+};
+
+static inline void parallel_lane(SharedPtr<ParallelState> state,
+                                 SharedPtr<bool> in_loop, size_t idx);
+
+// Runs continuations in a lane until one of them completes later
+static inline void parallel_loop(SharedPtr<ParallelState> state) {
+    for (;;) {
+        size_t idx = 0;
+        {
+            std::unique_lock<std::mutex> _{state->mutex};
+            if (state->should_stop()) {
+                if (state->cancel_remaining()) {
+                    _.unlock();
+                    state->callback(state->overall);
+                }
+                return;
             }
-            overall->child_errors[idx] = error;
-            *completed += 1;
-            if (*completed == input.size()) {
-                cb(*overall);
+            if (state->cursor >= state->input.size()) {
                 return;
             }
-            if (*completed > input.size()) {
+            idx = state->cursor++;
+        }
+        SharedPtr<bool> in_loop{new bool(true)};
+        parallel_lane(state, in_loop, idx);
+        {
+            std::unique_lock<std::mutex> _{state->mutex};
+            if (*in_loop) {
+                // Still running: its completion will continue the lane
+                *in_loop = false;
+                return;
+            }
+        }
+    }
+}
+
+static inline void parallel_lane(SharedPtr<ParallelState> state,
+                                 SharedPtr<bool> in_loop, size_t idx) {
+    state->input[idx]([=](Error error) {
+        bool done = false, continue_lane = false;
+        {
+            std::unique_lock<std::mutex> _{state->mutex};
+            if (error && state->overall == NoError()) {
+                static const Error template_error = ParallelOperationError();
+                state->overall.code = template_error.code;
+                state->overall.reason = template_error.reason;
+                // FALLTHROUGH
+            }
+            state->overall.child_errors[idx] = error;
+            state->completed += 1;
+            if (state->completed > state->input.size()) {
                 // Use exception, not assert, so it cannot be disabled using
                 // compiler flags and we always make this check
                 throw std::runtime_error("unexpected *complete value");
             }
-            run(idx + parallelism, input, cb, overall, completed, parallelism);
-        });
-    }
+            if (state->completed == state->input.size()) {
+                done = true;
+            } else if (*in_loop) {
+                // Completed immediately: the loop starts the next one
+                *in_loop = false;
+            } else {
+                continue_lane = true;
+            }
+        }
+        if (done) {
+            state->callback(state->overall);
+        } else if (continue_lane) {
+            parallel_loop(state);
+        }
+    });
 }
 
+/// \brief `parallel()` runs the continuations in \p input according to
+/// \p policy and then calls \p cb with ParallelOperationError, whose child
+/// errors are in the same order of \p input, if any continuation failed or
+/// was not started, and with NoError otherwise.
 static inline void parallel(std::vector<Continuation<Error>> input,
-                            Callback<Error> cb, size_t parallelism = 0) {
-    SharedPtr<Error> overall(new Error(NoError()));
+                            Callback<Error> cb, ParallelPolicy policy) {
     if (input.size() <= 0) {
-        cb(*overall);
+        cb(NoError());
         return;
     }
-    overall->child_errors.resize(input.size(), NoError());
-    SharedPtr<size_t> completed(new size_t(0));
-    if (parallelism <= 0) {
+    SharedPtr<ParallelState> state{new ParallelState};
+    size_t parallelism = policy.parallelism;
+    if (parallelism <= 0 || parallelism > input.size()) {
         parallelism = input.size();
     }
-    /*
-     * Possible improvement: use an atomic shared integer as opposed to
-     * using a counter to speed up the parallel process at the end, when
-     * some "threads" could terminate earlier than others.
-     *
-     * Enhancement suggested by @AntonioLangiu.
-     */
-    for (size_t idx = 0; idx < parallelism; ++idx) {
-        run(idx, input, cb, overall, completed, parallelism);
+    state->overall.child_errors.resize(input.size(), NoError());
+    state->input = std::move(input);
+    state->callback = std::move(cb);
+    using Clock = ParallelState::Clock;
+    state->deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                           std::chrono::duration<double>(
+                                                 policy.deadline));
+    state->policy = std::move(policy);
+    for (size_t lane = 0; lane < parallelism; ++lane) {
+        parallel_loop(state);
     }
 }
 
+/// \brief `parallel()` runs at most \p parallelism continuations at a time,
+/// or all of them at once when \p parallelism is zero.
+static inline void parallel(std::vector<Continuation<Error>> input,
+                            Callback<Error> cb, size_t parallelism = 0) {
+    ParallelPolicy policy;
+    policy.parallelism = parallelism;
+    parallel(std::move(input), std::move(cb), std::move(policy));
+}
+
 } // namespace mk
 #endif
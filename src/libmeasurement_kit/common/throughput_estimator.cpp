@@ -0,0 +1,133 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/common/throughput_estimator.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace mk {
+
+// Same interpolation as mk::percentile() but without sorting again
+static double sorted_percentile(const std::vector<double> &v, double percent) {
+    double pivot = (v.size() - 1) * percent;
+    double pivot_floor = floor(pivot);
+    double pivot_ceil = ceil(pivot);
+    if (pivot_floor == pivot_ceil) {
+        return v[(size_t)pivot];
+    }
+    return v[(size_t)pivot_floor] * (pivot_ceil - pivot) +
+           v[(size_t)pivot_ceil] * (pivot - pivot_floor);
+}
+
+nlohmann::json ThroughputSummary::as_json() const {
+    return {{"average", average}, {"count", count}, {"ewma", ewma},
+            {"p10", p10},         {"p50", p50},     {"p90", p90}};
+}
+
+RateStats::RateStats(double alpha, size_t expected) : alpha_{alpha} {
+    rates_.reserve(expected);
+}
+
+ThroughputSummary RateStats::summary(size_t window) const {
+    ThroughputSummary summary;
+    if (window <= 0 || window > rates_.size()) {
+        window = rates_.size();
+    }
+    if (window <= 0) {
+        return summary;
+    }
+    scratch_.assign(rates_.end() - window, rates_.end());
+    std::sort(scratch_.begin(), scratch_.end());
+    double sum = 0.0;
+    for (double rate : scratch_) {
+        sum += rate;
+    }
+    summary.average = sum / window;
+    summary.ewma = ewma_;
+    summary.p10 = sorted_percentile(scratch_, 0.1);
+    summary.p50 = sorted_percentile(scratch_, 0.5);
+    summary.p90 = sorted_percentile(scratch_, 0.9);
+    summary.count = window;
+    return summary;
+}
+
+ThroughputEstimator::ThroughputEstimator(double bin_width, size_t num_flows,
+                                         double expected_duration, double alpha)
+    : start_{Clock::now()}, bin_begin_{start_},
+      bin_duration_{std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(bin_width))},
+      bin_width_{bin_width}, flow_bin_bytes_(std::max<size_t>(num_flows, 1)),
+      stats_{alpha, (bin_width > 0.0 && expected_duration > 0.0)
+                          ? (size_t)ceil(expected_duration / bin_width) + 1
+                          : 0} {
+    if (bin_duration_ <= Clock::duration::zero()) {
+        bin_duration_ = Clock::duration{1}; // Avoid looping forever
+    }
+    bin_end_ = bin_begin_ + bin_duration_;
+    flow_rates_.reserve(stats_.rates().capacity() * flow_bin_bytes_.size());
+    bin_ends_.reserve(stats_.rates().capacity());
+}
+
+size_t ThroughputEstimator::complete_bins(Clock::time_point now) {
+    size_t completed = 0;
+    while (now >= bin_end_) {
+        complete_bin(bin_width_);
+        bin_begin_ = bin_end_;
+        bin_end_ += bin_duration_;
+        completed += 1;
+    }
+    return completed;
+}
+
+void ThroughputEstimator::complete_bin(double duration) {
+    auto kbit = [duration](uint64_t bytes) {
+        return (duration > 0.0) ? bytes * 8.0 / 1000.0 / duration : 0.0;
+    };
+    stats_.add(kbit(bin_bytes_));
+    bin_bytes_ = 0;
+    for (auto &bytes : flow_bin_bytes_) {
+        flow_rates_.push_back(kbit(bytes));
+        bytes = 0;
+    }
+    bin_ends_.push_back(
+          std::chrono::duration<double>(bin_begin_ - start_).count() +
+          duration);
+}
+
+void ThroughputEstimator::finish(Clock::time_point now) {
+    if (finish_elapsed_ >= 0.0) {
+        return;
+    }
+    (void)advance(now);
+    double partial = std::chrono::duration<double>(now - bin_begin_).count();
+    if (partial > 0.0 &&
+        (partial >= bin_width_ / 2 || stats_.rates().empty())) {
+        complete_bin(partial);
+    }
+    finish_elapsed_ = std::chrono::duration<double>(now - start_).count();
+}
+
+double ThroughputEstimator::elapsed(Clock::time_point now) const {
+    if (finish_elapsed_ >= 0.0) {
+        return finish_elapsed_;
+    }
+    return std::chrono::duration<double>(now - start_).count();
+}
+
+ThroughputSummary ThroughputEstimator::summary(size_t window) const {
+    ThroughputSummary summary = stats_.summary(window);
+    double seconds = elapsed();
+    summary.average = (seconds > 0.0) ? total_ * 8.0 / 1000.0 / seconds : 0.0;
+    return summary;
+}
+
+nlohmann::json ThroughputEstimator::summary_json(size_t window) const {
+    nlohmann::json json = summary(window).as_json();
+    json["bin_width"] = bin_width_;
+    return json;
+}
+
+} // namespace mk
@@ -0,0 +1,161 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_COMMON_THROUGHPUT_ESTIMATOR_HPP
+#define SRC_LIBMEASUREMENT_KIT_COMMON_THROUGHPUT_ESTIMATOR_HPP
+
+#include "src/libmeasurement_kit/common/error.hpp"
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+namespace mk {
+
+/// `ThroughputSummary` summarizes a series of rates in kbit/s.
+class ThroughputSummary {
+  public:
+    double average = 0.0; ///< Total bytes over total elapsed time
+    double ewma = 0.0;    ///< Exponentially weighted moving average
+    double p10 = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    size_t count = 0; ///< Number of rates used for the percentiles
+
+    nlohmann::json as_json() const;
+};
+
+/*
+    RateStats keeps a series of rates (in kbit/s) and their EWMA, and
+    computes percentiles over the whole series or over the last rates
+    only. Pass the expected number of rates to the constructor so that
+    adding a rate does not allocate.
+*/
+class RateStats {
+  public:
+    explicit RateStats(double alpha = 0.3, size_t expected = 0);
+
+    void add(double rate) {
+        ewma_ = (rates_.empty()) ? rate : alpha_ * rate + (1 - alpha_) * ewma_;
+        rates_.push_back(rate);
+    }
+
+    const std::vector<double> &rates() const { return rates_; }
+
+    double ewma() const { return ewma_; }
+
+    /// `summary()` computes the percentiles of the last \p window rates,
+    /// or of all of them when \p window is zero. The average is the mean
+    /// of the rates, which callers that know better may override.
+    ThroughputSummary summary(size_t window = 0) const;
+
+  private:
+    double alpha_ = 0.3;
+    double ewma_ = 0.0;
+    std::vector<double> rates_;
+    mutable std::vector<double> scratch_;
+};
+
+/*
+    ThroughputEstimator counts the bytes transferred by one or more flows
+    and splits time, as measured by a monotonic clock, in bins of fixed
+    width. When a bin is over we compute its aggregate rate and the rate
+    of each flow and feed the former to a RateStats.
+
+    Counting bytes is cheap: it reads the clock and, unless a bin is over,
+    updates two counters. Callers that want to report something when a
+    bin is over check the return value of add(). Bins in which nothing
+    was transferred have zero rate.
+*/
+class ThroughputEstimator {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// The constructor starts the clock. Pass the expected duration so
+    /// that completing a bin does not allocate.
+    ThroughputEstimator(double bin_width, size_t num_flows = 1,
+                        double expected_duration = 0.0, double alpha = 0.3);
+
+    /// `add()` accounts for \p bytes transferred by \p flow and returns
+    /// the number of bins completed since the previous call. It throws
+    /// ValueError, without counting anything, if there's no such flow.
+    size_t add(uint64_t bytes, size_t flow = 0) {
+        return add(bytes, flow, Clock::now());
+    }
+
+    size_t add(uint64_t bytes, size_t flow, Clock::time_point now) {
+        if (flow >= flow_bin_bytes_.size()) {
+            throw ValueError("invalid_flow");
+        }
+        size_t completed = advance(now);
+        total_ += bytes;
+        bin_bytes_ += bytes;
+        flow_bin_bytes_[flow] += bytes;
+        return completed;
+    }
+
+    /// `advance()` completes the bins that are over at \p now.
+    size_t advance(Clock::time_point now) {
+        if (now < bin_end_) {
+            return 0;
+        }
+        return complete_bins(now);
+    }
+
+    /// `finish()` completes all bins, including the current one, whose
+    /// rate is computed over the time elapsed since it began. Since the
+    /// rate of a short bin is noisy, the current bin is dropped when it
+    /// lasted less than half a bin, unless it's the only one. Its bytes
+    /// still count for the average.
+    void finish(Clock::time_point now = Clock::now());
+
+    double elapsed(Clock::time_point now = Clock::now()) const;
+
+    uint64_t total() const { return total_; }
+
+    double bin_width() const { return bin_width_; }
+
+    size_t num_flows() const { return flow_bin_bytes_.size(); }
+
+    /// `rates()` returns the aggregate rate of each completed bin.
+    const std::vector<double> &rates() const { return stats_.rates(); }
+
+    /// `flow_rate()` returns the rate of \p flow during bin \p bin.
+    double flow_rate(size_t bin, size_t flow) const {
+        return flow_rates_[bin * num_flows() + flow];
+    }
+
+    /// `bin_end()` returns when bin \p bin ended, relative to the start.
+    double bin_end(size_t bin) const { return bin_ends_[bin]; }
+
+    /// `summary()` is like RateStats::summary() except that the average
+    /// is computed over all bytes and all time.
+    ThroughputSummary summary(size_t window = 0) const;
+
+    /// `summary_json()` is like summary() but also includes the bin width.
+    nlohmann::json summary_json(size_t window = 0) const;
+
+  private:
+    size_t complete_bins(Clock::time_point now);
+    void complete_bin(double duration);
+
+    Clock::time_point start_;
+    Clock::time_point bin_begin_;
+    Clock::time_point bin_end_;
+    Clock::duration bin_duration_;
+    double bin_width_ = 0.0;
+    double finish_elapsed_ = -1.0;
+    uint64_t total_ = 0;
+    uint64_t bin_bytes_ = 0;
+    std::vector<uint64_t> flow_bin_bytes_;
+    std::vector<double> flow_rates_;
+    std::vector<double> bin_ends_;
+    RateStats stats_;
+};
+
+} // namespace mk
+#endif
@@ -0,0 +1,303 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/curl/multi.hpp"
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
+
+#ifndef MK_WITHOUT_CURL
+#include <curl/curl.h>
+#include <event2/event.h>
+#endif
+
+#include <map>
+#include <memory>
+
+namespace mk {
+namespace curl {
+
+Multi::~Multi() {}
+
+#ifndef MK_WITHOUT_CURL
+
+class CurlMulti : public Multi, public EnableSharedFromThis<CurlMulti> {
+  public:
+    CurlMulti(SharedPtr<Reactor> reactor, SharedPtr<Logger> logger)
+        : reactor_{std::move(reactor)}, logger_{std::move(logger)} {
+        multi_ = curl_multi_init();
+        if (multi_ == nullptr) {
+            throw std::runtime_error("curl_multi_init");
+        }
+        timer_ = evtimer_new(reactor_->get_event_base(), timer_event_cb, this);
+        if (timer_ == nullptr) {
+            curl_multi_cleanup(multi_);
+            throw std::runtime_error("evtimer_new");
+        }
+        if (curl_multi_setopt(multi_, CURLMOPT_SOCKETFUNCTION,
+                              socket_cb) != CURLM_OK ||
+            curl_multi_setopt(multi_, CURLMOPT_SOCKETDATA, this) != CURLM_OK ||
+            curl_multi_setopt(multi_, CURLMOPT_TIMERFUNCTION,
+                              timer_cb) != CURLM_OK ||
+            curl_multi_setopt(multi_, CURLMOPT_TIMERDATA, this) != CURLM_OK) {
+            event_free(timer_);
+            curl_multi_cleanup(multi_);
+            throw std::runtime_error("curl_multi_setopt");
+        }
+        // Multiplexing is the default since cURL 7.62.0; be explicit
+        // because that is why we share a single multi handle.
+        (void)curl_multi_setopt(multi_, CURLMOPT_PIPELINING,
+                                (long)CURLPIPE_MULTIPLEX);
+    }
+
+    ~CurlMulti() override {
+        for (auto &kv : pending_) {
+            (void)curl_multi_remove_handle(multi_, kv.first);
+        }
+        pending_.clear();
+        // Note: cleaning up may invoke socket_cb() to remove sockets
+        curl_multi_cleanup(multi_);
+        for (auto &kv : sockets_) {
+            event_free(kv.second);
+        }
+        event_free(timer_);
+    }
+
+    void perform(Request request,
+                 Callback<TransferResponse> &&callback) override {
+        start(std::move(request), std::move(callback), false);
+    }
+
+    void perform_http2(Request request,
+                       Callback<TransferResponse> &&callback) override {
+        request.enable_http2 = true;
+        start(std::move(request), std::move(callback), true);
+    }
+
+    size_t pending() override { return pending_.size(); }
+
+  private:
+    class PendingTransfer {
+      public:
+        std::unique_ptr<Transfer> transfer;
+        Callback<TransferResponse> callback;
+        bool http11_fallback = false;
+        Request request; // Only saved when we may need to fall back
+    };
+
+    CURLM *multi_ = nullptr;
+    std::map<CURL *, PendingTransfer> pending_;
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+    std::map<curl_socket_t, event *> sockets_;
+    event *timer_ = nullptr;
+
+    void start(Request request, Callback<TransferResponse> &&callback,
+               bool http11_fallback, bool force_http11 = false) {
+        Request saved;
+        if (http11_fallback) {
+            saved = request;
+        }
+        std::unique_ptr<Transfer> transfer{
+              new Transfer{std::move(request), force_http11}};
+        if (!transfer->prepare()) {
+            complete_soon(transfer->complete(CURLE_OK), std::move(callback));
+            return;
+        }
+        CURL *easy = static_cast<CURL *>(transfer->easy_handle());
+        if (curl_multi_add_handle(multi_, easy) != CURLM_OK) {
+            complete_soon(transfer->complete(CURLE_FAILED_INIT),
+                          std::move(callback));
+            return;
+        }
+        PendingTransfer &pt = pending_[easy];
+        pt.transfer = std::move(transfer);
+        pt.callback = std::move(callback);
+        pt.http11_fallback = http11_fallback;
+        pt.request = std::move(saved);
+    }
+
+    void complete_soon(TransferResponse response,
+                       Callback<TransferResponse> &&callback) {
+        // Deferred to avoid reentering cURL from within its callbacks
+        reactor_->call_soon([ response, callback ]() mutable {
+            callback(std::move(response));
+        });
+    }
+
+    void socket_action(curl_socket_t sock, int flags) {
+        SharedPtr<CurlMulti> guard = shared_from_this();
+        int running = 0;
+        CURLMcode rv = curl_multi_socket_action(multi_, sock, flags, &running);
+        if (rv != CURLM_OK) {
+            logger_->warn("curl: curl_multi_socket_action: %s",
+                          curl_multi_strerror(rv));
+        }
+        process_completed_transfers();
+    }
+
+    void process_completed_transfers() {
+        CURLMsg *msg = nullptr;
+        int left = 0;
+        while ((msg = curl_multi_info_read(multi_, &left)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL *easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+            (void)curl_multi_remove_handle(multi_, easy);
+            auto it = pending_.find(easy);
+            if (it == pending_.end()) {
+                continue;
+            }
+            if (it->second.transfer->should_retry(result) &&
+                curl_multi_add_handle(multi_, easy) == CURLM_OK) {
+                continue;
+            }
+            logger_->debug("curl: transfer complete: %s",
+                           curl_easy_strerror(result));
+            TransferResponse response =
+                  it->second.transfer->complete(result);
+            Callback<TransferResponse> callback =
+                  std::move(it->second.callback);
+            bool http11_fallback = it->second.http11_fallback;
+            Request request = std::move(it->second.request);
+            pending_.erase(it);
+            if (http11_fallback && (result == CURLE_HTTP2 ||
+                                    result == CURLE_HTTP2_STREAM)) {
+                logger_->debug("curl: retrying using HTTP/1.1");
+                request.enable_http2 = false;
+                std::vector<Log> logs = std::move(response.logs);
+                start(std::move(request), [
+                    logs = std::move(logs), callback = std::move(callback)
+                ](TransferResponse fallback_response) {
+                    // Keep the logs of the failed HTTP/2 attempt
+                    fallback_response.logs.insert(
+                          fallback_response.logs.begin(), logs.begin(),
+                          logs.end());
+                    callback(std::move(fallback_response));
+                }, false, true);
+                continue;
+            }
+            complete_soon(std::move(response), std::move(callback));
+        }
+    }
+
+    static int socket_cb(CURL *, curl_socket_t sock, int what, void *userp,
+                         void *) {
+        CurlMulti *self = static_cast<CurlMulti *>(userp);
+        auto it = self->sockets_.find(sock);
+        if (it != self->sockets_.end()) {
+            event_free(it->second);
+            self->sockets_.erase(it);
+        }
+        if (what == CURL_POLL_REMOVE) {
+            return 0;
+        }
+        short evflags = EV_PERSIST;
+        if ((what & CURL_POLL_IN) != 0) {
+            evflags |= EV_READ;
+        }
+        if ((what & CURL_POLL_OUT) != 0) {
+            evflags |= EV_WRITE;
+        }
+        event *evp = event_new(self->reactor_->get_event_base(), sock,
+                               evflags, socket_event_cb, self);
+        if (evp == nullptr || event_add(evp, nullptr) != 0) {
+            if (evp != nullptr) {
+                event_free(evp);
+            }
+            return -1;
+        }
+        self->sockets_[sock] = evp;
+        return 0;
+    }
+
+    static void socket_event_cb(evutil_socket_t sock, short evflags,
+                                void *opaque) {
+        int flags = 0;
+        if ((evflags & EV_READ) != 0) {
+            flags |= CURL_CSELECT_IN;
+        }
+        if ((evflags & EV_WRITE) != 0) {
+            flags |= CURL_CSELECT_OUT;
+        }
+        static_cast<CurlMulti *>(opaque)->socket_action(sock, flags);
+    }
+
+    static int timer_cb(CURLM *, long timeout_ms, void *userp) {
+        CurlMulti *self = static_cast<CurlMulti *>(userp);
+        if (timeout_ms < 0) {
+            return evtimer_del(self->timer_);
+        }
+        timeval tv{};
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        return evtimer_add(self->timer_, &tv);
+    }
+
+    static void timer_event_cb(evutil_socket_t, short, void *opaque) {
+        static_cast<CurlMulti *>(opaque)->socket_action(CURL_SOCKET_TIMEOUT, 0);
+    }
+};
+
+/*static*/ SharedPtr<Multi> Multi::make(SharedPtr<Reactor> reactor,
+                                        SharedPtr<Logger> logger) {
+    return SharedPtr<Multi>{std::make_shared<CurlMulti>(
+          std::move(reactor), std::move(logger))};
+}
+
+#else
+
+class DummyMulti : public Multi {
+  public:
+    explicit DummyMulti(SharedPtr<Reactor> reactor)
+        : reactor_{std::move(reactor)} {}
+
+    void perform(Request, Callback<TransferResponse> &&callback) override {
+        TransferResponse response;
+        response.error = -1;
+        Log log;
+        log.line = "MK was compiled without cURL support";
+        response.logs.push_back(std::move(log));
+        reactor_->call_soon([ response, callback ]() {
+            callback(response);
+        });
+    }
+
+    void perform_http2(Request request,
+                       Callback<TransferResponse> &&callback) override {
+        perform(std::move(request), std::move(callback));
+    }
+
+    size_t pending() override { return 0; }
+
+  private:
+    SharedPtr<Reactor> reactor_;
+};
+
+/*static*/ SharedPtr<Multi> Multi::make(SharedPtr<Reactor> reactor,
+                                        SharedPtr<Logger>) {
+    return SharedPtr<Multi>{std::make_shared<DummyMulti>(std::move(reactor))};
+}
+
+#endif // MK_WITHOUT_CURL
+
+void perform_http2(SharedPtr<Multi> multi, Request request,
+                   Callback<TransferResponse> callback) {
+    multi->perform_http2(std::move(request), std::move(callback));
+}
+
+Error response_error(const Response &response) {
+    if (response.error == 0) {
+        return NoError();
+    }
+#ifndef MK_WITHOUT_CURL
+    if (response.error == CURLE_OPERATION_TIMEDOUT) {
+        return TimeoutError();
+    }
+#endif
+    return GenericError();
+}
+
+} // namespace curl
+} // namespace mk
@@ -0,0 +1,65 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_CURL_MULTI_HPP
+#define SRC_LIBMEASUREMENT_KIT_CURL_MULTI_HPP
+
+#include "src/libmeasurement_kit/common/callback.hpp"
+#include "src/libmeasurement_kit/common/error.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+
+#include "src/libmeasurement_kit/curl/transfer.hpp"
+
+namespace mk {
+namespace curl {
+
+/*
+ * `Multi` performs many mkcurl requests concurrently from the reactor
+ * thread using a cURL multi handle. Rather than blocking in the easy API,
+ * it registers the sockets and the timeout cURL cares about with the event
+ * base of the reactor, so that transfers progress as part of the normal
+ * event loop. Transfers started from the same `Multi` share its connection
+ * cache, hence HTTP/2 transfers to the same origin are multiplexed over a
+ * single connection.
+ *
+ * The callback is always called from the reactor thread, never directly
+ * from within perform(). You must keep the `Multi` alive until all the
+ * callbacks have been called: destroying it aborts the pending transfers
+ * and their callbacks are not called. This way, a `Multi` does not outlive
+ * its owner when the reactor is stopped with transfers still pending.
+ *
+ * When MK is compiled without cURL, every request fails immediately with
+ * the `error` field of the response set to a nonzero value.
+ */
+class Multi : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<Multi> make(SharedPtr<Reactor>, SharedPtr<Logger>);
+
+    virtual void perform(Request, Callback<TransferResponse> &&) = 0;
+
+    /*
+     * Like perform() but uses HTTP/2 when the server supports it. cURL
+     * already falls back to HTTP/1.1 when ALPN does not select `h2`; on top
+     * of that, we retry once over HTTP/1.1 if the server negotiated HTTP/2
+     * but the transfer failed because of HTTP/2 framing or stream errors.
+     */
+    virtual void perform_http2(Request, Callback<TransferResponse> &&) = 0;
+
+    // Number of transfers that have not completed yet
+    virtual size_t pending() = 0;
+
+    virtual ~Multi();
+};
+
+// Same as Multi::perform_http2() but as a free function, to allow mocking
+void perform_http2(SharedPtr<Multi>, Request, Callback<TransferResponse>);
+
+// Maps the cURL error code of the response onto a MK error
+Error response_error(const Response &);
+
+} // namespace curl
+} // namespace mk
+#endif
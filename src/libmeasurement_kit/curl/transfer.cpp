@@ -0,0 +1,417 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/curl/transfer.hpp"
+
+#ifndef MK_WITHOUT_CURL
+#define CURL_STATICLIB // We build cURL as a static library
+#include <curl/curl.h>
+#endif
+
+#include <limits.h>
+
+#include <chrono>
+#include <sstream>
+
+namespace mk {
+namespace curl {
+
+#ifndef MK_WITHOUT_CURL
+
+// Appends `line` to `logs` with the current time, like mkcurl does
+static void log_line(std::vector<Log> &logs, std::string line) {
+    Log log;
+    log.msec = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now().time_since_epoch())
+                     .count();
+    log.line = std::move(line);
+    logs.push_back(std::move(log));
+}
+
+static void log_many_lines(std::vector<Log> &logs, const std::string &prefix,
+                           const std::string &str) {
+    std::stringstream ss{str};
+    std::string line;
+    while (std::getline(ss, line, '\n')) {
+        log_line(logs, (prefix.empty()) ? line : prefix + " " + line);
+    }
+}
+
+class CurlDeleter {
+  public:
+    void operator()(CURL *handle) { curl_easy_cleanup(handle); }
+};
+
+class SlistDeleter {
+  public:
+    void operator()(curl_slist *slist) { curl_slist_free_all(slist); }
+};
+
+using UniqueSlist = std::unique_ptr<curl_slist, SlistDeleter>;
+
+class Transfer::Impl {
+  public:
+    std::unique_ptr<CURL, CurlDeleter> handle;
+    Request req;
+    TransferResponse res;
+    UniqueSlist headers;
+    UniqueSlist connect_to;
+    bool force_http11 = false;
+    size_t retries = 0;
+
+    // Sets `option`, logging and saving the error on failure
+    template <typename Value> bool setopt(CURLoption option, Value value,
+                                          const char *name) {
+        res.error = curl_easy_setopt(handle.get(), option, value);
+        if (res.error != CURLE_OK) {
+            log_line(res.logs, std::string{"curl_easy_setopt("} + name +
+                                     ") failed");
+            return false;
+        }
+        return true;
+    }
+
+    // Gets `info`, logging and saving the error on failure
+    template <typename Value> bool getinfo(CURLINFO info, Value *value,
+                                           const char *name) {
+        res.error = curl_easy_getinfo(handle.get(), info, value);
+        if (res.error != CURLE_OK) {
+            log_line(res.logs, std::string{"curl_easy_getinfo("} + name +
+                                     ") failed");
+            return false;
+        }
+        return true;
+    }
+
+    bool append(UniqueSlist &slist, const std::string &s) {
+        curl_slist *p = curl_slist_append(slist.get(), s.c_str());
+        if (p == nullptr) {
+            res.error = CURLE_OUT_OF_MEMORY;
+            log_line(res.logs, "curl_slist_append() failed");
+            return false;
+        }
+        (void)slist.release(); // `p` is the head of the list
+        slist.reset(p);
+        return true;
+    }
+
+    bool configure();
+    void finish();
+    TransferResponse complete(int64_t error, const char *perform_name);
+};
+
+extern "C" {
+
+static size_t mk_curl_transfer_body_cb(char *ptr, size_t size, size_t nmemb,
+                                       void *userdata) {
+    if (nmemb <= 0 || size > SIZE_MAX / nmemb) {
+        return 0;
+    }
+    static_cast<Response *>(userdata)->body.append(ptr, size * nmemb);
+    return nmemb;
+}
+
+// Logs and counts the bytes like mkcurl's debug callback does
+static int mk_curl_transfer_debug_cb(CURL *, curl_infotype type, char *data,
+                                     size_t size, void *userptr) {
+    Response *res = static_cast<Response *>(userptr);
+    std::string s{(const char *)data, size};
+    switch (type) {
+    case CURLINFO_TEXT:
+        log_many_lines(res->logs, "", s);
+        break;
+    case CURLINFO_HEADER_IN:
+        log_many_lines(res->logs, "<", s);
+        res->response_headers += s;
+        res->bytes_recv += size;
+        break;
+    case CURLINFO_DATA_IN:
+        log_line(res->logs, "<data: " + std::to_string(size));
+        res->bytes_recv += size;
+        break;
+    case CURLINFO_SSL_DATA_IN:
+        log_line(res->logs, "<tls_data: " + std::to_string(size));
+        res->bytes_recv += size;
+        break;
+    case CURLINFO_HEADER_OUT:
+        log_many_lines(res->logs, ">", s);
+        res->request_headers += s;
+        res->bytes_sent += size;
+        break;
+    case CURLINFO_DATA_OUT:
+        log_line(res->logs, ">data: " + std::to_string(size));
+        res->bytes_sent += size;
+        break;
+    case CURLINFO_SSL_DATA_OUT:
+        log_line(res->logs, ">tls_data: " + std::to_string(size));
+        res->bytes_sent += size;
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+} // extern "C"
+
+bool Transfer::Impl::configure() {
+    for (auto &s : req.headers) {
+        if (!append(headers, s)) {
+            return false;
+        }
+    }
+    if (!req.connect_to.empty()) {
+        if (!append(connect_to, req.connect_to) ||
+            !setopt(CURLOPT_CONNECT_TO, connect_to.get(),
+                    "CURLOPT_CONNECT_TO")) {
+            return false;
+        }
+    }
+    if (req.enable_fastopen &&
+        !setopt(CURLOPT_TCP_FASTOPEN, 1L, "CURLOPT_TCP_FASTOPEN")) {
+        return false;
+    }
+    if (!req.ca_path.empty() &&
+        !setopt(CURLOPT_CAINFO, req.ca_path.c_str(), "CURLOPT_CAINFO")) {
+        return false;
+    }
+    if ((req.enable_http2 || force_http11) &&
+        !setopt(CURLOPT_HTTP_VERSION,
+                (force_http11) ? (long)CURL_HTTP_VERSION_1_1
+                               : (long)CURL_HTTP_VERSION_2_0,
+                "CURLOPT_HTTP_VERSION")) {
+        return false;
+    }
+    if (req.method == "POST" || req.method == "PUT") {
+        // Disable `Expect: 100-continue` like mkcurl does
+        if (!append(headers, "Expect:") ||
+            !setopt(CURLOPT_POST, 1L, "CURLOPT_POST") ||
+            !setopt(CURLOPT_POSTFIELDS, req.body.c_str(),
+                    "CURLOPT_POSTFIELDS")) {
+            return false;
+        }
+        if (req.body.size() > LONG_MAX) {
+            res.error = CURLE_FILESIZE_EXCEEDED;
+            log_line(res.logs, "Body larger than LONG_MAX");
+            return false;
+        }
+        if (!setopt(CURLOPT_POSTFIELDSIZE, (long)req.body.size(),
+                    "CURLOPT_POSTFIELDSIZE")) {
+            return false;
+        }
+        if (req.method == "PUT" &&
+            !setopt(CURLOPT_CUSTOMREQUEST, "PUT", "CURLOPT_CUSTOMREQUEST")) {
+            return false;
+        }
+    } else if (req.method != "GET") {
+        res.error = CURLE_BAD_FUNCTION_ARGUMENT;
+        log_line(res.logs, "unsupported request method");
+        return false;
+    }
+    if (headers && !setopt(CURLOPT_HTTPHEADER, headers.get(),
+                           "CURLOPT_HTTPHEADER")) {
+        return false;
+    }
+    long timeout = 0L; // Means: no timeout
+    if (req.timeout >= 0 && req.timeout < LONG_MAX) {
+        timeout = (long)req.timeout;
+    }
+    curl_write_callback body_cb = mk_curl_transfer_body_cb;
+    curl_debug_callback debug_cb = mk_curl_transfer_debug_cb;
+    Response *base = &res;
+    if (!setopt(CURLOPT_URL, req.url.c_str(), "CURLOPT_URL") ||
+        !setopt(CURLOPT_WRITEFUNCTION, body_cb, "CURLOPT_WRITEFUNCTION") ||
+        !setopt(CURLOPT_WRITEDATA, base, "CURLOPT_WRITEDATA") ||
+        // Don't use signals, which are not safe with many threads
+        !setopt(CURLOPT_NOSIGNAL, 1L, "CURLOPT_NOSIGNAL") ||
+        !setopt(CURLOPT_TIMEOUT, timeout, "CURLOPT_TIMEOUT") ||
+        !setopt(CURLOPT_DEBUGFUNCTION, debug_cb, "CURLOPT_DEBUGFUNCTION") ||
+        !setopt(CURLOPT_DEBUGDATA, base, "CURLOPT_DEBUGDATA") ||
+        !setopt(CURLOPT_VERBOSE, 1L, "CURLOPT_VERBOSE")) {
+        return false;
+    }
+    if (!req.proxy_url.empty() &&
+        !setopt(CURLOPT_PROXY, req.proxy_url.c_str(), "CURLOPT_PROXY")) {
+        return false;
+    }
+    if (req.follow_redir &&
+        !setopt(CURLOPT_FOLLOWLOCATION, 1L, "CURLOPT_FOLLOWLOCATION")) {
+        return false;
+    }
+    return setopt(CURLOPT_CERTINFO, 1L, "CURLOPT_CERTINFO");
+}
+
+void Transfer::Impl::finish() {
+    long status_code = 0L;
+    if (!getinfo(CURLINFO_RESPONSE_CODE, &status_code,
+                 "CURLINFO_RESPONSE_CODE")) {
+        return;
+    }
+    res.status_code = (int64_t)status_code;
+    char *url = nullptr;
+    if (!getinfo(CURLINFO_REDIRECT_URL, &url, "CURLINFO_REDIRECT_URL")) {
+        return;
+    }
+    if (url != nullptr) {
+        res.redirect_url = url;
+    }
+    curl_certinfo *certinfo = nullptr;
+    if (!getinfo(CURLINFO_CERTINFO, &certinfo, "CURLINFO_CERTINFO")) {
+        return;
+    }
+    for (int i = 0; certinfo != nullptr && i < certinfo->num_of_certs; ++i) {
+        for (curl_slist *p = certinfo->certinfo[i]; p != nullptr; p = p->next) {
+            // Just pass in the certificates and ignore the rest
+            std::string s = (p->data != nullptr) ? p->data : "";
+            if (s.find("Cert:") == 0) {
+                res.certs += s.substr(5);
+                res.certs += "\n";
+            }
+        }
+    }
+    char *ct = nullptr;
+    if (!getinfo(CURLINFO_CONTENT_TYPE, &ct, "CURLINFO_CONTENT_TYPE")) {
+        return;
+    }
+    if (ct != nullptr) {
+        res.content_type = ct;
+    }
+    long httpv = 0L;
+    if (!getinfo(CURLINFO_HTTP_VERSION, &httpv, "CURLINFO_HTTP_VERSION")) {
+        return;
+    }
+    res.http_version = (httpv == CURL_HTTP_VERSION_1_0) ? "HTTP/1.0"
+                     : (httpv == CURL_HTTP_VERSION_1_1) ? "HTTP/1.1"
+                     : (httpv == CURL_HTTP_VERSION_2_0) ? "HTTP/2" : "";
+    long num_connects = 0L;
+    if (!getinfo(CURLINFO_NUM_CONNECTS, &num_connects,
+                 "CURLINFO_NUM_CONNECTS")) {
+        return;
+    }
+    res.connection_reused = (num_connects == 0);
+    struct {
+        CURLINFO info;
+        const char *name;
+        int64_t *value;
+    } infos[] = {
+          {CURLINFO_SIZE_UPLOAD_T, "CURLINFO_SIZE_UPLOAD_T", &res.upload_size},
+          {CURLINFO_SIZE_DOWNLOAD_T, "CURLINFO_SIZE_DOWNLOAD_T",
+           &res.download_size},
+          {CURLINFO_NAMELOOKUP_TIME_T, "CURLINFO_NAMELOOKUP_TIME_T",
+           &res.namelookup_time_us},
+          {CURLINFO_CONNECT_TIME_T, "CURLINFO_CONNECT_TIME_T",
+           &res.connect_time_us},
+          {CURLINFO_APPCONNECT_TIME_T, "CURLINFO_APPCONNECT_TIME_T",
+           &res.appconnect_time_us},
+          {CURLINFO_PRETRANSFER_TIME_T, "CURLINFO_PRETRANSFER_TIME_T",
+           &res.pretransfer_time_us},
+          {CURLINFO_STARTTRANSFER_TIME_T, "CURLINFO_STARTTRANSFER_TIME_T",
+           &res.starttransfer_time_us},
+          {CURLINFO_TOTAL_TIME_T, "CURLINFO_TOTAL_TIME_T",
+           &res.total_time_us},
+    };
+    for (auto &i : infos) {
+        curl_off_t value = 0;
+        if (!getinfo(i.info, &value, i.name)) {
+            return;
+        }
+        *i.value = (int64_t)value;
+    }
+}
+
+Transfer::Transfer(Request request, bool force_http11) : impl_{new Impl} {
+    impl_->retries = request.retries;
+    impl_->force_http11 = force_http11;
+    impl_->req = std::move(request);
+}
+
+Transfer::~Transfer() {}
+
+bool Transfer::prepare() {
+    impl_->handle.reset(curl_easy_init());
+    if (!impl_->handle) {
+        impl_->res.error = CURLE_OUT_OF_MEMORY;
+        log_line(impl_->res.logs, "curl_easy_init() failed");
+        return false;
+    }
+    if (!impl_->configure()) {
+        impl_->handle.reset();
+        return false;
+    }
+    return true;
+}
+
+void *Transfer::easy_handle() { return impl_->handle.get(); }
+
+bool Transfer::should_retry(int64_t error) {
+    bool retriable = impl_->retries > 0 &&
+                     (error == CURLE_COULDNT_CONNECT ||
+                      error == CURLE_COULDNT_RESOLVE_HOST);
+    if (retriable) {
+        impl_->retries -= 1;
+        log_line(impl_->res.logs, "Transient failure; let's try one more time");
+    }
+    return retriable;
+}
+
+TransferResponse Transfer::Impl::complete(int64_t error,
+                                          const char *perform_name) {
+    if (handle) {
+        if (error != CURLE_OK) {
+            res.error = error;
+            log_line(res.logs, std::string{perform_name} + ": " +
+                                     curl_easy_strerror((CURLcode)error));
+        } else {
+            finish();
+        }
+    }
+    return std::move(res);
+}
+
+TransferResponse Transfer::complete(int64_t error) {
+    return impl_->complete(error, "curl_multi_perform");
+}
+
+TransferResponse Transfer::perform() {
+    CURLcode error = CURLE_OK;
+    if (impl_->handle) {
+        do {
+            error = curl_easy_perform(impl_->handle.get());
+        } while (error != CURLE_OK && should_retry(error));
+    }
+    return impl_->complete(error, "curl_easy_perform");
+}
+
+/*
+ * The blocking mkcurl API, implemented on top of Transfer. We only use the
+ * declarations of the vendored mkcurl.hpp, not its inline implementation,
+ * so that the configuration of cURL handles is not duplicated.
+ */
+inline namespace MKCURL_INLINE_NAMESPACE {
+
+class Client::Impl {};
+
+Client::Client() noexcept : impl_{new Client::Impl} {}
+Client::Client(Client &&) noexcept = default;
+Client &Client::operator=(Client &&) noexcept = default;
+Client::~Client() noexcept = default;
+
+// Unlike upstream mkcurl, each request uses a new easy handle, hence the
+// requests performed by a Client do not share connections
+Response Client::perform(const Request &request) noexcept {
+    return curl::perform(request);
+}
+
+Response perform(const Request &request) noexcept {
+    Transfer transfer{request};
+    (void)transfer.prepare(); // On failure, perform() returns the error
+    return transfer.perform();
+}
+
+} // inline namespace MKCURL_INLINE_NAMESPACE
+
+#endif // MK_WITHOUT_CURL
+
+} // namespace curl
+} // namespace mk
@@ -0,0 +1,105 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_CURL_TRANSFER_HPP
+#define SRC_LIBMEASUREMENT_KIT_CURL_TRANSFER_HPP
+
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include <measurement_kit/internal/vendor/mkcurl.hpp>
+
+#include <stdint.h>
+
+#include <memory>
+
+namespace mk {
+namespace curl {
+
+/*
+ * `TransferResponse` is the mkcurl Response of a Transfer along with the
+ * information about the transfer that mkcurl does not collect.
+ */
+class TransferResponse : public Response {
+  public:
+    /*
+     * Whether the transfer reused an established connection. With HTTP/2
+     * this means that it was multiplexed as a new stream.
+     */
+    bool connection_reused = false;
+
+    /* Body bytes, excluding headers and framing overhead. */
+    int64_t upload_size = 0;
+    int64_t download_size = 0;
+
+    /*
+     * Microseconds since the beginning of the transfer at which the
+     * name lookup, the TCP connect, the TLS handshake, the sending of the
+     * request, the first response byte and the whole transfer were done.
+     * For reused connections, the first three are zero or very small.
+     */
+    int64_t namelookup_time_us = 0;
+    int64_t connect_time_us = 0;
+    int64_t appconnect_time_us = 0;
+    int64_t pretransfer_time_us = 0;
+    int64_t starttransfer_time_us = 0;
+    int64_t total_time_us = 0;
+};
+
+/*
+    Transfer configures a cURL easy handle to perform an mkcurl Request.
+    Either the caller drives the I/O, e.g. by adding the handle to a cURL
+    multi handle, or perform() blocks until the transfer is complete. The
+    latter also implements mkcurl's perform() and Client, so that cURL
+    handles are configured only here. A Transfer cannot be copied or moved
+    because the handle points to its internal state.
+
+    When `force_http11` is true, we use HTTP/1.1 regardless of the value
+    of the `enable_http2` field of the request.
+*/
+class Transfer : public NonCopyable, public NonMovable {
+  public:
+    explicit Transfer(Request request, bool force_http11 = false);
+
+    ~Transfer();
+
+    /*
+     * `prepare()` creates and configures the easy handle. On failure it
+     * returns false and complete() returns the response with the error.
+     */
+    bool prepare();
+
+    /*
+     * `easy_handle()` returns the `CURL *` or nullptr if prepare() has
+     * not been called or has failed.
+     */
+    void *easy_handle();
+
+    /*
+     * `should_retry()` tells whether to retry after failing with
+     * \p error according to the `retries` field of the request. If so,
+     * remove the easy handle from the multi handle and add it back.
+     */
+    bool should_retry(int64_t error);
+
+    /*
+     * `complete()` returns the response of the transfer that completed
+     * with \p error. Call it at most once.
+     */
+    TransferResponse complete(int64_t error);
+
+    /*
+     * `perform()` runs the prepared transfer with the easy API, retrying
+     * as should_retry() says, and returns its response. Use it instead of
+     * driving the easy handle and calling complete() yourself.
+     */
+    TransferResponse perform();
+
+  private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace curl
+} // namespace mk
+#endif
@@ -120,12 +120,14 @@ static bool is_event_key_valid(const std::string &str) {
         (str == "status.progress") ||
         (str == "status.queued") ||
         (str == "status.measurement_start") ||
+        (str == "status.measurement_spooled") ||
         (str == "status.measurement_submission") ||
         (str == "status.measurement_done") ||
         (str == "status.report_close") ||
         (str == "status.report_create") ||
         (str == "status.resolver_lookup") ||
         (str == "status.started") ||
+        (str == "status.startup_phase") ||
         (str == "status.update.performance") ||
         (str == "status.update.websites") ||
         (str == "task_terminated");
@@ -249,6 +251,13 @@ nlohmann::json possibly_validate_event(nlohmann::json &&event) {
             assert(event.at("value").at("idx").is_number_integer());
             assert(event.at("value").count("input") == 1);
             assert(event.at("value").at("input").is_string());
+            assert(event.at("value").count("concurrency") == 0 ||
+                   event.at("value").at("concurrency").is_number_integer());
+            break;
+        }
+        if (event.at("key") == "status.measurement_spooled") {
+            assert(event.at("value").count("idx") == 1);
+            assert(event.at("value").at("idx").is_number_integer());
             break;
         }
         if (event.at("key") == "status.measurement_submission") {
@@ -276,6 +285,15 @@ nlohmann::json possibly_validate_event(nlohmann::json &&event) {
             assert(event.at("value").at("ip_address").is_string());
             break;
         }
+        if (event.at("key") == "status.startup_phase") {
+            assert(event.at("value").count("phase") == 1);
+            assert(event.at("value").at("phase").is_string());
+            assert(event.at("value").count("duration") == 1);
+            assert(event.at("value").at("duration").is_number_float());
+            assert(event.at("value").count("elapsed") == 1);
+            assert(event.at("value").at("elapsed").is_number_float());
+            break;
+        }
         if (event.at("key") == "status.update.performance") {
             assert(event.at("value").count("direction") == 1);
             assert(event.at("value").at("direction").is_string());
@@ -318,12 +336,14 @@ static nlohmann::json known_events() {
     json.push_back("status.progress");
     json.push_back("status.queued");
     json.push_back("status.measurement_start");
+    json.push_back("status.measurement_spooled");
     json.push_back("status.measurement_submission");
     json.push_back("status.measurement_done");
     json.push_back("status.report_close");
     json.push_back("status.report_create");
     json.push_back("status.resolver_lookup");
     json.push_back("status.started");
+    json.push_back("status.startup_phase");
     json.push_back("status.update.performance");
     json.push_back("status.update.websites");
     json.push_back("task_terminated");
@@ -139,6 +139,44 @@ class Request {
     static ErrorOr<SharedPtr<Request>> make(Settings, Headers, std::string);
 };
 
+/*
+ * `RequestTemplate` is a request compiled once for tests that send many
+ * near-identical requests over the same connection (e.g. DASH). Tests that
+ * send one-off requests to different hosts, like web_connectivity and
+ * http_header_field_manipulation, have nothing to reuse and keep using
+ * `Request` through request() and request_sendrecv(). The request line
+ * and headers are serialized at init() time into fixed byte strings and
+ * only three slots change across requests: the path, the value of the
+ * Host header (unless passed explicitly in Headers) and Content-Length.
+ * Each serialize() fills the slots into a single block that is handed to
+ * the output buffer by reference, without per-header allocations. The
+ * `request` member is the prototype from which make_request() derives the
+ * `Request` stored into the `Response` for report generation.
+ */
+class RequestTemplate {
+  public:
+    Request request;
+
+    RequestTemplate() {}
+    Error init(Settings, Headers);
+
+    // Empty `path` and `host` mean: use the ones in the prototype
+    SharedPtr<Request> make_request(const std::string &path,
+                                    const std::string &body) const;
+    void serialize(net::Buffer &, const std::string &path,
+                   const std::string &host, const std::string &body,
+                   SharedPtr<Logger> logger) const;
+
+    static ErrorOr<SharedPtr<RequestTemplate>> make(Settings, Headers);
+
+  private:
+    std::string path_;         // Default value of the path slot
+    std::string before_path_;  // "GET "
+    std::string after_path_;   // " HTTP/1.1\r\n<headers>[Host: ]"
+    std::string host_;         // Default value of the host slot
+    bool has_host_slot_ = false;
+};
+
 struct Response {
     SharedPtr<Request> request;
     SharedPtr<Response> previous;
@@ -149,6 +187,7 @@ struct Response {
     std::string reason;
     Headers headers;
     std::string body;
+    size_t body_size = 0; // Also counted when `http/ignore_body` is set
 };
 
 ErrorOr<Url> redirect(const Url &orig_url, const std::string &location);
@@ -159,6 +198,11 @@ void request_connect(Settings, Callback<Error, SharedPtr<net::Transport>>,
 void request_send(SharedPtr<net::Transport>, Settings, Headers, std::string,
                   SharedPtr<Logger>, Callback<Error, SharedPtr<Request>>);
 
+// Same as above except that the request is generated from a template
+void request_send_template(SharedPtr<net::Transport>, SharedPtr<RequestTemplate>,
+                           std::string path, std::string body,
+                           SharedPtr<Logger>, Callback<Error, SharedPtr<Request>>);
+
 // Same as above except that the optional Request is passed in explicitly
 void request_maybe_send(ErrorOr<SharedPtr<Request>>, SharedPtr<net::Transport>,
                         SharedPtr<Logger>, Callback<Error, SharedPtr<Request>>);
@@ -95,6 +95,98 @@ void Request::serialize(net::Buffer &buff, SharedPtr<Logger> logger) {
     }
 }
 
+/*static*/ ErrorOr<SharedPtr<RequestTemplate>>
+RequestTemplate::make(Settings settings, Headers headers) {
+    SharedPtr<RequestTemplate> tmpl{std::make_shared<RequestTemplate>()};
+    Error error = tmpl->init(settings, headers);
+    if (error) {
+        return {error, {}};
+    }
+    return {NoError(), tmpl};
+}
+
+Error RequestTemplate::init(Settings settings, Headers headers) {
+    Error error = request.init(settings, headers, "");
+    if (error) {
+        return error;
+    }
+    path_ = (request.url_path != "") ? request.url_path : request.url.pathquery;
+    before_path_ = request.method + " ";
+    after_path_ = " " + request.protocol + "\r\n";
+    for (auto &h : request.headers) {
+        after_path_ += h.key + ": " + h.value + "\r\n";
+    }
+    // Same logic of Request::serialize() for the Host header
+    has_host_slot_ = (headers_find_first(request.headers, "host") == "");
+    if (has_host_slot_) {
+        after_path_ += "Host: ";
+        host_ = request.url.address;
+        if ((request.url.schema == "http" and request.url.port != 80) or
+            (request.url.schema == "https" and request.url.port != 443)) {
+            host_ += ":" + std::to_string(request.url.port);
+        }
+    }
+    return NoError();
+}
+
+SharedPtr<Request> RequestTemplate::make_request(
+        const std::string &path, const std::string &body) const {
+    SharedPtr<Request> req{std::make_shared<Request>(request)};
+    if (path != "") {
+        // Same normalization of Request::init() for `http/path`
+        req->url_path = (path[0] != '/') ? "/" + path : path;
+    }
+    req->body = body;
+    return req;
+}
+
+void RequestTemplate::serialize(net::Buffer &buff, const std::string &path,
+                                const std::string &host,
+                                const std::string &body,
+                                SharedPtr<Logger> logger) const {
+    const std::string &p = (path != "") ? path : path_;
+    // Same normalization of Request::init() for `http/path`
+    bool needs_slash = (p != "" && p[0] != '/');
+    const std::string &h = (host != "") ? host : host_;
+    std::string content_length;
+    if (body != "") {
+        content_length = "Content-Length: ";
+        content_length += std::to_string(body.length());
+        content_length += "\r\n";
+    }
+    SharedPtr<std::string> block{std::make_shared<std::string>()};
+    block->reserve(before_path_.size() + needs_slash + p.size() +
+                   after_path_.size() +
+                   (has_host_slot_ ? h.size() + 2 : 0) +
+                   content_length.size() + 2 + body.size());
+    block->append(before_path_);
+    if (needs_slash) {
+        block->append("/");
+    }
+    block->append(p);
+    block->append(after_path_);
+    if (has_host_slot_) {
+        block->append(h);
+        block->append("\r\n");
+    }
+    block->append(content_length);
+    block->append("\r\n");
+    size_t headers_length = block->size();
+    block->append(body);
+    // Splitting the headers for logging is what makes serialize() slow, so
+    // do that only when the output is actually going to be emitted.
+    if (logger->get_verbosity() >= MK_LOG_DEBUG) {
+        for (auto s : mk::split(block->substr(0, headers_length), "\r\n")) {
+            logger->debug("> %s", s.c_str());
+        }
+        logger->debug(">");
+        if (body != "") {
+            logger->debug2("%s", base64_encode_if_needed(body).c_str());
+        }
+    }
+    buff.write_reference(std::move(block));
+}
+
 /*
  _             _
 | | ___   __ _(_) ___
@@ -116,6 +208,18 @@ void request_send(SharedPtr<Transport> txp, Settings settings, Headers headers,
                        callback);
 }
 
+void request_send_template(SharedPtr<Transport> txp,
+                           SharedPtr<RequestTemplate> tmpl, std::string path,
+                           std::string body, SharedPtr<Logger> logger,
+                           Callback<Error, SharedPtr<Request>> callback) {
+    SharedPtr<Request> request = tmpl->make_request(path, body);
+    Buffer buff;
+    tmpl->serialize(buff, path, "", body, logger);
+    net::write(txp, buff, [=](Error err) {
+        callback(err, request);
+    });
+}
+
 void request_maybe_send(ErrorOr<SharedPtr<Request>> request, SharedPtr<Transport> txp,
                         SharedPtr<Logger> logger,
                         Callback<Error, SharedPtr<Request>> callback) {
@@ -183,6 +287,10 @@ static void request_recv_response_start(SharedPtr<RequestRecvResponse> ctx) {
         });
     }
 
+    ctx->parser->on_body_size([ctx](size_t n) {
+        ctx->response->body_size += n;
+    });
+
     ctx->parser->on_response([ctx](Response r) {
         *ctx->response = r;
         ctx->valid_response = true;
@@ -33,6 +33,10 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
 
     void on_body(std::function<void(std::string)> fn) { body_fn_ = fn; }
 
+    /// Like on_body() but only reports the size of each body chunk, so
+    /// callers that discard the body do not pay for copying it.
+    void on_body_size(std::function<void(size_t)> fn) { body_size_fn_ = fn; }
+
     void on_end(std::function<void()> fn) { end_fn_ = fn; }
 
     void feed(Buffer &data) {
@@ -52,6 +56,18 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
 
     void eof() { parser_execute(nullptr, 0); }
 
+    /// `pipeline()` tells the parser to keep the data following a response,
+    /// rather than failing, because it belongs to the next response. Call
+    /// resume() to continue parsing after each response has ended.
+    void pipeline(bool enable) { pipeline_ = enable; }
+
+    /// `resume()` unpauses the parser after the end of a response and
+    /// parses the data that followed it.
+    void resume() {
+        http_parser_pause(&parser_, 0);
+        parse();
+    }
+
     int do_message_begin_() {
         logger_->debug2("http: BEGIN");
         response_ = Response();
@@ -110,6 +126,9 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
         if (body_fn_) {
             body_fn_(std::string(s, n));
         }
+        if (body_size_fn_) {
+            body_size_fn_(n);
+        }
         return 0;
     }
 
@@ -122,9 +141,8 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
         // because otherwise, if for whatever reason we receive two messages
         // back to back, only the second will be stored.
         //
-        // If this will ever become a limitation because we decide for some
-        // reason to reuse the same parser for more than a single response
-        // we can simply fix by allowing the caller to unpause us.
+        // When pipelining, the data that follows stays buffered until
+        // the caller unpauses us using resume().
         http_parser_pause(&parser_, 1);
         return 0;
     }
@@ -133,12 +151,14 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
     Delegate<> begin_fn_;
     Delegate<Response> response_fn_;
     Delegate<std::string> body_fn_;
+    Delegate<size_t> body_size_fn_;
     Delegate<> end_fn_;
 
     SharedPtr<Logger> logger_;
     http_parser parser_;
     http_parser_settings settings_;
     Buffer buffer_;
+    bool pipeline_ = false;
 
     // Variables used during parsing
     Response response_;
@@ -174,8 +194,9 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
     void parse() {
         size_t total = 0;
         buffer_.for_each([&](const void *p, size_t n) {
-            total += parser_execute(p, n);
-            return true;
+            size_t x = parser_execute(p, n);
+            total += x;
+            return x == n; // Stop when paused at the end of a response
         });
         buffer_.discard(total);
     }
@@ -203,6 +224,9 @@ class ResponseParserNg : public NonCopyable, public NonMovable {
         // }
         //
         if (x != n) {
+            if (pipeline_ && HTTP_PARSER_ERRNO(&parser_) == HPE_PAUSED) {
+                return x;
+            }
             throw map_parser_error_();
         }
         return n;
@@ -9,6 +9,32 @@ namespace mlabns {
 
 ErrorOr<std::string> as_query(Settings &settings);
 
+/* static */ SharedPtr<SelectionCache> SelectionCache::global() {
+    static SharedPtr<SelectionCache> cache = make();
+    return cache;
+}
+
+/* static */ SharedPtr<SelectionCache> SelectionCache::make(size_t capacity) {
+    return SharedPtr<SelectionCache>{new SelectionCache{capacity}};
+}
+
+SelectionCache::SelectionCache(size_t capacity) : replies_{capacity} {}
+
+bool SelectionCache::get(const std::string &key, Reply *reply) {
+    std::lock_guard<std::mutex> _{mutex_};
+    std::pair<double, Reply> *entry = replies_.get(key);
+    if (entry == nullptr || entry->first < mk::time_now()) {
+        return false;
+    }
+    *reply = entry->second;
+    return true;
+}
+
+void SelectionCache::put(const std::string &key, Reply reply, double ttl) {
+    std::lock_guard<std::mutex> _{mutex_};
+    replies_.put(key, {mk::time_now() + ttl, std::move(reply)});
+}
+
 void query(std::string tool, Callback<Error, Reply> callback, Settings settings,
            SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
     query_impl(tool, callback, settings, reactor, logger);
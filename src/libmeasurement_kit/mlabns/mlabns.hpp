@@ -6,9 +6,16 @@
 
 #include <measurement_kit/common.hpp>
 
+#include "src/libmeasurement_kit/common/lru_cache.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
 #include "src/libmeasurement_kit/common/settings.hpp"
 
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <mutex>
+
 namespace mk {
 namespace mlabns {
 
@@ -27,6 +34,34 @@ class Reply {
     std::string fqdn;            ///< FQDN of sliver.
     std::string site;            ///< Site where sliver is.
     std::string country;         ///< Country where sliver is.
+
+    /// Candidates and their connect RTTs, when using the `latency` policy.
+    nlohmann::json selection;
+};
+
+/*
+    SelectionCache remembers the server chosen using the `latency` policy
+    for each tool and network, so that running several tests one after the
+    other does not probe the candidates each time. It is shared by the
+    whole process and is thread safe.
+*/
+class SelectionCache : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<SelectionCache> global();
+
+    static SharedPtr<SelectionCache> make(size_t capacity = 64);
+
+    /// `get()` returns whether there is a fresh reply for \p key.
+    bool get(const std::string &key, Reply *reply);
+
+    /// `put()` saves \p reply for \p key for \p ttl seconds.
+    void put(const std::string &key, Reply reply, double ttl);
+
+  private:
+    explicit SelectionCache(size_t capacity);
+
+    std::mutex mutex_;
+    LruCache<std::string, std::pair<double, Reply>> replies_;
 };
 
 /// Query mlab-ns and receive response.
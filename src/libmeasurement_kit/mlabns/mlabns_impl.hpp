@@ -9,9 +9,22 @@
 
 #include "src/libmeasurement_kit/mlabns/mlabns.hpp"
 #include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/parallel.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
+#include "src/libmeasurement_kit/net/connect.hpp"
 #include "src/libmeasurement_kit/regexp/regexp.hpp"
 
+/*
+ * With the `latency` policy, we ask mlab-ns for several nearby candidates
+ * (i.e. we use the `geo_options` policy) and we concurrently connect to
+ * each of them, with a tight timeout, to measure the connect RTT. We then
+ * pick the candidate with the lowest RTT, because the server that mlab-ns
+ * returns is not always the closest one to us in terms of latency, and
+ * that skews throughput measurements. We remember the choice for a while,
+ * per tool and network, to avoid probing before each test.
+ */
+
 namespace mk {
 namespace mlabns {
 
@@ -26,13 +39,14 @@ static inline ErrorOr<std::string> as_query(Settings &settings) {
     }
     if (policy != "") {
         if (policy != "geo" && policy != "random" && policy != "metro" &&
-            policy != "country") {
+            policy != "country" && policy != "latency") {
             return {InvalidPolicyError(), std::string{}};
         }
         if (query != "") {
             query += "&";
         }
-        query += "policy=" + policy;
+        query += "policy=";
+        query += (policy == "latency") ? "geo_options" : policy;
     }
     if (country != "") {
         if (!regexp::valid_country_code(country)) {
@@ -80,7 +94,114 @@ static inline http::Headers make_headers(const Settings &settings) noexcept {
   return headers;
 }
 
-template <MK_MOCK_AS(http::request_json_no_body, request_json_no_body)>
+static inline Reply parse_reply(const nlohmann::json &node) {
+    Reply reply;
+    reply.city = node.at("city");
+    reply.url = node.at("url");
+    for (auto ip2 : node.at("ip")) {
+        reply.ip.push_back(ip2);
+    }
+    reply.fqdn = node.at("fqdn");
+    reply.site = node.at("site");
+    reply.country = node.at("country");
+    return reply;
+}
+
+// Whether we could connect to at least one candidate, otherwise we have
+// trusted mlab-ns and there is no point in remembering the selection
+static inline bool probe_succeeded(const Reply &reply) {
+    for (auto &probe : reply.selection.at("candidates")) {
+        if (!probe.at("connect_time").is_null()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <MK_MOCK_AS(net::connect, net_connect)>
+void probe_candidates_impl(std::vector<Reply> candidates, int probe_port,
+                           Callback<Error, Reply> callback, Settings settings,
+                           SharedPtr<Reactor> reactor,
+                           SharedPtr<Logger> logger) {
+    if (candidates.empty()) {
+        logger->warn("mlabns: no candidate servers");
+        callback(JsonProcessingError(), Reply());
+        return;
+    }
+    ErrorOr<double> timeout =
+          settings.get_noexcept("mlabns/probe_timeout", 1.0);
+    if (!timeout || *timeout <= 0) {
+        callback(ValueError(), Reply());
+        return;
+    }
+    settings["net/timeout"] = *timeout;
+    SharedPtr<nlohmann::json> probes{
+          new nlohmann::json(nlohmann::json::array())};
+    std::vector<Continuation<Error>> input;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        int port = probe_port;
+        if (port <= 0) {
+            ErrorOr<http::Url> url =
+                  http::parse_url_noexcept(candidates[i].url);
+            port = (!!url) ? url->port : 443;
+        }
+        probes->push_back({
+              {"connect_time", nullptr},
+              {"failure", nullptr},
+              {"fqdn", candidates[i].fqdn},
+              {"port", port},
+              {"site", candidates[i].site},
+        });
+        std::string fqdn = candidates[i].fqdn;
+        input.push_back([=](Callback<Error> cb) {
+            net_connect(fqdn, port,
+                        [=](Error err, SharedPtr<net::Transport> txp) {
+                            if (err) {
+                                logger->debug(
+                                      "mlabns: cannot connect to %s: %s",
+                                      fqdn.c_str(), err.what());
+                                (*probes)[i]["failure"] = err.reason;
+                                cb(err);
+                                return;
+                            }
+                            (*probes)[i]["connect_time"] = txp->connect_time();
+                            txp->close([=]() { cb(NoError()); });
+                        },
+                        settings, reactor, logger);
+        });
+    }
+    // Note: we ignore the overall error since failed probes are just
+    // candidates that we won't pick, and we deal with all of them failing
+    parallel(std::move(input), [=](Error) {
+        size_t best = 0;
+        bool found = false;
+        for (size_t i = 0; i < probes->size(); ++i) {
+            nlohmann::json &probe = (*probes)[i];
+            if (probe["connect_time"].is_null()) {
+                continue;
+            }
+            if (!found || probe["connect_time"].get<double>() <
+                                (*probes)[best]["connect_time"].get<double>()) {
+                best = i;
+                found = true;
+            }
+        }
+        if (!found) {
+            // Perhaps we cannot connect to the probe port: trust mlab-ns
+            logger->warn("mlabns: cannot connect to any candidate server");
+        }
+        Reply reply = candidates[best];
+        reply.selection = nlohmann::json{
+              {"cached", false},
+              {"candidates", *probes},
+              {"selected", reply.fqdn},
+        };
+        callback(NoError(), reply);
+    });
+}
+
+template <MK_MOCK_AS(http::request_json_no_body, request_json_no_body),
+          MK_MOCK_AS(net::connect, net_connect)>
 void query_impl(std::string tool, Callback<Error, Reply> callback,
                 Settings settings, SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
     ErrorOr<std::string> query = as_query(settings);
@@ -91,33 +212,81 @@ void query_impl(std::string tool, Callback<Error, Reply> callback,
     std::string url = settings.get("mlabns/base_url", std::string{
                                        "https://locate.measurementlab.net/",
                                    });
-    if (!regexp::lowercase_letters_only(tool)) {
+    if (!regexp::valid_mlabns_tool_name(tool)) {
         callback(InvalidToolNameError(), Reply());
         return;
     }
+    bool latency = (settings.get("mlabns/policy", "") == "latency");
+    ErrorOr<double> cache_ttl =
+          settings.get_noexcept("mlabns/cache_ttl", 300.0);
+    ErrorOr<int> probe_port = settings.get_noexcept("mlabns/probe_port", 0);
+    if (!cache_ttl || !probe_port) {
+        callback(ValueError(), Reply());
+        return;
+    }
+    // Note: the real probe IP and ASN, which Runnable passes down the
+    // stack after the GeoIP lookup, identify the network
+    std::string cache_key = tool + *query + " " +
+                            settings.get("real_probe_ip_", std::string{}) +
+                            " " +
+                            settings.get("real_probe_asn_", std::string{});
+    if (latency && *cache_ttl > 0) {
+        Reply reply;
+        if (SelectionCache::global()->get(cache_key, &reply)) {
+            logger->info("Using cached mlab test server: %s",
+                         reply.fqdn.c_str());
+            reply.selection["cached"] = true;
+            callback(NoError(), reply);
+            return;
+        }
+    }
     url += tool;
     url += *query;
     logger->debug("query mlabns for tool %s", tool.c_str());
     logger->debug("mlabns url: %s", url.c_str());
     request_json_no_body("GET", url, make_headers(settings),
-        [callback, logger](Error error, SharedPtr<http::Response> /*response*/,
-                           nlohmann::json node) {
+        [=](Error error, SharedPtr<http::Response> /*response*/,
+            nlohmann::json node) {
             if (error) {
                 logger->warn("mlabns: HTTP error: %s", error.what());
                 callback(error, Reply());
                 return;
             }
+            if (latency) {
+                std::vector<Reply> candidates;
+                try {
+                    if (node.is_array()) {
+                        for (auto &entry : node) {
+                            candidates.push_back(parse_reply(entry));
+                        }
+                    } else {
+                        candidates.push_back(parse_reply(node));
+                    }
+                } catch (const std::exception &) {
+                    logger->warn("mlabns: cannot parse json");
+                    callback(JsonProcessingError(), Reply());
+                    return;
+                }
+                probe_candidates_impl<net_connect>(
+                      candidates, *probe_port,
+                      [=](Error err, Reply reply) {
+                          if (!err) {
+                              logger->info("Selected mlab test server: %s",
+                                           reply.fqdn.c_str());
+                              if (*cache_ttl > 0 && probe_succeeded(reply)) {
+                                  SelectionCache::global()->put(
+                                        cache_key, reply, *cache_ttl);
+                              }
+                          }
+                          callback(err, reply);
+                      },
+                      settings, reactor, logger);
+                return;
+            }
             Reply reply;
             Error err = NoError();
             try {
-                reply.city = node.at("city");
-                reply.url = node.at("url");
-                for (auto ip2 : node.at("ip")) {
-                    reply.ip.push_back(ip2);
-                }
-                reply.fqdn = node.at("fqdn");
-                reply.site = node.at("site");
-                reply.country = node.at("country");
+                reply = parse_reply(node);
             } catch (const std::exception &) {
                 err = JsonProcessingError();
             }
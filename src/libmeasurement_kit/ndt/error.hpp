@@ -54,6 +54,7 @@ MK_DEFINE_ERR(MK_ERR_NDT(41), FormatMsgWaitingError, "ndt_cannot_format_msg_wait
 MK_DEFINE_ERR(MK_ERR_NDT(42), InvalidDurationError, "ndt_invalid_duration_setting")
 MK_DEFINE_ERR(MK_ERR_NDT(43), InvalidSnapsDelayError, "ndt_invalid_snaps_delay_setting")
 MK_DEFINE_ERR(MK_ERR_NDT(44), InvalidNumStreamsError, "ndt_invalid_num_streams_setting")
+MK_DEFINE_ERR(MK_ERR_NDT(45), InvalidProtocolError, "ndt_invalid_protocol_setting")
 
 } // namespace ndt
 } // namespace mk
@@ -10,15 +10,18 @@
 #include "src/libmeasurement_kit/common/continuation.hpp"
 #include "src/libmeasurement_kit/common/lexical_cast.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/throughput_estimator.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 
 #include "src/libmeasurement_kit/ndt/error.hpp"
 #include "src/libmeasurement_kit/ndt/run.hpp"
-#include "src/libmeasurement_kit/ndt/measure_speed.hpp"
 
 #include "src/libmeasurement_kit/net/connect.hpp"
 #include "src/libmeasurement_kit/net/error.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
+#include "src/libmeasurement_kit/net/tcp_info.hpp"
 #include "src/libmeasurement_kit/net/transport.hpp"
+#include "src/libmeasurement_kit/net/websocket.hpp"
 
 #include "measurement_kit/ndt.hpp"
 
@@ -84,6 +87,8 @@ static inline std::string id_to_name(int id) {
 #define KICKOFF_MESSAGE_SIZE (sizeof(KICKOFF_MESSAGE) - 1)
 
 #define NDT_PORT 3001
+#define NDT7_PORT 80
+#define NDT7_TLS_PORT 443
 #define NDT_TIMEOUT 10.0
 
 // During the handshake we declare to be measurement-kit version such and
@@ -160,6 +165,25 @@ void write_noasync(SharedPtr<Context>, Buffer);
 
 Error add_to_report(SharedPtr<nlohmann::json> entry, std::string key, std::string item);
 
+// Removes a whole message from the head of `buff`, if there is one
+bool read_frame(Buffer &buff, uint8_t *type, std::string *payload);
+
+// Extracts the `msg` string from a JSON message without parsing it all
+ErrorOr<std::string> extract_msg(const std::string &payload);
+
+// The server sends web100 variables as `name: value` lines spread over
+// many TEST_MSG messages; we keep them as strings and only convert them
+// to JSON when we write the report
+class Web100Table {
+  public:
+    void add_lines(const std::string &s);
+    size_t size() const { return vars_.size(); }
+    nlohmann::json as_json() const;
+
+  private:
+    std::vector<std::pair<std::string, std::string>> vars_;
+};
+
 } // namespace messages
 
 /*
@@ -197,7 +221,19 @@ void disconnect_and_callback(SharedPtr<Context> ctx, Error err);
 */
 namespace test_c2s {
 
-void coroutine(SharedPtr<nlohmann::json>, std::string address, int port, double runtime,
+struct Params {
+    int port = -1;
+    double duration = TEST_C2S_DURATION;
+    int num_streams = 1;
+
+    Params(){}
+
+    // This constructor only sets the port and all the other settings
+    // instead remain at their default value
+    Params(int port) : port(port) {}
+};
+
+void coroutine(SharedPtr<nlohmann::json>, std::string address, Params params,
                Callback<Error, Continuation<Error>> cb, double timeout,
                Settings settings, SharedPtr<Reactor> reactor,
                SharedPtr<Logger> logger);
@@ -261,6 +297,32 @@ void run(SharedPtr<Context> ctx, Callback<Error> callback);
 
 } // namespace test_s2c
 
+/*
+ _   _ ____ _____ _____
+| \ | |  _ \_   _|___  |
+|  \| | | | || |    / /
+| |\  | |_| || |   / /
+|_| \_|____/ |_|  /_/
+
+    ndt7: download and upload using a single WebSocket flow each
+*/
+namespace ndt7 {
+
+void connect(SharedPtr<Context> ctx, std::string path,
+             Callback<Error, SharedPtr<Transport>, SharedPtr<Buffer>> callback);
+
+void download(SharedPtr<Context> ctx, Callback<Error> callback);
+
+void upload(SharedPtr<Context> ctx, Callback<Error> callback);
+
+void run_with_specific_server(SharedPtr<nlohmann::json> entry,
+                              std::string address, int port,
+                              Callback<Error> callback, Settings settings,
+                              SharedPtr<Reactor> reactor,
+                              SharedPtr<Logger> logger);
+
+} // namespace ndt7
+
 /*
  _   _ _   _ _
 | | | | |_(_) |___
@@ -4,6 +4,8 @@
 
 #include "src/libmeasurement_kit/ndt/messages_impl.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 namespace mk {
@@ -77,6 +79,18 @@ void write_noasync(SharedPtr<Context> ctx, Buffer buff) {
     ctx->txp->write(buff);
 }
 
+static nlohmann::json as_number_or_string(const std::string &value) {
+    ErrorOr<long> as_long = lexical_cast_noexcept<long>(value);
+    if (!!as_long) {
+        return *as_long;
+    }
+    ErrorOr<double> as_double = lexical_cast_noexcept<double>(value);
+    if (!!as_double) {
+        return *as_double;
+    }
+    return value;
+}
+
 Error add_to_report(SharedPtr<nlohmann::json> entry, std::string key, std::string item) {
     std::list<std::string> list = split(item, ":");
     if (list.size() != 2) {
@@ -85,18 +99,360 @@ Error add_to_report(SharedPtr<nlohmann::json> entry, std::string key, std::strin
     // XXX: We should make sure that we remove leading and trailing whitespaces
     std::string variable = list.front();
     std::string value = list.back();
-    ErrorOr<long> as_long = lexical_cast_noexcept<long>(value);
-    if (!!as_long) {
-        (*entry)[key][variable] = *as_long;
-        return NoError();
+    (*entry)[key][variable] = as_number_or_string(value);
+    return NoError();
+}
+
+bool read_frame(Buffer &buff, uint8_t *type, std::string *payload) {
+    if (buff.length() < 3) {
+        return false;
     }
-    ErrorOr<double> as_double = lexical_cast_noexcept<double>(value);
-    if (!!as_double) {
-        (*entry)[key][variable] = *as_double;
-        return NoError();
+    std::string header = buff.peek(3);
+    size_t length = ((uint8_t)header[1] << 8) | (uint8_t)header[2];
+    if (buff.length() < 3 + length) {
+        return false;
     }
-    (*entry)[key][variable] = value;
-    return NoError();
+    buff.discard(3);
+    *type = (uint8_t)header[0];
+    *payload = buff.read(length);
+    return true;
+}
+
+/*
+ * Minimal scanner for the JSON objects sent by NDT servers, which are
+ * flat objects with string values, e.g. `{"msg": "..."}`. We skip values
+ * other than `msg`, including nested ones, without decoding them.
+ */
+
+static void skip_space(const std::string &s, size_t &pos) {
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t' ||
+                              s[pos] == '\n' || s[pos] == '\r')) {
+        ++pos;
+    }
+}
+
+static void append_utf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | (cp >> 18));
+        out += (char)(0x80 | ((cp >> 12) & 0x3f));
+        out += (char)(0x80 | ((cp >> 6) & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+static bool scan_hex4(const std::string &s, size_t &pos, uint32_t *cp) {
+    if (s.size() - pos < 4) {
+        return false;
+    }
+    *cp = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        char c = s[pos++];
+        *cp <<= 4;
+        if (c >= '0' && c <= '9') {
+            *cp |= (uint32_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            *cp |= (uint32_t)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            *cp |= (uint32_t)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Scans the string at `pos` and, if `out` is not null, decodes it
+static bool scan_string(const std::string &s, size_t &pos, std::string *out) {
+    if (pos >= s.size() || s[pos] != '"') {
+        return false;
+    }
+    ++pos;
+    while (pos < s.size()) {
+        char c = s[pos++];
+        if (c == '"') {
+            return true;
+        }
+        if ((unsigned char)c < 0x20) {
+            return false;
+        }
+        if (c != '\\') {
+            if (out != nullptr) {
+                *out += c;
+            }
+            continue;
+        }
+        if (pos >= s.size()) {
+            return false;
+        }
+        c = s[pos++];
+        uint32_t cp = 0;
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            cp = (uint32_t)c;
+            break;
+        case 'b':
+            cp = '\b';
+            break;
+        case 'f':
+            cp = '\f';
+            break;
+        case 'n':
+            cp = '\n';
+            break;
+        case 'r':
+            cp = '\r';
+            break;
+        case 't':
+            cp = '\t';
+            break;
+        case 'u':
+            if (!scan_hex4(s, pos, &cp)) {
+                return false;
+            }
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                uint32_t low = 0;
+                if (s.compare(pos, 2, "\\u") != 0 ||
+                    !scan_hex4(s, pos += 2, &low) || low < 0xdc00 ||
+                    low > 0xdfff) {
+                    return false;
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                return false; // Low surrogate without a high one
+            }
+            break;
+        default:
+            return false;
+        }
+        if (out != nullptr) {
+            append_utf8(*out, cp);
+        }
+    }
+    return false;
+}
+
+static bool skip_literal(const std::string &s, size_t &pos, const char *lit) {
+    size_t n = strlen(lit);
+    if (s.compare(pos, n, lit) != 0) {
+        return false;
+    }
+    pos += n;
+    return true;
+}
+
+static bool skip_digits(const std::string &s, size_t &pos) {
+    size_t begin = pos;
+    while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9') {
+        ++pos;
+    }
+    return pos > begin;
+}
+
+// Skips a number, as defined by RFC 8259 Sect. 6
+static bool skip_number(const std::string &s, size_t &pos) {
+    if (pos < s.size() && s[pos] == '-') {
+        ++pos;
+    }
+    if (pos < s.size() && s[pos] == '0') {
+        ++pos;
+    } else if (pos >= s.size() || s[pos] < '1' || s[pos] > '9' ||
+               !skip_digits(s, pos)) {
+        return false;
+    }
+    if (pos < s.size() && s[pos] == '.' && !skip_digits(s, ++pos)) {
+        return false;
+    }
+    if (pos < s.size() && (s[pos] == 'e' || s[pos] == 'E')) {
+        ++pos;
+        if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')) {
+            ++pos;
+        }
+        if (!skip_digits(s, pos)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Skips the `"key":` that starts each member of an object
+static bool skip_key(const std::string &s, size_t &pos) {
+    skip_space(s, pos);
+    if (!scan_string(s, pos, nullptr)) {
+        return false;
+    }
+    skip_space(s, pos);
+    if (pos >= s.size() || s[pos] != ':') {
+        return false;
+    }
+    ++pos;
+    return true;
+}
+
+// Skips the value at `pos`, leaving `pos` just past its end. The value must
+// be valid JSON; we use a stack of closing brackets rather than recursion so
+// that deeply nested input cannot exhaust our stack.
+static bool skip_value(const std::string &s, size_t &pos) {
+    std::string closers;
+    for (;;) {
+        skip_space(s, pos);
+        if (pos >= s.size()) {
+            return false;
+        }
+        char c = s[pos];
+        if (c == '{' || c == '[') {
+            char closer = (c == '{') ? '}' : ']';
+            ++pos;
+            skip_space(s, pos);
+            if (pos < s.size() && s[pos] == closer) {
+                ++pos; // Empty object or array
+            } else {
+                closers += closer;
+                if (closer == '}' && !skip_key(s, pos)) {
+                    return false;
+                }
+                continue; // Skip the first element
+            }
+        } else if (c == '"') {
+            if (!scan_string(s, pos, nullptr)) {
+                return false;
+            }
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            if (!skip_literal(s, pos, (c == 't') ? "true" :
+                                      (c == 'f') ? "false" : "null")) {
+                return false;
+            }
+        } else if (!skip_number(s, pos)) {
+            return false;
+        }
+        // Close the containers we are done with, then skip the separator
+        // before their next element, if any
+        for (;;) {
+            if (closers.empty()) {
+                return true;
+            }
+            skip_space(s, pos);
+            if (pos >= s.size()) {
+                return false;
+            }
+            if (s[pos] == closers.back()) {
+                ++pos;
+                closers.pop_back();
+                continue;
+            }
+            if (s[pos] != ',') {
+                return false;
+            }
+            ++pos;
+            if (closers.back() == '}' && !skip_key(s, pos)) {
+                return false;
+            }
+            break;
+        }
+    }
+}
+
+ErrorOr<std::string> extract_msg(const std::string &payload) {
+    size_t pos = 0;
+    skip_space(payload, pos);
+    if (pos >= payload.size() || payload[pos] != '{') {
+        return {JsonProcessingError(), ""};
+    }
+    ++pos;
+    // Like nlohmann::json, the last `msg` wins and nothing but whitespace
+    // may follow the object
+    bool found = false;
+    std::string msg;
+    for (;;) {
+        skip_space(payload, pos);
+        std::string key;
+        if (!scan_string(payload, pos, &key)) {
+            return {JsonProcessingError(), ""};
+        }
+        skip_space(payload, pos);
+        if (pos >= payload.size() || payload[pos] != ':') {
+            return {JsonProcessingError(), ""};
+        }
+        ++pos;
+        skip_space(payload, pos);
+        if (key == "msg" && pos < payload.size() && payload[pos] == '"') {
+            msg.clear();
+            if (!scan_string(payload, pos, &msg)) {
+                return {JsonProcessingError(), ""};
+            }
+            found = true;
+        } else {
+            found = found && key != "msg"; // Not a string
+            size_t begin = pos;
+            if (!skip_value(payload, pos) || pos == begin) {
+                return {JsonProcessingError(), ""};
+            }
+        }
+        skip_space(payload, pos);
+        if (pos >= payload.size()) {
+            return {JsonProcessingError(), ""};
+        }
+        if (payload[pos] == '}') {
+            ++pos;
+            break;
+        }
+        if (payload[pos] != ',') {
+            return {JsonProcessingError(), ""};
+        }
+        ++pos;
+    }
+    skip_space(payload, pos);
+    if (pos != payload.size() || !found) {
+        return {JsonProcessingError(), ""}; // Trailing data or no `msg`
+    }
+    return {NoError(), msg};
+}
+
+void Web100Table::add_lines(const std::string &s) {
+    size_t begin = 0;
+    while (begin < s.size()) {
+        size_t end = s.find('\n', begin);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        // Like add_to_report(), split the line at each ':', ignore empty
+        // pieces, and only keep lines consisting of exactly two pieces
+        size_t offsets[2] = {}, lengths[2] = {}, count = 0;
+        for (size_t pos = begin; pos < end && count <= 2;) {
+            size_t colon = std::min(s.find(':', pos), end);
+            if (colon > pos) {
+                if (count < 2) {
+                    offsets[count] = pos;
+                    lengths[count] = colon - pos;
+                }
+                count += 1;
+            }
+            pos = colon + 1;
+        }
+        if (count == 2) {
+            vars_.emplace_back(s.substr(offsets[0], lengths[0]),
+                               s.substr(offsets[1], lengths[1]));
+        }
+        begin = end + 1;
+    }
+}
+
+nlohmann::json Web100Table::as_json() const {
+    nlohmann::json json = nlohmann::json::object();
+    for (auto &var : vars_) {
+        json[var.first] = as_number_or_string(var.second);
+    }
+    return json;
 }
 
 } // namespace messages
@@ -15,8 +15,6 @@
 
 #include "src/libmeasurement_kit/ndt/internal.hpp"
 
-#include <assert.h>
-
 namespace mk {
 namespace ndt {
 namespace messages {
@@ -25,38 +23,41 @@ namespace messages {
     +----------+------------+-------------------+
     | type (1) | length (2) | payload (0-65535) |
     +----------+------------+-------------------+
+
+    We decode messages directly from the context buffer and only go back
+    to the reactor when a message is not complete yet. Usually a message
+    arrives with a single read, and so does more than one message.
 */
-template <MK_MOCK_AS(net::readn, net_readn_first),
-          MK_MOCK_AS(net::readn, net_readn_second)>
+template <MK_MOCK_AS(net::read, net_read)>
 void read_ll_impl(SharedPtr<Context> ctx,
                   Callback<Error, uint8_t, std::string> callback,
                   SharedPtr<Reactor> reactor) {
-
-    // Receive message type (1 byte) and length (2 bytes)
-    net_readn_first(ctx->txp, ctx->buff, 3, [=](Error err) mutable {
+    uint8_t type = 0;
+    std::string s;
+    if (read_frame(*ctx->buff, &type, &s)) {
+        ctx->logger->debug("< [%d]: (%d) %s", (int)s.size(), type, s.c_str());
+        // Like readn(), do not callback immediately to avoid O(N) stack
+        // consumption when many messages were already buffered
+        reactor->call_soon([=]() { callback(NoError(), type, s); });
+        return;
+    }
+    net_read(ctx->txp, ctx->buff, [=](Error err) {
         if (err) {
-            callback(ReadingMessageTypeLengthError(std::move(err)), 0, "");
-            return;
-        }
-        ErrorOr<uint8_t> type = ctx->buff->read_uint8();
-        ErrorOr<uint16_t> length = ctx->buff->read_uint16();
-        // Note: we don't check for `type` and `length` true-ness because
-        // we are after a readn() which should ensure enough space is there,
-        // hence, if that's not the case, we'll see an exception
-
-        // Now read the message payload (`*length` bytes in total)
-        net_readn_second(ctx->txp, ctx->buff, *length, [=](Error err) mutable {
-            if (err) {
+            if (ctx->buff->length() < 3) {
+                callback(ReadingMessageTypeLengthError(std::move(err)), 0, "");
+            } else {
                 callback(ReadingMessagePayloadError(std::move(err)), 0, "");
-                return;
             }
-            std::string s = ctx->buff->readn(*length);
-            // TODO: rather than using assert() here we should modify readn()
-            // to return ErrorOr<> (exceptions are better than asserts)
-            assert(s.size() == *length);
-            ctx->logger->debug("< [%d]: (%d) %s", *length, *type, s.c_str());
-            callback(NoError(), *type, s);
-        }, reactor);
+            return;
+        }
+        uint8_t type = 0;
+        std::string s;
+        if (!read_frame(*ctx->buff, &type, &s)) {
+            read_ll_impl<net_read>(ctx, callback, reactor);
+            return;
+        }
+        ctx->logger->debug("< [%d]: (%d) %s", (int)s.size(), type, s.c_str());
+        callback(NoError(), type, s);
     }, reactor);
 }
 
@@ -80,24 +81,22 @@ void read_json_impl(SharedPtr<Context> ctx, Callback<Error, uint8_t, nlohmann::j
     }, reactor);
 }
 
-// Like `read_json()` but return the `msg` field only
-template <MK_MOCK(read_json)>
+// Like `read_ll()` but return the `msg` field of the JSON payload only
+template <MK_MOCK(read_ll)>
 void read_msg_impl(SharedPtr<Context> ctx,
                    Callback<Error, uint8_t, std::string> callback,
                    SharedPtr<Reactor> reactor) {
-    read_json(ctx, [=](Error error, uint8_t type, nlohmann::json message) {
+    read_ll(ctx, [=](Error error, uint8_t type, std::string m) {
         if (error) {
             callback(error, 0, "");
             return;
         }
-        std::string s;
-        try {
-            s = message.at("msg");
-        } catch (const std::exception &) {
-            callback(JsonProcessingError(), 0, "");
+        ErrorOr<std::string> s = extract_msg(m);
+        if (!s) {
+            callback(s.as_error(), 0, "");
             return;
         }
-        callback(NoError(), type, s);
+        callback(NoError(), type, *s);
     }, reactor);
 }
 
@@ -0,0 +1,35 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/ndt/ndt7_impl.hpp"
+
+namespace mk {
+namespace ndt {
+namespace ndt7 {
+
+void connect(SharedPtr<Context> ctx, std::string path,
+             Callback<Error, SharedPtr<Transport>, SharedPtr<Buffer>> callback) {
+    connect_impl(ctx, path, callback);
+}
+
+void download(SharedPtr<Context> ctx, Callback<Error> callback) {
+    download_impl(ctx, callback);
+}
+
+void upload(SharedPtr<Context> ctx, Callback<Error> callback) {
+    upload_impl(ctx, callback);
+}
+
+void run_with_specific_server(SharedPtr<nlohmann::json> entry,
+                              std::string address, int port,
+                              Callback<Error> callback, Settings settings,
+                              SharedPtr<Reactor> reactor,
+                              SharedPtr<Logger> logger) {
+    run_with_specific_server_impl(entry, address, port, callback, settings,
+                                  reactor, logger);
+}
+
+} // namespace ndt7
+} // namespace ndt
+} // namespace mk
@@ -0,0 +1,465 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NDT_NDT7_IMPL_HPP
+#define SRC_LIBMEASUREMENT_KIT_NDT_NDT7_IMPL_HPP
+
+// This implementation follows the ndt7 specification, see
+// <https://github.com/m-lab/ndt-server/blob/master/spec/ndt7-protocol.md>
+
+#include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include "src/libmeasurement_kit/ndt/internal.hpp"
+
+#include <math.h>
+
+#include <vector>
+
+#define NDT7_DOWNLOAD_PATH "/ndt/v7/download"
+#define NDT7_UPLOAD_PATH "/ndt/v7/upload"
+#define NDT7_PROTOCOL "net.measurementlab.ndt.v7"
+
+// The server stops the download after ten seconds; we give up if that
+// does not happen in a reasonable time
+#define NDT7_MAX_DURATION 15.0
+#define NDT7_UPLOAD_DURATION 10.0
+
+// Upload messages start small, so slow networks are measured accurately,
+// and double while they are smaller than the bytes sent so far divided
+// by the scaling fraction, up to the maximum message size.
+#define NDT7_MIN_MESSAGE_SIZE (1 << 13)
+#define NDT7_MAX_MESSAGE_SIZE (1 << 20)
+#define NDT7_SCALING_FRACTION 16
+
+// Minimum number of bytes that we queue for sending when the output
+// buffer has been flushed, so that small messages do not starve the link
+#define NDT7_MIN_WRITE_SIZE (1 << 16)
+
+namespace mk {
+namespace ndt {
+namespace ndt7 {
+
+// State of a subtest, shared by the callbacks of its transport
+class Subtest : public NonCopyable, public NonMovable {
+  public:
+    Subtest(SharedPtr<Context> c, std::string n, SharedPtr<Buffer> b)
+        : ctx{std::move(c)}, name{std::move(n)}, buff{std::move(b)},
+          estimator{0.5, 1, NDT7_MAX_DURATION} {}
+
+    bool is_download() const { return name == "download"; }
+
+    SharedPtr<Context> ctx;
+    std::string name;
+    SharedPtr<Buffer> buff; // Received bytes not parsed yet
+    ThroughputEstimator estimator;
+    net::WsParser parser;
+    nlohmann::json entry;
+    std::vector<SharedPtr<std::string>> frames; // Upload frames we reuse
+    size_t message_size = NDT7_MIN_MESSAGE_SIZE;
+    bool close_sent = false;
+    bool finished = false;
+};
+
+static inline void send_frame(SharedPtr<Transport> txp, uint8_t opcode,
+                              std::string payload) {
+    Buffer data;
+    data.write_reference(net::ws_frame(opcode, std::move(payload), true));
+    txp->write(data);
+}
+
+// Maps a field of tcp_info_sample() or tcp_bbr_info_sample() to the name
+// used by the ndt7 specification, where times are in microseconds
+struct SpecField {
+    const char *name;
+    const char *spec_name;
+    bool is_time;
+};
+
+static inline nlohmann::json to_spec(const nlohmann::json &sample,
+                                     const std::vector<SpecField> &fields,
+                                     int64_t elapsed) {
+    nlohmann::json result{{"ElapsedTime", elapsed}};
+    for (auto &field : fields) {
+        if (sample.count(field.name) == 0) {
+            continue; // Not supported by the running kernel
+        }
+        if (field.is_time) {
+            result[field.spec_name] =
+                  llround(sample.at(field.name).get<double>() * 1e06);
+        } else {
+            result[field.spec_name] = sample.at(field.name);
+        }
+    }
+    return result;
+}
+
+// Measurement object in the format described by the ndt7 specification
+static inline nlohmann::json measure(Subtest &st, SharedPtr<Transport> txp) {
+    int64_t elapsed = llround(st.estimator.elapsed() * 1e06);
+    nlohmann::json measurement{
+          {"AppInfo",
+           {{"ElapsedTime", elapsed}, {"NumBytes", st.estimator.total()}}},
+          {"Origin", "client"},
+          {"Test", st.name}};
+    socket_t sockfd = net::tcp_info_socket(txp);
+    if (sockfd != (socket_t)-1) {
+        ErrorOr<nlohmann::json> tcp_info = net::tcp_info_sample(sockfd);
+        if (!!tcp_info) {
+            measurement["TCPInfo"] = to_spec(*tcp_info,
+                                             {{"state", "State", false},
+                                              {"rtt", "RTT", true},
+                                              {"rttvar", "RTTVar", true},
+                                              {"snd_cwnd", "SndCwnd", false},
+                                              {"snd_mss", "SndMSS", false},
+                                              {"retransmits", "Retransmits",
+                                               false},
+                                              {"total_retrans", "TotalRetrans",
+                                               false},
+                                              {"pacing_rate", "PacingRate",
+                                               false},
+                                              {"bytes_acked", "BytesAcked",
+                                               false},
+                                              {"bytes_received",
+                                               "BytesReceived", false},
+                                              {"delivery_rate", "DeliveryRate",
+                                               false}},
+                                             elapsed);
+        }
+        ErrorOr<nlohmann::json> bbr_info = net::tcp_bbr_info_sample(sockfd);
+        if (!!bbr_info) {
+            measurement["BBRInfo"] = to_spec(*bbr_info,
+                                             {{"bw", "BW", false},
+                                              {"min_rtt", "MinRTT", true},
+                                              {"pacing_gain", "PacingGain",
+                                               false},
+                                              {"cwnd_gain", "CwndGain", false}},
+                                             elapsed);
+        }
+    }
+    return measurement;
+}
+
+// Accounts for `count` bytes transferred and, whenever a bin of the
+// estimator is over, reports the speed and takes a measurement
+static inline void account(Subtest &st, SharedPtr<Transport> txp,
+                           size_t count) {
+    size_t completed = st.estimator.add(count);
+    if (completed <= 0) {
+        return;
+    }
+    const char *type = (st.is_download()) ? "download-speed" : "upload-speed";
+    const char *key = (st.is_download()) ? "receiver_data" : "sender_data";
+    size_t bins = st.estimator.rates().size();
+    for (size_t bin = bins - completed; bin < bins; ++bin) {
+        double el = st.estimator.bin_end(bin);
+        double x = st.estimator.rates()[bin];
+        log_speed(st.ctx->logger, type, 1, el, x);
+        st.entry[key].push_back({el, x});
+    }
+    nlohmann::json measurement = measure(st, txp);
+    if (!st.is_download() && !st.close_sent) {
+        // The specification allows clients to send measurements when
+        // uploading, and the server saves them
+        send_frame(txp, MK_WS_OPCODE_TEXT, measurement.dump());
+    }
+    st.entry["client_measurements"].push_back(std::move(measurement));
+}
+
+static inline void on_message(Subtest &st, SharedPtr<Transport> txp,
+                              uint8_t opcode, std::string payload) {
+    switch (opcode) {
+    case MK_WS_OPCODE_TEXT:
+        try {
+            st.entry["server_measurements"].push_back(
+                  nlohmann::json::parse(payload));
+        } catch (const std::exception &) {
+            st.ctx->logger->warn("ndt7: cannot parse server measurement");
+        }
+        break;
+    case MK_WS_OPCODE_PING:
+        send_frame(txp, MK_WS_OPCODE_PONG, std::move(payload));
+        break;
+    case MK_WS_OPCODE_CLOSE:
+        st.ctx->logger->debug("ndt7: the server closed the %s",
+                              st.name.c_str());
+        if (!st.close_sent) {
+            st.close_sent = true;
+            send_frame(txp, MK_WS_OPCODE_CLOSE, payload.substr(0, 2));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static inline void receive(SharedPtr<Subtest> st, SharedPtr<Transport> txp) {
+    Error err = st->parser.feed(*st->buff);
+    if (err) {
+        st->ctx->logger->warn("ndt7: %s", err.what());
+        txp->emit_error(err);
+        return;
+    }
+    if (st->is_download() && !st->close_sent &&
+        st->estimator.elapsed() > NDT7_MAX_DURATION) {
+        st->ctx->logger->info("ndt7: the download is taking too long");
+        st->close_sent = true;
+        send_frame(txp, MK_WS_OPCODE_CLOSE,
+                   net::ws_close_payload(MK_WS_CLOSE_NORMAL));
+    }
+}
+
+static inline SharedPtr<Subtest> make_subtest(SharedPtr<Context> ctx,
+                                              std::string name,
+                                              SharedPtr<Transport> txp,
+                                              SharedPtr<Buffer> buff) {
+    SharedPtr<Subtest> st = SharedPtr<Subtest>::make(ctx, name, buff);
+    st->entry["client_measurements"] = nlohmann::json::array();
+    st->entry["connect_times"] = nlohmann::json::array();
+    st->entry["connect_times"].push_back(txp->connect_time());
+    st->entry["params"]["num_streams"] = 1;
+    st->entry[(st->is_download()) ? "receiver_data" : "sender_data"] =
+          nlohmann::json::array();
+    st->entry["server_measurements"] = nlohmann::json::array();
+    st->entry["socket_options"] = nlohmann::json::array();
+    st->entry["socket_options"].push_back(net::socket_options_effective(txp));
+    // Note: the parser belongs to the subtest, so its callbacks must not
+    // keep the subtest alive
+    Subtest *raw = st.get();
+    st->parser.on_binary([raw, txp](size_t count) {
+        if (raw->is_download()) {
+            account(*raw, txp, count);
+        }
+    });
+    st->parser.on_message([raw, txp](uint8_t opcode, std::string payload) {
+        on_message(*raw, txp, opcode, std::move(payload));
+    });
+    txp->set_timeout(ctx->timeout);
+    txp->on_data([st, txp](Buffer data) {
+        *st->buff << data;
+        receive(st, txp);
+    });
+    return st;
+}
+
+static inline void finish(SharedPtr<Subtest> st, SharedPtr<Transport> txp,
+                          Error err, Callback<Error> callback) {
+    if (st->finished) {
+        return;
+    }
+    st->finished = true;
+    if (err == EofError()) {
+        err = NoError();
+    }
+    if (err) {
+        st->ctx->logger->info("Ending ndt7 %s (%d)", st->name.c_str(),
+                              err.code);
+    }
+    st->estimator.finish();
+    st->entry["throughput"] = st->estimator.summary_json();
+    st->ctx->logger->debug("ndt7: %s speed %lf kbit/s", st->name.c_str(),
+                           st->estimator.summary().average);
+    (*st->ctx->entry)[(st->is_download()) ? "test_s2c" : "test_c2s"].push_back(
+          st->entry);
+    // Note: close() ignores attempts to clear the data handler, which keeps
+    // a reference to txp, hence we must clear it before closing. Like in the
+    // legacy subtests, we must not reference txp in the close callback.
+    txp->on_data(nullptr);
+    txp->close([callback, err]() { callback(err); });
+}
+
+template <MK_MOCK_AS(net::connect, net_connect),
+          MK_MOCK_AS(net::ws_handshake, net_ws_handshake)>
+void connect_impl(
+      SharedPtr<Context> ctx, std::string path,
+      Callback<Error, SharedPtr<Transport>, SharedPtr<Buffer>> callback) {
+    Settings settings = ctx->settings;
+    bool tls = settings.get("ndt7/tls", true);
+    std::string host = ctx->address;
+    if (ctx->port != ((tls) ? NDT7_TLS_PORT : NDT7_PORT)) {
+        host += ":" + std::to_string(ctx->port);
+    }
+    if (tls) {
+        settings["net/ssl"] = true;
+    }
+    ctx->logger->debug("ndt7: connect ...");
+    net_connect(ctx->address, ctx->port,
+                [=](Error err, SharedPtr<Transport> txp) {
+                    ctx->logger->debug("ndt7: connect ... %d", (int)err);
+                    if (err) {
+                        callback(err, txp, Buffer::make());
+                        return;
+                    }
+                    ctx->logger->debug("ndt7: handshake ...");
+                    net_ws_handshake(
+                          txp, host, path, NDT7_PROTOCOL,
+                          [=](Error err, SharedPtr<Buffer> buff) {
+                              ctx->logger->debug("ndt7: handshake ... %d",
+                                                 (int)err);
+                              if (err) {
+                                  txp->close([callback, err, buff]() {
+                                      callback(err, {}, buff);
+                                  });
+                                  return;
+                              }
+                              callback(NoError(), txp, buff);
+                          },
+                          ctx->logger);
+                },
+                settings, ctx->reactor, ctx->logger);
+}
+
+template <MK_MOCK(connect)>
+void download_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
+    dump_settings(ctx->settings, "ndt7/download", ctx->logger);
+    connect(ctx, NDT7_DOWNLOAD_PATH,
+            [=](Error err, SharedPtr<Transport> txp, SharedPtr<Buffer> buff) {
+                if (err) {
+                    callback(ConnectTestConnectionError(std::move(err)));
+                    return;
+                }
+                ctx->logger->info("Starting download");
+                log_speed(ctx->logger, "download-speed", 1, 0.0, 0.0);
+                SharedPtr<Subtest> st =
+                      make_subtest(ctx, "download", txp, buff);
+                txp->on_error([=](Error err) {
+                    finish(st, txp, err, callback);
+                });
+                // Process what we received along with the handshake
+                receive(st, txp);
+            });
+}
+
+template <MK_MOCK(connect)>
+void upload_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
+    dump_settings(ctx->settings, "ndt7/upload", ctx->logger);
+    ErrorOr<double> duration = ctx->settings.get_noexcept(
+          "ndt7/upload_duration", NDT7_UPLOAD_DURATION);
+    if (!duration || *duration <= 0.0) {
+        callback(InvalidDurationError());
+        return;
+    }
+    connect(ctx, NDT7_UPLOAD_PATH,
+            [=](Error err, SharedPtr<Transport> txp, SharedPtr<Buffer> buff) {
+                if (err) {
+                    callback(ConnectTestConnectionError(std::move(err)));
+                    return;
+                }
+                ctx->logger->info("Starting upload");
+                SharedPtr<Subtest> st = make_subtest(ctx, "upload", txp, buff);
+
+                // Frames are formatted once and reused when the output is
+                // done with them, i.e. when we hold the only reference. As
+                // RFC 6455 requires for clients, each write masks them in
+                // place with a new key, rather than copying the payload.
+                auto send = [st, txp]() {
+                    if (st->message_size < NDT7_MAX_MESSAGE_SIZE &&
+                        st->message_size * NDT7_SCALING_FRACTION <=
+                              st->estimator.total()) {
+                        st->message_size *= 2;
+                        st->ctx->logger->debug("ndt7: message size %d",
+                                               (int)st->message_size);
+                        st->frames.clear();
+                    }
+                    Buffer data;
+                    size_t count = 0;
+                    for (auto &frame : st->frames) {
+                        if (count >= NDT7_MIN_WRITE_SIZE) {
+                            break;
+                        }
+                        if (frame.use_count() == 1) {
+                            net::ws_remask(*frame);
+                            count += frame->size();
+                            data.write_reference(frame);
+                        }
+                    }
+                    while (count < NDT7_MIN_WRITE_SIZE) {
+                        SharedPtr<std::string> frame = net::ws_frame(
+                              MK_WS_OPCODE_BINARY,
+                              random_printable(st->message_size), true);
+                        st->frames.push_back(frame);
+                        count += frame->size();
+                        data.write_reference(std::move(frame));
+                    }
+                    txp->write(data);
+                    account(*st, txp, count);
+                };
+
+                txp->on_flush([=]() {
+                    if (st->close_sent) {
+                        return; // Waiting for the server to close
+                    }
+                    if (st->estimator.elapsed() >= *duration) {
+                        ctx->logger->info("Elapsed enough time");
+                        st->close_sent = true;
+                        send_frame(txp, MK_WS_OPCODE_CLOSE,
+                                   net::ws_close_payload(MK_WS_CLOSE_NORMAL));
+                        return;
+                    }
+                    send();
+                });
+                txp->on_error([=](Error err) {
+                    finish(st, txp, err, callback);
+                });
+                receive(st, txp);
+                send();
+            });
+}
+
+template <MK_MOCK(download), MK_MOCK(upload)>
+void run_with_specific_server_impl(SharedPtr<nlohmann::json> entry,
+                                   std::string address, int port,
+                                   Callback<Error> callback, Settings settings,
+                                   SharedPtr<Reactor> reactor,
+                                   SharedPtr<Logger> logger) {
+    SharedPtr<Context> ctx{std::make_shared<Context>()};
+    ctx->address = address;
+    ctx->callback = callback;
+    ctx->entry = entry;
+    ctx->logger = logger;
+    ctx->reactor = reactor;
+    ctx->port = port;
+    ctx->settings = settings;
+    // Note: we only honour the download and upload bits here
+    ctx->test_suite |= settings.get("test_suite", TEST_C2S | TEST_S2C);
+
+    dump_settings(ctx->settings, "ndt7", ctx->logger);
+
+    // Same keys as the legacy protocol, so that we can compute the same
+    // summary, plus the protocol we used
+    (*ctx->entry)["client_resolver"] = nullptr; /* Set later by parent */
+    (*ctx->entry)["failure"] = nullptr;
+    (*ctx->entry)["protocol"] = "ndt7";
+    (*ctx->entry)["server_address"] = address;
+    (*ctx->entry)["server_port"] = port;
+    (*ctx->entry)["server_version"] = nullptr;
+    (*ctx->entry)["summary_data"] = nlohmann::json::object();
+    (*ctx->entry)["test_c2s"] = nlohmann::json::array();
+    (*ctx->entry)["test_s2c"] = nlohmann::json::array();
+    (*ctx->entry)["test_suite"] = ctx->test_suite;
+
+    auto maybe_upload = [ctx, callback]() {
+        if ((ctx->test_suite & TEST_C2S) == 0) {
+            callback(NoError());
+            return;
+        }
+        upload(ctx, callback);
+    };
+    if ((ctx->test_suite & TEST_S2C) == 0) {
+        maybe_upload();
+        return;
+    }
+    download(ctx, [=](Error err) {
+        if (err) {
+            callback(err);
+            return;
+        }
+        maybe_upload();
+    });
+}
+
+} // namespace ndt7
+} // namespace ndt
+} // namespace mk
+#endif
@@ -118,29 +118,58 @@ void run_with_specific_server_impl(SharedPtr<nlohmann::json> entry, std::string
 }
 
 template <MK_MOCK(run_with_specific_server),
-          MK_MOCK_AS(mlabns::query, mlabns_query)>
+          MK_MOCK_AS(mlabns::query, mlabns_query),
+          MK_MOCK_AS(ndt7::run_with_specific_server,
+                     ndt7_run_with_specific_server)>
 void run_impl(SharedPtr<nlohmann::json> entry, Callback<Error> callback, Settings settings,
               SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
-    ErrorOr<int> port = settings.get_noexcept<int>("port", NDT_PORT);
+    std::string protocol = settings.get("protocol", "legacy");
+    if (protocol != "legacy" && protocol != "ndt7") {
+        callback(InvalidProtocolError());
+        return;
+    }
+    bool ndt7 = (protocol == "ndt7");
+    ErrorOr<bool> tls = settings.get_noexcept("ndt7/tls", true);
+    if (!tls) {
+        callback(InvalidProtocolError(tls.as_error()));
+        return;
+    }
+    int default_port = NDT_PORT;
+    if (ndt7) {
+        default_port = (*tls) ? NDT7_TLS_PORT : NDT7_PORT;
+    }
+    ErrorOr<int> port = settings.get_noexcept<int>("port", default_port);
     if (!port) {
         callback(InvalidPortError(port.as_error()));
         return;
     }
-    std::string address = settings.get("address", "");
-    if (address != "") {
+    auto run_with = [=](std::string address) {
+        if (ndt7) {
+            ndt7_run_with_specific_server(entry, address, *port, callback,
+                                          settings, reactor, logger);
+            return;
+        }
         run_with_specific_server(entry, address, *port, callback, settings,
                                  reactor, logger);
+    };
+    std::string address = settings.get("address", "");
+    if (address != "") {
+        run_with(address);
         return;
     }
-    mlabns_query(settings.get("mlabns_tool_name", "ndt"),
+    if (settings.find("mlabns/probe_port") == settings.end()) {
+        settings["mlabns/probe_port"] = *port;
+    }
+    mlabns_query(settings.get("mlabns_tool_name", (ndt7) ? "ndt7" : "ndt"),
                  [=](Error err, mlabns::Reply reply) mutable {
                      if (err) {
                          callback(MlabnsQueryError(std::move(err)));
                          return;
                      }
-                     run_with_specific_server(entry, reply.fqdn, *port,
-                                              callback, settings, reactor,
-                                              logger);
+                     if (!reply.selection.is_null()) {
+                         (*entry)["server_selection"] = reply.selection;
+                     }
+                     run_with(reply.fqdn);
                  },
                  settings, reactor, logger);
 }
@@ -8,12 +8,11 @@ namespace mk {
 namespace ndt {
 namespace test_c2s {
 
-void coroutine(SharedPtr<nlohmann::json> e, std::string address, int port, double runtime,
+void coroutine(SharedPtr<nlohmann::json> e, std::string address, Params params,
                Callback<Error, Continuation<Error>> cb, double timeout,
                Settings settings, SharedPtr<Reactor> reactor,
                SharedPtr<Logger> logger) {
-    coroutine_impl(e, address, port, runtime, cb, timeout, settings, reactor,
-                   logger);
+    coroutine_impl(e, address, params, cb, timeout, settings, reactor, logger);
 }
 
 void run(SharedPtr<Context> ctx, Callback<Error> callback) {
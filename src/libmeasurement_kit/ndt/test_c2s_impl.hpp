@@ -12,72 +12,143 @@ namespace mk {
 namespace ndt {
 namespace test_c2s {
 
-template <MK_MOCK_AS(net::connect, net_connect)>
-void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address, int port, double runtime,
-                    Callback<Error, Continuation<Error>> cb, double timeout,
-                    Settings settings, SharedPtr<Reactor> reactor,
+// All flows append references to the same block, so sending never copies
+// payload bytes. Each write appends between one and C2S_MAX_BLOCKS of them.
+#define C2S_BLOCK_SIZE 65536
+#define C2S_MAX_BLOCKS 16
+
+// If the output buffer drains faster than this, we write more per flush
+#define C2S_FAST_FLUSH 0.01
+
+template <MK_MOCK_AS(net::connect_many, net_connect_many)>
+void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
+                    Params params, Callback<Error, Continuation<Error>> cb,
+                    double timeout, Settings settings, SharedPtr<Reactor> reactor,
                     SharedPtr<Logger> logger) {
 
-    // Performance note: This implementation does some string copies
-    // when sending but in localhost testing this does not seem to be
-    // a problem when sending against a MK based discard server.
-    //
-    // Otherwise, a possible improvement would be to have a fixed
-    // size buffer and bypass bufferevent's output logic.
-    //
-    // In my tests (where speed of course depends on the computer you
-    // use), I was able to send at over 1.1 GiB/s and similar speeds
-    // were achieved using stripped down NDT code from `test_c2s_clt.c`.
+    // Performance note: a single flow writing 8 KiB at a time, as we
+    // used to do, is not enough to saturate a gigabit link. Now we use
+    // as many flows as the server allows, we never copy the payload and
+    // we write up to 1 MiB at a time, so that the kernel socket buffer
+    // never runs empty while we wait to be called back.
 
     dump_settings(settings, "ndt/c2s", logger);
 
-    std::string str = random_printable(8192);
+    SharedPtr<std::string> block{
+          std::make_shared<std::string>(random_printable(C2S_BLOCK_SIZE))};
 
     logger->debug("ndt: connect ...");
-    net_connect(address, port,
-                [=](Error err, SharedPtr<Transport> txp) {
-                    logger->debug("ndt: connect ... %d", (int)err);
-                    if (err) {
-                        cb(err, nullptr);
-                        return;
-                    }
-                    (*report_entry)["connect_times"].push_back(txp->connect_time());
-                    logger->info("Connected to %s:%d", address.c_str(), port);
-                    logger->debug("ndt: suspend coroutine");
-                    cb(NoError(), [=](Callback<Error> cb) {
-                        double begin = time_now();
-                        SharedPtr<MeasureSpeed> snap{std::make_shared<MeasureSpeed>(0.5)};
-                        logger->debug("ndt: resume coroutine");
-                        logger->info("Starting upload");
-                        txp->set_timeout(timeout);
-                        txp->on_flush([=]() {
-                            double now = time_now();
-                            snap->maybe_speed(now, [&](double el, double x) {
-                                log_speed(logger, "upload-speed", 1, el, x);
-                                (*report_entry)["sender_data"].push_back({
-                                    el, x
-                                });
-                            });
-                            if (now - begin > runtime) {
-                                logger->info("Elapsed enough time");
-                                txp->emit_error(NoError());
+    net_connect_many(
+        address, params.port, params.num_streams,
+        [=](Error err, std::vector<SharedPtr<Transport>> txp_list) {
+            logger->debug("ndt: connect ... %d", (int)err);
+            if (err) {
+                cb(err, nullptr);
+                return;
+            }
+            for (auto &txp : txp_list) {
+                (*report_entry)["connect_times"].push_back(txp->connect_time());
+                (*report_entry)["socket_options"].push_back(
+                      net::socket_options_effective(txp));
+            }
+            logger->info("Connected to %s:%d", address.c_str(), params.port);
+            logger->debug("ndt: suspend coroutine");
+            cb(NoError(), [=](Callback<Error> cb) {
+                double begin = time_now();
+                size_t num_flows = txp_list.size();
+                SharedPtr<ThroughputEstimator> estimator{
+                      std::make_shared<ThroughputEstimator>(
+                            0.5, num_flows, params.duration)};
+                SharedPtr<size_t> num_completed{std::make_shared<size_t>(0)};
+                logger->debug("ndt: resume coroutine");
+                logger->info("Starting upload");
+                (*report_entry)["params"]["num_streams"] = params.num_streams;
+                SharedPtr<net::TcpInfoSampler> tcp_info =
+                      net::TcpInfoSampler::make(txp_list, settings, reactor,
+                                                logger);
+
+                for (size_t idx = 0; idx < num_flows; ++idx) {
+                    SharedPtr<Transport> txp = txp_list[idx];
+                    SharedPtr<size_t> num_blocks{std::make_shared<size_t>(1)};
+                    SharedPtr<double> last_write{std::make_shared<double>(0.0)};
+                    txp->set_timeout(timeout);
+
+                    auto send = [=](double now) {
+                        Buffer data;
+                        for (size_t i = 0; i < *num_blocks; ++i) {
+                            data.write_reference(block);
+                        }
+                        size_t count = data.length();
+                        txp->write(data);
+                        *last_write = now;
+                        size_t completed = estimator->add(count, idx);
+                        size_t bins = estimator->rates().size();
+                        for (size_t bin = bins - completed; bin < bins; ++bin) {
+                            double el = estimator->bin_end(bin);
+                            double x = estimator->rates()[bin];
+                            log_speed(logger, "upload-speed",
+                                      params.num_streams, el, x);
+                            nlohmann::json sample{el, x};
+                            if (num_flows > 1) {
+                                // Also save the speed of each flow
+                                nlohmann::json speeds = nlohmann::json::array();
+                                for (size_t flow = 0; flow < num_flows; ++flow) {
+                                    speeds.push_back(
+                                          estimator->flow_rate(bin, flow));
+                                }
+                                sample.push_back(speeds);
+                            }
+                            (*report_entry)["sender_data"].push_back(sample);
+                        }
+                    };
+
+                    txp->on_flush([=]() {
+                        double now = time_now();
+                        if (now - begin > params.duration) {
+                            logger->info("Elapsed enough time");
+                            txp->emit_error(NoError());
+                            return;
+                        }
+                        if (now - *last_write < C2S_FAST_FLUSH &&
+                            *num_blocks < C2S_MAX_BLOCKS) {
+                            *num_blocks *= 2;
+                            logger->debug("ndt: now writing %d bytes per flush",
+                                          (int)(*num_blocks * C2S_BLOCK_SIZE));
+                        }
+                        send(now);
+                    });
+
+                    txp->on_error([=](Error err) {
+                        logger->info("Ending upload (%d)", (int)err);
+                        // Must release before closing, see tcp_info.hpp
+                        tcp_info->remove(idx);
+                        txp->close([=]() {
+                            logger->info("Connection to %s:%d closed",
+                                         address.c_str(), params.port);
+                            // Note: like in S2C, we cannot reference txp_list
+                            // or txp here, otherwise we keep them alive
+                            if (++(*num_completed) < num_flows) {
                                 return;
                             }
-                            txp->write(str.data(), str.size());
-                            snap->total += str.size();
-                        });
-                        txp->on_error([=](Error err) {
-                            logger->info("Ending upload (%d)", (int)err);
-                            txp->close([=]() {
-                                logger->info("Connection to %s:%d closed",
-                                             address.c_str(), port);
-                                cb(err);
-                            });
+                            tcp_info->stop();
+                            if (tcp_info->enabled()) {
+                                (*report_entry)["tcp_info"] = tcp_info->take();
+                            }
+                            estimator->finish();
+                            (*report_entry)["throughput"] =
+                                  estimator->summary_json();
+                            // XXX Like in S2C, we need to define what is an
+                            // error when we have parallel flows
+                            cb((num_flows == 1) ? err : NoError());
                         });
-                        txp->write(str.data(), str.size());
                     });
-                },
-                settings, reactor, logger);
+
+                    send(begin);
+                }
+                tcp_info->start();
+            });
+        },
+        settings, reactor, logger);
 }
 
 template <MK_MOCK_AS(messages::read_msg, messages_read_msg_first),
@@ -99,22 +170,54 @@ void run_impl(SharedPtr<Context> ctx, Callback<Error> callback) {
             callback(NotTestPrepareError());
             return;
         }
-        ErrorOr<int> port = lexical_cast_noexcept<int>(s);
+        Params params;
+        std::vector<std::string> vec = split<std::vector<std::string>>(s);
+        if (vec.empty()) {
+            callback(InvalidPortError());
+            return;
+        }
+        ErrorOr<int> port = lexical_cast_noexcept<int>(vec[0]);
         if (!port || *port < 0 || *port > 65535) {
             callback(InvalidPortError());
             return;
         }
+        params.port = *port;
+        // Like S2C, we are liberal and accept the extra parameters that the
+        // server should only send when the test is C2S_EXT
+        if (vec.size() >= 2) {
+            ErrorOr<double> duration = lexical_cast_noexcept<double>(vec[1]);
+            if (!duration or *duration < 0 or *duration > 60000.0) {
+                ctx->logger->warn("Received invalid duration: %s",
+                                  vec[1].c_str());
+                callback(InvalidDurationError());
+                return;
+            }
+            params.duration = *duration / 1000.0;
+        }
+        if (vec.size() >= 6) {
+            ErrorOr<int> num_streams = lexical_cast_noexcept<int>(vec[5]);
+            if (!num_streams or *num_streams < 1 or *num_streams > 8) {
+                ctx->logger->warn("Received invalid num-streams: %s",
+                                  vec[5].c_str());
+                callback(InvalidNumStreamsError());
+                return;
+            }
+            params.num_streams = *num_streams;
+        }
+        ctx->logger->debug("Duration: %f s", params.duration);
+        ctx->logger->debug("Num-streams: %d", params.num_streams);
 
         SharedPtr<nlohmann::json> cur_entry{std::make_shared<nlohmann::json>()};
         (*cur_entry)["connect_times"] = nlohmann::json::array();
-        (*cur_entry)["params"] = {{"num_streams", 1}};
+        (*cur_entry)["socket_options"] = nlohmann::json::array();
+        (*cur_entry)["params"] = {{"num_streams", params.num_streams}};
         (*cur_entry)["receiver_data"] = {{"avg_speed", nullptr}};
         (*cur_entry)["sender_data"] = nlohmann::json::array();
 
         // We connect to the port and wait for coroutine to pause
         ctx->logger->debug("ndt: start c2s coroutine ...");
         coroutine(
-            cur_entry, ctx->address, *port, TEST_C2S_DURATION,
+            cur_entry, ctx->address, params,
             [=](Error err, Continuation<Error> cc) {
                 ctx->logger->debug("ndt: start c2s coroutine ... %d", (int)err);
                 if (err) {
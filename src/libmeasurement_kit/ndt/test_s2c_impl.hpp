@@ -31,8 +31,11 @@ void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
                 return;
             }
             (*report_entry)["connect_times"] = nlohmann::json::array();
+            (*report_entry)["socket_options"] = nlohmann::json::array();
             for (auto &txp : txp_list) {
                 (*report_entry)["connect_times"].push_back(txp->connect_time());
+                (*report_entry)["socket_options"].push_back(
+                      net::socket_options_effective(txp));
             }
             logger->debug("Connected to %s:%d", address.c_str(), params.port);
             logger->debug("ndt: suspend coroutine");
@@ -41,31 +44,39 @@ void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
                 // The coroutine is resumed and receives data
                 logger->debug("ndt: resume coroutine");
                 logger->debug("Starting download");
-                SharedPtr<MeasureSpeed> average{std::make_shared<MeasureSpeed>()};
+                size_t num_flows = txp_list.size();
                 // Note: we parse but ignore the server's snap delay
-                SharedPtr<MeasureSpeed> snaps{std::make_shared<MeasureSpeed>(0.5)};
+                SharedPtr<ThroughputEstimator> estimator{
+                      std::make_shared<ThroughputEstimator>(
+                            0.5, num_flows, params.duration)};
                 SharedPtr<size_t> num_completed{std::make_shared<size_t>(0)};
-                size_t num_flows = txp_list.size();
                 log_speed(logger, "download-speed", params.num_streams,
                           0.0, 0.0);
                 (*report_entry)["params"]["num_streams"] = params.num_streams;
                 (*report_entry)["params"]["snaps_delay"] = params.snaps_delay;
+                SharedPtr<net::TcpInfoSampler> tcp_info =
+                      net::TcpInfoSampler::make(txp_list, settings, reactor,
+                                                logger);
 
-                for (auto txp : txp_list) {
+                for (size_t idx = 0; idx < num_flows; ++idx) {
+                    SharedPtr<Transport> txp = txp_list[idx];
                     txp->set_timeout(timeout);
 
-                    txp->on_data([=](Buffer data) {
-                        average->total += data.length();
-                        snaps->total += data.length();
-                        double ct = time_now();
+                    // We only need to count the bytes we receive
+                    txp->on_drain([=](size_t count) {
+                        size_t completed = estimator->add(count, idx);
                         // Note: we stop printing the speed when at least
                         // one connection has terminated the test
-                        if (*num_completed == 0) {
-                            snaps->maybe_speed(ct, [&](double el, double x) {
-                                log_speed(logger, "download-speed",
-                                          params.num_streams, el, x);
-                                (*report_entry)["receiver_data"].push_back({el, x});
-                            });
+                        if (completed <= 0 || *num_completed != 0) {
+                            return;
+                        }
+                        size_t bins = estimator->rates().size();
+                        for (size_t bin = bins - completed; bin < bins; ++bin) {
+                            double el = estimator->bin_end(bin);
+                            double x = estimator->rates()[bin];
+                            log_speed(logger, "download-speed",
+                                      params.num_streams, el, x);
+                            (*report_entry)["receiver_data"].push_back({el, x});
                         }
                         // TODO: force close the connection after a given
                         // large amount of time has passed
@@ -78,6 +89,8 @@ void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
                         if (err) {
                             logger->info("Ending download (%d)", err.code);
                         }
+                        // Must release before closing, see tcp_info.hpp
+                        tcp_info->remove(idx);
                         txp->close([=]() {
                             ++(*num_completed);
                             // Note: in this callback we cannot reference
@@ -89,7 +102,14 @@ void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
                             if (*num_completed < num_flows) {
                                 return;
                             }
-                            double speed = average->speed();
+                            tcp_info->stop();
+                            if (tcp_info->enabled()) {
+                                (*report_entry)["tcp_info"] = tcp_info->take();
+                            }
+                            estimator->finish();
+                            (*report_entry)["throughput"] =
+                                  estimator->summary_json();
+                            double speed = estimator->summary().average;
                             logger->debug("S2C speed %lf kbit/s", speed);
                             // XXX We need to define what we consider
                             // error when we have parallel flows
@@ -97,15 +117,17 @@ void coroutine_impl(SharedPtr<nlohmann::json> report_entry, std::string address,
                         });
                     });
                 }
+                tcp_info->start();
             });
         },
         settings, reactor, logger);
 }
 
 template <MK_MOCK_AS(messages::read_msg, messages_read_msg)>
-void finalizing_test_impl(SharedPtr<Context> ctx, SharedPtr<nlohmann::json> cur_entry,
-                          Callback<Error> callback) {
-
+void collect_web100_impl(SharedPtr<Context> ctx,
+                         SharedPtr<nlohmann::json> cur_entry,
+                         SharedPtr<messages::Web100Table> web100,
+                         Callback<Error> callback) {
     ctx->logger->debug("ndt: recv TEST_MSG ...");
     messages_read_msg(ctx, [=](Error err, uint8_t type, std::string s) {
         ctx->logger->debug("ndt: recv TEST_MSG ... %d", (int)err);
@@ -116,6 +138,9 @@ void finalizing_test_impl(SharedPtr<Context> ctx, SharedPtr<nlohmann::json> cur_
         if (type == TEST_FINALIZE) {
             // Okay, now that we've reached the final state, we can append
             // the current entry to the entry of the whole NDT test
+            ctx->logger->debug("ndt: got %d web100 variables",
+                               (int)web100->size());
+            (*cur_entry)["web100_data"] = web100->as_json();
             (*ctx->entry)["test_s2c"].push_back(*cur_entry);
             callback(NoError());
             return;
@@ -124,17 +149,21 @@ void finalizing_test_impl(SharedPtr<Context> ctx, SharedPtr<nlohmann::json> cur_
             callback(NotTestMsgError());
             return;
         }
-        for (auto e : split(s, "\n")) {
-            if (e != "") {
-                ctx->logger->debug("%s", e.c_str());
-                messages::add_to_report(cur_entry, "web100_data", e);
-            }
-        }
+        ctx->logger->debug("%s", s.c_str());
+        web100->add_lines(s);
         // XXX: Here we can loop forever
-        finalizing_test_impl<messages_read_msg>(ctx, cur_entry, callback);
+        collect_web100_impl<messages_read_msg>(ctx, cur_entry, web100,
+                                               callback);
     }, ctx->reactor);
 }
 
+template <MK_MOCK_AS(messages::read_msg, messages_read_msg)>
+void finalizing_test_impl(SharedPtr<Context> ctx, SharedPtr<nlohmann::json> cur_entry,
+                          Callback<Error> callback) {
+    collect_web100_impl<messages_read_msg>(
+          ctx, cur_entry, SharedPtr<messages::Web100Table>::make(), callback);
+}
+
 template <MK_MOCK_AS(messages::read_msg, messages_read_msg_first),
           MK_MOCK(coroutine),
           MK_MOCK_AS(messages::read_msg, messages_read_msg_second),
@@ -4,6 +4,7 @@
 
 #include "src/libmeasurement_kit/ndt/utils.hpp"
 
+#include <algorithm>
 #include <stdexcept>
 
 namespace mk {
@@ -111,12 +112,63 @@ nlohmann::json compute_simple_stats_throws(
     return simple_stats;
 }
 
+/*
+ * ndt7 does not have web100 data, but the server periodically sends us its
+ * view of the kernel TCP state, in microseconds, from which we compute the
+ * subset of the advanced stats that have an equivalent.
+ */
+static nlohmann::json
+compute_ndt7_advanced_stats_throws(nlohmann::json &test_s2c) {
+    nlohmann::json tcp_info;
+    double MaxRTT = 0.0;
+    for (auto &m : test_s2c.at("server_measurements")) {
+        if (m.count("TCPInfo") != 0) {
+            tcp_info = m.at("TCPInfo");
+            MaxRTT = std::max(MaxRTT, tcp_info.at("RTT").get<double>());
+        }
+    }
+    if (tcp_info.is_null()) {
+        throw std::runtime_error("missing TCPInfo");
+    }
+
+    double SegsOut = tcp_info.at("SegsOut");
+    double TotalRetrans = tcp_info.at("TotalRetrans");
+    double PacketLoss = 0.0;
+    if (SegsOut > 0.0) {
+        PacketLoss = TotalRetrans / SegsOut;
+    }
+
+    double BusyTime = tcp_info.at("BusyTime");
+    double RWndLimited = tcp_info.at("RWndLimited");
+    double SndBufLimited = tcp_info.at("SndBufLimited");
+    double ReceiverLimited = 0.0;
+    double SenderLimited = 0.0;
+    if (BusyTime > 0.0) {
+        ReceiverLimited = RWndLimited / BusyTime;
+        SenderLimited = SndBufLimited / BusyTime;
+    }
+
+    nlohmann::json advanced_stats;
+    // Note: the kernel only exposes the smoothed RTT, not the average
+    advanced_stats["avg_rtt"] = tcp_info.at("RTT").get<double>() / 1000.0;
+    advanced_stats["mss"] = tcp_info.at("SndMSS");
+    advanced_stats["max_rtt"] = MaxRTT / 1000.0;
+    advanced_stats["min_rtt"] = tcp_info.at("MinRTT").get<double>() / 1000.0;
+    advanced_stats["packet_loss"] = PacketLoss;
+    advanced_stats["receiver_limited"] = ReceiverLimited;
+    advanced_stats["sender_limited"] = SenderLimited;
+    return advanced_stats;
+}
+
 nlohmann::json
 compute_advanced_stats_throws(nlohmann::json &entry, SharedPtr<Logger>) {
     /*
      * Typically we have just one entry. But see above comment.
      */
     nlohmann::json test_s2c = entry["test_s2c"][0];
+    if (entry.count("protocol") != 0 && entry["protocol"] == "ndt7") {
+        return compute_ndt7_advanced_stats_throws(test_s2c);
+    }
     nlohmann::json advanced_stats;
 
     // See: https://github.com/ndt-project/ndt/wiki/NDTTestMethodology#computed-variables
@@ -202,5 +202,19 @@ void Buffer::write(size_t count, std::function<size_t(void *, size_t)> func) {
     if (ctrl != 0) throw std::runtime_error("evbuffer_add_reference");
 }
 
+void Buffer::write_reference(SharedPtr<std::string> block) {
+    if (!block || block->empty()) return;
+    auto holder = new SharedPtr<std::string>{std::move(block)};
+    auto ctrl = evbuffer_add_reference(
+        evbuf.get(), (*holder)->data(), (*holder)->size(),
+        [](const void *, size_t, void *p) {
+            delete static_cast<SharedPtr<std::string> *>(p);
+        }, holder);
+    if (ctrl != 0) {
+        delete holder;
+        throw std::runtime_error("evbuffer_add_reference");
+    }
+}
+
 } // namespace net
 } // namespace mk
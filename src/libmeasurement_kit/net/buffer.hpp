@@ -117,6 +117,11 @@ class Buffer {
 
     void write(size_t count, std::function<size_t(void *, size_t)> func);
 
+    // Appends `block` by reference: the bytes are not copied and `block`
+    // is kept alive until the evbuffer is done with them, so the same
+    // block can be queued many times (and on many buffers) at no cost.
+    void write_reference(SharedPtr<std::string> block);
+
     SharedPtr<evbuffer> evbuf;
 };
 
@@ -84,7 +84,8 @@ void connect_first_of(SharedPtr<ConnectResult> result, int port,
                      logger->debug2("connect_first_of success");
                      result->connect_time = connect_time;
                      cb(*errors, bev);
-                 });
+                 },
+                 result->socket_options);
 }
 
 void connect_logic(std::string hostname, int port,
@@ -92,6 +93,14 @@ void connect_logic(std::string hostname, int port,
                    SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
 
     SharedPtr<ConnectResult> result(new ConnectResult);
+    ErrorOr<SocketOptions> socket_options =
+          SocketOptions::from_settings(settings);
+    if (!socket_options) {
+        logger->warn("connect: invalid socket options");
+        cb(socket_options.as_error(), result);
+        return;
+    }
+    result->socket_options = *socket_options;
     dns::resolve_hostname(hostname,
                      [=](dns::ResolveHostnameResult r) {
 
@@ -122,9 +131,12 @@ void connect_logic(std::string hostname, int port,
                                      cb(connect_error, result);
                                      return;
                                  }
-                                 Error nagle_error = disable_nagle(
-                                    bufferevent_getfd(result->connected_bev)
-                                 );
+                                 Error nagle_error = NoError();
+                                 if (result->socket_options.tcp_nodelay) {
+                                     nagle_error = disable_nagle(
+                                        bufferevent_getfd(result->connected_bev)
+                                     );
+                                 }
                                  for (auto se: e) {
                                     nagle_error.add_child_error(std::move(se));
                                  }
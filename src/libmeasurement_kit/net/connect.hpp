@@ -6,6 +6,7 @@
 
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/dns/resolve_hostname.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
 #include "src/libmeasurement_kit/net/transport.hpp"
 
 #include <event2/bufferevent.h>
@@ -28,6 +29,7 @@ class ConnectResult {
     std::vector<Error> connect_result;
     double connect_time = 0.0;
     bufferevent *connected_bev = nullptr;
+    SocketOptions socket_options;
 };
 
 typedef std::function<void(std::vector<Error>, bufferevent *)> ConnectFirstOfCb;
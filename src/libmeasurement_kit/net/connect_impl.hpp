@@ -8,6 +8,7 @@
 #include "src/libmeasurement_kit/common/utils.hpp"
 
 #include "src/libmeasurement_kit/net/connect.hpp"
+#include "src/libmeasurement_kit/net/error.hpp"
 
 #include <event2/bufferevent.h>
 
@@ -31,7 +32,8 @@ template <MK_MOCK(make_sockaddr), MK_MOCK(bufferevent_socket_new),
           MK_MOCK(bufferevent_socket_connect)>
 void connect_base(std::string address, uint16_t port, double timeout,
                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger,
-                  Callback<Error, bufferevent *, double> &&cb) {
+                  Callback<Error, bufferevent *, double> &&cb,
+                  const SocketOptions &options = SocketOptions{}) {
 
     std::string endpoint = [&address, &port]() {
         Endpoint endpoint;
@@ -67,9 +69,24 @@ void connect_base(std::string address, uint16_t port, double timeout,
      */
     static const int flags = BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS;
 
+    // Some options must be set before connect(), in which case we create
+    // the socket, otherwise bufferevent_socket_connect() creates it
+    socket_t sockfd = -1;
+    if (options.needs_socket()) {
+        sockfd = socket_create(saddr->sa_family, SOCK_STREAM, 0, logger);
+        if (sockfd == -1) {
+            cb(SocketError(), nullptr, 0.0);
+            return;
+        }
+        socket_options_apply(sockfd, options, logger);
+    }
+
     bufferevent *bev;
-    if ((bev = bufferevent_socket_new(reactor->get_event_base(), -1,
+    if ((bev = bufferevent_socket_new(reactor->get_event_base(), sockfd,
                                       flags)) == nullptr) {
+        if (sockfd != -1) {
+            (void)evutil_closesocket(sockfd);
+        }
         throw GenericError(); // This should not happen
     }
 
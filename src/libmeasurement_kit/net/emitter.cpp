@@ -30,6 +30,7 @@ void EmitterBase::close(Callback<> cb) {
     shutdown();
     on_connect(nullptr);
     on_data(nullptr);
+    on_drain(nullptr);
     on_flush(nullptr);
     on_error(nullptr);
     close_cb = cb;
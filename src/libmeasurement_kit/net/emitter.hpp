@@ -53,6 +53,12 @@ class EmitterBase : public Transport {
         if (do_record_received_data) {
             received_data_record.write(data.peek());
         }
+        if (do_drain) {
+            size_t count = data.length();
+            data.discard();
+            emit_drain(count);
+            return;
+        }
         if (!do_data) {
             logger->debug2("emitter: no handler set; ignoring");
             return;
@@ -63,6 +69,23 @@ class EmitterBase : public Transport {
         do_data(data);
     }
 
+    void emit_drain(size_t count) override {
+        logger->debug2("emitter: emit 'drain' event (num_bytes = %lu)",
+                       (unsigned long)count);
+        if (close_pending) {
+            logger->debug2("emitter: already closed; ignoring");
+            return;
+        }
+        if (!do_drain) {
+            logger->debug2("emitter: no handler set; ignoring");
+            return;
+        }
+        reactor->with_current_data_usage([count](DataUsage &du) {
+            du.down += count;
+        });
+        do_drain(count);
+    }
+
     void emit_flush() override {
         logger->debug2("emitter: emit 'flush' event");
         if (close_pending) {
@@ -104,6 +127,7 @@ class EmitterBase : public Transport {
             return;
         }
         if (fn) {
+            do_drain = nullptr;
             start_reading();
         } else {
             stop_reading();
@@ -111,6 +135,22 @@ class EmitterBase : public Transport {
         do_data = fn;
     }
 
+    void on_drain(std::function<void(size_t)> fn) override {
+        logger->debug2("emitter: %sregister 'drain' handler",
+                    (fn != nullptr) ? "" : "un");
+        if (close_pending) {
+            logger->debug2("emitter: already closed; ignoring");
+            return;
+        }
+        do_drain = fn;
+        if (fn) {
+            do_data = nullptr;
+            start_draining();
+        } else {
+            stop_reading();
+        }
+    }
+
     void on_flush(std::function<void()> fn) override {
         logger->debug2("emitter: %sregister 'flush' handler",
                     (fn != nullptr) ? "" : "un");
@@ -247,9 +287,15 @@ class EmitterBase : public Transport {
     SharedPtr<Logger> logger;
     Buffer output_buff;
 
+    // Whether we can discard incoming data without looking at it
+    bool draining() {
+        return do_drain && !do_record_received_data;
+    }
+
   private:
     Delegate<> do_connect;
     Delegate<Buffer> do_data;
+    Delegate<size_t> do_drain;
     Delegate<> do_flush;
     Delegate<Error> do_error;
     bool do_record_received_data = false;
@@ -280,6 +326,7 @@ class Emitter : public EmitterBase {
     void start_reading() override {}
     void stop_reading() override {}
     void start_writing() override {}
+    void start_draining() override {}
 };
 
 } // namespace net
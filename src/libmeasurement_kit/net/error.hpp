@@ -49,6 +49,9 @@ MK_DEFINE_ERR(MK_ERR_NET(28), SslCtxLoadVerifyMemError, "ssl_ctx_load_verify_mem
 
 MK_DEFINE_ERR(MK_ERR_NET(58), SslDirtyShutdownError, "ssl_dirty_shutdown")
 MK_DEFINE_ERR(MK_ERR_NET(59), SslMissingHostnameError, "ssl_missing_hostname")
+MK_DEFINE_ERR(MK_ERR_NET(60), WebSocketHandshakeError, "websocket_handshake_error")
+MK_DEFINE_ERR(MK_ERR_NET(61), WebSocketProtocolError, "websocket_protocol_error")
+MK_DEFINE_ERR(MK_ERR_NET(62), WebSocketMessageTooBigError, "websocket_message_too_big")
 
 /*
  * Mapping between errno (Unix) / WSAGetLastError (Windows) values and
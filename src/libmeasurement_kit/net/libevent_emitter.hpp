@@ -31,11 +31,16 @@
 #include <stdexcept>
 #include <utility>
 
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
 extern "C" {
 
 static inline void handle_libevent_read(bufferevent *, void *);
 static inline void handle_libevent_write(bufferevent *, void *);
 static inline void handle_libevent_event(bufferevent *, short, void *);
+static inline void handle_libevent_drain(evutil_socket_t, short, void *);
 
 } // extern "C"
 
@@ -62,6 +67,9 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
     }
 
     ~LibeventEmitter() override {
+        if (drain_event != nullptr) {
+            event_free(drain_event);
+        }
         if (bev != nullptr) {
             bufferevent_free(bev);
         }
@@ -77,6 +85,11 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
 
   protected:
     void adjust_timeout(double timeout) override {
+        read_timeout = timeout;
+        if (drain_event != nullptr && event_pending(drain_event, EV_READ,
+                                                    nullptr)) {
+            add_drain_event_();
+        }
         timeval tv, *tvp = mk::timeval_init(&tv, timeout);
         bufferevent *underlying = bufferevent_get_underlying(this->bev);
         if (underlying) {
@@ -99,22 +112,55 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
     }
 
     void start_reading() override {
+        stop_draining_();
         if (bufferevent_enable(this->bev, EV_READ) != 0) {
             throw std::runtime_error("cannot enable read");
         }
     }
 
     void stop_reading() override {
+        stop_draining_();
         if (bufferevent_disable(this->bev, EV_READ) != 0) {
             throw std::runtime_error("cannot disable read");
         }
     }
 
+    void start_draining() override {
+#ifdef __linux__
+        // On Linux, recv() with MSG_TRUNC discards TCP data in the kernel,
+        // so we bypass the bufferevent and never copy data into userspace. We
+        // cannot do that when the bufferevent is filtering data (e.g. SSL).
+        evutil_socket_t fd = bufferevent_getfd(bev);
+        if (fd != -1 && bufferevent_get_underlying(bev) == nullptr &&
+            draining()) {
+            if (bufferevent_disable(bev, EV_READ) != 0) {
+                throw std::runtime_error("cannot disable read");
+            }
+            if (drain_event == nullptr) {
+                drain_event = event_new(bufferevent_get_base(bev), fd,
+                                        EV_READ | EV_PERSIST,
+                                        handle_libevent_drain, this);
+                if (drain_event == nullptr) {
+                    throw std::bad_alloc();
+                }
+            }
+            add_drain_event_();
+            return;
+        }
+#endif
+        // Otherwise, data is discarded by handle_read_() without moving
+        // it out of the bufferevent's input buffer
+        if (bufferevent_enable(this->bev, EV_READ) != 0) {
+            throw std::runtime_error("cannot enable read");
+        }
+    }
+
     void shutdown() override {
         if (shutdown_called) {
             return; // Just for extra safety
         }
         shutdown_called = true;
+        stop_draining_();
         bufferevent_setcb(bev, nullptr, nullptr, nullptr, nullptr);
         reactor->call_soon([=]() { this->self = nullptr; });
     }
@@ -204,6 +250,25 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
     }
 
     void handle_read_() {
+        if (draining()) {
+            evbuffer *input = bufferevent_get_input(bev);
+            size_t count = evbuffer_get_length(input);
+            if (evbuffer_drain(input, count) != 0) {
+                emit_error(NetworkError("evbuffer_drain_failed"));
+                return;
+            }
+            try {
+                emit_drain(count);
+            } catch (Error &error) {
+                emit_error(error);
+                return;
+            }
+            if (suppressed_eof) {
+                suppressed_eof = false;
+                emit_error(EofError());
+            }
+            return;
+        }
         Buffer buff(bufferevent_get_input(bev));
         try {
             emit_data(buff);
@@ -219,6 +284,59 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
         }
     }
 
+    void handle_drain_(short what) {
+        // The drain event is persistent, so we must delete it ourselves
+        // before reporting an error, otherwise it will fire again
+        if ((what & EV_TIMEOUT) != 0) {
+            stop_draining_();
+            emit_error(TimeoutError());
+            return;
+        }
+        // Count what was read before we started draining in the kernel
+        evbuffer *input = bufferevent_get_input(bev);
+        size_t count = evbuffer_get_length(input);
+        if (evbuffer_drain(input, count) != 0) {
+            stop_draining_();
+            emit_error(NetworkError("evbuffer_drain_failed"));
+            return;
+        }
+        Error error = NoError();
+#ifdef __linux__
+        evutil_socket_t fd = bufferevent_getfd(bev);
+        // Bounded, so that other connections get a chance to run
+        for (int i = 0; i < 16; ++i) {
+            ssize_t n = ::recv(fd, nullptr, 1 << 20, MSG_TRUNC | MSG_DONTWAIT);
+            if (n > 0) {
+                count += (size_t)n;
+                continue;
+            }
+            if (n == 0) {
+                error = EofError();
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                error = net::map_errno(errno);
+            }
+            break;
+        }
+#endif
+        if (error) {
+            stop_draining_();
+        }
+        if (count > 0) {
+            try {
+                emit_drain(count);
+            } catch (Error &drain_error) {
+                stop_draining_();
+                emit_error(drain_error);
+                return;
+            }
+        }
+        if (error) {
+            emit_error(error);
+        }
+    }
+
     void handle_write_() {
         try {
             emit_flush();
@@ -238,7 +356,22 @@ class LibeventEmitter : public EmitterBase, public NonMovable, public NonCopyabl
                           handle_libevent_write, handle_libevent_event, this);
     }
 
+    void add_drain_event_() {
+        timeval tv, *tvp = mk::timeval_init(&tv, read_timeout);
+        if (event_add(drain_event, tvp) != 0) {
+            throw std::runtime_error("cannot add drain event");
+        }
+    }
+
+    void stop_draining_() {
+        if (drain_event != nullptr && event_del(drain_event) != 0) {
+            throw std::runtime_error("cannot delete drain event");
+        }
+    }
+
     bufferevent *bev = nullptr;
+    event *drain_event = nullptr;
+    double read_timeout = -1.0;
     SharedPtr<Transport> self;
     Callback<> close_cb;
     bool suppressed_eof = false;
@@ -264,4 +397,9 @@ static inline void handle_libevent_event(bufferevent *, short what,
     static_cast<mk::net::LibeventEmitter *>(opaque)->handle_event_(what);
 }
 
+static inline void handle_libevent_drain(evutil_socket_t, short what,
+                                         void *opaque) {
+    static_cast<mk::net::LibeventEmitter *>(opaque)->handle_drain_(what);
+}
+
 } // extern "C"
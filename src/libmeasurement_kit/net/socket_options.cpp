@@ -0,0 +1,163 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/net/socket_options.hpp"
+
+#include "src/libmeasurement_kit/net/tcp_info.hpp"
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+#include <string.h>
+
+// Older libc headers may not define it, even if the kernel supports it
+#if defined __linux__ && !defined TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT 30
+#endif
+
+namespace mk {
+namespace net {
+
+/* static */ ErrorOr<SocketOptions> SocketOptions::from_settings(
+      const Settings &settings) {
+    SocketOptions options;
+    ErrorOr<int> rcvbuf = settings.get_noexcept("net/rcvbuf", 0);
+    ErrorOr<int> sndbuf = settings.get_noexcept("net/sndbuf", 0);
+    ErrorOr<bool> tcp_nodelay = settings.get_noexcept("net/tcp_nodelay", true);
+    ErrorOr<int> tcp_notsent_lowat =
+          settings.get_noexcept("net/tcp_notsent_lowat", 0);
+    ErrorOr<bool> tcp_fastopen =
+          settings.get_noexcept("net/tcp_fastopen", false);
+    if (!rcvbuf || *rcvbuf < 0 || !sndbuf || *sndbuf < 0 || !tcp_nodelay ||
+        !tcp_notsent_lowat || *tcp_notsent_lowat < 0 || !tcp_fastopen) {
+        return {ValueError(), {}};
+    }
+    options.rcvbuf = *rcvbuf;
+    options.sndbuf = *sndbuf;
+    options.tcp_nodelay = *tcp_nodelay;
+    options.tcp_congestion = settings.get("net/tcp_congestion", "");
+    options.tcp_notsent_lowat = *tcp_notsent_lowat;
+    options.tcp_fastopen = *tcp_fastopen;
+    return {NoError(), std::move(options)};
+}
+
+bool SocketOptions::needs_socket() const {
+    return rcvbuf > 0 || sndbuf > 0 || tcp_congestion != "" ||
+           tcp_notsent_lowat > 0 || tcp_fastopen;
+}
+
+static void set_int_option(socket_t sockfd, int level, int name,
+                           const char *descr, int value,
+                           SharedPtr<Logger> logger) {
+    if (setsockopt(sockfd, level, name, (char *)&value, sizeof(value)) != 0) {
+        logger->warn("socket_options: cannot set %s to %d", descr, value);
+    }
+}
+
+void socket_options_apply(socket_t sockfd, const SocketOptions &options,
+                          SharedPtr<Logger> logger) {
+    // Note: buffer sizes must be set before connect() because they
+    // determine the window scale that we advertise in the SYN
+    if (options.rcvbuf > 0) {
+        set_int_option(sockfd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF",
+                       options.rcvbuf, logger);
+    }
+    if (options.sndbuf > 0) {
+        set_int_option(sockfd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF",
+                       options.sndbuf, logger);
+    }
+    if (options.tcp_congestion != "") {
+#ifdef TCP_CONGESTION
+        if (setsockopt(sockfd, IPPROTO_TCP, TCP_CONGESTION,
+                       options.tcp_congestion.c_str(),
+                       (socklen_t)options.tcp_congestion.size()) != 0) {
+            logger->warn("socket_options: cannot set TCP_CONGESTION to %s",
+                         options.tcp_congestion.c_str());
+        }
+#else
+        logger->warn("socket_options: TCP_CONGESTION not supported");
+#endif
+    }
+    if (options.tcp_notsent_lowat > 0) {
+#ifdef TCP_NOTSENT_LOWAT
+        set_int_option(sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                       "TCP_NOTSENT_LOWAT", options.tcp_notsent_lowat, logger);
+#else
+        logger->warn("socket_options: TCP_NOTSENT_LOWAT not supported");
+#endif
+    }
+    if (options.tcp_fastopen) {
+#ifdef TCP_FASTOPEN_CONNECT
+        set_int_option(sockfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                       "TCP_FASTOPEN_CONNECT", 1, logger);
+#else
+        logger->warn("socket_options: TCP Fast Open not supported");
+#endif
+    }
+}
+
+static void read_int_option(nlohmann::json &result, socket_t sockfd, int level,
+                            int name, const char *key) {
+    int value = 0;
+    socklen_t len = sizeof(value);
+    if (getsockopt(sockfd, level, name, (char *)&value, &len) == 0) {
+        result[key] = value;
+    }
+}
+
+nlohmann::json socket_options_read(socket_t sockfd) {
+    nlohmann::json result = nlohmann::json::object();
+    read_int_option(result, sockfd, SOL_SOCKET, SO_RCVBUF, "rcvbuf");
+    read_int_option(result, sockfd, SOL_SOCKET, SO_SNDBUF, "sndbuf");
+    read_int_option(result, sockfd, IPPROTO_TCP, TCP_NODELAY, "tcp_nodelay");
+    if (result.count("tcp_nodelay") != 0) {
+        result["tcp_nodelay"] = result["tcp_nodelay"].get<int>() != 0;
+    }
+#ifdef TCP_CONGESTION
+    char congestion[64] = {};
+    socklen_t len = sizeof(congestion) - 1;
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_CONGESTION, congestion, &len) ==
+        0) {
+        result["tcp_congestion"] = std::string{congestion, strnlen(
+                                                      congestion, len)};
+    }
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+    read_int_option(result, sockfd, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+                    "tcp_notsent_lowat");
+#endif
+#ifdef TCP_FASTOPEN_CONNECT
+    read_int_option(result, sockfd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                    "tcp_fastopen");
+    if (result.count("tcp_fastopen") != 0) {
+        result["tcp_fastopen"] = result["tcp_fastopen"].get<int>() != 0;
+    }
+#endif
+    return result;
+}
+
+nlohmann::json socket_options_effective(SharedPtr<Transport> txp) {
+    socket_t sockfd = tcp_info_socket(txp);
+    if (sockfd == (socket_t)-1) {
+        return nullptr;
+    }
+    return socket_options_read(sockfd);
+}
+
+void socket_options_copy(const Settings &from, Settings &to) {
+    for (auto key : {"net/rcvbuf", "net/sndbuf", "net/tcp_nodelay",
+                     "net/tcp_congestion", "net/tcp_notsent_lowat",
+                     "net/tcp_fastopen"}) {
+        auto it = from.find(key);
+        if (it != from.end()) {
+            to[key] = it->second;
+        }
+    }
+}
+
+} // namespace net
+} // namespace mk
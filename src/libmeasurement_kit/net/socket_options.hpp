@@ -0,0 +1,75 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NET_SOCKET_OPTIONS_HPP
+#define SRC_LIBMEASUREMENT_KIT_NET_SOCKET_OPTIONS_HPP
+
+#include "src/libmeasurement_kit/common/error_or.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/common/socket.hpp"
+#include "src/libmeasurement_kit/net/transport.hpp"
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <string>
+
+namespace mk {
+namespace net {
+
+/*
+    SocketOptions tunes the sockets created by net::connect(). Zero and
+    empty values mean that we keep the OS default. The options are
+    best effort: if the kernel refuses one of them we log a warning and
+    continue, and callers can see the effective values by reading them
+    back with socket_options_effective().
+
+    The settings are:
+
+    - `net/rcvbuf`, `net/sndbuf`: SO_RCVBUF and SO_SNDBUF in bytes;
+
+    - `net/tcp_nodelay`: whether to disable Nagle (default: true);
+
+    - `net/tcp_congestion`: congestion control algorithm (Linux only);
+
+    - `net/tcp_notsent_lowat`: TCP_NOTSENT_LOWAT in bytes;
+
+    - `net/tcp_fastopen`: whether to use TCP Fast Open (Linux only), in
+      which case the SYN is sent along with the first write.
+*/
+class SocketOptions {
+  public:
+    int rcvbuf = 0;
+    int sndbuf = 0;
+    bool tcp_nodelay = true;
+    std::string tcp_congestion;
+    int tcp_notsent_lowat = 0;
+    bool tcp_fastopen = false;
+
+    static ErrorOr<SocketOptions> from_settings(const Settings &settings);
+
+    /// `needs_socket()` tells whether we need to create the socket
+    /// ourselves, to set options before calling connect().
+    bool needs_socket() const;
+};
+
+/// `socket_options_apply()` sets the options that must be set before
+/// connect() on \p sockfd. Failures are logged and ignored.
+void socket_options_apply(socket_t sockfd, const SocketOptions &options,
+                          SharedPtr<Logger> logger);
+
+/// `socket_options_read()` returns the values of the options of \p sockfd
+/// as seen by the kernel. Options that cannot be read are omitted.
+nlohmann::json socket_options_read(socket_t sockfd);
+
+/// `socket_options_effective()` is like socket_options_read() for the
+/// socket of \p txp. It returns null if \p txp does not have a socket.
+nlohmann::json socket_options_effective(SharedPtr<Transport> txp);
+
+/// `socket_options_copy()` copies the settings that SocketOptions reads
+/// from \p from to \p to, if they are set.
+void socket_options_copy(const Settings &from, Settings &to);
+
+} // namespace net
+} // namespace mk
+#endif
@@ -0,0 +1,233 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/net/tcp_info.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/net/error.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <stdexcept>
+
+#include <event2/bufferevent.h>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#endif
+
+namespace mk {
+namespace net {
+
+#ifdef __linux__
+
+/*
+ * The libc `struct tcp_info` may not include the fields that newer kernels
+ * appended to it, and <linux/tcp.h> conflicts with <netinet/tcp.h>. Since
+ * the kernel only appends fields, we read the newer ones at their offsets.
+ */
+static const size_t tcpi_pacing_rate_offset = 104;
+static const size_t tcpi_bytes_acked_offset = 120;
+static const size_t tcpi_bytes_received_offset = 128;
+static const size_t tcpi_delivery_rate_offset = 160;
+
+static void maybe_add_u64(nlohmann::json &sample, const char *key,
+                          const uint8_t *raw, socklen_t len, size_t offset) {
+    uint64_t value = 0;
+    if (len >= offset + sizeof(value)) {
+        memcpy(&value, raw + offset, sizeof(value));
+        sample[key] = value;
+    }
+}
+
+ErrorOr<nlohmann::json> tcp_info_sample(socket_t sockfd) {
+    union {
+        struct tcp_info info;
+        uint8_t raw[256];
+    } u{};
+    socklen_t len = sizeof(u);
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &u, &len) != 0) {
+        return {SocketError(), {}};
+    }
+    const struct tcp_info &info = u.info;
+    nlohmann::json sample;
+    sample["state"] = info.tcpi_state;
+    sample["rtt"] = info.tcpi_rtt / 1e06;
+    sample["rttvar"] = info.tcpi_rttvar / 1e06;
+    sample["snd_cwnd"] = info.tcpi_snd_cwnd;
+    sample["snd_mss"] = info.tcpi_snd_mss;
+    sample["retransmits"] = info.tcpi_retransmits;
+    sample["total_retrans"] = info.tcpi_total_retrans;
+    maybe_add_u64(sample, "pacing_rate", u.raw, len, tcpi_pacing_rate_offset);
+    maybe_add_u64(sample, "bytes_acked", u.raw, len, tcpi_bytes_acked_offset);
+    maybe_add_u64(sample, "bytes_received", u.raw, len,
+                  tcpi_bytes_received_offset);
+    maybe_add_u64(sample, "delivery_rate", u.raw, len,
+                  tcpi_delivery_rate_offset);
+    return {NoError(), std::move(sample)};
+}
+
+ErrorOr<nlohmann::json> tcp_bbr_info_sample(socket_t sockfd) {
+#ifdef TCP_CC_INFO
+    char congestion[16] = {};
+    socklen_t len = sizeof(congestion) - 1;
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_CONGESTION, congestion, &len) !=
+              0 ||
+        strcmp(congestion, "bbr") != 0) {
+        return {NotImplementedError(), {}};
+    }
+    // Same layout as `struct tcp_bbr_info` in <linux/inet_diag.h>
+    struct {
+        uint32_t bw_lo;
+        uint32_t bw_hi;
+        uint32_t min_rtt;
+        uint32_t pacing_gain;
+        uint32_t cwnd_gain;
+    } info{};
+    len = sizeof(info);
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_CC_INFO, &info, &len) != 0) {
+        return {SocketError(), {}};
+    }
+    if (len < sizeof(info)) {
+        return {NotImplementedError(), {}};
+    }
+    nlohmann::json sample;
+    sample["bw"] = ((uint64_t)info.bw_hi << 32) | info.bw_lo;
+    sample["min_rtt"] = info.min_rtt / 1e06;
+    sample["pacing_gain"] = info.pacing_gain;
+    sample["cwnd_gain"] = info.cwnd_gain;
+    return {NoError(), std::move(sample)};
+#else
+    (void)sockfd;
+    return {NotImplementedError(), {}};
+#endif
+}
+
+#else
+
+ErrorOr<nlohmann::json> tcp_info_sample(socket_t) {
+    return {NotImplementedError(), {}};
+}
+
+ErrorOr<nlohmann::json> tcp_bbr_info_sample(socket_t) {
+    return {NotImplementedError(), {}};
+}
+
+#endif
+
+socket_t tcp_info_socket(SharedPtr<Transport> txp) {
+    bufferevent *bev = nullptr;
+    try {
+        bev = txp->get_bufferevent();
+    } catch (const std::runtime_error &) {
+        return (socket_t)-1; // Not attached to a bufferevent
+    }
+    while (bev != nullptr && bufferevent_get_underlying(bev) != nullptr) {
+        bev = bufferevent_get_underlying(bev);
+    }
+    return (bev != nullptr) ? (socket_t)bufferevent_getfd(bev) : (socket_t)-1;
+}
+
+/* static */ SharedPtr<TcpInfoSampler> TcpInfoSampler::make(
+      std::vector<SharedPtr<Transport>> flows, Settings settings,
+      SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
+    double interval = settings.get("net/tcp_info_interval", 0.0);
+    return SharedPtr<TcpInfoSampler>{
+          std::shared_ptr<TcpInfoSampler>{new TcpInfoSampler{
+                std::move(flows), interval, std::move(reactor),
+                std::move(logger)}}};
+}
+
+TcpInfoSampler::TcpInfoSampler(std::vector<SharedPtr<Transport>> flows,
+                               double interval, SharedPtr<Reactor> reactor,
+                               SharedPtr<Logger> logger)
+    : flows_{std::move(flows)}, samples_(nlohmann::json::array()),
+      interval_{interval}, reactor_{std::move(reactor)},
+      logger_{std::move(logger)} {
+    for (size_t i = 0; i < flows_.size(); ++i) {
+        samples_.push_back(nlohmann::json::array());
+    }
+}
+
+void TcpInfoSampler::start() {
+    if (started_ || interval_ <= 0.0) {
+        return;
+    }
+    started_ = true;
+    start_time_ = mk::time_now();
+    for (auto &txp : flows_) {
+        sockets_.push_back((!!txp) ? tcp_info_socket(txp) : (socket_t)-1);
+    }
+    sample_all();
+    schedule();
+}
+
+void TcpInfoSampler::remove(size_t flow) {
+    if (flow >= flows_.size()) {
+        return;
+    }
+    if (started_ && !stopped_) {
+        sample(flow, mk::time_now() - start_time_);
+        sockets_[flow] = (socket_t)-1;
+    }
+    flows_[flow] = {};
+}
+
+void TcpInfoSampler::stop() {
+    if (!started_ || stopped_) {
+        return;
+    }
+    stopped_ = true;
+    sample_all();
+    flows_.clear();
+    sockets_.clear();
+}
+
+nlohmann::json TcpInfoSampler::take() {
+    nlohmann::json samples = std::move(samples_);
+    samples_ = nlohmann::json::array();
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples_.push_back(nlohmann::json::array());
+    }
+    return samples;
+}
+
+void TcpInfoSampler::schedule() {
+    auto self = shared_from_this();
+    reactor_->call_later(interval_, [self]() {
+        if (self->stopped_) {
+            return;
+        }
+        self->sample_all();
+        self->schedule();
+    });
+}
+
+void TcpInfoSampler::sample(size_t flow, double elapsed) {
+    if (sockets_[flow] == (socket_t)-1) {
+        return;
+    }
+    ErrorOr<nlohmann::json> sample = tcp_info_sample(sockets_[flow]);
+    if (!sample) {
+        logger_->debug("tcp_info: cannot sample flow %lu: %s",
+                       (unsigned long)flow, sample.as_error().what());
+        return;
+    }
+    (*sample)["elapsed"] = elapsed;
+    samples_[flow].push_back(std::move(*sample));
+}
+
+void TcpInfoSampler::sample_all() {
+    double elapsed = mk::time_now() - start_time_;
+    for (size_t i = 0; i < sockets_.size(); ++i) {
+        sample(i, elapsed);
+    }
+}
+
+} // namespace net
+} // namespace mk
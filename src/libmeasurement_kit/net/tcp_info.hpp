@@ -0,0 +1,101 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NET_TCP_INFO_HPP
+#define SRC_LIBMEASUREMENT_KIT_NET_TCP_INFO_HPP
+
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
+#include "src/libmeasurement_kit/common/error_or.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/common/socket.hpp"
+#include "src/libmeasurement_kit/net/transport.hpp"
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <vector>
+
+namespace mk {
+namespace net {
+
+/// `tcp_info_sample()` reads the kernel TCP state of \p sockfd and returns
+/// it as a JSON object. Times are in seconds and rates in bytes per second.
+/// Fields not supported by the running kernel are omitted. On systems other
+/// than Linux it always fails with NotImplementedError.
+ErrorOr<nlohmann::json> tcp_info_sample(socket_t sockfd);
+
+/// `tcp_bbr_info_sample()` is like tcp_info_sample() but returns the state
+/// of the BBR congestion control (`bw` in bytes per second, `min_rtt` in
+/// seconds and the gains scaled by 256). It fails if \p sockfd does not
+/// use BBR.
+ErrorOr<nlohmann::json> tcp_bbr_info_sample(socket_t sockfd);
+
+/// `tcp_info_socket()` returns the socket underlying \p txp, looking through
+/// stacked bufferevents (e.g. TLS), or -1 if there is no such socket.
+socket_t tcp_info_socket(SharedPtr<Transport> txp);
+
+/*
+    TcpInfoSampler samples TCP_INFO for a set of flows every `interval`
+    seconds using the reactor timer, so that we also see what happens when
+    no data is arriving (e.g. the congestion window collapsing after a
+    loss). Samples are stored per flow, in the order of the flows, and
+    each of them also contains the `elapsed` time since start().
+
+    The sampler keeps the flows alive until they are removed or stop() is
+    called, therefore callers must remove a flow before waiting for it to
+    be closed. Sampling is opt-in because it makes results larger.
+*/
+class TcpInfoSampler : public EnableSharedFromThis<TcpInfoSampler>,
+                       public NonCopyable,
+                       public NonMovable {
+  public:
+    /// `make()` reads the interval from the `net/tcp_info_interval` setting
+    /// (default: 0, i.e. disabled). A nonpositive interval disables sampling.
+    static SharedPtr<TcpInfoSampler> make(std::vector<SharedPtr<Transport>> flows,
+                                          Settings settings,
+                                          SharedPtr<Reactor> reactor,
+                                          SharedPtr<Logger> logger);
+
+    /// `start()` takes the first sample and starts the timer. A sampler
+    /// cannot be started again after it has been stopped.
+    void start();
+
+    /// `remove()` takes a last sample of \p flow, stops sampling it and
+    /// releases it, while the other flows are still sampled.
+    void remove(size_t flow);
+
+    /// `stop()` takes a last sample, stops sampling and releases the flows.
+    void stop();
+
+    /// `take()` returns the samples collected so far, as a JSON array with
+    /// an array of samples for each flow, and forgets them.
+    nlohmann::json take();
+
+    double interval() const { return interval_; }
+
+    /// `enabled()` returns whether the sampler collects samples.
+    bool enabled() const { return interval_ > 0.0; }
+
+  private:
+    TcpInfoSampler(std::vector<SharedPtr<Transport>> flows, double interval,
+                   SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
+    void schedule();
+    void sample(size_t flow, double elapsed);
+    void sample_all();
+
+    std::vector<SharedPtr<Transport>> flows_;
+    std::vector<socket_t> sockets_;
+    nlohmann::json samples_;
+    double interval_ = 0.0;
+    double start_time_ = 0.0;
+    bool started_ = false;
+    bool stopped_ = false;
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+};
+
+} // namespace net
+} // namespace mk
+#endif
@@ -24,11 +24,16 @@ class TransportEmitter {
 
     virtual void emit_connect() = 0;
     virtual void emit_data(Buffer buf) = 0;
+    virtual void emit_drain(size_t count) = 0;
     virtual void emit_flush() = 0;
     virtual void emit_error(Error err) = 0;
 
     virtual void on_connect(Callback<>) = 0;
     virtual void on_data(Callback<Buffer>) = 0;
+    // Like on_data() but incoming data is discarded as soon as it is
+    // received and the handler is only told how many bytes were received,
+    // which is what throughput tests need. It replaces on_data().
+    virtual void on_drain(Callback<size_t>) = 0;
     virtual void on_flush(Callback<>) = 0;
     virtual void on_error(Callback<Error>) = 0;
 
@@ -101,6 +106,12 @@ class TransportPollable {
     virtual void start_reading() = 0;
     virtual void stop_reading() = 0;
     virtual void start_writing() = 0;
+
+    /*
+     * Like start_reading() but for on_drain(). Implementations may use
+     * this to discard data without copying it, when possible.
+     */
+    virtual void start_draining() = 0;
 };
 
 class TransportConnectable {
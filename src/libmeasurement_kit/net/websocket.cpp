@@ -0,0 +1,330 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/net/websocket.hpp"
+
+#include "src/libmeasurement_kit/common/encoding.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+#include <event2/util.h>
+#include <openssl/sha.h>
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace mk {
+namespace net {
+
+// See RFC 6455, Sect. 1.3
+#define WS_ACCEPT_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+SharedPtr<std::string> ws_frame(uint8_t opcode, const std::string &payload,
+                                bool mask) {
+    uint64_t length = payload.size();
+    uint8_t mask_bit = (mask) ? 0x80 : 0x00;
+    std::string frame;
+    frame.reserve(14 + length);
+    frame.push_back((char)(0x80 | (opcode & 0x0f)));
+    if (length < 126) {
+        frame.push_back((char)(mask_bit | length));
+    } else if (length <= 0xffff) {
+        frame.push_back((char)(mask_bit | 126));
+        frame.push_back((char)(length >> 8));
+        frame.push_back((char)length);
+    } else {
+        frame.push_back((char)(mask_bit | 127));
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame.push_back((char)(length >> shift));
+        }
+    }
+    uint8_t key[4] = {};
+    if (mask) {
+        evutil_secure_rng_get_bytes(key, sizeof(key));
+        frame.append((const char *)key, sizeof(key));
+    }
+    size_t offset = frame.size();
+    frame += payload;
+    if (mask) {
+        for (size_t i = 0; i < length; ++i) {
+            frame[offset + i] ^= key[i & 3];
+        }
+    }
+    return SharedPtr<std::string>{
+          std::make_shared<std::string>(std::move(frame))};
+}
+
+void ws_remask(std::string &frame) {
+    if (frame.size() < 2 || ((uint8_t)frame[1] & 0x80) == 0) {
+        throw std::runtime_error("ws_remask: frame is not masked");
+    }
+    uint8_t length = (uint8_t)frame[1] & 0x7f;
+    size_t offset = (length < 126) ? 2 : (length == 126) ? 4 : 10;
+    if (frame.size() < offset + 4) {
+        throw std::runtime_error("ws_remask: frame is too short");
+    }
+    // XORing with old ^ new removes the old key and applies the new one
+    uint8_t key[4] = {};
+    evutil_secure_rng_get_bytes(key, sizeof(key));
+    for (size_t i = 0; i < 4; ++i) {
+        uint8_t old = (uint8_t)frame[offset + i];
+        frame[offset + i] = (char)key[i];
+        key[i] ^= old;
+    }
+    for (size_t i = offset + 4, j = 0; i < frame.size(); ++i, ++j) {
+        frame[i] ^= key[j & 3];
+    }
+}
+
+std::string ws_close_payload(uint16_t code) {
+    std::string payload;
+    payload.push_back((char)(code >> 8));
+    payload.push_back((char)code);
+    return payload;
+}
+
+std::string ws_handshake_key() {
+    char nonce[16] = {};
+    evutil_secure_rng_get_bytes(nonce, sizeof(nonce));
+    return base64_encode(std::string{nonce, sizeof(nonce)});
+}
+
+std::string ws_accept_key(const std::string &key) {
+    std::string input = key + WS_ACCEPT_GUID;
+    unsigned char digest[SHA_DIGEST_LENGTH] = {};
+    SHA1((const unsigned char *)input.data(), input.size(), digest);
+    return base64_encode(std::string{(const char *)digest, sizeof(digest)});
+}
+
+static std::string lowercase(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](char c) { return (char)tolower((unsigned char)c); });
+    return s;
+}
+
+static Error check_handshake_response(const std::string &head,
+                                      const std::string &key,
+                                      const std::string &protocol,
+                                      SharedPtr<Logger> logger) {
+    std::vector<std::string> lines =
+          split<std::vector<std::string>>(head, "\r\n");
+    if (lines.empty() || lines[0].find("HTTP/1.1 101") != 0) {
+        logger->warn("websocket: unexpected response: %s",
+                     (lines.empty()) ? "" : lines[0].c_str());
+        return WebSocketHandshakeError();
+    }
+    bool upgrade = false;
+    bool accept = false;
+    bool subprotocol = (protocol == "");
+    for (size_t i = 1; i < lines.size(); ++i) {
+        size_t colon = lines[i].find(':');
+        if (colon == std::string::npos) {
+            return WebSocketHandshakeError();
+        }
+        std::string name = lowercase(lines[i].substr(0, colon));
+        std::string value = lines[i].substr(colon + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        if (name == "upgrade") {
+            upgrade = (lowercase(value) == "websocket");
+        } else if (name == "sec-websocket-accept") {
+            accept = (value == ws_accept_key(key));
+        } else if (name == "sec-websocket-protocol") {
+            subprotocol = (value == protocol);
+        }
+    }
+    if (!upgrade || !accept || !subprotocol) {
+        logger->warn("websocket: invalid handshake response headers");
+        return WebSocketHandshakeError();
+    }
+    return NoError();
+}
+
+void ws_handshake(SharedPtr<Transport> txp, std::string host, std::string path,
+                  std::string protocol, Callback<Error, SharedPtr<Buffer>> cb,
+                  SharedPtr<Logger> logger) {
+    std::string key = ws_handshake_key();
+    std::stringstream ss;
+    ss << "GET " << path << " HTTP/1.1\r\n"
+       << "Host: " << host << "\r\n"
+       << "Upgrade: websocket\r\n"
+       << "Connection: Upgrade\r\n"
+       << "Sec-WebSocket-Key: " << key << "\r\n"
+       << "Sec-WebSocket-Version: 13\r\n";
+    if (protocol != "") {
+        ss << "Sec-WebSocket-Protocol: " << protocol << "\r\n";
+    }
+    ss << "\r\n";
+    logger->debug("websocket: > GET %s", path.c_str());
+    SharedPtr<Buffer> buff = Buffer::make();
+    write(txp, Buffer{ss.str()}, [=](Error err) {
+        if (err) {
+            cb(err, buff);
+            return;
+        }
+        txp->on_data([=](Buffer data) {
+            *buff << data;
+            std::string head = buff->peek(MK_WS_MAX_HANDSHAKE_SIZE);
+            size_t end = head.find("\r\n\r\n");
+            if (end == std::string::npos) {
+                if (head.size() >= MK_WS_MAX_HANDSHAKE_SIZE) {
+                    txp->on_data(nullptr);
+                    txp->on_error(nullptr);
+                    cb(WebSocketHandshakeError(), buff);
+                }
+                return;
+            }
+            txp->on_data(nullptr);
+            txp->on_error(nullptr);
+            buff->discard(end + 4);
+            head.resize(end);
+            logger->debug("websocket: < %s",
+                          head.substr(0, head.find("\r\n")).c_str());
+            cb(check_handshake_response(head, key, protocol, logger), buff);
+        });
+        txp->on_error([=](Error err) {
+            txp->on_data(nullptr);
+            txp->on_error(nullptr);
+            cb(err, buff);
+        });
+    });
+}
+
+Error WsParser::feed(Buffer &data) {
+    for (;;) {
+        if (!in_frame_) {
+            bool complete = false;
+            Error err = begin_frame(data, &complete);
+            if (err || !complete) {
+                return err;
+            }
+        }
+        bool control = (opcode_ & 0x08) != 0;
+        size_t count = (size_t)std::min<uint64_t>(remaining_, data.length());
+        if (control || message_opcode_ == MK_WS_OPCODE_TEXT) {
+            std::string chunk = data.read(count);
+            unmask(chunk);
+            ((control) ? control_ : message_) += chunk;
+        } else if (count > 0) {
+            data.discard(count);
+            key_offset_ += count;
+            if (binary_fn_) {
+                binary_fn_(count);
+            }
+        }
+        remaining_ -= count;
+        if (remaining_ > 0) {
+            return NoError();
+        }
+        in_frame_ = false;
+        if (control) {
+            std::string payload;
+            std::swap(payload, control_);
+            if (message_fn_) {
+                message_fn_(opcode_, std::move(payload));
+            }
+        } else if (fin_) {
+            in_message_ = false;
+            if (message_opcode_ == MK_WS_OPCODE_TEXT) {
+                std::string payload;
+                std::swap(payload, message_);
+                if (message_fn_) {
+                    message_fn_(MK_WS_OPCODE_TEXT, std::move(payload));
+                }
+            }
+        }
+    }
+}
+
+Error WsParser::begin_frame(Buffer &data, bool *complete) {
+    *complete = false;
+    if (data.length() < 2) {
+        return NoError();
+    }
+    std::string header = data.peek(14);
+    uint8_t b0 = (uint8_t)header[0];
+    uint8_t b1 = (uint8_t)header[1];
+    if ((b0 & 0x70) != 0) {
+        return WebSocketProtocolError(); // No extensions were negotiated
+    }
+    uint8_t opcode = b0 & 0x0f;
+    bool fin = (b0 & 0x80) != 0;
+    bool masked = (b1 & 0x80) != 0;
+    if (masked != expect_masked_) {
+        return WebSocketProtocolError(); // See RFC 6455, Sect. 5.1
+    }
+    uint64_t length = b1 & 0x7f;
+    size_t header_size = 2;
+    if (length == 126) {
+        header_size += 2;
+    } else if (length == 127) {
+        header_size += 8;
+    }
+    size_t key_pos = header_size;
+    if (masked) {
+        header_size += 4;
+    }
+    if (header.size() < header_size) {
+        return NoError();
+    }
+    if (length >= 126) {
+        size_t size = (length == 126) ? 2 : 8;
+        length = 0;
+        for (size_t i = 0; i < size; ++i) {
+            length = (length << 8) | (uint8_t)header[2 + i];
+        }
+    }
+    if ((opcode & 0x08) != 0) {
+        if (!fin || length > 125 || (opcode != MK_WS_OPCODE_CLOSE &&
+                                     opcode != MK_WS_OPCODE_PING &&
+                                     opcode != MK_WS_OPCODE_PONG)) {
+            return WebSocketProtocolError();
+        }
+    } else if (opcode == MK_WS_OPCODE_CONTINUATION) {
+        if (!in_message_) {
+            return WebSocketProtocolError();
+        }
+    } else if (opcode == MK_WS_OPCODE_TEXT || opcode == MK_WS_OPCODE_BINARY) {
+        if (in_message_) {
+            return WebSocketProtocolError();
+        }
+        message_opcode_ = opcode;
+    } else {
+        return WebSocketProtocolError();
+    }
+    if ((opcode & 0x08) == 0 && message_opcode_ == MK_WS_OPCODE_TEXT &&
+        length > max_message_size_ - message_.size()) {
+        return WebSocketMessageTooBigError();
+    }
+    data.discard(header_size);
+    in_frame_ = true;
+    opcode_ = opcode;
+    fin_ = fin;
+    remaining_ = length;
+    masked_ = masked;
+    key_offset_ = 0;
+    if (masked) {
+        memcpy(key_, header.data() + key_pos, sizeof(key_));
+    }
+    if ((opcode & 0x08) == 0) {
+        in_message_ = !fin;
+    }
+    *complete = true;
+    return NoError();
+}
+
+void WsParser::unmask(std::string &chunk) {
+    if (!masked_) {
+        return;
+    }
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        chunk[i] ^= key_[(key_offset_ + i) & 3];
+    }
+    key_offset_ += chunk.size();
+}
+
+} // namespace net
+} // namespace mk
@@ -0,0 +1,134 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NET_WEBSOCKET_HPP
+#define SRC_LIBMEASUREMENT_KIT_NET_WEBSOCKET_HPP
+
+#include "src/libmeasurement_kit/common/callback.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/net/buffer.hpp"
+#include "src/libmeasurement_kit/net/error.hpp"
+#include "src/libmeasurement_kit/net/transport.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#define MK_WS_OPCODE_CONTINUATION 0x0
+#define MK_WS_OPCODE_TEXT 0x1
+#define MK_WS_OPCODE_BINARY 0x2
+#define MK_WS_OPCODE_CLOSE 0x8
+#define MK_WS_OPCODE_PING 0x9
+#define MK_WS_OPCODE_PONG 0xa
+
+#define MK_WS_CLOSE_NORMAL 1000
+
+// Upper bound for the messages that we keep in memory, i.e. text and
+// control messages; binary messages are counted and discarded
+#define MK_WS_MAX_MESSAGE_SIZE (1 << 20)
+
+// Upper bound for the response to the opening handshake
+#define MK_WS_MAX_HANDSHAKE_SIZE 8192
+
+namespace mk {
+namespace net {
+
+/*
+    Minimal RFC 6455 WebSocket support, meant for throughput tests.
+
+    Frames are formatted into a block that is appended to the output with
+    Buffer::write_reference(), so that writing does not copy it again.
+    Masking is done in place inside the block, when the block is created.
+    Since each frame sent by a client must use a new masking key, so that
+    proxies are protected against cache poisoning, a masked block must be
+    written only once. Once the output is done with it, ws_remask() gives
+    it a new key in place, so that it can be written again.
+
+    On the receiving side WsParser discards the payload of binary frames
+    directly from the input buffer and only reports their size.
+*/
+
+/// `ws_frame()` returns a block containing a single, final frame with the
+/// given \p opcode and \p payload. When \p mask is true, as it must be for
+/// frames sent by clients, the payload is masked with a new random key.
+SharedPtr<std::string> ws_frame(uint8_t opcode, const std::string &payload,
+                                bool mask);
+
+/// `ws_remask()` masks the payload of a \p frame returned by ws_frame()
+/// with \p mask true using a new random key, without copying it.
+void ws_remask(std::string &frame);
+
+/// `ws_close_payload()` returns the payload of a close frame.
+std::string ws_close_payload(uint16_t code);
+
+/// `ws_handshake_key()` returns a random Sec-WebSocket-Key value.
+std::string ws_handshake_key();
+
+/// `ws_accept_key()` returns the Sec-WebSocket-Accept value that the
+/// server must send back when the client has sent \p key.
+std::string ws_accept_key(const std::string &key);
+
+/// `ws_handshake()` performs the client side of the opening handshake for
+/// \p path on \p txp, requesting the \p protocol subprotocol if it is not
+/// empty. The callback receives the bytes that followed the response, if
+/// any, which must be parsed before reading more data from \p txp.
+void ws_handshake(SharedPtr<Transport> txp, std::string host, std::string path,
+                  std::string protocol, Callback<Error, SharedPtr<Buffer>> cb,
+                  SharedPtr<Logger> logger);
+
+class WsParser : public NonCopyable, public NonMovable {
+  public:
+    /// The constructor takes the maximum size of text messages and whether
+    /// frames must be \p masked, i.e. whether we are parsing what a client
+    /// sends. Per RFC 6455, a server must not mask its frames.
+    explicit WsParser(size_t max_message_size = MK_WS_MAX_MESSAGE_SIZE,
+                      bool masked = false)
+        : max_message_size_{max_message_size}, expect_masked_{masked} {}
+
+    /// `on_binary()` is called with the size of each chunk of payload of
+    /// binary messages, which are never buffered.
+    void on_binary(std::function<void(size_t)> fn) { binary_fn_ = fn; }
+
+    /// `on_message()` is called with the opcode and the unmasked payload
+    /// of each complete text message and of each control frame.
+    void on_message(std::function<void(uint8_t, std::string)> fn) {
+        message_fn_ = fn;
+    }
+
+    /// `feed()` consumes as much of \p data as possible. It returns an
+    /// error if the peer violates the protocol, e.g. by masking frames it
+    /// should not mask, after which the parser must not be used anymore.
+    Error feed(Buffer &data);
+
+  private:
+    Error begin_frame(Buffer &data, bool *complete);
+    void unmask(std::string &chunk);
+
+    size_t max_message_size_;
+    bool expect_masked_;
+    std::function<void(size_t)> binary_fn_;
+    std::function<void(uint8_t, std::string)> message_fn_;
+
+    // State of the frame being parsed
+    bool in_frame_ = false;
+    uint8_t opcode_ = 0;
+    bool fin_ = false;
+    uint64_t remaining_ = 0;
+    bool masked_ = false;
+    uint8_t key_[4] = {};
+    size_t key_offset_ = 0;
+    std::string control_;
+
+    // State of the (possibly fragmented) data message being parsed
+    bool in_message_ = false;
+    uint8_t message_opcode_ = 0;
+    std::string message_;
+};
+
+} // namespace net
+} // namespace mk
+#endif
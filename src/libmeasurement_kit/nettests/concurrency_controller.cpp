@@ -0,0 +1,86 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/nettests/concurrency_controller.hpp"
+
+#include <algorithm>
+
+namespace mk {
+namespace nettests {
+
+// Weights of the new sample in the short and long term averages
+static const double short_alpha = 0.3;
+static const double long_alpha = 0.05;
+
+// Samples needed before trusting the runtime averages
+static const size_t warmup_samples = 4;
+
+// Measurements in which we count timeouts, and timeouts needed to back off,
+// so that a single unlucky measurement does not halve the limit
+static const size_t timeout_window = 10;
+static const size_t min_timeouts = 2;
+
+SharedPtr<ConcurrencyController> ConcurrencyController::make(
+      Settings settings) {
+    return SharedPtr<ConcurrencyController>{
+          new ConcurrencyController{std::move(settings)}};
+}
+
+ConcurrencyController::ConcurrencyController(Settings settings) {
+    min_ = std::max(settings.get("parallelism/min", 1.0), 1.0);
+    max_ = std::max(settings.get("parallelism/max", 16.0), min_);
+    limit_ = std::min(std::max(settings.get("parallelism/initial", 3.0), min_),
+                      max_);
+    max_timeout_rate_ = settings.get("parallelism/max_timeout_rate", 0.1);
+    max_latency_ratio_ = settings.get("parallelism/max_latency_ratio", 2.0);
+    max_loop_lag_ = settings.get("parallelism/max_loop_lag", 0.1);
+}
+
+void ConcurrencyController::on_measurement_done(double runtime,
+                                                bool timed_out) {
+    samples_ += 1;
+    since_decrease_ += 1;
+    recent_timeouts_.push_back(timed_out);
+    num_recent_timeouts_ += (timed_out) ? 1 : 0;
+    if (recent_timeouts_.size() > timeout_window) {
+        num_recent_timeouts_ -= (recent_timeouts_.front()) ? 1 : 0;
+        recent_timeouts_.pop_front();
+    }
+    double timeout_rate =
+          num_recent_timeouts_ / (double)recent_timeouts_.size();
+    if (samples_ == 1) {
+        short_runtime_ = long_runtime_ = runtime;
+    } else {
+        short_runtime_ += short_alpha * (runtime - short_runtime_);
+        long_runtime_ += long_alpha * (runtime - long_runtime_);
+    }
+    if ((num_recent_timeouts_ >= min_timeouts &&
+         timeout_rate > max_timeout_rate_) ||
+        (samples_ >= warmup_samples &&
+         short_runtime_ > max_latency_ratio_ * long_runtime_)) {
+        decrease();
+        return;
+    }
+    // Increasing by 1/limit for each measurement means increasing by
+    // one after we have completed `limit` measurements
+    limit_ = std::min(limit_ + 1.0 / limit_, max_);
+}
+
+void ConcurrencyController::on_loop_lag(double lag) {
+    if (lag > max_loop_lag_) {
+        decrease();
+    }
+}
+
+void ConcurrencyController::decrease() {
+    if (since_decrease_ < cooldown_) {
+        return;
+    }
+    cooldown_ = limit();
+    since_decrease_ = 0;
+    limit_ = std::max(limit_ / 2.0, min_);
+}
+
+} // namespace nettests
+} // namespace mk
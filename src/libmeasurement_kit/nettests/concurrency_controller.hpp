@@ -0,0 +1,70 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_CONCURRENCY_CONTROLLER_HPP
+#define SRC_LIBMEASUREMENT_KIT_NETTESTS_CONCURRENCY_CONTROLLER_HPP
+
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+
+#include <measurement_kit/common/shared_ptr.hpp>
+
+#include <deque>
+#include <stddef.h>
+
+namespace mk {
+namespace nettests {
+
+/*
+    ConcurrencyController decides how many measurements to run in parallel
+    when `parallelism` is `auto`. Like TCP congestion control, it uses
+    additive increase and multiplicative decrease (AIMD): the limit grows by
+    one after each round of measurements completed without congestion, and
+    is halved when we see congestion. Congestion is either at least two
+    timeouts among the last ten measurements, with a rate above
+    `parallelism/max_timeout_rate`, a short term average runtime more
+    than `parallelism/max_latency_ratio` times the long term average, or a
+    reactor loop lag above `parallelism/max_loop_lag` seconds. After a
+    decrease, we wait for a round before decreasing again, so that the
+    measurements started with the old limit do not shrink it further.
+
+    The limit is within `parallelism/min` (default: 1) and `parallelism/max`
+    (default: 16) and starts from `parallelism/initial` (default: 3).
+*/
+class ConcurrencyController : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<ConcurrencyController> make(Settings settings);
+
+    /// `limit()` returns the number of measurements to run in parallel.
+    size_t limit() const { return (size_t)limit_; }
+
+    /// `on_measurement_done()` accounts for a measurement that took
+    /// \p runtime seconds and possibly \p timed_out.
+    void on_measurement_done(double runtime, bool timed_out);
+
+    /// `on_loop_lag()` accounts for a timer that fired \p lag seconds late.
+    void on_loop_lag(double lag);
+
+  private:
+    explicit ConcurrencyController(Settings settings);
+    void decrease();
+
+    double min_ = 1.0;
+    double max_ = 16.0;
+    double limit_ = 3.0;
+    double max_timeout_rate_ = 0.1;
+    double max_latency_ratio_ = 2.0;
+    double max_loop_lag_ = 0.1;
+    std::deque<bool> recent_timeouts_;
+    size_t num_recent_timeouts_ = 0;
+    double short_runtime_ = 0.0;
+    double long_runtime_ = 0.0;
+    size_t samples_ = 0;
+    size_t since_decrease_ = 0;
+    size_t cooldown_ = 0;
+};
+
+} // namespace nettests
+} // namespace mk
+#endif
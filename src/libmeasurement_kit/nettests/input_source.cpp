@@ -0,0 +1,117 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
+#include "src/libmeasurement_kit/ooni/error.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace mk {
+namespace nettests {
+
+constexpr size_t InputSource::manual_inputs;
+
+/* static */ SharedPtr<InputSource> InputSource::make(
+      std::deque<std::string> inputs, size_t block_size) {
+    return SharedPtr<InputSource>{
+          new InputSource{std::move(inputs), block_size}};
+}
+
+InputSource::InputSource(std::deque<std::string> inputs, size_t block_size)
+    : block_size_{(block_size > 0) ? block_size : 1},
+      manual_{std::move(inputs)} {
+    size_ = manual_.size();
+    if (!manual_.empty()) {
+        Block block;
+        block.file = manual_inputs;
+        block.count = manual_.size();
+        blocks_.push_back(block);
+    }
+}
+
+Error InputSource::add_file(const std::string &path) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file.is_open()) {
+        return ooni::CannotOpenInputFileError();
+    }
+    Block block;
+    block.file = paths_.size();
+    paths_.push_back(path);
+    uint64_t offset = 0;
+    bool partial = false; // Whether we've seen part of a line
+    char buffer[65536];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        size_t count = (size_t)file.gcount();
+        const char *p = buffer, *end = buffer + count;
+        const char *eol;
+        while ((eol = (const char *)memchr(p, '\n', (size_t)(end - p)))) {
+            p = eol + 1;
+            partial = false;
+            if (++block.count == block_size_) {
+                size_ += block.count;
+                blocks_.push_back(block);
+                block.offset = offset + (uint64_t)(p - buffer);
+                block.count = 0;
+            }
+        }
+        partial = partial || p < end;
+        offset += count;
+    }
+    if (partial) {
+        block.count += 1; // Like std::getline(), count the last line
+    }
+    if (block.count > 0) {
+        size_ += block.count;
+        blocks_.push_back(block);
+    }
+    if (file.bad()) {
+        return FileIoError();
+    }
+    return NoError();
+}
+
+void InputSource::randomize(uint32_t seed) {
+    shuffle_ = true;
+    rng_.seed(seed);
+    std::shuffle(blocks_.begin() + next_block_, blocks_.end(), rng_);
+}
+
+void InputSource::load(const Block &block) {
+    if (block.file == manual_inputs) {
+        std::swap(current_, manual_);
+    } else {
+        if (file_index_ != block.file) {
+            file_.close();
+            file_.clear();
+            file_.open(paths_[block.file], std::ios::binary);
+            file_index_ = block.file;
+        }
+        file_.clear();
+        file_.seekg((std::streamoff)block.offset);
+        std::string line;
+        for (size_t i = 0; i < block.count && std::getline(file_, line); ++i) {
+            current_.push_back(std::move(line));
+        }
+    }
+    if (shuffle_) {
+        std::shuffle(current_.begin(), current_.end(), rng_);
+    }
+}
+
+bool InputSource::next(std::string &input) {
+    while (current_.empty()) {
+        if (next_block_ >= blocks_.size()) {
+            return false;
+        }
+        load(blocks_[next_block_++]);
+    }
+    input = std::move(current_.front());
+    current_.pop_front();
+    return true;
+}
+
+} // namespace nettests
+} // namespace mk
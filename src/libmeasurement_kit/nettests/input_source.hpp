@@ -0,0 +1,80 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_INPUT_SOURCE_HPP
+#define SRC_LIBMEASUREMENT_KIT_NETTESTS_INPUT_SOURCE_HPP
+
+#include "src/libmeasurement_kit/common/error.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include <measurement_kit/common/shared_ptr.hpp>
+
+#include <stdint.h>
+
+#include <deque>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace mk {
+namespace nettests {
+
+/*
+    InputSource yields the inputs of a nettest without loading all input
+    files into memory. When a file is added, we read it in chunks to count
+    its lines and remember the offset of every `block_size` lines. Then we
+    read a block at a time. Randomizing shuffles the order of the blocks and
+    the lines within each block, so memory is proportional to the block
+    size plus the number of blocks. Inputs passed to make() are kept in
+    memory and treated as a single block.
+*/
+class InputSource : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<InputSource> make(std::deque<std::string> inputs = {},
+                                       size_t block_size = 4096);
+
+    /// `add_file()` adds the lines of \p path. Returns CannotOpenInputFileError
+    /// if the file cannot be opened and FileIoError if we cannot read all of
+    /// it, in which case the lines read so far are kept.
+    Error add_file(const std::string &path);
+
+    /// `randomize()` shuffles the inputs. Call it before next().
+    void randomize(uint32_t seed);
+
+    /// `next()` returns false when there are no more inputs.
+    bool next(std::string &input);
+
+    /// `size()` returns the total number of inputs.
+    size_t size() const { return size_; }
+
+  private:
+    class Block {
+      public:
+        size_t file = 0;
+        uint64_t offset = 0;
+        size_t count = 0;
+    };
+
+    InputSource(std::deque<std::string> inputs, size_t block_size);
+    void load(const Block &block);
+
+    static constexpr size_t manual_inputs = (size_t)-1;
+
+    size_t block_size_ = 0;
+    size_t size_ = 0;
+    std::deque<std::string> manual_;
+    std::vector<std::string> paths_;
+    std::vector<Block> blocks_;
+    size_t next_block_ = 0;
+    std::deque<std::string> current_;
+    bool shuffle_ = false;
+    std::mt19937 rng_;
+    std::ifstream file_;
+    size_t file_index_ = manual_inputs;
+};
+
+} // namespace nettests
+} // namespace mk
+#endif
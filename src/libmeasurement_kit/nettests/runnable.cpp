@@ -5,21 +5,24 @@
 #include "src/libmeasurement_kit/common/fmap.hpp"
 #include "src/libmeasurement_kit/common/parallel.hpp"
 #include "src/libmeasurement_kit/common/range.hpp"
+#include "src/libmeasurement_kit/nettests/concurrency_controller.hpp"
 #include "src/libmeasurement_kit/nettests/runnable.hpp"
 
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/bouncer.hpp"
+#include "src/libmeasurement_kit/ooni/geoip_cache.hpp"
 #include "src/libmeasurement_kit/ooni/utils.hpp"
 #include "src/libmeasurement_kit/nettests/utils.hpp"
 
+#include "src/libmeasurement_kit/report/entry_builder.hpp"
 #include "src/libmeasurement_kit/report/file_reporter.hpp"
 #include "src/libmeasurement_kit/report/ooni_reporter.hpp"
 
-#include <measurement_kit/internal/vendor/mkmmdb.hpp>
-#include <measurement_kit/internal/vendor/mkuuid4.hpp>
+#include <fstream>
 
 #ifndef MK_WITHOUT_CURL
-#include <measurement_kit/internal/vendor/mkiplookup.hpp>
+#include "src/libmeasurement_kit/curl/multi.hpp"
+#include "src/libmeasurement_kit/ooni/ip_lookup.hpp"
 #endif
 
 namespace mk {
@@ -28,6 +31,9 @@ namespace nettests {
 using namespace mk::report;
 using namespace mk::ooni;
 
+// Errors of failed lanes we keep when `parallelism` is `auto`
+static const size_t max_lane_errors = 16;
+
 Runnable::~Runnable() {}
 
 void Runnable::setup(std::string) {}
@@ -40,27 +46,60 @@ void Runnable::main(std::string, Settings, Callback<SharedPtr<nlohmann::json>> c
 }
 void Runnable::fixup_entry(nlohmann::json &) {}
 
+// Whether any of the top level failures of \p test_keys is a timeout
+static bool timed_out(const nlohmann::json &test_keys) {
+    if (!test_keys.is_object()) {
+        return false;
+    }
+    static const std::string suffix = "failure";
+    for (auto it = test_keys.begin(); it != test_keys.end(); ++it) {
+        const std::string &key = it.key();
+        if (key.size() >= suffix.size() &&
+            key.compare(key.size() - suffix.size(), suffix.size(), suffix) ==
+                  0 &&
+            it->is_string() &&
+            it->get<std::string>().find("timeout") != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
                                     size_t num_entries,
                                     SharedPtr<size_t> current_entry) {
     logger->debug("net_test: running next measurement");
 
+    if (write_error) {
+        // Only set when `ignore_write_entry_error` is false
+        wait_for_pending_writes(0, [=]() { cb(write_error); });
+        return;
+    }
+
     double max_rt = options.get("max_runtime", -1.0);
     double max_rt_tolerance = max_rt / 10.0;
     double delta = mk::time_now() - beginning;
     if (max_rt >= 0.0 && delta > max_rt - max_rt_tolerance) {
         logger->info("Exceeded test maximum runtime");
+        wait_for_pending_writes(0, [=]() { cb(write_error); });
+        return;
+    }
+
+    // With `parallelism=auto` lanes retire when the limit has shrunk; the
+    // last lane never retires, so that it waits for pending writes
+    if (concurrency && active_lanes > 1 &&
+        active_lanes > concurrency->limit()) {
+        logger->debug("net_test: retiring lane %lu", (unsigned long)thread_id);
         cb(NoError());
         return;
     }
 
-    if (inputs.size() <= 0) {
+    std::string next_input;
+    if (!input_source->next(next_input)) {
         logger->debug("net_test: reached end of input");
-        cb(NoError());
+        wait_for_pending_writes(0, [=]() { cb(write_error); });
         return;
     }
-    std::string next_input = inputs.front();
-    inputs.pop_front();
 
     double prog = 0.0;
     if (max_rt > 0.0) {
@@ -86,116 +125,220 @@ void Runnable::run_next_measurement(size_t thread_id, Callback<Error> cb,
     logger->debug("net_test: calling setup");
     setup(next_input);
 
+    if (saved_current_entry == 0) {
+        emit_startup_phase("first_measurement", beginning);
+    }
     logger->debug("net_test: running with input %s", next_input.c_str());
-    logger->emit_event_ex("status.measurement_start", nlohmann::json::object({
+    nlohmann::json start_event{
         {"idx", saved_current_entry},
         {"input", next_input},
-    }));
+    };
+    if (concurrency) {
+        start_event["concurrency"] = active_lanes;
+    }
+    logger->emit_event_ex("status.measurement_start", std::move(start_event));
 
     main(next_input, options, [=](SharedPtr<nlohmann::json> test_keys) {
-        nlohmann::json entry;
-        entry["input"] = next_input;
-        // Make sure the input is `null` rather than empty string
-        if (entry["input"] == "") {
-            entry["input"] = nullptr;
-        }
-        entry["test_keys"] = *test_keys;
-        entry["test_keys"]["client_resolver"] = resolver_ip;
-        entry["measurement_start_time"] =
-            *mk::timestamp(&measurement_start_time);
-        entry["test_runtime"] = mk::time_now() - start_time;
-        entry["id"] = mk::uuid4::gen();
-
-        // Until we have support for passing options, leave it empty
-        entry["options"] = nlohmann::json::array();
-
-        // Until we have support for it, just put `null`
-        entry["probe_city"] = nullptr;
-
-        // Add test helpers
-        entry["test_helpers"] = nlohmann::json::object();
-        for (auto &name : test_helpers_option_names()) {
-            if (options.count(name) != 0) {
-                entry["test_helpers"][name] = options[name];
+        // Measured here, so waiting for the report ID below is not included
+        double test_runtime = mk::time_now() - start_time;
+        if (concurrency) {
+            concurrency->on_measurement_done(test_runtime,
+                                             timed_out(*test_keys));
+            while (active_lanes < concurrency->limit()) {
+                start_lane(num_entries, current_entry);
             }
         }
 
-        // Add empty input hashes
-        entry["input_hashes"] = nlohmann::json::array();
-
         logger->debug("net_test: tearing down");
         teardown(next_input);
 
-        // Note: annotations must be added before fill_entry because in the
-        // latter we will add additional annotations.
-        entry["annotations"] = annotations;
-        report.fill_entry(entry);
-        fixup_entry(entry); // Let drivers possibly fix-up the entry
-
-        // We should not dump without checking. See #1823.
-        std::string dumped;
-        try {
-          dumped = entry.dump();
-        } catch (const std::exception &exc) {
-          logger->warn("net_test: cannot dump entry");
-          entry["test_keys"] = nullptr;
-          entry["test_keys"]["failure"] = "json_processing_error";
-          try {
-            dumped = entry.dump();
-          } catch (const std::exception &exc) {
-            logger->warn("net_test: cannot really dump entry");
-            dumped = R"({"test_keys":{"failure":"json_processing_error"}})";
-          }
-        }
+        // When the collector creates the report in the background, wait
+        // for the report ID, so that every reporter saves the same entry
+        report.wait_for_open([=]() {
+            if (!entry_builder) {
+                // Built here, because the report fields are known by now
+                nlohmann::json test_helpers = nlohmann::json::object();
+                for (auto &name : test_helpers_option_names()) {
+                    if (options.count(name) != 0) {
+                        test_helpers[name] = options[name];
+                    }
+                }
+                entry_builder = SharedPtr<EntryBuilder>{
+                      std::make_shared<EntryBuilder>(
+                            report, annotations, std::move(test_helpers))};
+            }
+            nlohmann::json entry = entry_builder->build(
+                  next_input, std::move(*test_keys), resolver_ip,
+                  measurement_start_time, test_runtime,
+                  report.report_id);
+
+            fixup_entry(entry); // Let drivers possibly fix-up the entry
+
+            // We should not dump without checking. See #1823.
+            //
+            // This is the only place where we serialize the entry: the event
+            // below, the dedup logic and all the reporters share these bytes.
+            SerializedEntry serialized;
+            try {
+              serialized = SerializedEntry::make(std::move(entry));
+            } catch (const std::exception &exc) {
+              logger->warn("net_test: cannot dump entry");
+              entry["test_keys"] = nullptr;
+              entry["test_keys"]["failure"] = "json_processing_error";
+              try {
+                serialized = SerializedEntry::make(std::move(entry));
+              } catch (const std::exception &exc) {
+                logger->warn("net_test: cannot really dump entry");
+                static const char *fallback =
+                    R"({"test_keys":{"failure":"json_processing_error"}})";
+                serialized = SerializedEntry{fallback,
+                                             nlohmann::json::parse(fallback)};
+              }
+            }
 
-        // TODO(bassosimone): make sure that this entry contains the report ID
-        // which probably is currently not the case.
-        logger->emit_event_ex("measurement", nlohmann::json::object({
-            {"idx", saved_current_entry},
-            {"json_str", dumped},
-        }));
-        report.write_entry(entry, [=](Error error) {
+            logger->emit_event_ex("measurement", nlohmann::json::object({
+                {"idx", saved_current_entry},
+                {"json_str", serialized.str()},
+            }));
+            // Submitting the entry happens in the background, so that we can
+            // start the next measurement without waiting for the collector. We
+            // only stop when too many submissions are still pending.
+            pending_writes += 1;
+            report.write_entry(serialized, [=](Error error) {
+                if (error) {
+                    logger->warn("cannot write entry");
+                    if (!options.get("no_collector", false)) {
+                        // We should only emit submission related events when
+                        // the collector is enabled. Otherwise we confuse OONI.
+                        logger->emit_event_ex(
+                              "failure.measurement_submission", {
+                                    {"idx", saved_current_entry},
+                                    {"json_str", serialized.str()},
+                                    {"failure", error.reason},
+                              });
+                    }
+                    if (not options.get("ignore_write_entry_error", true)) {
+                        write_error = error;
+                    }
+                } else {
+                    logger->debug("net_test: written entry");
+                    if (!options.get("no_collector", false)) {
+                        // Like above, emit this event only if the collector
+                        // has been enabled by the user. When spooling, the
+                        // entry will be submitted later, possibly by another
+                        // run, so don't tell the app it has been submitted.
+                        logger->emit_event_ex(
+                              (report.spools_entries())
+                                    ? "status.measurement_spooled"
+                                    : "status.measurement_submission",
+                              {{"idx", saved_current_entry}});
+                    }
+                }
+                logger->emit_event_ex("status.measurement_done", {
+                    {"idx", saved_current_entry}
+                });
+                pending_write_done();
+            }, logger);
+            wait_for_pending_writes(
+                  options.get("max_pending_submissions", (size_t)16), [=]() {
+                reactor->call_soon([=]() {
+                    run_next_measurement(thread_id, cb, num_entries,
+                                         current_entry);
+                });
+            });
+        });
+    });
+}
+
+void Runnable::run_adaptively(Callback<Error> cb, size_t num_entries,
+                              SharedPtr<size_t> current_entry) {
+    concurrency = ConcurrencyController::make(options);
+    lanes_error = NoError();
+    num_failed_lanes = 0;
+    lanes_done = cb;
+    for (size_t i = 0; i < concurrency->limit(); ++i) {
+        start_lane(num_entries, current_entry);
+    }
+    sample_loop_lag();
+}
+
+void Runnable::start_lane(size_t num_entries,
+                          SharedPtr<size_t> current_entry) {
+    size_t thread_id = num_lanes++;
+    active_lanes += 1;
+    logger->debug("net_test: starting lane %lu (%lu active)",
+                  (unsigned long)thread_id, (unsigned long)active_lanes);
+    reactor->call_soon([=]() {
+        run_next_measurement(thread_id, [=](Error error) {
+            // Like mk::parallel() does when `parallelism` is a number, except
+            // that lanes come and go for the whole run, so we only keep the
+            // errors of the first lanes that failed
             if (error) {
-                logger->warn("cannot write entry");
-                if (!options.get("no_collector", false)) {
-                    // We should only emit submission related events when
-                    // the collector is enabled. Otherwise we confuse OONI.
-                    logger->emit_event_ex("failure.measurement_submission", {
-                        {"idx", saved_current_entry},
-                        {"json_str", dumped},
-                        {"failure", error.reason},
-                    });
+                if (lanes_error == NoError()) {
+                    static const Error template_error =
+                          ParallelOperationError();
+                    lanes_error.code = template_error.code;
+                    lanes_error.reason = template_error.reason;
                 }
-                if (not options.get("ignore_write_entry_error", true)) {
-                    cb(error);
-                    return;
+                if (lanes_error.child_errors.size() < max_lane_errors) {
+                    lanes_error.child_errors.push_back(error);
                 }
-            } else {
-                logger->debug("net_test: written entry");
-                if (!options.get("no_collector", false)) {
-                    // Like above, emit this event only if the collector
-                    // has been enabled by the user.
-                    logger->emit_event_ex("status.measurement_submission", {
-                        {"idx", saved_current_entry}
-                    });
+                num_failed_lanes += 1;
+            }
+            assert(active_lanes > 0);
+            active_lanes -= 1;
+            if (active_lanes == 0) {
+                if (num_failed_lanes > 0) {
+                    logger->warn("net_test: %lu of %lu lanes failed",
+                                 (unsigned long)num_failed_lanes,
+                                 (unsigned long)num_lanes);
                 }
+                Callback<Error> done = std::move(lanes_done);
+                lanes_done = nullptr;
+                concurrency = {}; // Also stops sampling the loop lag
+                done(lanes_error);
             }
-            logger->emit_event_ex("status.measurement_done", {
-                {"idx", saved_current_entry}
-            });
-            reactor->call_soon([=]() {
-                run_next_measurement(thread_id, cb, num_entries, current_entry);
-            });
-        }, logger);
+        }, num_entries, current_entry);
     });
 }
 
-void Runnable::geoip_lookup(Callback<> cb) {
-    static const std::string default_probe_ip = "127.0.0.1";
-    static const std::string default_probe_asn = "AS0";
-    static const std::string default_probe_cc = "ZZ";
-    static const std::string default_probe_network_name = "";
+void Runnable::sample_loop_lag() {
+    // A timer that fires late means the reactor is too busy
+    double interval = options.get("parallelism/loop_lag_interval", 0.25);
+    double expected = mk::time_now() + interval;
+    reactor->call_later(interval, [=]() {
+        if (!concurrency) {
+            return;
+        }
+        concurrency->on_loop_lag(mk::time_now() - expected);
+        sample_loop_lag();
+    });
+}
+
+void Runnable::wait_for_pending_writes(size_t max_pending, Callback<> cb) {
+    if (pending_writes <= max_pending) {
+        cb();
+        return;
+    }
+    write_waiters.push_back({max_pending, std::move(cb)});
+}
 
+void Runnable::pending_write_done() {
+    assert(pending_writes > 0);
+    pending_writes -= 1;
+    auto waiters = std::move(write_waiters);
+    write_waiters.clear();
+    for (auto &waiter : waiters) {
+        wait_for_pending_writes(waiter.first, std::move(waiter.second));
+    }
+}
+
+static const std::string default_probe_ip = "127.0.0.1";
+static const std::string default_probe_asn = "AS0";
+static const std::string default_probe_cc = "ZZ";
+static const std::string default_probe_network_name = "";
+
+void Runnable::geoip_lookup(Callback<> cb) {
     // This is to ensure that when calling multiple times geoip_lookup we
     // always reset the probe_ip, probe_asn and probe_cc values.
     probe_ip = default_probe_ip;
@@ -203,10 +346,6 @@ void Runnable::geoip_lookup(Callback<> cb) {
     probe_cc = default_probe_cc;
     probe_network_name = default_probe_network_name;
 
-    bool save_ip = options.get("save_real_probe_ip", false);
-    bool save_asn = options.get("save_real_probe_asn", true);
-    bool save_cc = options.get("save_real_probe_cc", true);
-    bool save_network_name = options.get("save_real_probe_network_name", true);
     bool no_geoip = options.get("no_geoip", false);
 
     std::string real_probe_ip = options.get("probe_ip", default_probe_ip);
@@ -217,76 +356,105 @@ void Runnable::geoip_lookup(Callback<> cb) {
         mk::iplookup::Request req;
         req.timeout = (int64_t)timeout;
         req.ca_bundle_path = ca;
-        mk::iplookup::Response res = mk::iplookup::perform(req);
-        if (!res.good) {
-            logger->emit_event_ex("failure.ip_lookup", {
-                {"failure", "generic_error"},
-            });
-            logger->logsv(MK_LOG_WARNING, res.logs);
-            annotations["failure_ip_lookup"] = "true";
-        } else {
-            real_probe_ip = res.probe_ip;
-            logger->logsv(MK_LOG_DEBUG, res.logs);
+        // Performed through the reactor, so we do not block the I/O loop
+        // for up to `net/timeout` seconds while waiting for the server.
+        if (!ip_lookup_multi) {
+            ip_lookup_multi = mk::curl::Multi::make(reactor, logger);
         }
+        ip_lookup_multi->perform(ooni::ip_lookup_request(req),
+                                 [=](mk::curl::TransferResponse re) {
+            std::string ip = default_probe_ip;
+            mk::iplookup::Response res =
+                ooni::ip_lookup_response(std::move(re));
+            if (!res.good) {
+                logger->emit_event_ex("failure.ip_lookup", {
+                    {"failure", "generic_error"},
+                });
+                logger->logsv(MK_LOG_WARNING, res.logs);
+                annotations["failure_ip_lookup"] = "true";
+            } else {
+                ip = res.probe_ip;
+                logger->logsv(MK_LOG_DEBUG, res.logs);
+            }
+            geoip_lookup_databases(ip, cb);
+        });
+        return;
     }
 #endif
+    geoip_lookup_databases(real_probe_ip, cb);
+}
+
+void Runnable::geoip_lookup_databases(
+        std::string real_probe_ip, Callback<> cb) {
+    bool save_ip = options.get("save_real_probe_ip", false);
+    bool save_asn = options.get("save_real_probe_asn", true);
+    bool save_cc = options.get("save_real_probe_cc", true);
+    bool save_network_name = options.get("save_real_probe_network_name", true);
+    bool no_geoip = options.get("no_geoip", false);
 
     std::string real_probe_cc = options.get("probe_cc", default_probe_cc);
-    if (real_probe_cc == default_probe_cc && no_geoip == false) {
-        std::string path = options.get("geoip_country_path", std::string{});
-        mk::mmdb::Handle db;
-        std::vector<std::string> logs;
-        std::string cc;
-        if (!db.open(path, logs) || !db.lookup_cc(real_probe_ip, cc, logs)) {
+    std::string real_probe_asn = options.get("probe_asn", default_probe_asn);
+    std::string real_probe_network_name = options.get(
+        "probe_network_name", default_probe_network_name);
+    bool need_cc = real_probe_cc == default_probe_cc && no_geoip == false;
+    bool need_asn = real_probe_asn == default_probe_asn && no_geoip == false;
+    bool need_network_name =
+        real_probe_network_name == default_probe_network_name &&
+        no_geoip == false;
+
+    // The databases stay open across runs and the results are cached.
+    std::vector<std::string> logs;
+    GeoipInfo geoip;
+    if (need_cc || need_asn || need_network_name) {
+        geoip = GeoipCache::global()->lookup(
+            need_cc ? options.get("geoip_country_path", std::string{}) : "",
+            (need_asn || need_network_name)
+                ? options.get("geoip_asn_path", std::string{}) : "",
+            real_probe_ip, logs, need_network_name);
+    }
+    bool failed = false;
+
+    if (need_cc) {
+        if (!geoip.cc_ok) {
             logger->emit_event_ex("failure.cc_lookup", {
                 {"failure", "generic_error"},
             });
-            logger->logsv(MK_LOG_WARNING, logs);
             annotations["failure_cc_lookup"] = "true";
+            failed = true;
         } else {
-            std::swap(cc, real_probe_cc);
-            logger->logsv(MK_LOG_DEBUG, logs);
+            real_probe_cc = geoip.cc;
         }
     }
 
-    std::string real_probe_asn = options.get("probe_asn", default_probe_asn);
-    if (real_probe_asn == default_probe_asn && no_geoip == false) {
-        std::string path = options.get("geoip_asn_path", std::string{});
-        mk::mmdb::Handle db;
-        std::vector<std::string> logs;
-        std::string asn;
-        if (!db.open(path, logs) || !db.lookup_asn2(real_probe_ip, asn, logs)) {
+    if (need_asn) {
+        if (!geoip.asn_ok) {
             logger->emit_event_ex("failure.asn_lookup", {
                 {"failure", "generic_error"},
             });
-            logger->logsv(MK_LOG_WARNING, logs);
             annotations["failure_asn_lookup"] = "true";
+            failed = true;
         } else {
-            std::swap(real_probe_asn, asn);
-            logger->logsv(MK_LOG_DEBUG, logs);
+            real_probe_asn = geoip.asn;
         }
     }
 
-    std::string real_probe_network_name = options.get(
-        "probe_network_name", default_probe_network_name);
-    if (real_probe_network_name == default_probe_network_name &&
-        no_geoip == false) {
-        std::string path = options.get("geoip_asn_path", std::string{});
-        mk::mmdb::Handle db;
-        std::vector<std::string> logs;
-        std::string org;
-        if (!db.open(path, logs) || !db.lookup_org(real_probe_ip, org, logs)) {
+    if (need_network_name) {
+        if (!geoip.org_ok) {
             logger->emit_event_ex("failure.network_name_lookup", {
                 {"failure", "generic_error"},
             });
-            logger->logsv(MK_LOG_WARNING, logs);
             annotations["failure_network_name_lookup"] = "true";
+            failed = true;
         } else {
-            std::swap(org, real_probe_network_name);
-            logger->logsv(MK_LOG_INFO, logs);
+            real_probe_network_name = geoip.org;
         }
     }
 
+    // The logs of a successful network name lookup are worth showing
+    logger->logsv(failed ? MK_LOG_WARNING
+                         : need_network_name ? MK_LOG_INFO : MK_LOG_DEBUG,
+                  logs);
+
     // Note: if geoip is skipped, we need to update internal variables but
     // we should not emit log messages because that may be confusing. The main
     // use case for this feature is running MK nettest from ooni/probe-engine
@@ -337,8 +505,13 @@ void Runnable::geoip_lookup(Callback<> cb) {
      * specific tests to scrub entries.
      *
      * See also measurement-kit/measurement-kit#1110.
+     *
+     * The real probe ASN, along with the IP, also tells mlab-ns
+     * code which network we're in, to remember the server it
+     * selected for each network.
      */
     options["real_probe_ip_"] = real_probe_ip;
+    options["real_probe_asn_"] = real_probe_asn;
     cb();
 }
 
@@ -357,18 +530,35 @@ void Runnable::open_report(Callback<Error> callback) {
     report.probe_cc = probe_cc;
     report.probe_asn = probe_asn;
 
-    if (output_filepath == "") {
-        output_filepath = generate_output_filepath();
-    }
-    if (!options.get("no_file_report", false)) {
-        report.add_reporter(FileReporter::make(output_filepath));
-    }
     if (!options.get("no_collector", false)) {
-        report.add_reporter(OoniReporter::make(options, reactor, logger));
+        // We cannot start measuring while the collector is creating the
+        // report when we must fail if we cannot open the report
+        Settings settings = options;
+        if (!options.get("ignore_open_report_error", true)) {
+            settings["collector/open_in_background"] = false;
+        }
+        report.add_reporter(OoniReporter::make(settings, reactor, logger));
     }
+    // Note: opening again the file reporter is a no-op, unless we failed
+    // to open it before, in which case we try again
     report.open(callback);
 }
 
+void Runnable::open_report_file(Callback<Error> callback) {
+    if (options.get("no_file_report", false)) {
+        callback(NoError());
+        return;
+    }
+    if (output_filepath == "") {
+        output_filepath = generate_output_filepath();
+    }
+    SharedPtr<BaseReporter> reporter =
+          FileReporter::make(output_filepath, options, reactor,
+                                             logger);
+    report.add_reporter(reporter);
+    reporter->open(report)(callback);
+}
+
 std::string Runnable::generate_output_filepath() {
     int idx = 0;
     std::stringstream filename;
@@ -413,7 +603,7 @@ void Runnable::query_bouncer(Callback<Error> cb) {
     auto bouncer = options.get("bouncer_base_url",
             ooni::bouncer::production_bouncer_url());
     logger->info("Contacting bouncer: %s", bouncer.c_str());
-    ooni::bouncer::post_net_tests(
+    ooni::bouncer::post_net_tests_cached(
         bouncer, test_name, test_version, test_helpers_bouncer_names(),
         [=](Error error, SharedPtr<BouncerReply> reply) {
             if (error) {
@@ -469,13 +659,54 @@ void Runnable::query_bouncer(Callback<Error> cb) {
 void Runnable::begin(Callback<Error> cb) {
     mk::utc_time_now(&test_start_time);
     beginning = mk::time_now();
-    query_bouncer([=](Error error) {
-        if (error) {
-            cb(error);
-            return;
-        }
-        mk::dump_settings(options, "runnable", logger);
-        geoip_lookup([=]() {
+    // Only opening the report depends on the other phases, hence we run
+    // them in parallel and open the report when all of them are done. We
+    // create the report file only once the bouncer succeeded. Every phase
+    // always completes, and we decide whether we failed at the end.
+    SharedPtr<Error> bouncer_error{new Error{NoError()}};
+    SharedPtr<Callback<Error>> pending_geoip{new Callback<Error>{}};
+    mk::parallel({
+        [=](Callback<Error> cb_) {
+            startup_phase("bouncer", [=](Callback<Error> cb) {
+                query_bouncer(cb);
+            })([=](Error error) {
+                if (error) {
+                    *bouncer_error = error;
+                    if (*pending_geoip) {
+                        // Destroying the Multi aborts the pending IP lookup
+                        // without calling its callback, so we complete the
+                        // geoip phase on its behalf
+#ifndef MK_WITHOUT_CURL
+                        ip_lookup_multi.reset();
+#endif
+                        Callback<Error> geoip_cb = std::move(*pending_geoip);
+                        *pending_geoip = nullptr;
+                        geoip_cb(OperationCancelledError());
+                    }
+                    cb_(error);
+                    return;
+                }
+                startup_phase("report_file", [=](Callback<Error> cb) {
+                    open_report_file(cb);
+                })(cb_);
+            });
+        },
+        startup_phase("geoip_lookup", [=](Callback<Error> cb) {
+            if (*bouncer_error) {
+                cb(OperationCancelledError());
+                return;
+            }
+            *pending_geoip = cb;
+            geoip_lookup([=]() {
+                *pending_geoip = nullptr;
+                cb(NoError());
+            });
+        }),
+        startup_phase("resolver_lookup", [=](Callback<Error> cb) {
+            if (*bouncer_error) {
+                cb(OperationCancelledError());
+                return;
+            }
             resolver_lookup(
                 [=](Error error, std::string resolver_ip_) {
                     if (!error) {
@@ -483,48 +714,85 @@ void Runnable::begin(Callback<Error> cb) {
                     } else {
                         logger->debug("failed to lookup resolver ip");
                     }
-                    open_report([=](Error error) {
-                        if (error) {
-                            logger->warn("Cannot open report: %s",
-                                         error.what());
-                            // FALLTHROUGH
-                        }
-                        if (error and
-                            not options.get("ignore_open_report_error", true)) {
-                            cb(error);
-                            return;
-                        }
-                        logger->progress(0.1, "starting the test");
-                        logger->set_progress_offset(0.1);
-                        logger->set_progress_scale(0.8);
-
-                        error = process_input_filepaths(inputs,
-                                needs_input, input_filepaths, probe_cc, options,
-                                logger, nullptr, nullptr);
-                        if (error) {
-                            cb(error);
-                            return;
-                        }
-                        size_t num_entries = inputs.size();
-
-                        // Run `parallelism` measurements in parallel
-                        SharedPtr<size_t> current_entry(new size_t(0));
-                        mk::parallel(mk::fmap<size_t, Continuation<Error>>(
-                                         mk::range<size_t>(
-                                             options.get("parallelism", 3)),
-                                         [=](size_t thread_id) {
-                                             return [=](Callback<Error> cb) {
-                                                 run_next_measurement(
-                                                     thread_id, cb, num_entries,
-                                                     current_entry);
-                                             };
-                                         }),
-                                     cb);
-
-                    });
+                    cb(NoError());
                 },
                 options, reactor, logger);
+        }),
+    }, [=](Error) {
+        // Failing to create the report file is not fatal, as open_report()
+        // below decides what to do when we cannot open the report
+        if (*bouncer_error) {
+            cb(*bouncer_error);
+            return;
+        }
+        mk::dump_settings(options, "runnable", logger);
+        startup_phase("open_report", [=](Callback<Error> cb) {
+            open_report(cb);
+        })([=](Error error) {
+            if (error) {
+                logger->warn("Cannot open report: %s", error.what());
+                // FALLTHROUGH
+            }
+            if (error and not options.get("ignore_open_report_error", true)) {
+                cb(error);
+                return;
+            }
+            logger->progress(0.1, "starting the test");
+            logger->set_progress_offset(0.1);
+            logger->set_progress_scale(0.8);
+
+            // Input files are read lazily to bound memory usage
+            ErrorOr<SharedPtr<InputSource>> source = open_input_source(
+                std::move(inputs), needs_input, input_filepaths, probe_cc,
+                options, logger, nullptr, nullptr);
+            inputs.clear();
+            if (!source) {
+                cb(source.as_error());
+                return;
+            }
+            input_source = *source;
+            size_t num_entries = input_source->size();
+
+            // Run `parallelism` measurements in parallel or let the
+            // controller pick their number when `auto`
+            SharedPtr<size_t> current_entry(new size_t(0));
+            if (options.get("parallelism", std::string{}) == "auto") {
+                run_adaptively(cb, num_entries, current_entry);
+                return;
+            }
+            mk::parallel(
+                mk::fmap<size_t, Continuation<Error>>(
+                    mk::range<size_t>(options.get("parallelism", 3)),
+                    [=](size_t thread_id) {
+                        return [=](Callback<Error> cb) {
+                            run_next_measurement(thread_id, cb, num_entries,
+                                                 current_entry);
+                        };
+                    }),
+                cb);
+        });
+    });
+}
+
+Continuation<Error> Runnable::startup_phase(std::string phase,
+                                            Continuation<Error> cc) {
+    return [=](Callback<Error> cb) {
+        double start = mk::time_now();
+        cc([=](Error error) {
+            emit_startup_phase(phase, start);
+            cb(error);
         });
+    };
+}
+
+void Runnable::emit_startup_phase(std::string phase, double start) {
+    double now = mk::time_now();
+    logger->debug("net_test: startup phase %s took %.3f seconds",
+                  phase.c_str(), now - start);
+    logger->emit_event_ex("status.startup_phase", {
+        {"phase", phase},
+        {"duration", now - start},
+        {"elapsed", now - beginning},
     });
 }
 
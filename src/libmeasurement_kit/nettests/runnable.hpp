@@ -4,6 +4,7 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_NETTESTS_RUNNABLE_HPP
 #define SRC_LIBMEASUREMENT_KIT_NETTESTS_RUNNABLE_HPP
 
+#include "src/libmeasurement_kit/common/continuation.hpp"
 #include "src/libmeasurement_kit/common/delegate.hpp"
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
 #include "src/libmeasurement_kit/common/non_movable.hpp"
@@ -18,8 +19,17 @@
 #include <sstream>
 
 namespace mk {
+namespace curl {
+class Multi;
+} // namespace curl
+namespace report {
+class EntryBuilder;
+} // namespace report
 namespace nettests {
 
+class ConcurrencyController; // Forward decl.
+class InputSource; // Forward decl.
+
 class Runnable : public NonCopyable, public NonMovable {
   public:
     void begin(Callback<Error>);
@@ -61,11 +71,34 @@ class Runnable : public NonCopyable, public NonMovable {
     report::ReportLegacy report;
     tm test_start_time;
     double beginning = 0.0;
+    size_t pending_writes = 0;
+    Error write_error;
+    std::list<std::pair<size_t, Callback<>>> write_waiters;
+    SharedPtr<InputSource> input_source;
+    SharedPtr<report::EntryBuilder> entry_builder;
+    SharedPtr<curl::Multi> ip_lookup_multi;
+
+    // Only used when `parallelism` is `auto`
+    SharedPtr<ConcurrencyController> concurrency;
+    size_t active_lanes = 0;
+    size_t num_lanes = 0;
+    Error lanes_error;
+    size_t num_failed_lanes = 0;
+    Callback<Error> lanes_done;
 
     void run_next_measurement(size_t, Callback<Error>, size_t, SharedPtr<size_t>);
+    void run_adaptively(Callback<Error>, size_t, SharedPtr<size_t>);
+    void start_lane(size_t, SharedPtr<size_t>);
+    void sample_loop_lag();
+    void wait_for_pending_writes(size_t, Callback<>);
+    void pending_write_done();
     void query_bouncer(Callback<Error>);
     void geoip_lookup(Callback<>);
+    void geoip_lookup_databases(std::string, Callback<>);
     void open_report(Callback<Error>);
+    void open_report_file(Callback<Error>);
+    Continuation<Error> startup_phase(std::string, Continuation<Error>);
+    void emit_startup_phase(std::string, double);
     std::string generate_output_filepath();
 };
 
@@ -98,6 +131,9 @@ class WebConnectivityRunnable : public Runnable {
     void main(
             std::string, Settings, Callback<SharedPtr<nlohmann::json>>) override;
     void fixup_entry(nlohmann::json &) override;
+
+  private:
+    SharedPtr<curl::Multi> control_multi;
 };
 
 } // namespace nettests
@@ -2,34 +2,74 @@
 // Measurement Kit is free software under the BSD license. See AUTHORS
 // and LICENSE for more information on the copying conditions.
 
-#include "src/libmeasurement_kit/nettests/utils_impl.hpp"
+#include "src/libmeasurement_kit/nettests/utils.hpp"
 
-namespace mk {
-namespace nettests {
+#include "src/libmeasurement_kit/ooni/error.hpp"
+#include "src/libmeasurement_kit/regexp/regexp.hpp"
 
-SharedPtr<std::istream> open_file_(const std::string &path) {
-    return SharedPtr<std::istream>{new std::ifstream{path}};
-}
-
-bool readline_(std::istream &input, std::string &line) {
-    return static_cast<bool>(std::getline(input, line));
-}
+#include <random>
 
-void randomize_input_(std::deque<std::string> &inputs) {
-    // See http://en.cppreference.com/w/cpp/algorithm/shuffle
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(inputs.begin(), inputs.end(), g);
-}
+namespace mk {
+namespace nettests {
 
-Error process_input_filepaths(std::deque<std::string> &input,
-    const bool &needs_input, const std::list<std::string> &input_filepaths,
-    const std::string &probe_cc, const Settings &options, SharedPtr<Logger> logger,
+ErrorOr<SharedPtr<InputSource>> open_input_source(
+    std::deque<std::string> &&input, const bool &needs_input,
+    const std::list<std::string> &input_filepaths, const std::string &probe_cc,
+    const Settings &options, SharedPtr<Logger> logger,
     std::function<void(const std::string &)> on_open_error,
     std::function<void(const std::string &)> on_io_error) {
-    return process_input_filepaths_impl(input, needs_input, input_filepaths,
-                                        probe_cc, options, logger,
-                                        on_open_error, on_io_error);
+    if (!needs_input) {
+        // Yield a single empty entry to call main just once. Manually
+        // passed input is ignored, otherwise input-less tests would run
+        // more than once.
+        if (input.size() != 0) {
+            logger->warn("Manually passed input for a test that requires no "
+                         "input; fixing by clearing the input vector");
+        }
+        return {NoError(), InputSource::make({""})};
+    }
+    if (input_filepaths.size() <= 0 && input.size() == 0) {
+        logger->warn("at least an input file is required");
+        return {ooni::MissingRequiredInputFileError(), {}};
+    }
+    ErrorOr<bool> shuffle = options.get_noexcept<bool>("randomize_input", true);
+    if (!shuffle) {
+        logger->warn("invalid 'randomize_input' option");
+        return {shuffle.as_error(), {}};
+    }
+    std::string probe_cc_lowercase = "";
+    for (auto c : probe_cc) {
+        probe_cc_lowercase += std::tolower(c);
+    }
+    SharedPtr<InputSource> source = InputSource::make(
+          std::move(input), options.get("input_block_size", (size_t)4096));
+    for (auto input_filepath : input_filepaths) {
+        input_filepath = regexp::replace_probe_cc(std::move(input_filepath),
+                                                  probe_cc_lowercase);
+        Error error = source->add_file(input_filepath);
+        if (error == ooni::CannotOpenInputFileError()) {
+            logger->warn("cannot open input file");
+            if (!!on_open_error) {
+                on_open_error(input_filepath);
+            }
+        } else if (error) {
+            logger->warn("I/O error reading input file");
+            if (!!on_io_error) {
+                on_io_error(input_filepath);
+            }
+        }
+    }
+    if (source->size() <= 0) {
+        logger->warn("no specified input file could be read");
+        return {ooni::CannotReadAnyInputFileError(), {}};
+    }
+    if (*shuffle) {
+        uint32_t seed = options.get("randomize_input_seed",
+                                    (uint32_t)std::random_device{}());
+        source->randomize(seed);
+    }
+    return {NoError(), source};
 }
+
 } // namespace nettests
 } // namespace mk
@@ -8,21 +8,22 @@
 #include <list>
 #include <measurement_kit/common.hpp>
 
+#include "src/libmeasurement_kit/common/error_or.hpp"
 #include "src/libmeasurement_kit/common/logger.hpp"
 #include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
 
 namespace mk {
 namespace nettests {
 
 /**
- * @brief Generates the list of entries to be tested.
+ * @brief Returns an InputSource that lazily yields the entries to be tested.
  *
- * @param input The input deque containing input. Note that it may already
- * contain input that has been manually specified by the user.
+ * @param input Manually specified input, moved into the InputSource.
  *
- * @param needs_input If this value is false, the function returns just a
- * single, empty entry; otherwise, the function reads and returns as entries
- * all lines of the files provided as argument.
+ * @param needs_input If this value is false, the InputSource yields just a
+ * single, empty entry; otherwise, it yields the manually specified input
+ * followed by all lines of the files provided as argument.
  *
  * @param input_filepaths When input is required, files to read; a missing
  * or non-readable file is not considered fatal and a warning will be
@@ -31,8 +32,10 @@ namespace nettests {
  * @param probe_cc Country code of the probe: if a file path contains the
  * "${probe_cc}" string, this is expanded to the country code in lower case.
  *
- * @param options If the boolean "randomize_input" option is true, this
- * function randomizes the list of entries before returning it.
+ * @param options If the boolean "randomize_input" option is true (the
+ * default), the entries are shuffled using "randomize_input_seed" as seed
+ * (by default a random seed). The "input_block_size" option is the number
+ * of lines that are loaded and shuffled together (default: 4096).
  *
  * @param logger Used to print log messages.
  *
@@ -57,8 +60,8 @@ namespace nettests {
  * - the error returned when trying to convert to boolean the value of
  *   "randomize_input" setting (e.g. ValueError)
  */
-Error process_input_filepaths(
-        std::deque<std::string> &input,
+ErrorOr<SharedPtr<InputSource>> open_input_source(
+        std::deque<std::string> &&input,
         const bool &needs_input,
         const std::list<std::string> &input_filepaths,
         const std::string &probe_cc,
@@ -3,6 +3,7 @@
 // and LICENSE for more information on the copying conditions.
 
 #include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/curl/multi.hpp"
 #include "src/libmeasurement_kit/nettests/runnable.hpp"
 #include "src/libmeasurement_kit/ooni/nettests.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
@@ -19,7 +20,12 @@ WebConnectivityRunnable::WebConnectivityRunnable() noexcept {
 
 void WebConnectivityRunnable::main(std::string input, Settings options,
                                    Callback<SharedPtr<nlohmann::json>> cb) {
-    ooni::web_connectivity(input, options, cb, reactor, logger);
+    // All the control requests of this run go through the same multi
+    // handle such that they share one HTTP/2 connection to the backend.
+    if (!control_multi && options.get("backend/http2", false)) {
+        control_multi = curl::Multi::make(reactor, logger);
+    }
+    ooni::web_connectivity(input, options, cb, reactor, logger, control_multi);
 }
 
 void WebConnectivityRunnable::fixup_entry(nlohmann::json &entry) {
@@ -0,0 +1,229 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/neubot/abr.hpp"
+
+#include "src/libmeasurement_kit/common/throughput_estimator.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace mk {
+namespace neubot {
+namespace dash {
+
+AbrStrategy::~AbrStrategy() {}
+
+// Returns the highest rate not greater than `limit` or the lowest rate
+static int highest_rate_below(const std::vector<int> &rates, double limit) {
+    int rate = rates.front();
+    for (int r : rates) {
+        if (r > limit) {
+            break;
+        }
+        rate = r;
+    }
+    return rate;
+}
+
+class LegacyAbr : public AbrStrategy {
+  public:
+    explicit LegacyAbr(AbrParams params) : speed_kbit_{params.initial_rate} {}
+
+    int select_rate(double) override { return speed_kbit_; }
+
+    void add_sample(double speed_kbit) override {
+        speed_kbit_ = std::max((int)speed_kbit, 1);
+    }
+
+  private:
+    int speed_kbit_;
+};
+
+class ThroughputAbr : public AbrStrategy {
+  public:
+    explicit ThroughputAbr(AbrParams params) : params_{params} {}
+
+    int select_rate(double) override {
+        if (samples_ == 0) {
+            return highest_rate_below(params_.rates, params_.initial_rate);
+        }
+        // Leave some headroom so that small speed variations do not
+        // cause the player to stall
+        return highest_rate_below(params_.rates, 0.9 * speeds_.ewma());
+    }
+
+    void add_sample(double speed_kbit) override {
+        speeds_.add(speed_kbit);
+        samples_ += 1;
+    }
+
+  private:
+    AbrParams params_;
+    size_t samples_ = 0;
+    RateStats speeds_;
+};
+
+class BolaAbr : public AbrStrategy {
+  public:
+    explicit BolaAbr(AbrParams params) : params_{params} {
+        // Using the parameters recommended by the paper: gamma*p is
+        // five segments and V is such that we choose the highest rate
+        // when the buffer is full.
+        double max_utility = utility(params_.rates.back());
+        v_ = (params_.buffer_capacity / params_.segment_duration - 1) /
+             (max_utility + gamma_p_);
+    }
+
+    int select_rate(double buffer_level) override {
+        double q = buffer_level / params_.segment_duration;
+        int rate = params_.rates.front();
+        double best = 0.0;
+        bool first = true;
+        for (int r : params_.rates) {
+            double score = (v_ * (utility(r) + gamma_p_) - q) / r;
+            if (first || score > best) {
+                best = score;
+                rate = r;
+                first = false;
+            }
+        }
+        return rate;
+    }
+
+    void add_sample(double) override {}
+
+  private:
+    double utility(int rate) const {
+        return log((double)rate / params_.rates.front());
+    }
+
+    const double gamma_p_ = 5.0;
+    AbrParams params_;
+    double v_ = 0.0;
+};
+
+class HybridAbr : public AbrStrategy {
+  public:
+    explicit HybridAbr(AbrParams params)
+        : bola_{params}, capacity_{params.buffer_capacity},
+          throughput_{params} {}
+
+    int select_rate(double buffer_level) override {
+        // Hysteresis so that we don't flip strategy at each segment
+        if (buffer_level >= capacity_ / 3) {
+            use_bola_ = true;
+        } else if (buffer_level < capacity_ / 6) {
+            use_bola_ = false;
+        }
+        return (use_bola_) ? bola_.select_rate(buffer_level)
+                           : throughput_.select_rate(buffer_level);
+    }
+
+    void add_sample(double speed_kbit) override {
+        throughput_.add_sample(speed_kbit);
+    }
+
+  private:
+    BolaAbr bola_;
+    double capacity_;
+    ThroughputAbr throughput_;
+    bool use_bola_ = false;
+};
+
+ErrorOr<SharedPtr<AbrStrategy>> make_abr_strategy(const std::string &name,
+                                                  AbrParams params) {
+    if (params.rates.empty() || params.rates.front() <= 0 ||
+        !std::is_sorted(params.rates.begin(), params.rates.end()) ||
+        params.segment_duration <= 0 ||
+        params.buffer_capacity < params.segment_duration ||
+        params.initial_rate <= 0) {
+        return {InvalidAbrError("invalid_params"), {}};
+    }
+    SharedPtr<AbrStrategy> abr;
+    if (name == "legacy") {
+        abr.reset(new LegacyAbr{params});
+    } else if (name == "throughput") {
+        abr.reset(new ThroughputAbr{params});
+    } else if (name == "bola") {
+        abr.reset(new BolaAbr{params});
+    } else if (name == "hybrid") {
+        abr.reset(new HybridAbr{params});
+    } else {
+        return {InvalidAbrError(name), {}};
+    }
+    return {NoError(), abr};
+}
+
+double PlayoutBuffer::add_segment(double download_time, double duration) {
+    double stall = 0.0;
+    if (playing_) {
+        stall = std::max(download_time - level_, 0.0);
+        level_ = std::max(level_ - download_time, 0.0);
+    }
+    playing_ = true;
+    level_ = std::min(level_ + duration, capacity_);
+    return stall;
+}
+
+ErrorOr<nlohmann::json> simulate_abr(const nlohmann::json &receiver_data,
+                                     const std::string &name,
+                                     AbrParams params) {
+    ErrorOr<SharedPtr<AbrStrategy>> abr = make_abr_strategy(name, params);
+    if (!abr) {
+        return {abr.as_error(), {}};
+    }
+    std::vector<double> speeds;
+    try {
+        for (auto &record : receiver_data) {
+            double elapsed = record.at("elapsed");
+            double received = record.at("received");
+            if (elapsed <= 0 || received <= 0) {
+                return {ValueError("invalid_record"), {}};
+            }
+            speeds.push_back((received * 8) / 1000 / elapsed);
+        }
+    } catch (const std::exception &) {
+        return {ValueError("invalid_record"), {}};
+    }
+    PlayoutBuffer buffer{params.buffer_capacity};
+    nlohmann::json rates = nlohmann::json::array();
+    double rebuffer_time = 0.0;
+    double startup_delay = 0.0;
+    double sum_rates = 0.0;
+    int switches = 0;
+    int prev_rate = 0;
+    for (double speed : speeds) {
+        int rate = (*abr)->select_rate(buffer.level());
+        // The segment size is proportional to its rate, so it takes
+        // this much to download it at the recorded speed
+        double download_time = rate * params.segment_duration / speed;
+        if (rates.empty()) {
+            startup_delay = download_time;
+        } else if (rate != prev_rate) {
+            switches += 1;
+        }
+        rebuffer_time += buffer.add_segment(download_time,
+                                            params.segment_duration);
+        (*abr)->add_sample(speed);
+        rates.push_back(rate);
+        sum_rates += rate;
+        prev_rate = rate;
+    }
+    return {NoError(), nlohmann::json{
+                             {"abr", name},
+                             {"average_rate", (speeds.empty())
+                                                    ? 0.0
+                                                    : sum_rates / speeds.size()},
+                             {"rates", rates},
+                             {"rebuffer_time", rebuffer_time},
+                             {"startup_delay", startup_delay},
+                             {"switches", switches},
+                       }};
+}
+
+} // namespace dash
+} // namespace neubot
+} // namespace mk
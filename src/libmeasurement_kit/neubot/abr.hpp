@@ -0,0 +1,105 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_NEUBOT_ABR_HPP
+#define SRC_LIBMEASUREMENT_KIT_NEUBOT_ABR_HPP
+
+/*
+ * Adaptive bitrate (ABR) strategies for the DASH test. A strategy chooses
+ * the rate of the next segment given the speed at which the previous
+ * segments were downloaded and the level of a simulated playout buffer.
+ *
+ * Available strategies:
+ *
+ * - `legacy`: the rate is the speed of the previous segment, which is
+ *   what the DASH test does by default;
+ *
+ * - `throughput`: the highest rate lower than 90% of the EWMA of the
+ *   segment speeds;
+ *
+ * - `bola`: the buffer-based BOLA-BASIC algorithm described in "BOLA:
+ *   Near-Optimal Bitrate Adaptation for Online Videos", by K. Spiteri,
+ *   R. Urgaonkar, R. K. Sitaraman;
+ *
+ * - `hybrid`: `throughput` while the buffer is low and `bola` once the
+ *   buffer has grown, like the DYNAMIC strategy of dash.js.
+ */
+
+#include "src/libmeasurement_kit/neubot/dash.hpp"
+
+#include "src/libmeasurement_kit/common/error_or.hpp"
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <string>
+#include <vector>
+
+#define DASH_ABR_BUFFER_CAPACITY 30.0
+
+namespace mk {
+namespace neubot {
+namespace dash {
+
+/// `AbrParams` contains the parameters shared by all ABR strategies.
+class AbrParams {
+  public:
+    double buffer_capacity = DASH_ABR_BUFFER_CAPACITY; ///< In seconds
+    int initial_rate = 3000;                            ///< In kbit/s
+    std::vector<int> rates = dash_rates(); ///< Sorted rates in kbit/s
+    double segment_duration = 2.0;         ///< In seconds
+};
+
+/// `AbrStrategy` is the interface implemented by ABR strategies.
+class AbrStrategy {
+  public:
+    /// `select_rate()` returns the rate of the next segment in kbit/s
+    /// given the level of the playout buffer in seconds.
+    virtual int select_rate(double buffer_level) = 0;
+
+    /// `add_sample()` informs the strategy that a segment has been
+    /// downloaded at \p speed_kbit.
+    virtual void add_sample(double speed_kbit) = 0;
+
+    virtual ~AbrStrategy();
+};
+
+/// `make_abr_strategy()` returns the strategy called \p name or an
+/// InvalidAbrError if there's no such strategy or \p params is invalid.
+ErrorOr<SharedPtr<AbrStrategy>> make_abr_strategy(const std::string &name,
+                                                  AbrParams params);
+
+/*
+    PlayoutBuffer models the buffer of a video player that starts playing
+    when the first segment arrives. The level decreases while we download
+    and increases by the segment duration when a segment arrives. The
+    player waits rather than exceeding the buffer capacity.
+*/
+class PlayoutBuffer {
+  public:
+    explicit PlayoutBuffer(double capacity = DASH_ABR_BUFFER_CAPACITY)
+        : capacity_{capacity} {}
+
+    /// `add_segment()` accounts for a segment of \p duration seconds that
+    /// took \p download_time seconds and returns the stall time.
+    double add_segment(double download_time, double duration);
+
+    double level() const { return level_; }
+
+  private:
+    double capacity_;
+    double level_ = 0.0;
+    bool playing_ = false;
+};
+
+/// `simulate_abr()` replays the segment speeds recorded in the
+/// \p receiver_data of a DASH report, using the strategy called \p name,
+/// and returns the rates it chose along with the resulting video
+/// quality metrics. Same input, same output: there's no randomness.
+ErrorOr<nlohmann::json> simulate_abr(const nlohmann::json &receiver_data,
+                                     const std::string &name,
+                                     AbrParams params = {});
+
+} // namespace dash
+} // namespace neubot
+} // namespace mk
+#endif
@@ -13,6 +13,9 @@ namespace dash {
 
 MK_DEFINE_ERR(
         MK_ERR_NEUBOT(0), MiddleboxDetectedError, "middlebox_detected_error")
+MK_DEFINE_ERR(MK_ERR_NEUBOT(1), InvalidAbrError, "invalid_abr_error")
+
+const std::vector<int> &dash_rates(); // Implemented in dash.cpp
 
 void run(
         std::string measurement_server_hostname,
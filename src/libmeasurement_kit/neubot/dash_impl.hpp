@@ -31,6 +31,10 @@
  *    receive the first byte of the response. I think this is not bad,
  *    since it actually captures better the time to fetch the chunk that
  *    one should play, as opposed to accurately estimating the speed.
+ *    When the `dash/prefetch_depth` option is greater than one, we keep
+ *    more requests in flight and time a segment from the later of its
+ *    request and the read preceding the one carrying its first byte, so
+ *    the first segment still includes the RTT and the server wait.
  *
  * 4. We leave to zero the `delta_user_time` and `delta_sys_time`. We
  *    may change this in the future, when we understand how to get them
@@ -52,18 +56,26 @@
  *    seems anyway to be a reasonable starting point.)
  */
 
+#include "src/libmeasurement_kit/neubot/abr.hpp"
 #include "src/libmeasurement_kit/neubot/dash.hpp"
 
 #include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/throughput_estimator.hpp"
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/mlabns/mlabns.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
+#include "src/libmeasurement_kit/http/response_parser.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
+#include "src/libmeasurement_kit/net/tcp_info.hpp"
 
 #include <measurement_kit/common/nlohmann/json.hpp>
 #include <measurement_kit/internal/vendor/mkuuid4.hpp>
 
+#include <deque>
+
 #define DASH_INITIAL_RATE 3000
 #define DASH_MAX_ITERATIONS 15
+#define DASH_MAX_PREFETCH_DEPTH 4
 #define DASH_SECONDS 2
 #define MAX_NEGOTIATIONS 512
 
@@ -71,8 +83,6 @@ namespace mk {
 namespace neubot {
 namespace dash {
 
-const std::vector<int> &dash_rates(); // Implemented in dash.cpp
-
 static inline size_t select_lower_rate_index(int speed_kbit) {
     size_t rate_index = 0;
     while (dash_rates()[rate_index] < speed_kbit &&
@@ -86,117 +96,147 @@ static inline size_t select_lower_rate_index(int speed_kbit) {
     return rate_index;
 }
 
-class DashLoopCtx {
+class DashOptions {
   public:
-    std::string auth_token;
-    Callback<Error> cb;
-    int speed_kbit = -1; // Means: determine best initial value
-    SharedPtr<nlohmann::json> entry;
-    int iteration = 1;
-    SharedPtr<Logger> logger;
-    SharedPtr<Reactor> reactor;
-    std::string real_address;
-    Settings settings;
-    SharedPtr<net::Transport> txp;
-    std::string uuid;
-    std::string server_url;
+    std::string abr = "legacy";
+    int constant_bitrate = 0;
+    int elapsed_target = DASH_SECONDS;
+    bool fast_scale_down = false;
+    int initial_rate = DASH_INITIAL_RATE;
+    int max_iterations = DASH_MAX_ITERATIONS;
+    int prefetch_depth = 1;
+    bool use_fixed_rates = false;
 };
 
-template <MK_MOCK_AS(http::request_send, http_request_send),
-          MK_MOCK_AS(http::request_recv_response, http_request_recv_response)>
-void run_loop_(SharedPtr<DashLoopCtx> ctx) {
-    // TODO: We may want to move this parsing of options in the setup
-    // phase of the test and store them inside `ctx`.
+static inline Error parse_options_(Settings settings, SharedPtr<Logger> logger,
+                                   DashOptions &options) {
     ErrorOr<bool> fast_scale_down =
-          ctx->settings.get_noexcept("fast_scale_down", false);
+          settings.get_noexcept("fast_scale_down", false);
     if (!fast_scale_down) {
-        ctx->logger->warn("dash: cannot parse `fast_scale_down' option");
-        ctx->cb(fast_scale_down.as_error());
-        return;
+        logger->warn("dash: cannot parse `fast_scale_down' option");
+        return fast_scale_down.as_error();
     }
-    ErrorOr<int> constant_bitrate =
-          ctx->settings.get_noexcept("constant_bitrate", 0);
+    ErrorOr<int> constant_bitrate = settings.get_noexcept("constant_bitrate", 0);
     if (!constant_bitrate || *constant_bitrate < 0) {
-        ctx->logger->warn("dash: cannot parse `constant_bitrate' option");
-        ctx->cb(ValueError());
-        return;
+        logger->warn("dash: cannot parse `constant_bitrate' option");
+        return ValueError();
     }
     ErrorOr<bool> use_fixed_rates =
-          ctx->settings.get_noexcept("use_fixed_rates", false);
+          settings.get_noexcept("use_fixed_rates", false);
     if (!use_fixed_rates) {
-        ctx->logger->warn("dash: cannot parse `use_fixed_rates' option");
-        ctx->cb(use_fixed_rates.as_error());
-        return;
+        logger->warn("dash: cannot parse `use_fixed_rates' option");
+        return use_fixed_rates.as_error();
     }
     ErrorOr<int> elapsed_target =
-          ctx->settings.get_noexcept("elapsed_target", DASH_SECONDS);
+          settings.get_noexcept("elapsed_target", DASH_SECONDS);
     if (!elapsed_target || *elapsed_target < 0) {
-        ctx->logger->warn("dash: cannot parse `elapsed_target' option");
-        ctx->cb(ValueError());
-        return;
+        logger->warn("dash: cannot parse `elapsed_target' option");
+        return ValueError();
     }
     ErrorOr<int> max_iterations =
-          ctx->settings.get_noexcept("max_iteration", DASH_MAX_ITERATIONS);
+          settings.get_noexcept("max_iteration", DASH_MAX_ITERATIONS);
     if (!max_iterations || *max_iterations < 0) {
-        ctx->logger->warn("dash: cannot parse `max_iteration' option");
-        ctx->cb(ValueError());
-        return;
+        logger->warn("dash: cannot parse `max_iteration' option");
+        return ValueError();
     }
     ErrorOr<int> initial_rate =
-          ctx->settings.get_noexcept("initial_rate", DASH_INITIAL_RATE);
+          settings.get_noexcept("initial_rate", DASH_INITIAL_RATE);
     if (!initial_rate || *initial_rate < 0) {
-        ctx->logger->warn("dash: cannot parse `initial_rate' option");
-        ctx->cb(ValueError());
-        return;
+        logger->warn("dash: cannot parse `initial_rate' option");
+        return ValueError();
+    }
+    ErrorOr<int> prefetch_depth =
+          settings.get_noexcept("dash/prefetch_depth", 1);
+    if (!prefetch_depth || *prefetch_depth < 1 ||
+        *prefetch_depth > DASH_MAX_PREFETCH_DEPTH) {
+        logger->warn("dash: cannot parse `dash/prefetch_depth' option");
+        return ValueError();
     }
+    options.abr = settings.get("dash/abr", std::string{"legacy"});
+    options.constant_bitrate = *constant_bitrate;
+    options.elapsed_target = *elapsed_target;
+    options.fast_scale_down = *fast_scale_down;
+    options.initial_rate = *initial_rate;
+    options.max_iterations = *max_iterations;
+    options.prefetch_depth = *prefetch_depth;
+    options.use_fixed_rates = *use_fixed_rates;
+    return NoError();
+}
 
-    if (ctx->iteration > *max_iterations) {
-        ctx->logger->debug("dash: completed all iterations");
-        try {
-            std::vector<double> rates;
-            std::vector<double> stalls;
-            double frame_ready_time = 0.0;
-            double play_time = 0.0;
-            double connect_latency = 0.0;
-            for (auto &e : (*ctx->entry)["receiver_data"]) {
-                if (connect_latency == 0.0) {
-                    // It is always equal for all the records
-                    connect_latency = e["connect_time"];
-                }
-                rates.push_back(e["rate"]);
-                /* The first chunk is played when it arrives. To have smooth
-                   video, we'd like to play each subsequent chunk within
-                   `elapsed_target` seconds. So, the player has always something
-                   to play and the user sees the video. If a chunk arrives
-                   earlier than the play deadline, good because we can request
-                   the next chunk also earlier. That is, we increase buffer
-                   time for slow delivery. On the contrary, if a chunk arrives
-                   later than the play deadline, we need to stop playing. The
-                   max(stalls) is the delay we would have needed to add at
-                   the beginning to make sure we had no player stalls. */
-                double elapsed = e["elapsed"];
-                frame_ready_time += elapsed;
-                double elapsed_target = e["elapsed_target"];
-                // Note: this says that the play time of the first frame is
-                // when we receive it. Subsequent frames must be played after
-                // `elapsed_target` seconds each to have smooth video.
-                play_time +=
-                      (play_time == 0) ? frame_ready_time : elapsed_target;
-                double stall = frame_ready_time - play_time;
-                stalls.push_back(stall);
-            }
-            (*ctx->entry)["simple"]["connect_latency"] = connect_latency;
-            (*ctx->entry)["simple"]["median_bitrate"] = mk::median(rates);
-            (*ctx->entry)["simple"]["min_playout_delay"] =
-                  (stalls.size() > 0)
-                        ? *std::max_element(stalls.begin(), stalls.end())
-                        : 0.0;
-        } catch (...) {
-            ctx->logger->warn("dash: cannot save summary information");
+// A segment that we have requested and whose response is not complete yet
+class DashSegment {
+  public:
+    double first_byte_ticks = 0.0;
+    int iteration = 0;
+    int rate_kbit = 0;
+    size_t received = 0;
+    double request_ticks = 0.0;
+};
+
+class DashLoopCtx {
+  public:
+    SharedPtr<AbrStrategy> abr; // Unset when using the legacy strategy
+    std::string auth_token;
+    PlayoutBuffer buffer;
+    Callback<Error> cb;
+    int speed_kbit = -1; // Means: determine best initial value
+    SharedPtr<nlohmann::json> entry;
+    int iteration = 1;
+    SharedPtr<Logger> logger;
+    DashOptions options;
+    SharedPtr<Reactor> reactor;
+    std::string real_address;
+    SharedPtr<http::RequestTemplate> request_template;
+    Settings settings;
+    RateStats speeds{0.3, DASH_MAX_ITERATIONS}; // Speed of each segment
+    SharedPtr<net::TcpInfoSampler> tcp_info;
+    SharedPtr<net::Transport> txp;
+    std::string uuid;
+    std::string server_url;
+
+    // State used only when prefetching segments
+    Error pipeline_error;
+    SharedPtr<http::ResponseParserNg> parser;
+    double prev_read_ticks = 0.0;
+    bool segment_complete = false;
+    std::deque<DashSegment> segments;
+};
+
+static inline Error compile_request_template_(SharedPtr<DashLoopCtx> ctx) {
+    if (!ctx->request_template) {
+        /*
+         * All the requests we send only differ in the path, hence we
+         * compile them once and then just fill the path slot.
+         */
+        Settings settings = ctx->settings; /* Make a local copy */
+        settings["http/method"] = "GET";
+        ErrorOr<SharedPtr<http::RequestTemplate>> maybe_template =
+              http::RequestTemplate::make(
+                    settings,
+                    {
+                          {"Authorization", ctx->auth_token},
+                          {"Cache-Control",
+                           "no-cache, no-store, must-revalidate"},
+                    });
+        if (!maybe_template) {
+            ctx->logger->warn("dash: cannot compile request template: %s",
+                              maybe_template.as_error().what());
+            return maybe_template.as_error();
         }
-        ctx->cb(NoError());
-        return;
+        ctx->request_template = *maybe_template;
     }
+    return NoError();
+}
+
+/*
+ * Select the rate that is lower than the latest measured speed, or the
+ * one chosen by the ABR strategy, and compute the path for downloading
+ * the number of bytes such that downloading with the selected rate
+ * takes `elapsed_target` (in theory).
+ */
+static inline std::string select_segment_(SharedPtr<DashLoopCtx> ctx,
+                                          int *rate_kbit) {
+    const DashOptions &options = ctx->options;
     if (ctx->speed_kbit < 0) {
         // Determine initial speed estimate. In legacy mode (i.e. when we use
         // a fixed vector of rates), we use the first entry. Otherwise, we use
@@ -205,25 +245,180 @@ void run_loop_(SharedPtr<DashLoopCtx> ctx) {
         // 2017. I though this would be a good starting point.
         //
         // See: <https://help.netflix.com/en/node/306>.
-        ctx->speed_kbit = (*use_fixed_rates == true)
-              ? dash_rates()[0] : *initial_rate;
+        ctx->speed_kbit = (options.use_fixed_rates == true)
+              ? dash_rates()[0] : options.initial_rate;
     }
-    /*
-     * Select the rate that is lower than the latest measured speed and
-     * compute the number of bytes to download such that downloading with
-     * the selected rate takes `elapsed_target` (in theory).
-     */
-    int rate_kbit =
-          (*use_fixed_rates == true)
-                ? dash_rates()[select_lower_rate_index(ctx->speed_kbit)]
-                : (*constant_bitrate > 0) ? *constant_bitrate : ctx->speed_kbit;
-    int count = ((rate_kbit * 1000) / 8) * (*elapsed_target);
+    if (!!ctx->abr) {
+        *rate_kbit = ctx->abr->select_rate(ctx->buffer.level());
+    } else {
+        *rate_kbit =
+              (options.use_fixed_rates == true)
+                    ? dash_rates()[select_lower_rate_index(ctx->speed_kbit)]
+                    : (options.constant_bitrate > 0) ? options.constant_bitrate
+                                                     : ctx->speed_kbit;
+    }
+    int count = ((*rate_kbit * 1000) / 8) * options.elapsed_target;
     std::string path = "/dash/download/";
     path += std::to_string(count);
-    Settings settings = ctx->settings; /* Make a local copy */
-    settings["http/ignore_body"] = true;
-    settings["http/path"] = path;
-    settings["http/method"] = "GET";
+    return path;
+}
+
+static inline void save_summary_(SharedPtr<DashLoopCtx> ctx) {
+    ctx->logger->debug("dash: completed all iterations");
+    try {
+        std::vector<double> rates;
+        std::vector<double> stalls;
+        double frame_ready_time = 0.0;
+        double play_time = 0.0;
+        double connect_latency = 0.0;
+        for (auto &e : (*ctx->entry)["receiver_data"]) {
+            if (connect_latency == 0.0) {
+                // It is always equal for all the records
+                connect_latency = e["connect_time"];
+            }
+            rates.push_back(e["rate"]);
+            /* The first chunk is played when it arrives. To have smooth
+               video, we'd like to play each subsequent chunk within
+               `elapsed_target` seconds. So, the player has always something
+               to play and the user sees the video. If a chunk arrives
+               earlier than the play deadline, good because we can request
+               the next chunk also earlier. That is, we increase buffer
+               time for slow delivery. On the contrary, if a chunk arrives
+               later than the play deadline, we need to stop playing. The
+               max(stalls) is the delay we would have needed to add at
+               the beginning to make sure we had no player stalls. */
+            double elapsed = e["elapsed"];
+            frame_ready_time += elapsed;
+            double elapsed_target = e["elapsed_target"];
+            // Note: this says that the play time of the first frame is
+            // when we receive it. Subsequent frames must be played after
+            // `elapsed_target` seconds each to have smooth video.
+            play_time +=
+                  (play_time == 0) ? frame_ready_time : elapsed_target;
+            double stall = frame_ready_time - play_time;
+            stalls.push_back(stall);
+        }
+        (*ctx->entry)["simple"]["connect_latency"] = connect_latency;
+        (*ctx->entry)["simple"]["median_bitrate"] = mk::median(rates);
+        (*ctx->entry)["simple"]["min_playout_delay"] =
+              (stalls.size() > 0)
+                    ? *std::max_element(stalls.begin(), stalls.end())
+                    : 0.0;
+        (*ctx->entry)["simple"]["throughput"] =
+              ctx->speeds.summary().as_json();
+    } catch (...) {
+        ctx->logger->warn("dash: cannot save summary information");
+    }
+}
+
+// Saves the measurement of a segment and updates the speed estimate
+static inline void save_segment_(SharedPtr<DashLoopCtx> ctx, int iteration,
+                                 int rate_kbit, size_t length,
+                                 double time_elapsed, double saved_time) {
+    const DashOptions &options = ctx->options;
+    ctx->buffer.add_segment(time_elapsed, options.elapsed_target);
+    (*ctx->entry)["receiver_data"].push_back(nlohmann::json{
+          /* These are extensions from the code that was originally
+           * implemented in Neubot. The buffer level is the one of a
+           * player that plays the segments as they arrive. */
+          {"abr", options.abr},
+          {"buffer_level", ctx->buffer.level()},
+          {"connect_time", ctx->txp->connect_time()},
+          {"constant_bitrate", options.constant_bitrate != 0},
+          {"delta_user_time", 0.0},
+          {"delta_sys_time", 0.0},
+          {"elapsed", time_elapsed},
+          {"elapsed_target", options.elapsed_target},
+          {"engine_name", "libmeasurement_kit"},
+          {"engine_version", MK_VERSION},
+          {"fast_scale_down", options.fast_scale_down},
+          {"internal_address", ctx->txp->sockname().hostname},
+          {"iteration", iteration},
+          {"platform", mk_platform()},
+          /* This is an extension from the code that was originally
+           * implemented in Neubot. When greater than one, `elapsed`
+           * starts at the read preceding the segment's first byte, or
+           * at the request if later (e.g. for the first segment). */
+          {"prefetch_depth", options.prefetch_depth},
+          {"rate", rate_kbit},
+          {"real_address", ctx->real_address},
+          /*
+           * Note: here we're only concerned with the amount
+           * of useful data we received (we ignore overhead)
+           *
+           * This is different from the original
+           * implementation of DASH that is part of Neubot.
+           */
+          {"received", length},
+          {"remote_address", ctx->txp->peername().hostname},
+          {"request_ticks", saved_time},
+          /* This is an extension from the code that was
+           * originally implemented in Neubot */
+          {"server_url", ctx->server_url},
+          {"timestamp", llround(saved_time)},
+          {"use_fixed_rates", options.use_fixed_rates},
+          {"uuid", ctx->uuid},
+          /*
+           * History of this field:
+           *
+           * 0.007004000: added support for abr and buffer_level.
+           *
+           * 0.007003000: added support for prefetch_depth.
+           *
+           * 0.007002000: added support for tcp_info (only when
+           * net/tcp_info_interval is positive).
+           *
+           * 0.007001000: added support for server_url.
+           *
+           * 0.007000000: measurement-kit.
+           *
+           * 0.004016009: last Neubot version.
+           */
+          {"version", "0.007004000"}});
+    if (!!ctx->tcp_info && ctx->tcp_info->enabled()) {
+        // Kernel TCP state sampled while we were waiting for this segment
+        (*ctx->entry)["receiver_data"].back()["tcp_info"] =
+              ctx->tcp_info->take()[0];
+    }
+    double speed = length / time_elapsed;
+    double s_k = (speed * 8) / 1000;
+    std::stringstream ss;
+    ss << "rate: " << rate_kbit << " kbit/s, speed: " << std::fixed
+       << std::setprecision(2) << s_k << " kbit/s, elapsed: " << time_elapsed
+       << " s";
+    ctx->logger->progress(iteration / (double)options.max_iterations,
+                          ss.str().c_str());
+    ctx->speeds.add(s_k);
+    if (!!ctx->abr) {
+        ctx->abr->add_sample(s_k);
+    }
+    if (options.fast_scale_down == true &&
+        time_elapsed > options.elapsed_target) {
+        // If the rate is too high, scale it down
+        double relerr = 1 - (time_elapsed / options.elapsed_target);
+        s_k *= relerr;
+        if (s_k <= 0) {
+            s_k = dash_rates()[0];
+        }
+    }
+    ctx->speed_kbit = (int)s_k;
+}
+
+template <MK_MOCK_AS(http::request_send_template, http_request_send_template),
+          MK_MOCK_AS(http::request_recv_response, http_request_recv_response)>
+void run_loop_(SharedPtr<DashLoopCtx> ctx) {
+    if (ctx->iteration > ctx->options.max_iterations) {
+        save_summary_(ctx);
+        ctx->cb(NoError());
+        return;
+    }
+    int rate_kbit = 0;
+    std::string path = select_segment_(ctx, &rate_kbit);
+    Error error = compile_request_template_(ctx);
+    if (error) {
+        ctx->cb(error);
+        return;
+    }
     ctx->logger->debug("dash: requesting '%s'", path.c_str());
     /*
      * Note: our accounting of time also includes the time to send the
@@ -232,14 +427,13 @@ void run_loop_(SharedPtr<DashLoopCtx> ctx) {
      * This is different from the original implementation of DASH that
      * is part of Neubot.
      */
+    Settings recv_settings = ctx->settings;
+    // We only account for the segment size, so do not keep its content
+    recv_settings["http/ignore_body"] = true;
     double saved_time = mk::time_now();
-    http_request_send(
-          ctx->txp, settings,
-          {
-                {"Authorization", ctx->auth_token},
-                {"Cache-Control", "no-cache, no-store, must-revalidate"},
-          },
-          "", ctx->logger, [=](Error error, SharedPtr<http::Request> req) mutable {
+    http_request_send_template(
+          ctx->txp, ctx->request_template, path, "", ctx->logger,
+          [=](Error error, SharedPtr<http::Request> req) mutable {
               if (error) {
                   ctx->logger->warn("dash: request failed: %s", error.what());
                   ctx->cb(error);
@@ -277,91 +471,187 @@ void run_loop_(SharedPtr<DashLoopCtx> ctx) {
                             return;
                         }
                         res->request = req;
-                        auto length = res->body.length();
                         double time_elapsed = mk::time_now() - saved_time;
                         if (time_elapsed <= 0) { // For robustness
                             ctx->logger->warn("dash: negative time error");
                             ctx->cb(GenericError("negative_time_error"));
                             return;
                         }
-                        (*ctx->entry)["receiver_data"].push_back(nlohmann::json{
-                              {"connect_time", ctx->txp->connect_time()},
-                              {"constant_bitrate", *constant_bitrate != 0},
-                              {"delta_user_time", 0.0},
-                              {"delta_sys_time", 0.0},
-                              {"elapsed", time_elapsed},
-                              {"elapsed_target", *elapsed_target},
-                              {"engine_name", "libmeasurement_kit"},
-                              {"engine_version", MK_VERSION},
-                              {"fast_scale_down", *fast_scale_down},
-                              {"internal_address",
-                               ctx->txp->sockname().hostname},
-                              {"iteration", ctx->iteration},
-                              {"platform", mk_platform()},
-                              {"rate", rate_kbit},
-                              {"real_address", ctx->real_address},
-                              /*
-                               * Note: here we're only concerned with the amount
-                               * of useful data we received (we ignore overhead)
-                               *
-                               * This is different from the original
-                               * implementation of DASH that is part of Neubot.
-                               */
-                              {"received", length},
-                              {"remote_address", ctx->txp->peername().hostname},
-                              {"request_ticks", saved_time},
-                              /* This is an extension from the code that was
-                               * originally implemented in Neubot */
-                              {"server_url", ctx->server_url},
-                              {"timestamp", llround(saved_time)},
-                              {"use_fixed_rates", *use_fixed_rates},
-                              {"uuid", ctx->uuid},
-                              /*
-                               * History of this field:
-                               *
-                               * 0.007001000: added support for server_url.
-                               *
-                               * 0.007000000: measurement-kit.
-                               *
-                               * 0.004016009: last Neubot version.
-                               */
-                              {"version", "0.007001000"}});
-                        double speed = length / time_elapsed;
-                        double s_k = (speed * 8) / 1000;
-                        std::stringstream ss;
-                        ss << "rate: " << rate_kbit
-                           << " kbit/s, speed: " << std::fixed
-                           << std::setprecision(2) << s_k
-                           << " kbit/s, elapsed: " << time_elapsed << " s";
-                        ctx->logger->progress(ctx->iteration /
-                                                    (double)*max_iterations,
-                                              ss.str().c_str());
-                        if (*fast_scale_down == true &&
-                            time_elapsed > *elapsed_target) {
-                            // If the rate is too high, scale it down
-                            double relerr =
-                                  1 - (time_elapsed / *elapsed_target);
-                            s_k *= relerr;
-                            if (s_k <= 0) {
-                                s_k = dash_rates()[0];
-                            }
-                        }
-                        ctx->speed_kbit = (int)s_k;
+                        save_segment_(ctx, ctx->iteration, rate_kbit,
+                                      res->body_size, time_elapsed, saved_time);
                         ctx->iteration += 1;
-                        run_loop_<http_request_send,
+                        run_loop_<http_request_send_template,
                                   http_request_recv_response>(ctx);
                     },
-                    ctx->settings, ctx->reactor, ctx->logger);
+                    recv_settings, ctx->reactor, ctx->logger);
           });
 }
 
+/*
+ * Prefetching: we keep up to `prefetch_depth` requests outstanding on the
+ * same persistent connection, like a player that fills its buffer ahead
+ * of the playout point. Each request is sent when the previous segment
+ * completes, using the then most recent speed estimate, so the server
+ * has always the next segment queued and the link does not go idle for
+ * one RTT between segments. A segment that was queued behind another one
+ * cannot start arriving before the read that completed the previous one,
+ * hence we time it from the later of that read and its request, rather
+ * than from the moment in which we sent the request. This is the time of
+ * the first byte only at the granularity of reads, and only when the link
+ * was busy: the first segment, or any segment requested while the link
+ * was idle, still includes the RTT and the time the server took to reply.
+ * We don't use the read carrying the first byte instead, as a segment that
+ * fits into a single read would then have no measurable duration.
+ */
+
+static inline void pipeline_end_(SharedPtr<DashLoopCtx> ctx, Error error) {
+    // Break the reference cycles through the transport and the parser
+    ctx->txp->on_data(nullptr);
+    ctx->txp->on_error(nullptr);
+    ctx->parser.reset();
+    if (error) {
+        ctx->logger->warn("dash: pipelined download failed: %s", error.what());
+        ctx->cb(error);
+        return;
+    }
+    save_summary_(ctx);
+    ctx->cb(NoError());
+}
+
+static inline void pipeline_fill_(SharedPtr<DashLoopCtx> ctx) {
+    int next = ctx->iteration + (int)ctx->segments.size();
+    while ((int)ctx->segments.size() < ctx->options.prefetch_depth &&
+           next <= ctx->options.max_iterations) {
+        DashSegment segment;
+        segment.iteration = next++;
+        std::string path = select_segment_(ctx, &segment.rate_kbit);
+        ctx->logger->debug("dash: requesting '%s'", path.c_str());
+        net::Buffer buff;
+        ctx->request_template->serialize(buff, path, "", "", ctx->logger);
+        segment.request_ticks = mk::time_now();
+        ctx->txp->write(buff);
+        ctx->segments.push_back(segment);
+    }
+}
+
+static inline void pipeline_complete_(SharedPtr<DashLoopCtx> ctx) {
+    while (ctx->segment_complete && !ctx->pipeline_error) {
+        ctx->segment_complete = false;
+        DashSegment segment = ctx->segments.front();
+        ctx->segments.pop_front();
+        // The last byte of the segment arrived with the current read
+        double time_elapsed = mk::time_now() - segment.first_byte_ticks;
+        if (time_elapsed <= 0) { // For robustness
+            ctx->logger->warn("dash: negative time error");
+            pipeline_end_(ctx, GenericError("negative_time_error"));
+            return;
+        }
+        save_segment_(ctx, segment.iteration, segment.rate_kbit,
+                      segment.received, time_elapsed, segment.request_ticks);
+        ctx->iteration += 1;
+        if (ctx->iteration > ctx->options.max_iterations) {
+            pipeline_end_(ctx, NoError());
+            return;
+        }
+        pipeline_fill_(ctx);
+        try {
+            ctx->parser->resume(); // Parse what follows the segment
+        } catch (const Error &error) {
+            ctx->pipeline_error = error;
+        }
+    }
+    if (ctx->pipeline_error) {
+        pipeline_end_(ctx, ctx->pipeline_error);
+    }
+}
+
+static inline void run_pipelined_loop_(SharedPtr<DashLoopCtx> ctx) {
+    if (ctx->options.max_iterations <= 0) {
+        save_summary_(ctx);
+        ctx->cb(NoError());
+        return;
+    }
+    Error error = compile_request_template_(ctx);
+    if (error) {
+        ctx->cb(error);
+        return;
+    }
+    ctx->parser.reset(new http::ResponseParserNg{ctx->logger});
+    ctx->parser->pipeline(true);
+    // Using a raw pointer because `ctx` owns the parser
+    DashLoopCtx *raw = ctx.get();
+    ctx->parser->on_begin([raw]() {
+        if (raw->segments.empty()) {
+            raw->pipeline_error = GenericError("unexpected_response");
+            return;
+        }
+        // The data we are processing arrived after the previous read
+        DashSegment &segment = raw->segments.front();
+        segment.first_byte_ticks =
+              std::max(segment.request_ticks, raw->prev_read_ticks);
+    });
+    ctx->parser->on_response([raw](http::Response res) {
+        if (res.status_code != 200) {
+            raw->logger->warn("dash: invalid response code: %d",
+                              res.status_code);
+            raw->pipeline_error = http::HttpRequestFailedError();
+            return;
+        }
+        // See the comment about Connection: close in run_loop_()
+        if (headers_find_first(res.headers, "connection") == "close") {
+            raw->logger->warn("dash: middlebox detected error");
+            raw->pipeline_error = MiddleboxDetectedError();
+        }
+    });
+    ctx->parser->on_body_size([raw](size_t count) {
+        if (!raw->segments.empty()) {
+            raw->segments.front().received += count;
+        }
+    });
+    ctx->parser->on_end([raw]() { raw->segment_complete = true; });
+    ctx->txp->on_data([ctx](net::Buffer data) {
+        double read_ticks = mk::time_now();
+        try {
+            ctx->parser->feed(data);
+        } catch (const Error &error) {
+            ctx->pipeline_error = error;
+        }
+        // Responses beginning while we complete segments arrived with this
+        // read, hence after the previous one: update the time only later
+        pipeline_complete_(ctx);
+        ctx->prev_read_ticks = read_ticks;
+    });
+    ctx->txp->on_error([ctx](Error error) { pipeline_end_(ctx, error); });
+    ctx->prev_read_ticks = mk::time_now();
+    pipeline_fill_(ctx);
+}
+
 template <MK_MOCK_AS(http::request_connect, http_request_connect),
-          MK_MOCK_AS(http::request_send, http_request_send),
+          MK_MOCK_AS(http::request_send_template, http_request_send_template),
           MK_MOCK_AS(http::request_recv_response, http_request_recv_response)>
 void run_impl(std::string url, std::string auth_token, std::string real_address,
               SharedPtr<nlohmann::json> entry, Settings settings, SharedPtr<Reactor> reactor,
               SharedPtr<Logger> logger, Callback<Error> cb) {
     SharedPtr<DashLoopCtx> ctx = SharedPtr<DashLoopCtx>::make();
+    Error error = parse_options_(settings, logger, ctx->options);
+    if (error) {
+        cb(error);
+        return;
+    }
+    if (ctx->options.abr != "legacy") {
+        AbrParams params;
+        params.initial_rate = ctx->options.initial_rate;
+        params.segment_duration = ctx->options.elapsed_target;
+        ErrorOr<SharedPtr<AbrStrategy>> abr =
+              make_abr_strategy(ctx->options.abr, params);
+        if (!abr) {
+            logger->warn("dash: cannot create `%s' ABR strategy: %s",
+                         ctx->options.abr.c_str(), abr.as_error().what());
+            cb(abr.as_error());
+            return;
+        }
+        ctx->abr = *abr;
+    }
     ctx->auth_token = auth_token;
     ctx->entry = entry;
     ctx->logger = logger;
@@ -395,12 +685,23 @@ void run_impl(std::string url, std::string auth_token, std::string real_address,
               logger->info("Connected to server (3WHS RTT = %f s); starting "
                            "the test", txp->connect_time());
               ctx->txp = txp;
+              (*entry)["socket_options"] = net::socket_options_effective(txp);
+              SharedPtr<net::TcpInfoSampler> tcp_info =
+                    net::TcpInfoSampler::make({txp}, settings, reactor, logger);
+              ctx->tcp_info = tcp_info;
               ctx->cb = [=](Error error) {
                   // Release the `txp` before continuing
                   logger->info("Test complete; closing connection");
+                  tcp_info->stop();
                   txp->close([=]() { cb(error); });
               };
-              run_loop_<http_request_send, http_request_recv_response>(ctx);
+              tcp_info->start();
+              if (ctx->options.prefetch_depth > 1) {
+                  run_pipelined_loop_(ctx);
+                  return;
+              }
+              run_loop_<http_request_send_template,
+                        http_request_recv_response>(ctx);
           },
           reactor, logger);
 }
@@ -593,6 +894,9 @@ void negotiate_impl(SharedPtr<nlohmann::json> entry, Settings settings,
         return;
     }
     logger->info("Discovering mlab server using mlabns");
+    if (settings.find("mlabns/probe_port") == settings.end()) {
+        settings["mlabns/probe_port"] = 443; // We negotiate using HTTPS
+    }
     mlabns_query("neubot",
                  [=](Error error, mlabns::Reply reply) {
                      if (error) {
@@ -601,6 +905,9 @@ void negotiate_impl(SharedPtr<nlohmann::json> entry, Settings settings,
                          cb(error);
                          return;
                      }
+                     if (!reply.selection.is_null()) {
+                         (*entry)["server_selection"] = reply.selection;
+                     }
                      negotiate_with_(reply.fqdn, entry, settings, reactor,
                                      logger, cb);
                  },
@@ -92,6 +92,16 @@ void post_net_tests(std::string base_bouncer_url, std::string test_name,
                         settings, reactor, logger);
 }
 
+void post_net_tests_cached(std::string base_bouncer_url, std::string test_name,
+                           std::string test_version,
+                           std::list<std::string> helpers,
+                           Callback<Error, SharedPtr<BouncerReply>> cb,
+                           Settings settings, SharedPtr<Reactor> reactor,
+                           SharedPtr<Logger> logger) {
+    post_net_tests_cached_impl(base_bouncer_url, test_name, test_version,
+                               helpers, cb, settings, reactor, logger);
+}
+
 std::string production_bouncer_url() {
     return MK_OONI_PRODUCTION_BOUNCER_URL;
 }
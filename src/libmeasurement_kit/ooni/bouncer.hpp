@@ -38,6 +38,20 @@ void post_net_tests(std::string base_bouncer_url, std::string test_name,
                     Callback<Error, SharedPtr<BouncerReply>> cb, Settings settings,
                     SharedPtr<Reactor> reactor, SharedPtr<Logger> logger);
 
+/*
+    Like post_net_tests() but, if `bouncer/cache_dir` is set, saves the reply
+    in that directory and reuses it for `bouncer/cache_ttl` seconds (default:
+    one day). Past half of the TTL, we also refresh the reply in background.
+    When we cannot contact the bouncer, we use the last reply we received,
+    no matter how old it is.
+*/
+void post_net_tests_cached(std::string base_bouncer_url, std::string test_name,
+                           std::string test_version,
+                           std::list<std::string> helpers,
+                           Callback<Error, SharedPtr<BouncerReply>> cb,
+                           Settings settings, SharedPtr<Reactor> reactor,
+                           SharedPtr<Logger> logger);
+
 #define MK_OONI_PRODUCTION_BOUNCER_URL "https://ps1.ooni.io"
 #define MK_OONI_TESTING_BOUNCER_URL "https://ams-pg-test.ooni.org"
 
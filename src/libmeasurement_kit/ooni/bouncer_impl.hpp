@@ -8,9 +8,21 @@
 
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/bouncer.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
 
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <fstream>
+
 namespace mk {
 namespace ooni {
 namespace bouncer {
@@ -88,6 +100,144 @@ void post_net_tests_impl(std::string base_bouncer_url, std::string test_name,
                  reactor, logger, nullptr, 0);
 }
 
+// Identifies the request, so that we do not reuse the reply to another one
+static inline nlohmann::json cache_key(std::string base_bouncer_url,
+                                       std::string test_name,
+                                       std::string test_version,
+                                       std::list<std::string> helpers) {
+    helpers.sort();
+    return {
+        {"bouncer", base_bouncer_url},
+        {"name", test_name},
+        {"version", test_version},
+        {"test-helpers", helpers},
+    };
+}
+
+static inline std::string cache_path(std::string cache_dir,
+                                     const nlohmann::json &key) {
+    // FNV-1a, so that file names do not depend on the standard library
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key.dump()) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "/bouncer-%016llx.json",
+             (unsigned long long)hash);
+    return cache_dir + name;
+}
+
+// Returns the cached reply and when we fetched it, if any
+static inline ErrorOr<SharedPtr<BouncerReply>> read_cache(
+      std::string path, const nlohmann::json &key, double &fetched,
+      SharedPtr<Logger> logger) {
+    try {
+        std::ifstream file{path};
+        if (!file.good()) {
+            return {FileIoError(), {}};
+        }
+        nlohmann::json entry = nlohmann::json::parse(file);
+        if (entry.at("key") != key) {
+            return {BouncerValueNotFoundError(), {}};
+        }
+        fetched = entry.at("fetched").get<double>();
+        return create_impl(entry.at("response").dump(), logger);
+    } catch (const std::exception &) {
+        logger->warn("bouncer: ignoring corrupt cache %s", path.c_str());
+    }
+    return {JsonProcessingError(), {}};
+}
+
+static inline void write_cache(std::string path, const nlohmann::json &key,
+                               SharedPtr<BouncerReply> reply,
+                               SharedPtr<Logger> logger) {
+    // Write and rename, so that readers never see a partial file. The
+    // temporary file is per process, so concurrent writers do not clash.
+#ifdef _WIN32
+    std::string temp = path + "." + std::to_string(_getpid()) + ".tmp";
+#else
+    std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+#endif
+    {
+        std::ofstream file{temp, std::ios::trunc};
+        file << nlohmann::json{
+            {"key", key},
+            {"fetched", mk::time_now()},
+            {"response", reply->response},
+        }.dump() << "\n";
+        if (!file.good()) {
+            logger->warn("bouncer: cannot write cache %s", temp.c_str());
+            file.close();
+            (void)::remove(temp.c_str());
+            return;
+        }
+    }
+#ifdef _WIN32
+    // On Windows rename() fails if the target exists, while elsewhere
+    // it atomically replaces it, so readers always see a cache file
+    (void)::remove(path.c_str());
+#endif
+    if (::rename(temp.c_str(), path.c_str()) != 0) {
+        logger->warn("bouncer: cannot rename cache %s", temp.c_str());
+        (void)::remove(temp.c_str());
+    }
+}
+
+template <MK_MOCK_AS(bouncer::post_net_tests, bouncer_post_net_tests)>
+void post_net_tests_cached_impl(std::string base_bouncer_url,
+                                std::string test_name,
+                                std::string test_version,
+                                std::list<std::string> helpers,
+                                Callback<Error, SharedPtr<BouncerReply>> cb,
+                                Settings settings, SharedPtr<Reactor> reactor,
+                                SharedPtr<Logger> logger) {
+    std::string cache_dir = settings.get("bouncer/cache_dir", std::string{});
+    if (cache_dir == "") {
+        bouncer_post_net_tests(base_bouncer_url, test_name, test_version,
+                               helpers, cb, settings, reactor, logger);
+        return;
+    }
+    double ttl = settings.get("bouncer/cache_ttl", 86400.0);
+    nlohmann::json key =
+          cache_key(base_bouncer_url, test_name, test_version, helpers);
+    std::string path = cache_path(cache_dir, key);
+    double fetched = 0.0;
+    ErrorOr<SharedPtr<BouncerReply>> cached =
+          read_cache(path, key, fetched, logger);
+    double age = mk::time_now() - fetched;
+    auto fetch = [=](Callback<Error, SharedPtr<BouncerReply>> cb) {
+        bouncer_post_net_tests(
+              base_bouncer_url, test_name, test_version, helpers,
+              [=](Error error, SharedPtr<BouncerReply> reply) {
+                  if (!error) {
+                      write_cache(path, key, reply, logger);
+                  }
+                  cb(error, reply);
+              },
+              settings, reactor, logger);
+    };
+    if (cached && age >= 0.0 && age < ttl) {
+        logger->debug("bouncer: using cached reply (%.0f seconds old)", age);
+        cb(NoError(), *cached);
+        if (age >= ttl / 2.0) {
+            // Refresh in the background, so the next run has a fresh reply
+            fetch([=](Error error, SharedPtr<BouncerReply>) {
+                logger->debug("bouncer: refreshed cache: %s", error.what());
+            });
+        }
+        return;
+    }
+    fetch([=](Error error, SharedPtr<BouncerReply> reply) {
+        if (error && cached) {
+            logger->warn("bouncer: %s; using the last known good reply",
+                         error.what());
+            cb(NoError(), *cached);
+            return;
+        }
+        cb(error, reply);
+    });
+}
+
 } // namespace bouncer
 } // namespace ooni
 } // namespace mk
@@ -24,9 +24,9 @@ static std::map<std::string, bool(*)(const std::string &)> mandatory_re{
     {"test_start_time", regexp::valid_test_start_time},
 };
 
-Error valid_entry(nlohmann::json entry) {
+Error valid_entry(const nlohmann::json &entry) {
     // TODO: also validate the optional values
-    for (auto pair : mandatory_re) {
+    for (auto &pair : mandatory_re) {
         std::string s;
         try {
           s = entry.at(pair.first);
@@ -71,6 +71,14 @@ void update_report(SharedPtr<Transport> transport, std::string report_id, nlohma
                        logger);
 }
 
+void update_report_entry(SharedPtr<Transport> transport, std::string report_id,
+                         SerializedEntry entry, Callback<Error> callback,
+                         Settings settings, SharedPtr<Reactor> reactor,
+                         SharedPtr<Logger> logger) {
+    update_report_entry_impl(transport, report_id, entry, callback, settings,
+                             reactor, logger);
+}
+
 void connect_and_update_report(std::string report_id, nlohmann::json entry,
                                Callback<Error> callback, Settings settings,
                                SharedPtr<Reactor> reactor, SharedPtr<Logger> logger) {
@@ -92,6 +100,15 @@ void connect_and_close_report(std::string report_id, Callback<Error> callback,
                                   logger);
 }
 
+/* static */ SharedPtr<Session> Session::make(Settings settings,
+                                            SharedPtr<Reactor> reactor,
+                                            SharedPtr<Logger> logger) {
+    return SharedPtr<Session>{std::make_shared<SessionImpl<>>(
+          std::move(settings), std::move(reactor), std::move(logger))};
+}
+
+Session::~Session() {}
+
 ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<Logger> logger) {
     std::string line;
     std::getline(*file, line);
@@ -4,7 +4,10 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_CLIENT_HPP
 #define SRC_LIBMEASUREMENT_KIT_OONI_COLLECTOR_CLIENT_HPP
 
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
 
 namespace mk {
 namespace ooni {
@@ -51,6 +54,11 @@ void update_report(SharedPtr<net::Transport>, std::string report_id, nlohmann::j
                    Callback<Error>, Settings,
                    SharedPtr<Reactor>, SharedPtr<Logger>);
 
+// Like update_report() but avoids serializing the entry again
+void update_report_entry(SharedPtr<net::Transport>, std::string report_id,
+                         report::SerializedEntry, Callback<Error>, Settings,
+                         SharedPtr<Reactor>, SharedPtr<Logger>);
+
 void connect_and_update_report(std::string report_id, nlohmann::json,
                                Callback<Error>, Settings,
                                SharedPtr<Reactor>, SharedPtr<Logger>);
@@ -62,6 +70,35 @@ void connect_and_close_report(std::string report_id, Callback<Error>,
                               Settings, SharedPtr<Reactor>,
                               SharedPtr<Logger>);
 
+/*
+    A session submits many entries using a single persistent connection
+    with the collector, rather than connecting for each of them. Operations
+    are queued and performed in FIFO order, hence the caller does not need
+    to wait for an entry to be submitted before queueing the next one. When
+    an operation fails, we reconnect and retry after a delay that doubles at
+    each attempt. Closing the report also closes the connection.
+
+    Settings: `collector/max_retries` (default: 3) and `collector/retry_delay`
+    (initial delay in seconds, default: 1.0).
+*/
+class Session : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<Session> make(Settings, SharedPtr<Reactor>,
+                                   SharedPtr<Logger>);
+
+    virtual void update_report(std::string report_id,
+                               report::SerializedEntry entry,
+                               Callback<Error> callback) = 0;
+
+    virtual void close_report(std::string report_id,
+                              Callback<Error> callback) = 0;
+
+    /// Returns the number of queued operations, including the running one.
+    virtual size_t pending() = 0;
+
+    virtual ~Session();
+};
+
 } // namespace collector
 } // namespace mk
 } // namespace ooni
@@ -9,12 +9,16 @@
 
 #include <measurement_kit/common/nlohmann/json.hpp>
 
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
 #include "src/libmeasurement_kit/common/mock.hpp"
 #include "src/libmeasurement_kit/http/http.hpp"
+#include "src/libmeasurement_kit/net/error.hpp"
 #include "src/libmeasurement_kit/ooni/collector_client.hpp"
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/report/error.hpp"
 
+#include <cmath>
+#include <deque>
 #include <fstream>
 
 namespace mk {
@@ -64,32 +68,45 @@ void post_impl(SharedPtr<Transport> transport, std::string append_to_url,
     }
     http_request_sendrecv(transport, settings, headers, body,
                           [=](Error err, SharedPtr<Response> response) {
+                              // If the collector is going to close the
+                              // connection, tell whoever keeps it alive
+                              // across requests (see SessionImpl)
+                              bool closing = response && strcasecmp(
+                                    headers_find_first(response->headers,
+                                                       "Connection").c_str(),
+                                    "close") == 0;
+                              auto done = [=](Error error, nlohmann::json json) {
+                                  callback(error, json);
+                                  if (closing) {
+                                      transport->emit_error(EofError());
+                                  }
+                              };
                               if (err) {
-                                  callback(err, nullptr);
+                                  done(err, nullptr);
                                   return;
                               }
                               if (response->status_code / 100 != 2) {
-                                  callback(HttpRequestFailedError(), nullptr);
+                                  done(HttpRequestFailedError(), nullptr);
                                   return;
                               }
                               // If response is empty, don't parse it
                               if (response->body == "") {
-                                  callback(NoError(), nullptr);
+                                  done(NoError(), nullptr);
                                   return;
                               }
                               nlohmann::json reply;
                               try {
                                   reply = nlohmann::json::parse(response->body);
                               } catch (const std::exception &) {
-                                  callback(JsonProcessingError(), nullptr);
+                                  done(JsonProcessingError(), nullptr);
                                   return;
                               }
-                              callback(NoError(), reply);
+                              done(NoError(), reply);
                           },
                           reactor, logger);
 }
 
-Error valid_entry(nlohmann::json entry);
+Error valid_entry(const nlohmann::json &entry);
 
 /*
              _
@@ -193,45 +210,64 @@ void connect_and_create_report_impl(nlohmann::json entry,
 }
 
 template <MK_MOCK_AS(collector::post, collector_post)>
-void update_report_impl(SharedPtr<Transport> transport, std::string report_id,
-                        nlohmann::json entry, Callback<Error> callback,
-                        Settings settings, SharedPtr<Reactor> reactor,
-                        SharedPtr<Logger> logger) {
+void update_report_entry_impl(SharedPtr<Transport> transport,
+                              std::string report_id,
+                              report::SerializedEntry entry,
+                              Callback<Error> callback, Settings settings,
+                              SharedPtr<Reactor> reactor,
+                              SharedPtr<Logger> logger) {
 
     /*
      * If needed, overwrite the `report_id` field with what was
      * passed us by the server, which should be authoritative.
      *
-     * Note that `entry` is passed by copy so changing it has no
-     * effect outside of this function.
+     * This requires serializing the entry again, but it should not
+     * happen because higher layers should already have set the
+     * report-id's value, hence we warn when it happens.
      *
      * This action must be performed in addition to `valid_entry()`
      * because that function does not check for report_id.
-     *
-     * We warn if `report_id` is not present because higher layers
-     * should already have set the report-id's value.
      */
-    if (entry["report_id"] == nullptr) {
+    auto it = entry.json().find("report_id");
+    if (it == entry.json().end() || it->is_null()) {
         logger->warn("collector: forcing report_id which was not set");
-        entry["report_id"] = report_id;
+        nlohmann::json copy = entry.json();
+        copy["report_id"] = report_id;
+        entry = report::SerializedEntry::make(std::move(copy));
     }
 
-    Error err = valid_entry(entry);
+    Error err = valid_entry(entry.json());
     if (err != NoError()) {
         logger->warn("collector: you passed me an invalid entry");
         callback(err);
         return;
     }
-    nlohmann::json request{{"format", "json"}};
-    request["content"] = entry;
-    std::string body = request.dump();
-    collector_post(transport, "/report/" + report_id, body,
+    // Splice the already serialized entry into the body. Keys are in the
+    // same order in which nlohmann::json::dump() would have emitted them.
+    static const std::string prefix = R"({"content":)";
+    static const std::string suffix = R"(,"format":"json"})";
+    std::string body;
+    body.reserve(prefix.size() + entry.str().size() + suffix.size());
+    body += prefix;
+    body += entry.str();
+    body += suffix;
+    collector_post(transport, "/report/" + report_id, std::move(body),
                    [=](Error err, nlohmann::json) {
                        callback(err);
                    },
                    settings, reactor, logger);
 }
 
+template <MK_MOCK_AS(collector::post, collector_post)>
+void update_report_impl(SharedPtr<Transport> transport, std::string report_id,
+                        nlohmann::json entry, Callback<Error> callback,
+                        Settings settings, SharedPtr<Reactor> reactor,
+                        SharedPtr<Logger> logger) {
+    update_report_entry_impl<collector_post>(
+          transport, report_id, report::SerializedEntry::make(std::move(entry)),
+          callback, settings, reactor, logger);
+}
+
 template <MK_MOCK_AS(collector::connect, collector_connect),
           MK_MOCK_AS(collector::update_report, collector_update_report)>
 void connect_and_update_report_impl(std::string report_id, nlohmann::json entry,
@@ -281,6 +317,197 @@ void connect_and_close_report_impl(std::string report_id,
     }, reactor, logger);
 }
 
+/*
+ ___  ___  ___ ___(_) ___  _ __
+/ __|/ _ \/ __/ __| |/ _ \| '_ \
+\__ \  __/\__ \__ \ | (_) | | | |
+|___/\___||___/___/_|\___/|_| |_|
+*/
+
+template <MK_MOCK_AS(collector::connect, collector_connect),
+          MK_MOCK_AS(collector::update_report_entry, collector_update_report),
+          MK_MOCK_AS(collector::close_report, collector_close_report)>
+class SessionImpl
+    : public Session,
+      public EnableSharedFromThis<SessionImpl<collector_connect,
+                                              collector_update_report,
+                                              collector_close_report>> {
+  public:
+    SessionImpl(Settings settings, SharedPtr<Reactor> reactor,
+                SharedPtr<Logger> logger)
+        : settings_{std::move(settings)}, reactor_{std::move(reactor)},
+          logger_{std::move(logger)} {}
+
+    void update_report(std::string report_id, report::SerializedEntry entry,
+                       Callback<Error> callback) override {
+        Operation op;
+        op.report_id = std::move(report_id);
+        op.entry = std::move(entry);
+        op.callback = std::move(callback);
+        queue_.push_back(std::move(op));
+        pump();
+    }
+
+    void close_report(std::string report_id,
+                      Callback<Error> callback) override {
+        Operation op;
+        op.report_id = std::move(report_id);
+        op.is_close = true;
+        op.callback = std::move(callback);
+        queue_.push_back(std::move(op));
+        pump();
+    }
+
+    size_t pending() override { return queue_.size(); }
+
+  private:
+    class Operation {
+      public:
+        std::string report_id;
+        report::SerializedEntry entry;
+        bool is_close = false;
+        Callback<Error> callback;
+        unsigned attempts = 0;
+    };
+
+    std::deque<Operation> queue_;
+    bool busy_ = false;
+    bool reused_ = false;
+    SharedPtr<Transport> txp_;
+    Settings settings_;
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+
+    // Errors that would happen again if we retry the same operation
+    static bool is_permanent(Error error) {
+        return error == MissingCollectorBaseUrlError() ||
+               error == MissingMandatoryKeyError() ||
+               error == InvalidMandatoryValueError();
+    }
+
+    void pump() {
+        if (busy_ || queue_.empty()) {
+            return;
+        }
+        busy_ = true;
+        auto self = this->shared_from_this();
+        if (!!txp_) {
+            reused_ = true;
+            run_front();
+            return;
+        }
+        logger_->debug("collector: connecting...");
+        collector_connect(settings_, [self](Error error,
+                                            SharedPtr<Transport> txp) {
+            self->logger_->debug("collector: connecting... %d", error.code);
+            if (error) {
+                self->complete_front(error);
+                return;
+            }
+            self->txp_ = txp;
+            self->reused_ = false;
+            self->run_front();
+        }, reactor_, logger_);
+    }
+
+    void run_front() {
+        auto self = this->shared_from_this();
+        const Operation &op = queue_.front();
+        Callback<Error> cb = [self](Error error) {
+            self->complete_front(error);
+        };
+        // Stop watching the idle connection, HTTP code takes over from here
+        txp_->on_data(nullptr);
+        txp_->on_error(nullptr);
+        if (op.is_close) {
+            collector_close_report(txp_, op.report_id, cb, settings_,
+                                   reactor_, logger_);
+            return;
+        }
+        collector_update_report(txp_, op.report_id, op.entry, cb, settings_,
+                                reactor_, logger_);
+    }
+
+    void complete_front(Error error) {
+        auto self = this->shared_from_this();
+        Operation &op = queue_.front();
+        if (error && reused_ && !is_permanent(error)) {
+            // The collector may have closed the kept-alive connection before
+            // we noticed: this is not the collector failing, so reconnect
+            // right away without a backoff and without counting an attempt
+            logger_->debug("collector: %s on reused connection; reconnecting",
+                           error.what());
+            close_transport([self]() {
+                self->busy_ = false;
+                self->pump();
+            });
+            return;
+        }
+        unsigned max_retries = settings_.get("collector/max_retries", 3U);
+        if (error && !is_permanent(error) && op.attempts < max_retries) {
+            double delay = std::ldexp(
+                  settings_.get("collector/retry_delay", 1.0), op.attempts);
+            op.attempts += 1;
+            logger_->warn("collector: %s; retrying in %.1f seconds",
+                          error.what(), delay);
+            // The connection may be in an inconsistent state
+            close_transport([self, delay]() {
+                self->reactor_->call_later(delay, [self]() {
+                    self->busy_ = false;
+                    self->pump();
+                });
+            });
+            return;
+        }
+        Callback<Error> callback = std::move(op.callback);
+        bool close = op.is_close || error;
+        queue_.pop_front();
+        Callback<> next = [self, callback, error]() {
+            self->busy_ = false;
+            callback(error);
+            self->pump();
+        };
+        if (close) {
+            close_transport(std::move(next));
+            return;
+        }
+        watch_transport();
+        // Break explicit recursion, as we do in update_and_fetch_next_impl
+        reactor_->call_soon(std::move(next));
+    }
+
+    // Keep reading from the idle connection, so that we notice when the
+    // collector closes it (or says it will) and we don't reuse it later
+    void watch_transport() {
+        std::weak_ptr<SessionImpl> weak =
+              std::enable_shared_from_this<SessionImpl>::shared_from_this();
+        Transport *watched = txp_.get();
+        auto drop = [weak, watched]() {
+            SharedPtr<SessionImpl> self{weak.lock()};
+            if (!self || !self->txp_ || self->txp_.get() != watched) {
+                return;
+            }
+            self->logger_->debug("collector: idle connection closed");
+            // Don't close from within the transport's own handler
+            SharedPtr<Transport> txp = std::move(self->txp_);
+            self->txp_ = {};
+            self->reactor_->call_soon([txp]() { txp->close([]() {}); });
+        };
+        txp_->on_data([drop](Buffer) { drop(); }); // Unexpected while idle
+        txp_->on_error([drop](Error) { drop(); });
+    }
+
+    void close_transport(Callback<> callback) {
+        if (!txp_) {
+            reactor_->call_soon(std::move(callback));
+            return;
+        }
+        SharedPtr<Transport> txp = std::move(txp_);
+        txp_ = {};
+        txp->close(callback);
+    }
+};
+
 ErrorOr<nlohmann::json> get_next_entry(SharedPtr<std::istream> file, SharedPtr<Logger> logger);
 
 template <MK_MOCK_AS(collector::update_report, collector_update_report),
@@ -9,8 +9,7 @@
 #include "src/libmeasurement_kit/common/utils.hpp"
 #include "src/libmeasurement_kit/ooni/templates.hpp"
 #include "src/libmeasurement_kit/ooni/error.hpp"
-
-#include <measurement_kit/internal/vendor/mkmmdb.hpp>
+#include "src/libmeasurement_kit/ooni/geoip_cache.hpp"
 
 namespace mk {
 namespace ooni {
@@ -29,12 +28,9 @@ static const std::map<std::string, std::string> &FB_SERVICE_HOSTNAMES = {
 static bool ip_in_fb_asn(Settings options, std::string ip) {
     std::string asn_p = options.get("geoip_asn_path", std::string{});
     std::vector<std::string> logs;
-    std::string asn;
-    mk::mmdb::Handle db;
-    if (!db.open(asn_p, logs) || !db.lookup_asn2(ip, asn, logs)) {
-        return false;
-    }
-    return asn == FB_ASN;
+    GeoipInfo info =
+          GeoipCache::global()->lookup("", asn_p, ip, logs, false);
+    return info.asn_ok && info.asn == FB_ASN;
 }
 
 static void
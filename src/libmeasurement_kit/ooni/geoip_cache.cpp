@@ -0,0 +1,98 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/ooni/geoip_cache.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace mk {
+namespace ooni {
+
+/* static */ SharedPtr<GeoipCache> GeoipCache::global() {
+    static SharedPtr<GeoipCache> cache = make();
+    return cache;
+}
+
+/* static */ SharedPtr<GeoipCache> GeoipCache::make(size_t capacity) {
+    return SharedPtr<GeoipCache>{new GeoipCache{capacity}};
+}
+
+GeoipCache::GeoipCache(size_t capacity) : results_{capacity} {}
+
+SharedPtr<mmdb::Handle> GeoipCache::database(const std::string &path,
+                                             std::vector<std::string> &logs) {
+    std::lock_guard<std::mutex> _{mutex_};
+    return database_locked(path, logs);
+}
+
+SharedPtr<mmdb::Handle> GeoipCache::database_locked(
+      const std::string &path, std::vector<std::string> &logs) {
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+        logs.push_back("geoip_cache: cannot stat '" + path + "'");
+        databases_.erase(path);
+        return {};
+    }
+    auto it = databases_.find(path);
+    if (it != databases_.end() && it->second.mtime == (int64_t)info.st_mtime &&
+        it->second.size == (int64_t)info.st_size) {
+        return it->second.handle;
+    }
+    // Results may have been computed with the previous database
+    results_.clear();
+    SharedPtr<mmdb::Handle> handle{std::make_shared<mmdb::Handle>()};
+    if (!handle->open(path, logs)) {
+        databases_.erase(path);
+        return {};
+    }
+    Database &database = databases_[path];
+    database.mtime = (int64_t)info.st_mtime;
+    database.size = (int64_t)info.st_size;
+    database.handle = handle;
+    return handle;
+}
+
+GeoipInfo GeoipCache::lookup(const std::string &country_path,
+                             const std::string &asn_path,
+                             const std::string &ip,
+                             std::vector<std::string> &logs, bool need_org) {
+    std::lock_guard<std::mutex> _{mutex_};
+    // Fetching the databases first also checks whether they have changed
+    SharedPtr<mmdb::Handle> country_db, asn_db;
+    if (country_path != "") {
+        country_db = database_locked(country_path, logs);
+    }
+    if (asn_path != "") {
+        asn_db = database_locked(asn_path, logs);
+    }
+    // Results are only valid as long as all the databases are there
+    bool have_all = (country_path == "" || country_db) &&
+                    (asn_path == "" || asn_db);
+    auto key = std::make_tuple(country_path, asn_path, ip, need_org);
+    if (have_all) {
+        GeoipInfo *cached = results_.get(key);
+        if (cached != nullptr) {
+            return *cached;
+        }
+    }
+    GeoipInfo info;
+    if (country_db) {
+        info.cc_ok = country_db->lookup_cc(ip, info.cc, logs);
+    }
+    if (asn_db) {
+        info.asn_ok = asn_db->lookup_asn2(ip, info.asn, logs);
+        if (need_org) {
+            info.org_ok = asn_db->lookup_org(ip, info.org, logs);
+        }
+    }
+    // Do not remember failures caused by missing databases
+    if (have_all) {
+        results_.put(key, info);
+    }
+    return info;
+}
+
+} // namespace ooni
+} // namespace mk
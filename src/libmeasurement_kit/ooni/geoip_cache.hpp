@@ -0,0 +1,89 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_GEOIP_CACHE_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_GEOIP_CACHE_HPP
+
+#include "src/libmeasurement_kit/common/lru_cache.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+
+#include <measurement_kit/common/shared_ptr.hpp>
+#include <measurement_kit/internal/vendor/mkmmdb.hpp>
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace mk {
+namespace ooni {
+
+/// `GeoipInfo` is the result of GeoipCache::lookup().
+class GeoipInfo {
+  public:
+    bool cc_ok = false;
+    std::string cc;
+    bool asn_ok = false;
+    std::string asn;
+    bool org_ok = false;
+    std::string org;
+};
+
+/*
+    GeoipCache keeps the GeoIP databases open (they are memory mapped)
+    and remembers the results of recent lookups, so that running several
+    nettests does not open the same databases over and over. A database is
+    opened again when its modification time or size changes, which also
+    clears the results, and results are not used when a database is gone.
+    Handles are reference counted, so reopening does not close a database
+    that another thread is using. The ASN and the organization are looked
+    up separately, hence with two walks of the database tree, and the
+    organization lookup is skipped when it is not needed.
+
+    The cache is shared by the whole process and is thread safe.
+*/
+class GeoipCache : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<GeoipCache> global();
+
+    static SharedPtr<GeoipCache> make(size_t capacity = 1024);
+
+    /// `database()` returns the database at \p path, or an empty pointer
+    /// if it cannot be opened, in which case \p logs explains why.
+    SharedPtr<mmdb::Handle> database(const std::string &path,
+                                     std::vector<std::string> &logs);
+
+    /// `lookup()` returns the country code of \p ip according to the
+    /// \p country_path database and its ASN and organization according to
+    /// the \p asn_path database. Empty paths skip the related lookups,
+    /// and so does a false \p need_org for the organization.
+    GeoipInfo lookup(const std::string &country_path,
+                     const std::string &asn_path, const std::string &ip,
+                     std::vector<std::string> &logs, bool need_org = true);
+
+  private:
+    class Database {
+      public:
+        int64_t mtime = 0;
+        int64_t size = 0;
+        SharedPtr<mmdb::Handle> handle;
+    };
+
+    explicit GeoipCache(size_t capacity);
+    SharedPtr<mmdb::Handle> database_locked(const std::string &path,
+                                            std::vector<std::string> &logs);
+
+    std::mutex mutex_;
+    std::map<std::string, Database> databases_;
+    LruCache<std::tuple<std::string, std::string, std::string, bool>,
+             GeoipInfo>
+          results_;
+};
+
+} // namespace ooni
+} // namespace mk
+#endif
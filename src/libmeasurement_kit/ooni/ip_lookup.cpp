@@ -0,0 +1,90 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/ooni/ip_lookup.hpp"
+#include "src/libmeasurement_kit/net/utils.hpp"
+
+#include <measurement_kit/internal/vendor/mkdata.hpp>
+
+#include <ctype.h>
+
+namespace mk {
+namespace ooni {
+
+// Same URL used by iplookup::perform()
+static const char *ip_lookup_url = "https://geoip.ubuntu.com/lookup";
+
+// Extracts the candidate IP from the body returned by Ubuntu's GeoIP
+// service; the caller still needs to make sure that it's an IP
+static bool ip_lookup_extract(std::string body, std::string &probe_ip) {
+    probe_ip = "";
+    if (!mk::data::contains_valid_utf8(body)) {
+        return false;
+    }
+    static const std::string open_tag = "<Ip>";
+    static const std::string close_tag = "</Ip>";
+    auto pos = body.find(open_tag);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    body = body.substr(pos + open_tag.size());
+    pos = body.find(close_tag);
+    if (pos == std::string::npos) {
+        return false;
+    }
+    body = body.substr(0, pos);
+    for (char ch : body) {
+        if (ch == ' ' || ch == '\t') {
+            continue;
+        }
+        if (!isxdigit((unsigned char)ch) && ch != '.' && ch != ':') {
+            return false;
+        }
+        probe_ip += ch;
+    }
+    return true;
+}
+
+curl::Request ip_lookup_request(const iplookup::Request &request) {
+    curl::Request r;
+    r.timeout = request.timeout;
+    r.ca_path = request.ca_bundle_path;
+    r.url = ip_lookup_url;
+    return r;
+}
+
+iplookup::Response ip_lookup_response(curl::Response re) {
+    iplookup::Response response;
+    response.bytes_recv = re.bytes_recv;
+    response.bytes_sent = re.bytes_sent;
+    for (auto &log : re.logs) {
+        response.logs.push_back(std::move(log.line));
+    }
+    if (re.error != 0) {
+        response.logs.push_back("We could not communicate with server.");
+        return response;
+    }
+    if (re.status_code != 200) {
+        response.logs.push_back("Status code indicates failure.");
+        return response;
+    }
+    response.logs.push_back("=== BEGIN RECEIVED BODY ===");
+    response.logs.push_back(re.body);
+    response.logs.push_back("=== END RECEIVED BODY ===");
+    std::string maybe_probe_ip;
+    if (!ip_lookup_extract(std::move(re.body), maybe_probe_ip)) {
+        response.logs.push_back("Cannot extract IP from response body.");
+        return response;
+    }
+    if (!net::is_ip_addr(maybe_probe_ip)) {
+        response.logs.push_back("Not a valid IP address: " + maybe_probe_ip);
+        return response;
+    }
+    response.probe_ip = std::move(maybe_probe_ip);
+    response.good = true;
+    return response;
+}
+
+} // namespace ooni
+} // namespace mk
@@ -0,0 +1,29 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_IP_LOOKUP_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_IP_LOOKUP_HPP
+
+#include <measurement_kit/internal/vendor/mkcurl.hpp>
+#include <measurement_kit/internal/vendor/mkiplookup.hpp>
+
+namespace mk {
+namespace ooni {
+
+/*
+    The following split iplookup::perform() in two halves, so that the
+    caller can perform the request asynchronously, e.g. using curl::Multi,
+    rather than blocking until the server responds.
+*/
+
+/// `ip_lookup_request()` returns the request that iplookup::perform()
+/// would send given the \p request settings.
+curl::Request ip_lookup_request(const iplookup::Request &request);
+
+/// `ip_lookup_response()` processes the \p response to the request that
+/// was returned by ip_lookup_request(), like iplookup::perform() does.
+iplookup::Response ip_lookup_response(curl::Response response);
+
+} // namespace ooni
+} // namespace mk
+#endif
@@ -8,6 +8,9 @@
 #include "src/libmeasurement_kit/common/reactor.hpp"
 
 namespace mk {
+namespace curl {
+class Multi;
+} // namespace curl
 namespace ooni {
 
 void captiveportal(std::string, Settings, Callback<SharedPtr<nlohmann::json>>,
@@ -22,9 +25,13 @@ void http_invalid_request_line(Settings, Callback<SharedPtr<nlohmann::json>>,
 void tcp_connect(std::string, Settings, Callback<SharedPtr<nlohmann::json>>,
                  SharedPtr<Reactor>, SharedPtr<Logger>);
 
+// When `backend/http2` is true, `control_multi` is set and the backend is
+// HTTPS, control requests use HTTP/2 through `control_multi`, so that
+// concurrent measurements share a single connection to the test helper.
 void web_connectivity(std::string input, Settings,
                       Callback<SharedPtr<nlohmann::json>>,
-                      SharedPtr<Reactor>, SharedPtr<Logger>);
+                      SharedPtr<Reactor>, SharedPtr<Logger>,
+                      SharedPtr<curl::Multi> control_multi = {});
 
 void meek_fronted_requests(std::string input, Settings,
                            Callback<SharedPtr<nlohmann::json>>,
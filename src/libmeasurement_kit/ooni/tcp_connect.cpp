@@ -4,6 +4,7 @@
 
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/ooni/nettests.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
 #include "src/libmeasurement_kit/net/transport.hpp"
 #include "src/libmeasurement_kit/ooni/templates.hpp"
 
@@ -32,6 +33,7 @@ void tcp_connect(std::string input, Settings options,
             callback(entry);
             return;
         }
+        (*entry)["socket_options"] = net::socket_options_effective(txp);
         txp->close([=]() {
             (*entry)["connection"] = "success";
             callback(entry);
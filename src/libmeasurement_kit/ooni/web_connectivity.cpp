@@ -3,17 +3,19 @@
 // and LICENSE for more information on the copying conditions.
 
 #include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/curl/multi.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
 #include "src/libmeasurement_kit/ooni/constants.hpp"
+#include "src/libmeasurement_kit/ooni/geoip_cache.hpp"
 #include "src/libmeasurement_kit/ooni/nettests.hpp"
 #include "src/libmeasurement_kit/ooni/templates.hpp"
 #include "src/libmeasurement_kit/ooni/utils.hpp"
+#include "src/libmeasurement_kit/ooni/web_connectivity_impl.hpp"
 
 #include <algorithm>
 #include <cctype>
 #include <set>
 
-#include <measurement_kit/internal/vendor/mkmmdb.hpp>
-
 #define BODY_PROPORTION_FACTOR 0.7
 
 namespace mk {
@@ -198,18 +200,17 @@ static void compare_dns_queries(mk::http::Url url, SharedPtr<nlohmann::json> ent
 
     std::string asn_p = options.get("geoip_asn_path", std::string{});
     std::vector<std::string> logs;
-    mk::mmdb::Handle db;
-    (void)db.open(asn_p, logs);  // lookup will fail if open fails
+    SharedPtr<GeoipCache> geoip = GeoipCache::global();
     for (auto exp_addr : exp_addresses) {
-        std::string asn;
-        if (db.lookup_asn2(exp_addr, asn, logs) == true) {
-            exp_asns.insert(asn);
+        GeoipInfo info = geoip->lookup("", asn_p, exp_addr, logs, false);
+        if (info.asn_ok) {
+            exp_asns.insert(info.asn);
         }
     }
     for (auto ctrl_addr : ctrl_addresses) {
-        std::string asn;
-        if (db.lookup_asn2(ctrl_addr, asn, logs) == true) {
-            ctrl_asns.insert(asn);
+        GeoipInfo info = geoip->lookup("", asn_p, ctrl_addr, logs, false);
+        if (info.asn_ok) {
+            ctrl_asns.insert(info.asn);
         }
     }
     std::set<std::string> common_asns;
@@ -352,7 +353,8 @@ static void control_request(http::Headers headers_to_pass_along,
                             SharedPtr<nlohmann::json> entry, SocketList socket_list,
                             std::string url, Callback<Error> callback,
                             Settings settings, SharedPtr<Reactor> reactor,
-                            SharedPtr<Logger> logger) {
+                            SharedPtr<Logger> logger,
+                            SharedPtr<curl::Multi> control_multi) {
 
     // Implementation note: this function uses (and modifies) the settings
     // passed by the caller because such object is passed by copy and we
@@ -408,6 +410,15 @@ static void control_request(http::Headers headers_to_pass_along,
 
     mk::dump_settings(settings, "web_connectivity", logger);
 
+#ifndef MK_WITHOUT_CURL
+    if (control_multi && mk::startswith(settings["backend"], "https://") &&
+        settings.get("backend/http2", false)) {
+        control_request_http2_impl(entry, body, callback, settings,
+                                   control_multi, logger);
+        return;
+    }
+#endif
+
     http::request(settings, headers, body,
                   [=](Error error, SharedPtr<http::Response> response) {
                       if (!error) {
@@ -466,7 +477,8 @@ static void experiment_http_request(
 }
 
 static void experiment_tcp_connect(SharedPtr<nlohmann::json> entry, SocketList sockets,
-                                   Callback<Error> cb, SharedPtr<Reactor> reactor,
+                                   Callback<Error> cb, Settings options,
+                                   SharedPtr<Reactor> reactor,
                                    SharedPtr<Logger> logger) {
 
     int socket_count = sockets.size();
@@ -501,6 +513,7 @@ static void experiment_tcp_connect(SharedPtr<nlohmann::json> entry, SocketList s
                              ip.c_str(), port);
                 result["status"]["success"] = true;
                 result["status"]["blocked"] = false;
+                result["socket_options"] = net::socket_options_effective(txp);
             }
             (*entry)["tcp_connect"].push_back(result);
             if (socket_count == *sockets_tested) {
@@ -525,6 +538,7 @@ static void experiment_tcp_connect(SharedPtr<nlohmann::json> entry, SocketList s
         connect_options["host"] = address;
         connect_options["port"] = port;
         connect_options["net/timeout"] = 10.0;
+        net::socket_options_copy(options, connect_options);
         templates::tcp_connect(connect_options, handle_connect(address, port),
                                reactor, logger);
     }
@@ -572,7 +586,8 @@ static void experiment_dns_query(
 
 void web_connectivity(std::string input, Settings options,
                       Callback<SharedPtr<nlohmann::json>> callback, SharedPtr<Reactor> reactor,
-                      SharedPtr<Logger> logger) {
+                      SharedPtr<Logger> logger,
+                      SharedPtr<curl::Multi> control_multi) {
 
     logger->emit_event_ex("status.update.websites", {
         {"url", input},
@@ -684,13 +699,13 @@ void web_connectivity(std::string input, Settings options,
 
                                 },
                                 options, reactor,
-                                logger); // end control_request
+                                logger, control_multi); // end control_request
 
                         },
                         options, reactor, logger); // end http_request
 
                 },
-                reactor, logger); // end tcp_connect
+                options, reactor, logger); // end tcp_connect
 
         },
         options, reactor, logger); // end dns_query
@@ -0,0 +1,82 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_OONI_WEB_CONNECTIVITY_IMPL_HPP
+#define SRC_LIBMEASUREMENT_KIT_OONI_WEB_CONNECTIVITY_IMPL_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include "src/libmeasurement_kit/common/error.hpp"
+#include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/curl/multi.hpp"
+
+namespace mk {
+namespace ooni {
+
+// Builds the cURL request for the control, honouring the same settings
+// used by the HTTP/1.1 code path for the CA bundle and the proxy.
+static inline curl::Request control_curl_request(std::string body,
+                                                 Settings settings) {
+    curl::Request request;
+    request.method = "POST";
+    request.url = settings["backend"];
+    request.headers.push_back("Content-Type: application/json");
+    request.body = std::move(body);
+    request.timeout = (int64_t)settings.get("net/timeout", 30.0);
+    request.ca_path = settings.get("net/ca_bundle_path", std::string{});
+    std::string proxy = settings.get("net/socks5_proxy", std::string{});
+    if (proxy != "") {
+        // As with net::connect(), names are resolved by the proxy
+        request.proxy_url = "socks5h://" + proxy;
+    }
+    return request;
+}
+
+template <MK_MOCK_AS(curl::perform_http2, curl_perform_http2)>
+void control_request_http2_impl(SharedPtr<nlohmann::json> entry,
+                                std::string body, Callback<Error> callback,
+                                Settings settings,
+                                SharedPtr<curl::Multi> multi,
+                                SharedPtr<Logger> logger) {
+    curl::Request request = control_curl_request(std::move(body), settings);
+    curl_perform_http2(multi, request, [=](curl::TransferResponse response) {
+        for (auto &log : response.logs) {
+            logger->debug2("%s", log.line.c_str());
+        }
+        // Per-stream accounting, useful to understand how much we gain
+        // by multiplexing many control requests over one connection.
+        (*entry)["control_transfer"] = {
+            {"http_version", response.http_version},
+            {"connection_reused", response.connection_reused},
+            {"bytes_sent", response.bytes_sent},
+            {"bytes_received", response.bytes_recv},
+            {"body_bytes_sent", response.upload_size},
+            {"body_bytes_received", response.download_size},
+            {"t_connect", response.connect_time_us / 1e06},
+            {"t_tls_handshake", response.appconnect_time_us / 1e06},
+            {"t_first_byte", response.starttransfer_time_us / 1e06},
+            {"t_total", response.total_time_us / 1e06},
+        };
+        Error error = curl::response_error(response);
+        if (error) {
+            (*entry)["control_failure"] = error.reason;
+            callback(error);
+            return;
+        }
+        nlohmann::json doc;
+        try {
+            doc = nlohmann::json::parse(response.body);
+        } catch (const std::exception &) {
+            (*entry)["control_failure"] = "json_parse_error";
+            callback(JsonProcessingError());
+            return;
+        }
+        (*entry)["control"] = std::move(doc);
+        callback(NoError());
+    });
+}
+
+} // namespace ooni
+} // namespace mk
+#endif
@@ -4,59 +4,245 @@
 
 #include "src/libmeasurement_kit/regexp/regexp.hpp"
 
-#include <regex>
+#include <string.h>
+
+// Note: these used to be implemented using std::regex, which however
+// compiles the expression at every call and then backtracks. We now
+// use hand written matchers that behave exactly like the expressions
+// that are documented above each function.
 
 namespace mk {
 namespace regexp {
 
+static bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+
+static bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static char to_lower(char c) { return is_upper(c) ? (char)(c - 'A' + 'a') : c; }
+
+template <typename Predicate>
+static bool all_of(const std::string &input, Predicate &&pred) {
+  for (char c : input) {
+    if (!pred(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the number of consecutive digits in `s` starting at `pos`.
+static size_t count_digits(const std::string &s, size_t pos) {
+  size_t n = 0;
+  while (pos + n < s.size() && is_digit(s[pos + n])) {
+    ++n;
+  }
+  return n;
+}
+
+// ^[A-Z]{2}$
 bool valid_country_code(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[A-Z]{2}$)"});
+  return input.size() == 2 && all_of(input, is_upper);
 }
 
+// ^[a-z]{3}$
 bool valid_airport_iata_code(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[a-z]{3}$)"});
+  return input.size() == 3 && all_of(input, is_lower);
 }
 
+// ^[a-z]+$
 bool lowercase_letters_only(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[a-z]+$)"});
+  return !input.empty() && all_of(input, is_lower);
 }
 
+// ^[a-z][a-z0-9]*$
+bool valid_mlabns_tool_name(const std::string &input) {
+  return !input.empty() && is_lower(input[0]) &&
+         all_of(input, [](char c) { return is_lower(c) || is_digit(c); });
+}
+
+// s/\$\{probe_cc\}/cc/g
 std::string replace_probe_cc(std::string &&input, const std::string &cc) {
-  return std::regex_replace(input, std::regex{R"(\$\{probe_cc\})"}, cc);
+  static const std::string pattern = "${probe_cc}";
+  size_t pos = input.find(pattern);
+  while (pos != std::string::npos) {
+    input.replace(pos, pattern.size(), cc);
+    pos = input.find(pattern, pos + cc.size());
+  }
+  return std::move(input);
 }
 
+// ^[A-Za-z0-9._-]+$
 bool valid_nettest_name(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^[A-Za-z0-9._-]+$)"});
+  return !input.empty() && all_of(input, [](char c) {
+    return is_upper(c) || is_lower(c) || is_digit(c) || c == '.' ||
+           c == '_' || c == '-';
+  });
 }
 
+// ^v?[0-9]{1,8}\.[0-9]{1,8}\.[0-9]{1,8}[a-z0-9-+.]{0,32}$
 bool valid_nettest_version(const std::string &input) {
-  return std::regex_match(
-      input,
-      std::regex{R"(^v?[0-9]{1,8}\.[0-9]{1,8}\.[0-9]{1,8}[a-z0-9-+.]{0,32}$)"});
+  size_t pos = (!input.empty() && input[0] == 'v') ? 1 : 0;
+  for (int i = 0; i < 2; ++i) {
+    size_t n = count_digits(input, pos);
+    if (n < 1 || n > 8 || pos + n >= input.size() || input[pos + n] != '.') {
+      return false;
+    }
+    pos += n + 1;
+  }
+  // The suffix may also begin with digits, hence the third number
+  // takes at most eight digits and the rest belongs to the suffix.
+  size_t n = count_digits(input, pos);
+  if (n < 1) {
+    return false;
+  }
+  pos += (n < 8) ? n : 8;
+  if (input.size() - pos > 32) {
+    return false;
+  }
+  for (; pos < input.size(); ++pos) {
+    char c = input[pos];
+    if (!is_lower(c) && !is_digit(c) && c != '-' && c != '+' && c != '.') {
+      return false;
+    }
+  }
+  return true;
 }
 
+// ^AS[0-9]+$
 bool valid_probe_asn(const std::string &input) {
-  return std::regex_match(input, std::regex{R"(^AS[0-9]+$)"});
+  return input.size() > 2 && input[0] == 'A' && input[1] == 'S' &&
+         count_digits(input, 2) == input.size() - 2;
 }
 
+// ^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}$
 bool valid_test_start_time(const std::string &input) {
-  return std::regex_match(
-      input,
-      std::regex{R"(^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}$)"});
+  static const char *pattern = "dddd-dd-dd dd:dd:dd";
+  if (input.size() != strlen(pattern)) {
+    return false;
+  }
+  for (size_t i = 0; i < input.size(); ++i) {
+    if (pattern[i] == 'd' ? !is_digit(input[i]) : input[i] != pattern[i]) {
+      return false;
+    }
+  }
+  return true;
 }
 
+// Titles longer than this many bytes are ignored
+static constexpr size_t max_title_length = 128;
+
+// Case insensitive equivalent of `<title>([^<]{1,128})<\/title>`
 std::string html_extract_title(const std::string &input) {
-  std::smatch match;
-  std::regex re{R"(<title>([^<]{1,128})<\/title>)", std::regex::icase};
-  if (std::regex_search(input, match, re) == false) {
-    return "";
+  static const char open_tag[] = "<title>";
+  static const char close_tag[] = "</title>";
+  enum class State { open, title, close };
+  State state = State::open;
+  size_t matched = 0;
+  std::string title;
+  const char *end = input.data() + input.size();
+  for (const char *p = input.data(); p < end;) {
+    switch (state) {
+    case State::open:
+      if (matched == 0) {
+        // Fast path: skip everything that cannot start a tag
+        p = static_cast<const char *>(memchr(p, '<', (size_t)(end - p)));
+        if (p == nullptr) {
+          return "";
+        }
+      }
+      if (to_lower(*p) == open_tag[matched]) {
+        if (++matched == sizeof(open_tag) - 1) {
+          state = State::title;
+          title.clear();
+        }
+      } else {
+        matched = (*p == '<') ? 1 : 0;
+      }
+      ++p;
+      break;
+    case State::title: {
+      size_t avail = (size_t)(end - p);
+      const char *lt = static_cast<const char *>(memchr(p, '<', avail));
+      size_t n = (lt != nullptr) ? (size_t)(lt - p) : avail;
+      if (title.size() + n > max_title_length) {
+        // Cannot be a title; a new tag cannot start before the next `<`
+        title.clear();
+        state = State::open;
+        matched = 0;
+        p += n;
+        break;
+      }
+      title.append(p, n);
+      p += n;
+      if (lt != nullptr) {
+        // Empty titles do not match, yet `<` may start `<title>`
+        state = (title.empty()) ? State::open : State::close;
+        matched = 1;
+        ++p;
+      }
+      break;
+    }
+    case State::close:
+      if (to_lower(*p) == close_tag[matched]) {
+        ++p;
+        if (++matched == sizeof(close_tag) - 1) {
+          return title;
+        }
+        break;
+      }
+      // Only if we did not see `</` the `<` may have started `<title>`; in
+      // any case, reprocess the current character in the open state.
+      matched = (matched == 1) ? 1 : 0;
+      title.clear();
+      state = State::open;
+      break;
+    }
+  }
+  return "";
+}
+
+// Splits `input` into four dot-separated groups of one to three digits.
+static bool split_ipv4_like(const std::string &input, std::string (&out)[4]) {
+  size_t pos = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    size_t n = count_digits(input, pos);
+    if (n < 1 || n > 3) {
+      return false;
+    }
+    out[i] = input.substr(pos, n);
+    pos += n;
+    if (i < 3) {
+      if (pos >= input.size() || input[pos] != '.') {
+        return false;
+      }
+      pos += 1;
+    }
   }
-  return (match.size() >= 2) ? match[1] : std::string{};
+  return pos == input.size();
 }
 
+// ^(127\.d\.d\.d|192\.168\.d\.d|10\.d\.d\.d|172\.(1[6-9]|2[0-9]|3[0-1])\.d\.d|
+// localhost)$ where `d` is `[0-9]{1,3}`
 bool private_ipv4(const std::string &input) {
-  const char *pattern = R"(^(?:(?:127\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:192\.168\.[0-9]{1,3}\.[0-9]{1,3})|(?:10\.[0-9]{1,3}\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.1[6-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.2[0-9]\.[0-9]{1,3}\.[0-9]{1,3})|(?:172\.3[0-1]\.[0-9]{1,3}\.[0-9]{1,3})|localhost)$)";
-  return std::regex_match(input, std::regex{pattern});
+  if (input == "localhost") {
+    return true;
+  }
+  std::string g[4];
+  if (!split_ipv4_like(input, g)) {
+    return false;
+  }
+  if (g[0] == "127" || g[0] == "10") {
+    return true;
+  }
+  if (g[0] == "192") {
+    return g[1] == "168";
+  }
+  if (g[0] == "172") {
+    return g[1].size() == 2 && g[1] >= "16" && g[1] <= "31";
+  }
+  return false;
 }
 
 } // namespace regexp
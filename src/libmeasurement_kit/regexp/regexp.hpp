@@ -15,6 +15,8 @@ bool valid_airport_iata_code(const std::string &input);
 
 bool lowercase_letters_only(const std::string &input);
 
+bool valid_mlabns_tool_name(const std::string &input);
+
 std::string replace_probe_cc(std::string &&input, const std::string &cc);
 
 bool valid_nettest_name(const std::string &input);
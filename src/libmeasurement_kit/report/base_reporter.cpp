@@ -35,7 +35,7 @@ Continuation<Error> BaseReporter::do_open_(Continuation<Error> cc) {
 }
 
 Continuation<Error>
-BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
+BaseReporter::do_write_entry_(SerializedEntry entry, Continuation<Error> cc) {
     return [=](Callback<Error> cb) {
         if (!openned_) {
             cb(ReportNotOpenError());
@@ -47,8 +47,7 @@ BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
         }
         // On success we save the serialization of the previous entry such
         // that submitting more than once the same entry is idempontent
-        std::string serio = entry.dump();
-        if (serio == prev_entry_) {
+        if (has_prev_entry_ && entry == prev_entry_) {
             cb(NoError(DuplicateEntrySubmitError()));
             return;
         }
@@ -57,7 +56,8 @@ BaseReporter::do_write_entry_(nlohmann::json entry, Continuation<Error> cc) {
                 cb(error);
                 return;
             }
-            prev_entry_ = serio; // Only on success to allow resubmit
+            prev_entry_ = entry; // Only on success to allow resubmit
+            has_prev_entry_ = true;
             cb(NoError());
         });
     };
@@ -8,6 +8,7 @@
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
 #include "src/libmeasurement_kit/common/non_movable.hpp"
 #include "src/libmeasurement_kit/report/report_legacy.hpp"
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
 
 namespace mk {
 namespace report {
@@ -26,7 +27,7 @@ class BaseReporter : public NonCopyable, public NonMovable {
         return do_open_([=](Callback<Error> cb) { cb(NoError()); });
     }
 
-    virtual Continuation<Error> write_entry(nlohmann::json e) {
+    virtual Continuation<Error> write_entry(SerializedEntry e) {
         return do_write_entry_(e, [=](Callback<Error> cb) { cb(NoError()); });
     }
 
@@ -34,16 +35,24 @@ class BaseReporter : public NonCopyable, public NonMovable {
         return do_close_([=](Callback<Error> cb) { cb(NoError()); });
     }
 
+    // Calls back once opening is complete, which may happen after the
+    // continuation returned by open() when opening in the background
+    virtual void wait_for_open(Callback<> cb) { cb(); }
+
     virtual std::string get_report_id() {
         return ""; /* This is basically "invalid report id" */
     }
 
+    // Whether write_entry() saves entries to be submitted later, so that
+    // its success does not mean that the entry has been submitted
+    virtual bool spools_entries() { return false; }
+
   protected:
     BaseReporter() {}
 
     Continuation<Error> do_open_(Continuation<Error> cc);
 
-    Continuation<Error> do_write_entry_(nlohmann::json, Continuation<Error> cc);
+    Continuation<Error> do_write_entry_(SerializedEntry, Continuation<Error> cc);
 
     Continuation<Error> do_close_(Continuation<Error> cc);
 
@@ -51,7 +60,8 @@ class BaseReporter : public NonCopyable, public NonMovable {
 
     bool openned_ = false;
     bool closed_ = false;
-    std::string prev_entry_;
+    bool has_prev_entry_ = false;
+    SerializedEntry prev_entry_;
 };
 
 } // namespace report
@@ -0,0 +1,87 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/report/entry_builder.hpp"
+
+#include "src/libmeasurement_kit/common/fast_uuid4.hpp"
+#include "src/libmeasurement_kit/common/utils.hpp"
+
+namespace mk {
+namespace report {
+
+EntryBuilder::EntryBuilder(const ReportLegacy &report,
+                           const std::map<std::string, std::string> &annotations,
+                           nlohmann::json test_helpers) {
+    // Note: annotations must be added before fill_entry because in the
+    // latter we will add additional annotations.
+    header_["annotations"] = annotations;
+    report.fill_entry(header_);
+    header_.erase("report_id");
+
+    // Until we have support for passing options, leave it empty
+    header_["options"] = nlohmann::json::array();
+
+    // Until we have support for it, just put `null`
+    header_["probe_city"] = nullptr;
+
+    header_["test_helpers"] = std::move(test_helpers);
+
+    // Add empty input hashes
+    header_["input_hashes"] = nlohmann::json::array();
+}
+
+nlohmann::json EntryBuilder::build(const std::string &input,
+                                   nlohmann::json &&test_keys,
+                                   const std::string &resolver_ip,
+                                   const tm &start_time, double runtime,
+                                   const std::string &report_id) const {
+    nlohmann::json entry = header_;
+    // Make sure the input is `null` rather than empty string
+    if (input != "") {
+        entry["input"] = input;
+    } else {
+        entry["input"] = nullptr;
+    }
+    test_keys["client_resolver"] = resolver_ip;
+    entry["test_keys"] = std::move(test_keys);
+    entry["measurement_start_time"] = format_timestamp(start_time);
+    entry["test_runtime"] = runtime;
+    entry["id"] = mk::fast_uuid4();
+    entry["report_id"] = report_id;
+    return entry;
+}
+
+static inline char *format_number(char *out, int value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        out[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+std::string format_timestamp(const tm &t) {
+    int year = t.tm_year + 1900;
+    // The fast path only deals with the dates that we can actually see
+    if (year < 1000 || year > 9999 || t.tm_mon < 0 || t.tm_mon > 11 ||
+        t.tm_mday < 1 || t.tm_mday > 31 || t.tm_hour < 0 || t.tm_hour > 23 ||
+        t.tm_min < 0 || t.tm_min > 59 || t.tm_sec < 0 || t.tm_sec > 60) {
+        return *mk::timestamp(&t);
+    }
+    char result[19];
+    char *p = format_number(result, year, 4);
+    *p++ = '-';
+    p = format_number(p, t.tm_mon + 1, 2);
+    *p++ = '-';
+    p = format_number(p, t.tm_mday, 2);
+    *p++ = ' ';
+    p = format_number(p, t.tm_hour, 2);
+    *p++ = ':';
+    p = format_number(p, t.tm_min, 2);
+    *p++ = ':';
+    p = format_number(p, t.tm_sec, 2);
+    return std::string(result, (size_t)(p - result));
+}
+
+} // namespace report
+} // namespace mk
@@ -0,0 +1,50 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_ENTRY_BUILDER_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_ENTRY_BUILDER_HPP
+
+#include "src/libmeasurement_kit/report/report_legacy.hpp"
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+
+#include <ctime>
+#include <map>
+#include <string>
+
+namespace mk {
+namespace report {
+
+/*
+    EntryBuilder creates the measurement entries of a report. The fields
+    that are the same for all entries (test name, probe info, annotations,
+    etc.) are computed once, when the builder is constructed, so that each
+    entry is a copy of them plus the fields specific to the measurement.
+
+    The report ID is not cached because, when the report is opened in the
+    background, we learn it after the first measurements have started.
+*/
+class EntryBuilder {
+  public:
+    EntryBuilder(const ReportLegacy &report,
+                 const std::map<std::string, std::string> &annotations,
+                 nlohmann::json test_helpers);
+
+    /// `build()` returns the entry for a measurement with \p input, which
+    /// may be empty, started at \p start_time and lasting \p runtime
+    /// seconds. To avoid a copy, it takes ownership of \p test_keys.
+    nlohmann::json build(const std::string &input, nlohmann::json &&test_keys,
+                         const std::string &resolver_ip, const tm &start_time,
+                         double runtime, const std::string &report_id) const;
+
+  private:
+    nlohmann::json header_;
+};
+
+/// `format_timestamp()` is like mk::timestamp() without the overhead of
+/// strftime() and ErrorOr. It throws if \p t does not contain a valid date.
+std::string format_timestamp(const tm &t);
+
+} // namespace report
+} // namespace mk
+#endif
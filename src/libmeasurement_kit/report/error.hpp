@@ -18,6 +18,8 @@ MK_DEFINE_ERR(MK_ERR_REPORT(5), ReportLogicalError, "report_formatting_error")
 MK_DEFINE_ERR(MK_ERR_REPORT(6), DuplicateEntrySubmitError, "duplicate_entry_submitted")
 MK_DEFINE_ERR(MK_ERR_REPORT(7), MissingReportIdError, "missing_report_id")
 MK_DEFINE_ERR(MK_ERR_REPORT(8), MultipleReportIdsError, "multiple_inconsistent_report_ids")
+MK_DEFINE_ERR(MK_ERR_REPORT(9), SpoolLockedError, "spool_locked")
+MK_DEFINE_ERR(MK_ERR_REPORT(10), SpoolEntryNotFoundError, "spool_entry_not_found")
 
 } // namespace report
 } // namespace mk
@@ -24,8 +24,17 @@ static Error map_error(std::ostream &file) {
 }
 
 /* static */ SharedPtr<BaseReporter> FileReporter::make(std::string s) {
+    return make(std::move(s), {});
+}
+
+/* static */ SharedPtr<BaseReporter> FileReporter::make(
+        std::string s, Settings settings, SharedPtr<Reactor> reactor,
+        SharedPtr<Logger> logger) {
     SharedPtr<FileReporter> reporter(new FileReporter);
     reporter->filename = s;
+    reporter->settings = settings;
+    reporter->reactor = reactor;
+    reporter->logger = (!!logger) ? logger : Logger::make();
     return reporter.as<BaseReporter>();
 }
 
@@ -35,21 +44,21 @@ Continuation<Error> FileReporter::open(ReportLegacy &) {
             cb(NoError());
             return;
         }
-        file.open(filename);
-        if (!file.good()) {
-            cb(map_error(file));
-            return;
-        }
-        cb(NoError());
+        writer = ReportWriter::make(filename, settings);
+        cb(writer->open());
     });
 }
 
-Continuation<Error> FileReporter::write_entry(nlohmann::json entry) {
+Continuation<Error> FileReporter::write_entry(SerializedEntry entry) {
     return do_write_entry_(entry, [=](Callback<Error> cb) {
-        std::ostream &frf = (filename == "-") ? std::cout : file;
-        frf << entry.dump() << std::endl;
-        if (!frf.good()) {
-            cb(map_error(frf));
+        if (filename != "-") {
+            // Note: the actual write happens in a background thread
+            cb(writer->write_line(entry.str()));
+            return;
+        }
+        std::cout << entry.str() << std::endl;
+        if (!std::cout.good()) {
+            cb(map_error(std::cout));
             return;
         }
         cb(NoError());
@@ -62,12 +71,13 @@ Continuation<Error> FileReporter::close() {
             cb(NoError());
             return;
         }
-        file.close();
-        if (!file.good()) {
-            cb(map_error(file));
+        if (!!reactor) {
+            SharedPtr<ReportWriter> w = writer;
+            // Capturing the writer to keep it alive until it is closed
+            w->close(reactor, logger, [w, cb](Error err) { cb(err); });
             return;
         }
-        cb(NoError());
+        cb(writer->close());
     });
 }
 
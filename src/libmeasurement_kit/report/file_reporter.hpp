@@ -4,9 +4,8 @@
 #ifndef SRC_LIBMEASUREMENT_KIT_REPORT_FILE_REPORTER_HPP
 #define SRC_LIBMEASUREMENT_KIT_REPORT_FILE_REPORTER_HPP
 
-#include <fstream>
-
 #include "src/libmeasurement_kit/report/base_reporter.hpp"
+#include "src/libmeasurement_kit/report/report_writer.hpp"
 
 namespace mk {
 namespace report {
@@ -15,8 +14,16 @@ class FileReporter : public BaseReporter {
   public:
     static SharedPtr<BaseReporter> make(std::string filename);
 
+    /// Like make() but \p settings configure the ReportWriter used to write
+    /// entries in the background. Use `-` to write on the standard output.
+    /// When \p reactor is not null, close() does not block it on disk I/O.
+    static SharedPtr<BaseReporter> make(std::string filename,
+                                        Settings settings,
+                                        SharedPtr<Reactor> reactor = {},
+                                        SharedPtr<Logger> logger = {});
+
     Continuation<Error> open(ReportLegacy &report) override;
-    Continuation<Error> write_entry(nlohmann::json entry) override;
+    Continuation<Error> write_entry(SerializedEntry entry) override;
     Continuation<Error> close() override;
 
     ~FileReporter() override {}
@@ -25,7 +32,10 @@ class FileReporter : public BaseReporter {
     FileReporter() {}
 
     std::string filename;
-    std::ofstream file;
+    Settings settings;
+    SharedPtr<Reactor> reactor;
+    SharedPtr<Logger> logger;
+    SharedPtr<ReportWriter> writer;
 };
 
 } // namespace report
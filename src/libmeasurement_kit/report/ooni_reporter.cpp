@@ -5,7 +5,8 @@
 #include "src/libmeasurement_kit/ooni/error.hpp"
 #include "src/libmeasurement_kit/report/ooni_reporter.hpp"
 #include "src/libmeasurement_kit/report/error.hpp"
-#include "src/libmeasurement_kit/ooni/collector_client.hpp"
+
+#include <measurement_kit/internal/vendor/mkuuid4.hpp>
 
 namespace mk {
 namespace report {
@@ -22,6 +23,19 @@ OoniReporter::OoniReporter(Settings s, SharedPtr<Reactor> r, SharedPtr<Logger> l
     }
     logger->info("Results collector: %s",
         settings["collector_base_url"].c_str());
+    // Entries and the final close share a single collector connection
+    session = ooni::collector::Session::make(settings, reactor, logger);
+    std::string spool_dir = settings.get("collector/spool_dir", std::string{});
+    if (spool_dir != "") {
+        // On failure, we fall back to submitting entries directly
+        ErrorOr<SharedPtr<Spool>> maybe_spool =
+              Spool::open(spool_dir, settings, logger);
+        if (maybe_spool) {
+            spool = *maybe_spool;
+            uploader = SpoolUploader::make(spool, settings, reactor, logger);
+            spool_key = mk::uuid4::gen();
+        }
+    }
 }
 
 /* static */ SharedPtr<BaseReporter> OoniReporter::make(Settings settings,
@@ -33,6 +47,11 @@ OoniReporter::OoniReporter(Settings s, SharedPtr<Reactor> r, SharedPtr<Logger> l
 Continuation<Error> OoniReporter::open(ReportLegacy &report) {
     return do_open_([=, &report](Callback<Error> cb) {
         logger->info("Opening report; please be patient...");
+        if (!!uploader) {
+            uploader->drain(); // Resume what previous runs left behind
+        }
+        bool background = settings.get("collector/open_in_background", false);
+        creating = background;
         ooni::collector::connect_and_create_report(
                 report.get_dummy_entry(),
                 [=, &report](Error error, std::string rid) {
@@ -42,71 +61,129 @@ Continuation<Error> OoniReporter::open(ReportLegacy &report) {
                         report_id = rid;
                         assert(report.report_id == "");
                         report.report_id = rid;
+                        if (!!spool) {
+                            error = spool->set_report_id(spool_key, rid);
+                        }
+                    } else if (!!spool) {
+                        logger->warn("Cannot open report; we will open it "
+                                     "later and submit spooled results");
+                        error = NoError();
+                    }
+                    if (!background) {
+                        cb(error);
+                        return;
+                    }
+                    if (error) {
+                        logger->warn("Cannot open report: %s", error.what());
+                    }
+                    creating = false;
+                    create_error = error;
+                    auto callbacks = std::move(after_create);
+                    after_create.clear();
+                    for (auto &callback : callbacks) {
+                        callback();
                     }
-                    cb(error);
                 },
                 settings,
                 reactor,
                 logger);
+        if (background) {
+            cb(NoError());
+        }
     });
 }
 
-Continuation<Error> OoniReporter::write_entry(nlohmann::json entry) {
+Continuation<Error> OoniReporter::write_entry(SerializedEntry entry) {
 
     // Register action for when we will be asked to write the entry
     return do_write_entry_(entry, [=](Callback<Error> cb) {
-        if (report_id == "") {
-            logger->warn("ooni_reporter: missing report ID");
-            cb(MissingReportIdError());
+        if (!!spool) {
+            // Do not wait for the collector; the uploader will submit
+            ErrorOr<uint64_t> seq = spool->append(spool_key, entry);
+            if (seq) {
+                uploader->drain();
+            }
+            cb(seq.as_error());
+            return;
+        }
+        if (creating) {
+            after_create.push_back([=]() { update_report(entry, cb); });
+            return;
+        }
+        update_report(entry, cb);
+    });
+}
+
+void OoniReporter::update_report(SerializedEntry entry, Callback<Error> cb) {
+    if (report_id == "") {
+        logger->warn("ooni_reporter: missing report ID");
+        if (create_error) {
+            cb(create_error);
             return;
         }
-        logger->info("Submitting test results; please be patient...");
-        ooni::collector::connect_and_update_report(report_id, entry,
-                                             [=](Error e) {
-                                                 logger->debug(
-                                                     "Submitting entry... %d",
-                                                     e.code);
-                                                 if (!e) {
-                                                     logger->info("Results "
-                                                        "successfully "
-                                                        "submitted");
-                                                 }
-                                                 cb(e);
-                                             },
-                                             settings,
-                                             reactor,
-                                             logger);
+        cb(MissingReportIdError());
+        return;
+    }
+    // Entries written before the report was created lack its ID
+    auto it = entry.json().find("report_id");
+    if (it == entry.json().end() || *it != report_id) {
+        nlohmann::json copy = entry.json();
+        copy["report_id"] = report_id;
+        entry = SerializedEntry::make(std::move(copy));
+    }
+    logger->info("Submitting test results; please be patient...");
+    session->update_report(report_id, entry, [=](Error e) {
+        logger->debug("Submitting entry... %d", e.code);
+        if (!e) {
+            logger->info("Results successfully submitted");
+        }
+        cb(e);
     });
 }
 
 Continuation<Error> OoniReporter::close() {
     return do_close_([=](Callback<Error> cb) {
+        if (creating) {
+            after_create.push_back([=]() { close()(cb); });
+            return;
+        }
+        if (!!spool) {
+            Error error = spool->close_report(spool_key);
+            uploader->drain();
+            cb(error);
+            return;
+        }
         if (report_id == "") {
             logger->warn("ooni_reporter: missing report ID");
             cb(MissingReportIdError());
             return;
         }
         logger->info("Closing report; please be patient...");
-        ooni::collector::connect_and_close_report(report_id,
-                                            [=](Error e) {
-                                                logger->debug(
-                                                    "Closing report... %d",
-                                                    e.code);
-                                                if (!e) {
-                                                    logger->info("Report "
-                                                        "successfully closed");
-                                                }
-                                                cb(e);
-                                            },
-                                            settings,
-                                            reactor,
-                                            logger);
+        session->close_report(report_id, [=](Error e) {
+            logger->debug("Closing report... %d", e.code);
+            if (!e) {
+                logger->info("Report successfully closed");
+            }
+            cb(e);
+        });
     });
 }
 
+void OoniReporter::wait_for_open(Callback<> cb) {
+    if (creating) {
+        after_create.push_back(std::move(cb));
+        return;
+    }
+    cb();
+}
+
 std::string OoniReporter::get_report_id() {
     return report_id;
 }
 
+bool OoniReporter::spools_entries() {
+    return !!spool;
+}
+
 } // namespace report
 } // namespace mk
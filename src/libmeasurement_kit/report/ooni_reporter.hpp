@@ -6,22 +6,37 @@
 
 #include "src/libmeasurement_kit/report/base_reporter.hpp"
 #include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/ooni/collector_client.hpp"
+#include "src/libmeasurement_kit/report/spool_uploader.hpp"
+
+#include <list>
 
 namespace mk {
 namespace report {
 
+/*
+    When `collector/open_in_background` is true, open() does not wait for
+    the collector to create the report, so that measurements can start
+    earlier. Entries written in the meanwhile, and the final close, are
+    queued and submitted, with the proper report ID, after the report has
+    been created. If that fails, they fail with the same error. Use
+    wait_for_open() to know when the report ID is known.
+*/
 class OoniReporter : public BaseReporter {
   public:
     static SharedPtr<BaseReporter> make(Settings, SharedPtr<Reactor>, SharedPtr<Logger>);
 
     Continuation<Error> open(ReportLegacy &report) override;
-    Continuation<Error> write_entry(nlohmann::json entry) override;
+    Continuation<Error> write_entry(SerializedEntry entry) override;
     Continuation<Error> close() override;
+    void wait_for_open(Callback<> cb) override;
 
     ~OoniReporter() override {}
 
     std::string get_report_id() override;
 
+    bool spools_entries() override;
+
   private:
     OoniReporter(Settings, SharedPtr<Reactor>, SharedPtr<Logger>);
 
@@ -29,6 +44,15 @@ class OoniReporter : public BaseReporter {
     SharedPtr<Logger> logger;
     Settings settings; // Our private copy of the ooni_test settings
     std::string report_id;
+    SharedPtr<ooni::collector::Session> session;
+    SharedPtr<Spool> spool;          // Only set when spooling entries
+    SharedPtr<SpoolUploader> uploader;
+    std::string spool_key;
+    bool creating = false;          // Creating the report in background
+    Error create_error;
+    std::list<Callback<>> after_create;
+
+    void update_report(SerializedEntry entry, Callback<Error> cb);
 };
 
 } // namespace report
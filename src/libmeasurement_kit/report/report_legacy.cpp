@@ -20,6 +20,15 @@ void ReportLegacy::add_reporter(SharedPtr<BaseReporter> reporter) {
     reporters_.push_back(reporter);
 }
 
+bool ReportLegacy::spools_entries() const {
+    for (auto &reporter : reporters_) {
+        if (reporter->spools_entries()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void ReportLegacy::fill_entry(nlohmann::json &entry) const {
     entry["test_name"] = test_name;
     entry["test_version"] = test_version;
@@ -54,19 +63,33 @@ void ReportLegacy::open(Callback<Error> callback) {
     }), callback);
 }
 
-void ReportLegacy::write_entry(nlohmann::json entry, Callback<Error> callback,
+void ReportLegacy::write_entry(SerializedEntry entry, Callback<Error> callback,
                          SharedPtr<Logger>) {
     mk::parallel(FMAP(reporters_, [=](SharedPtr<BaseReporter> r) {
         return r->write_entry(entry);
     }), callback);
 }
 
+void ReportLegacy::write_entry(nlohmann::json entry, Callback<Error> callback,
+                         SharedPtr<Logger> logger) {
+    write_entry(SerializedEntry::make(std::move(entry)), std::move(callback),
+                std::move(logger));
+}
+
 void ReportLegacy::close(Callback<Error> callback) {
     mk::parallel(FMAP(reporters_, [](SharedPtr<BaseReporter> r) {
         return r->close();
     }), callback);
 }
 
+void ReportLegacy::wait_for_open(Callback<> callback) {
+    mk::parallel(FMAP(reporters_, [](SharedPtr<BaseReporter> r) {
+        return [r](Callback<Error> cb) {
+            r->wait_for_open([cb]() { cb(NoError()); });
+        };
+    }), [callback](Error) { callback(); });
+}
+
 #undef FMAP // So long, and thanks for the fish
 
 } // namespace report
@@ -10,6 +10,7 @@
 
 #include "src/libmeasurement_kit/common/logger.hpp"
 #include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
 
 namespace mk {
 namespace report {
@@ -45,10 +46,20 @@ class ReportLegacy {
 
     void open(Callback<Error> callback);
 
+    void write_entry(SerializedEntry entry, Callback<Error> callback, SharedPtr<Logger> logger);
+
+    // Convenience overload that serializes the entry for you
     void write_entry(nlohmann::json entry, Callback<Error> callback, SharedPtr<Logger> logger);
 
     void close(Callback<Error> callback);
 
+    // Calls back once all reporters have completed opening, so that
+    // `report_id` is set, if possible, also when opening in background
+    void wait_for_open(Callback<> callback);
+
+    // Whether any reporter saves entries to submit them later
+    bool spools_entries() const;
+
   private:
     std::vector<SharedPtr<BaseReporter>> reporters_;
 };
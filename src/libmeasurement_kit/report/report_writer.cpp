@@ -0,0 +1,324 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/report/error.hpp"
+#include "src/libmeasurement_kit/report/report_writer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mk {
+namespace report {
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+    return s.size() >= suffix.size() &&
+           s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static Error io_error_if(bool failed) {
+    if (failed) {
+        return ReportIoError();
+    }
+    return NoError();
+}
+
+static Error sync_fd(int fd) {
+#ifdef _WIN32
+    return io_error_if(_commit(fd) != 0);
+#else
+    return io_error_if(fsync(fd) != 0);
+#endif
+}
+
+class PlainSink : public ReportSink {
+  public:
+    explicit PlainSink(FILE *filep) : filep_{filep} {
+        // We already buffer in ReportWriter, so stdio buffering is redundant
+        (void)setvbuf(filep_, nullptr, _IONBF, 0);
+    }
+
+    Error write(const std::string &data) override {
+        if (fwrite(data.data(), 1, data.size(), filep_) != data.size()) {
+            return ReportIoError();
+        }
+        return NoError();
+    }
+
+    Error flush() override {
+        return io_error_if(fflush(filep_) != 0);
+    }
+
+    Error sync() override {
+        Error err = flush();
+        return (err) ? err : sync_fd(fileno(filep_));
+    }
+
+    Error finish() override { return flush(); }
+
+    Error close() override {
+        FILE *filep = filep_;
+        filep_ = nullptr;
+        return io_error_if(fclose(filep) != 0);
+    }
+
+    ~PlainSink() override {
+        if (filep_ != nullptr) {
+            (void)fclose(filep_);
+        }
+    }
+
+  private:
+    FILE *filep_ = nullptr;
+};
+
+#ifndef MK_WITHOUT_ZLIB
+
+class GzipSink : public ReportSink {
+  public:
+    GzipSink(gzFile gzfp, FILE *filep) : gzfp_{gzfp}, filep_{filep} {}
+
+    Error write(const std::string &data) override {
+        // Note: gzwrite() takes an unsigned, hence the loop
+        size_t off = 0;
+        while (off < data.size()) {
+            unsigned count = (unsigned)std::min<size_t>(data.size() - off,
+                                                        1 << 30);
+            if (gzwrite(gzfp_, data.data() + off, count) != (int)count) {
+                return ReportIoError();
+            }
+            off += count;
+        }
+        return NoError();
+    }
+
+    Error flush() override {
+        return io_error_if(gzflush(gzfp_, Z_SYNC_FLUSH) != Z_OK);
+    }
+
+    Error sync() override {
+        Error err = flush();
+        return (err) ? err : sync_fd(fileno(filep_));
+    }
+
+    // Writes the final block and the trailer, after which gzclose() has
+    // nothing left to write, so that sync() makes the whole file durable
+    Error finish() override {
+        return io_error_if(gzflush(gzfp_, Z_FINISH) != Z_OK);
+    }
+
+    Error close() override {
+        gzFile gzfp = gzfp_;
+        FILE *filep = filep_;
+        gzfp_ = nullptr;
+        filep_ = nullptr;
+        int rv = gzclose(gzfp);
+        return io_error_if(fclose(filep) != 0 || rv != Z_OK);
+    }
+
+    ~GzipSink() override {
+        if (gzfp_ != nullptr) {
+            (void)gzclose(gzfp_);
+            (void)fclose(filep_);
+        }
+    }
+
+  private:
+    gzFile gzfp_ = nullptr;
+    FILE *filep_ = nullptr; // Used for fsync; gzfp_ writes a dup()ed fd
+};
+
+#endif // MK_WITHOUT_ZLIB
+
+Error open_report_sink(const std::string &path,
+                       std::unique_ptr<ReportSink> *sink) {
+    if (ends_with(path, ".zst")) {
+        return NotImplementedError(); // Rather than writing plain text
+    }
+    FILE *filep = fopen(path.c_str(), "wb");
+    if (filep == nullptr) {
+        return ReportIoError();
+    }
+    if (ends_with(path, ".gz")) {
+#ifndef MK_WITHOUT_ZLIB
+        int fd = dup(fileno(filep));
+        gzFile gzfp = (fd != -1) ? gzdopen(fd, "wb") : nullptr;
+        if (gzfp == nullptr) {
+            if (fd != -1) {
+                (void)::close(fd);
+            }
+            (void)fclose(filep);
+            return ReportIoError();
+        }
+        sink->reset(new GzipSink{gzfp, filep});
+#else
+        (void)fclose(filep);
+        return NotImplementedError();
+#endif
+    } else {
+        sink->reset(new PlainSink{filep});
+    }
+    return NoError();
+}
+
+/* static */ SharedPtr<ReportWriter> ReportWriter::make(std::string path,
+                                                        Settings settings) {
+    return SharedPtr<ReportWriter>{
+          new ReportWriter{std::move(path), std::move(settings)}};
+}
+
+ReportWriter::ReportWriter(std::string path, Settings settings)
+    : path_{std::move(path)} {
+    buffer_size_ = settings.get("report/buffer_size", buffer_size_);
+    flush_interval_ = settings.get("report/flush_interval", flush_interval_);
+    fsync_policy_ = settings.get("report/fsync", fsync_policy_);
+}
+
+Error ReportWriter::open() {
+    if (!!sink_) {
+        return ReportAlreadyOpenError();
+    }
+    if (fsync_policy_ != "never" && fsync_policy_ != "close" &&
+        fsync_policy_ != "always") {
+        return ValueError();
+    }
+    Error err = open_report_sink(path_, &sink_);
+    if (err) {
+        return err;
+    }
+    thread_ = std::thread{[this]() { loop(); }};
+    return NoError();
+}
+
+Error ReportWriter::write_line(const std::string &line) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (!sink_ || stop_) {
+        return ReportNotOpenError();
+    }
+    if (error_) {
+        return error_;
+    }
+    pending_.append(line);
+    pending_.append("\n");
+    if (pending_.size() >= buffer_size_ || flush_interval_ <= 0.0) {
+        cond_.notify_one();
+    }
+    return NoError();
+}
+
+void ReportWriter::loop() {
+    auto interval = std::chrono::duration<double>{flush_interval_};
+    // A nonpositive interval means that we flush after every line, so we
+    // just wait for lines; otherwise wait_for() would return immediately
+    bool every_line = (flush_interval_ <= 0.0);
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+        bool full = false;
+        if (every_line) {
+            cond_.wait(lock, [this]() { return stop_ || !pending_.empty(); });
+        } else {
+            full = cond_.wait_for(lock, interval, [this]() {
+                return stop_ || pending_.size() >= buffer_size_;
+            });
+        }
+        std::string chunk;
+        std::swap(chunk, pending_);
+        bool stop = stop_;
+        lock.unlock();
+        Error err = NoError();
+        if (!chunk.empty()) {
+            err = sink_->write(chunk);
+        }
+        // Flush when idle or closing; a full buffer means more is coming
+        if (!err && fsync_policy_ == "always" && !chunk.empty()) {
+            err = sink_->sync();
+        } else if (!err && (!full || stop)) {
+            err = sink_->flush();
+        }
+        if (stop) {
+            // Closing here, so that the caller does not block on disk I/O
+            Error close_err = close_sink();
+            lock.lock();
+            if (!error_) {
+                error_ = (err) ? err : close_err;
+            }
+            return;
+        }
+        lock.lock();
+        if (err && !error_) {
+            error_ = err;
+        }
+    }
+}
+
+Error ReportWriter::close_sink() {
+    Error err = sink_->finish();
+    if (!err && fsync_policy_ != "never") {
+        err = sink_->sync();
+    }
+    Error close_err = sink_->close();
+    return (err) ? err : close_err;
+}
+
+Error ReportWriter::begin_close() {
+    if (!sink_) {
+        return ReportNotOpenError();
+    }
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (stop_) {
+        return ReportAlreadyClosedError();
+    }
+    stop_ = true;
+    cond_.notify_one();
+    return NoError();
+}
+
+void ReportWriter::close(SharedPtr<Reactor> reactor, SharedPtr<Logger> logger,
+                         Callback<Error> cb) {
+    Error err = begin_close();
+    if (err) {
+        reactor->call_soon([=]() { cb(err); });
+        return;
+    }
+    // We wait for the thread using a reactor background thread, because
+    // the reactor does not exit while any of them is running
+    reactor->call_in_thread(logger, [=]() {
+        thread_.join();
+        Error err = NoError();
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            err = error_;
+        }
+        reactor->call_soon([=]() { cb(err); });
+    });
+}
+
+Error ReportWriter::close() {
+    Error err = begin_close();
+    if (err) {
+        return err;
+    }
+    thread_.join();
+    std::unique_lock<std::mutex> lock{mutex_};
+    return error_;
+}
+
+ReportWriter::~ReportWriter() {
+    if (thread_.joinable()) {
+        (void)close();
+    }
+}
+
+} // namespace report
+} // namespace mk
@@ -0,0 +1,108 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_REPORT_WRITER_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_REPORT_WRITER_HPP
+
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+#include <measurement_kit/common/shared_ptr.hpp>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace mk {
+namespace report {
+
+/// `ReportSink` is where ReportWriter writes data. Only the background
+/// thread uses it once the file has been opened, hence no locking.
+class ReportSink {
+  public:
+    virtual Error write(const std::string &data) = 0;
+    virtual Error flush() = 0;
+
+    /// `sync()` flushes and asks the OS to commit the file to disk.
+    virtual Error sync() = 0;
+
+    /// `finish()` writes all the data that close() would write, e.g. the
+    /// gzip trailer, so that sync() afterwards makes the whole file durable.
+    virtual Error finish() = 0;
+
+    virtual Error close() = 0;
+    virtual ~ReportSink() {}
+};
+
+/// `open_report_sink()` opens the sink for \p path, which is compressed
+/// when \p path ends in `.gz`, and stores it into \p sink.
+Error open_report_sink(const std::string &path,
+                       std::unique_ptr<ReportSink> *sink);
+
+/// `ReportWriter` writes report lines using a background thread, so that
+/// the reactor never blocks on disk I/O. Lines are buffered and handed to
+/// the thread when the buffer is full, periodically, and when closing. The
+/// output is gzip compressed when the path ends in `.gz`, while paths
+/// ending in `.zst` are not supported.
+///
+/// Settings:
+///
+/// - `report/buffer_size` (int): bytes to buffer before waking up the
+///   background thread (default: 65536);
+///
+/// - `report/flush_interval` (double): seconds after which buffered data
+///   is written and flushed anyway (default: 1.0). Zero or less means
+///   that each line is written and flushed as soon as possible;
+///
+/// - `report/fsync` (string): `"never"` (default), `"close"` to fsync the
+///   file when closing it, or `"always"` to fsync after each write. Other
+///   values cause open() to fail with ValueError.
+class ReportWriter : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<ReportWriter> make(std::string path, Settings settings);
+
+    /// `open()` opens the file and starts the background thread.
+    Error open();
+
+    /// `write_line()` appends \p line and a newline to the buffer. Errors
+    /// occurred in the background are reported by the next call.
+    Error write_line(const std::string &line);
+
+    /// `close()` tells the background thread to write buffered data and
+    /// to close the file, and calls \p cb from the \p reactor thread once
+    /// it is done, so that the reactor does not block on disk I/O. You must
+    /// keep the writer alive until \p cb is called.
+    void close(SharedPtr<Reactor> reactor, SharedPtr<Logger> logger,
+               Callback<Error> cb);
+
+    /// `close()` is like the above but blocks until the file is closed.
+    Error close();
+
+    ~ReportWriter();
+
+  private:
+    ReportWriter(std::string path, Settings settings);
+    Error begin_close();
+    void loop();
+    Error close_sink();
+
+    std::string path_;
+    size_t buffer_size_ = 65536;
+    double flush_interval_ = 1.0;
+    std::string fsync_policy_ = "never";
+
+    std::unique_ptr<ReportSink> sink_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::string pending_;   // Protected by mutex_
+    Error error_;           // Ditto
+    bool stop_ = false;     // Ditto
+};
+
+} // namespace report
+} // namespace mk
+#endif
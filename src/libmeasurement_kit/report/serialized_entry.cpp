@@ -0,0 +1,38 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
+
+#include <functional>
+
+namespace mk {
+namespace report {
+
+/* static */ SerializedEntry SerializedEntry::make(nlohmann::json &&entry) {
+    std::string bytes = entry.dump();
+    return SerializedEntry{std::move(bytes), std::move(entry)};
+}
+
+/* static */ SerializedEntry
+SerializedEntry::make(const nlohmann::json &entry) {
+    return SerializedEntry{entry.dump(), entry};
+}
+
+SerializedEntry::SerializedEntry(std::string bytes, nlohmann::json entry) {
+    hash_ = std::hash<std::string>{}(bytes);
+    bytes_ = SharedPtr<const std::string>{
+          std::make_shared<const std::string>(std::move(bytes))};
+    entry_ = SharedPtr<const nlohmann::json>{
+          std::make_shared<const nlohmann::json>(std::move(entry))};
+}
+
+SerializedEntry::SerializedEntry() : SerializedEntry{"null", nullptr} {}
+
+bool SerializedEntry::operator==(const SerializedEntry &other) const {
+    return hash_ == other.hash_ &&
+           (bytes_.get() == other.bytes_.get() || *bytes_ == *other.bytes_);
+}
+
+} // namespace report
+} // namespace mk
@@ -0,0 +1,58 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_SERIALIZED_ENTRY_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_SERIALIZED_ENTRY_HPP
+
+#include <measurement_kit/common/nlohmann/json.hpp>
+#include <measurement_kit/common/shared_ptr.hpp>
+
+#include <string>
+
+namespace mk {
+namespace report {
+
+/// `SerializedEntry` is an immutable measurement entry that has been
+/// serialized exactly once. Copies are cheap because the JSON document,
+/// its serialization and the hash of the latter are shared, hence it can
+/// be passed around to all the consumers of a measurement.
+class SerializedEntry {
+  public:
+    /// `make()` serializes \p entry. It throws if \p entry cannot be
+    /// serialized, e.g. because it contains invalid UTF-8, in which case
+    /// \p entry is not moved and may be fixed and serialized again.
+    static SerializedEntry make(nlohmann::json &&entry);
+
+    static SerializedEntry make(const nlohmann::json &entry);
+
+    /// Constructs from \p entry and its serialization \p bytes, which is
+    /// useful when the entry has been read from a report file.
+    SerializedEntry(std::string bytes, nlohmann::json entry);
+
+    /// Constructs an empty entry serialized as `null`.
+    SerializedEntry();
+
+    /// `str()` returns the serialization, without trailing newline.
+    const std::string &str() const { return *bytes_; }
+
+    /// `json()` returns the JSON document that was serialized.
+    const nlohmann::json &json() const { return *entry_; }
+
+    /// `hash()` returns the hash of the serialization.
+    size_t hash() const { return hash_; }
+
+    bool operator==(const SerializedEntry &other) const;
+
+    bool operator!=(const SerializedEntry &other) const {
+        return !(*this == other);
+    }
+
+  private:
+    SharedPtr<const std::string> bytes_;
+    SharedPtr<const nlohmann::json> entry_;
+    size_t hash_ = 0;
+};
+
+} // namespace report
+} // namespace mk
+#endif
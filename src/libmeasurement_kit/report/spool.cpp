@@ -0,0 +1,516 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/report/error.hpp"
+#include "src/libmeasurement_kit/report/spool.hpp"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include <sstream>
+
+namespace mk {
+namespace report {
+
+// FNV-1a: we only need to detect records torn by a crash.
+static uint64_t checksum(const char *base, size_t count) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < count; ++i) {
+        hash ^= (unsigned char)base[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool valid_token(const std::string &s) {
+    return !s.empty() && s.find_first_of(" \r\n") == std::string::npos;
+}
+
+static bool parse_u64(const std::string &s, uint64_t *value) {
+    if (s.empty() || s.size() > 20) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        uint64_t d = (uint64_t)(c - '0');
+        if (v > (UINT64_MAX - d) / 10) {
+            return false; // Would overflow
+        }
+        v = v * 10 + d;
+    }
+    *value = v;
+    return true;
+}
+
+static bool parse_hex64(const std::string &s, uint64_t *value) {
+    if (s.size() != 16) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (char c : s) {
+        if (c >= '0' && c <= '9') {
+            v = (v << 4) | (uint64_t)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            v = (v << 4) | (uint64_t)(c - 'a' + 10);
+        } else {
+            return false;
+        }
+    }
+    *value = v;
+    return true;
+}
+
+static bool read_file(const std::string &path, uint64_t offset,
+                      std::string *data) {
+    FILE *filep = fopen(path.c_str(), "rb");
+    if (filep == nullptr) {
+        return false;
+    }
+    bool okay = fseek(filep, (long)offset, SEEK_SET) == 0;
+    char buffer[65536];
+    size_t count;
+    while (okay && (count = fread(buffer, 1, sizeof(buffer), filep)) > 0) {
+        data->append(buffer, count);
+    }
+    okay = okay && !ferror(filep);
+    (void)fclose(filep);
+    return okay;
+}
+
+static bool file_exists(const std::string &path) {
+    struct stat sb{};
+    return stat(path.c_str(), &sb) == 0;
+}
+
+static bool truncate_file(const std::string &path, uint64_t size) {
+#ifdef _WIN32
+    int fd = ::_open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd == -1) {
+        return false;
+    }
+    bool okay = _chsize_s(fd, (__int64)size) == 0;
+    (void)::_close(fd);
+    return okay;
+#else
+    return ::truncate(path.c_str(), (off_t)size) == 0;
+#endif
+}
+
+static bool sync_file(FILE *filep) {
+#ifdef _WIN32
+    return _commit(_fileno(filep)) == 0;
+#else
+    return fsync(fileno(filep)) == 0;
+#endif
+}
+
+/* static */ ErrorOr<SharedPtr<Spool>> Spool::open(std::string dirpath,
+                                                   Settings settings,
+                                                   SharedPtr<Logger> logger) {
+    SharedPtr<Spool> spool{new Spool{dirpath, settings, logger}};
+#ifdef _WIN32
+    (void)_mkdir(dirpath.c_str());
+#else
+    (void)mkdir(dirpath.c_str(), 0700);
+#endif
+    Error err = spool->lock();
+    if (!err) {
+        err = spool->recover();
+    }
+    if (err) {
+        logger->warn("spool: cannot open %s: %s", dirpath.c_str(), err.what());
+        return {err, {}};
+    }
+    return {NoError(), spool};
+}
+
+Spool::Spool(std::string dirpath, Settings settings, SharedPtr<Logger> logger)
+    : dirpath_{std::move(dirpath)}, logger_{std::move(logger)} {
+    segment_size_ = settings.get("collector/spool_segment_size", segment_size_);
+    fsync_ = settings.get("collector/spool_fsync", std::string{"never"}) ==
+             "always";
+}
+
+Spool::~Spool() {
+    if (filep_ != nullptr) {
+        (void)fclose(filep_);
+    }
+    if (lock_fd_ != -1) {
+#ifdef _WIN32
+        (void)::_close(lock_fd_);
+#else
+        (void)::close(lock_fd_); // Also releases the lock
+#endif
+    }
+}
+
+Error Spool::lock() {
+    std::string path = dirpath_ + "/lock";
+#ifdef _WIN32
+    // Note: we do not lock on Windows; there, the caller must make sure
+    // that a single process at a time uses a spool directory.
+    lock_fd_ = ::_open(path.c_str(), _O_CREAT | _O_RDWR, _S_IREAD | _S_IWRITE);
+    if (lock_fd_ == -1) {
+        return ReportIoError();
+    }
+#else
+    lock_fd_ = ::open(path.c_str(), O_CREAT | O_RDWR, 0600);
+    if (lock_fd_ == -1) {
+        return ReportIoError();
+    }
+    if (flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+        return SpoolLockedError();
+    }
+#endif
+    return NoError();
+}
+
+std::string Spool::segment_path(uint64_t segment) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%010" PRIu64 ".seg", segment);
+    return dirpath_ + name;
+}
+
+Error Spool::recover() {
+    Position cursor;
+    std::string index;
+    if (read_file(dirpath_ + "/index", 0, &index)) {
+        std::istringstream ss{index};
+        std::string segment, offset, next_seq;
+        if (!(ss >> segment >> offset >> next_seq) ||
+            !parse_u64(segment, &cursor.segment) ||
+            !parse_u64(offset, &cursor.offset) ||
+            !parse_u64(next_seq, &next_seq_)) {
+            logger_->warn("spool: invalid index; replaying all segments");
+            cursor = Position{};
+            next_seq_ = 1;
+        }
+    }
+    first_segment_ = cursor.segment;
+    end_ = Position{cursor.segment, 0};
+    for (uint64_t segment = cursor.segment;; ++segment) {
+        std::string path = segment_path(segment);
+        if (!file_exists(path)) {
+            break;
+        }
+        bool last = !file_exists(segment_path(segment + 1));
+        uint64_t offset = (segment == cursor.segment) ? cursor.offset : 0;
+        Error err = replay(segment, offset, last);
+        if (err) {
+            return err;
+        }
+    }
+    // Whoever was writing these reports is gone, hence they are complete
+    for (auto &kv : reports_) {
+        kv.second.closing = true;
+    }
+    logger_->debug("spool: %zu entries and %zu reports to submit",
+                   entries_.size(), reports_.size());
+    filep_ = fopen(segment_path(end_.segment).c_str(), "ab");
+    if (filep_ == nullptr) {
+        return ReportIoError();
+    }
+    return write_index();
+}
+
+Error Spool::replay(uint64_t segment, uint64_t offset, bool last) {
+    std::string path = segment_path(segment);
+    std::string data;
+    if (!read_file(path, offset, &data)) {
+        return ReportIoError();
+    }
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t eol = data.find('\n', pos);
+        if (eol == std::string::npos) {
+            break;
+        }
+        std::istringstream ss{data.substr(pos, eol - pos)};
+        std::string type, first, second, length, sum, extra;
+        ss >> type >> first >> second >> length >> sum >> extra;
+        Position position{segment, offset + pos};
+        uint64_t seq = 0, size = 0, expect = 0;
+        if (type == "E" && parse_u64(first, &seq) && valid_token(second) &&
+            parse_u64(length, &size) && size < data.size() - eol - 1 &&
+            data[eol + 1 + size] == '\n' && extra.empty() &&
+            parse_hex64(sum, &expect) &&
+            checksum(data.data() + eol + 1, size) == expect) {
+            EntryInfo &info = entries_[seq];
+            info.key = second;
+            info.payload = Position{segment, offset + eol + 1};
+            info.length = size;
+            (void)process_record('E', second, seq, "", position);
+            pos = eol + 1 + size + 1;
+        } else if (type == "A" && parse_u64(first, &seq) && second.empty()) {
+            (void)process_record('A', "", seq, "", position);
+            pos = eol + 1;
+        } else if (type == "R" && valid_token(first) && valid_token(second) &&
+                   length.empty()) {
+            (void)process_record('R', first, 0, second, position);
+            pos = eol + 1;
+        } else if ((type == "C" || type == "X") && valid_token(first) &&
+                   second.empty()) {
+            (void)process_record(type[0], first, 0, "", position);
+            pos = eol + 1;
+        } else {
+            break;
+        }
+    }
+    if (pos < data.size()) {
+        if (!last) {
+            logger_->warn("spool: skipping corrupt data in %s", path.c_str());
+            return NoError();
+        }
+        // Most likely a record torn by a crash while we were writing it
+        logger_->warn("spool: discarding torn record in %s", path.c_str());
+        if (!truncate_file(path, offset + pos)) {
+            return ReportIoError();
+        }
+    }
+    end_ = Position{segment, offset + pos};
+    return NoError();
+}
+
+// Updates the in-memory state; used when replaying and when writing.
+Error Spool::process_record(char type, const std::string &key, uint64_t seq,
+                            const std::string &value, Position position) {
+    switch (type) {
+    case 'E': {
+        if (seq >= next_seq_) {
+            next_seq_ = seq + 1;
+        }
+        if (reports_.count(key) == 0) {
+            first_record_[key] = position;
+        }
+        Report &report = reports_[key];
+        report.pending += 1;
+        if (report.first_seq == 0) {
+            report.first_seq = seq;
+        }
+        return NoError();
+    }
+    case 'A': {
+        auto it = entries_.find(seq);
+        if (it == entries_.end()) {
+            return SpoolEntryNotFoundError();
+        }
+        auto report = reports_.find(it->second.key);
+        if (report != reports_.end() && report->second.pending > 0) {
+            report->second.pending -= 1;
+        }
+        entries_.erase(it);
+        return NoError();
+    }
+    case 'R':
+        if (reports_.count(key) == 0) {
+            first_record_[key] = position;
+        }
+        reports_[key].report_id = value;
+        return NoError();
+    case 'C': {
+        auto it = reports_.find(key);
+        if (it != reports_.end()) {
+            it->second.closing = true;
+        }
+        return NoError();
+    }
+    case 'X':
+        reports_.erase(key);
+        first_record_.erase(key);
+        return NoError();
+    }
+    return ReportLogicalError();
+}
+
+Error Spool::write_record(const std::string &header, const std::string *payload,
+                          Position *position) {
+    if (error_) {
+        return error_;
+    }
+    if (end_.offset >= segment_size_) {
+        FILE *filep = fopen(segment_path(end_.segment + 1).c_str(), "ab");
+        if (filep == nullptr) {
+            return ReportIoError();
+        }
+        (void)fclose(filep_);
+        filep_ = filep;
+        end_ = Position{end_.segment + 1, 0};
+    }
+    std::string record = header;
+    record += "\n";
+    if (payload != nullptr) {
+        record += *payload;
+        record += "\n";
+    }
+    if (fwrite(record.data(), 1, record.size(), filep_) != record.size() ||
+        fflush(filep_) != 0 || (fsync_ && !sync_file(filep_))) {
+        // We cannot know what reached the disk, so stop writing
+        logger_->warn("spool: cannot write into %s", dirpath_.c_str());
+        error_ = ReportIoError();
+        return error_;
+    }
+    *position = end_;
+    end_.offset += record.size();
+    return NoError();
+}
+
+Error Spool::write_index() {
+    // The oldest record we need is the first record of the oldest report
+    Position cursor = end_;
+    for (auto &kv : first_record_) {
+        const Position &p = kv.second;
+        if (p.segment < cursor.segment ||
+            (p.segment == cursor.segment && p.offset < cursor.offset)) {
+            cursor = p;
+        }
+    }
+    std::string path = dirpath_ + "/index";
+    std::string temp = path + ".tmp";
+    FILE *filep = fopen(temp.c_str(), "wb");
+    if (filep == nullptr) {
+        return ReportIoError();
+    }
+    bool okay = fprintf(filep, "%" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+                        cursor.segment, cursor.offset, next_seq_) > 0 &&
+                fflush(filep) == 0 && (!fsync_ || sync_file(filep));
+    okay = (fclose(filep) == 0) && okay;
+#ifdef _WIN32
+    (void)remove(path.c_str()); // rename() does not replace on Windows
+#endif
+    if (!okay || rename(temp.c_str(), path.c_str()) != 0) {
+        return ReportIoError();
+    }
+    // Segments before the cursor are not needed anymore
+    for (; first_segment_ < cursor.segment; ++first_segment_) {
+        (void)remove(segment_path(first_segment_).c_str());
+    }
+    return NoError();
+}
+
+ErrorOr<uint64_t> Spool::append(const std::string &key,
+                                const SerializedEntry &entry) {
+    if (!valid_token(key)) {
+        return {ReportLogicalError(), 0};
+    }
+    uint64_t seq = next_seq_;
+    const std::string &bytes = entry.str();
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), " %zu %016" PRIx64, bytes.size(),
+             checksum(bytes.data(), bytes.size()));
+    std::string header = "E " + std::to_string(seq) + " " + key + suffix;
+    Position position;
+    Error err = write_record(header, &bytes, &position);
+    if (err) {
+        return {err, 0};
+    }
+    EntryInfo &info = entries_[seq];
+    info.key = key;
+    info.payload = Position{position.segment,
+                            position.offset + header.size() + 1};
+    info.length = bytes.size();
+    (void)process_record('E', key, seq, "", position);
+    return {NoError(), seq};
+}
+
+Error Spool::set_report_id(const std::string &key,
+                           const std::string &report_id) {
+    if (!valid_token(key) || !valid_token(report_id)) {
+        return ReportLogicalError();
+    }
+    Position position;
+    Error err = write_record("R " + key + " " + report_id, nullptr, &position);
+    if (err) {
+        return err;
+    }
+    return process_record('R', key, 0, report_id, position);
+}
+
+Error Spool::close_report(const std::string &key) {
+    if (reports_.count(key) == 0) {
+        return NoError(); // Nothing was spooled for this report
+    }
+    Position position;
+    Error err = write_record("C " + key, nullptr, &position);
+    if (err) {
+        return err;
+    }
+    return process_record('C', key, 0, "", position);
+}
+
+Error Spool::ack(uint64_t seq) {
+    if (entries_.count(seq) == 0) {
+        return SpoolEntryNotFoundError();
+    }
+    Position position;
+    Error err = write_record("A " + std::to_string(seq), nullptr, &position);
+    if (err) {
+        return err;
+    }
+    return process_record('A', "", seq, "", position);
+}
+
+Error Spool::report_closed(const std::string &key) {
+    if (reports_.count(key) == 0) {
+        return SpoolEntryNotFoundError();
+    }
+    Position position;
+    Error err = write_record("X " + key, nullptr, &position);
+    if (err) {
+        return err;
+    }
+    (void)process_record('X', key, 0, "", position);
+    return write_index();
+}
+
+ErrorOr<Spool::Entry> Spool::next_entry(uint64_t seq) const {
+    auto it = entries_.upper_bound(seq);
+    if (it == entries_.end()) {
+        return {SpoolEntryNotFoundError(), {}};
+    }
+    Entry entry;
+    entry.seq = it->first;
+    entry.key = it->second.key;
+    return {NoError(), entry};
+}
+
+ErrorOr<SerializedEntry> Spool::read_entry(uint64_t seq) {
+    auto it = entries_.find(seq);
+    if (it == entries_.end()) {
+        return {SpoolEntryNotFoundError(), {}};
+    }
+    const EntryInfo &info = it->second;
+    FILE *filep = fopen(segment_path(info.payload.segment).c_str(), "rb");
+    if (filep == nullptr) {
+        return {ReportIoError(), {}};
+    }
+    std::string bytes(info.length, '\0');
+    bool okay = fseek(filep, (long)info.payload.offset, SEEK_SET) == 0 &&
+                fread(&bytes[0], 1, bytes.size(), filep) == bytes.size();
+    (void)fclose(filep);
+    if (!okay) {
+        return {ReportIoError(), {}};
+    }
+    nlohmann::json doc;
+    try {
+        doc = nlohmann::json::parse(bytes);
+    } catch (const std::exception &) {
+        return {JsonProcessingError(), {}};
+    }
+    return {NoError(), SerializedEntry{std::move(bytes), std::move(doc)}};
+}
+
+} // namespace report
+} // namespace mk
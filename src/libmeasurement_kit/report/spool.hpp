@@ -0,0 +1,138 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_HPP
+
+#include "src/libmeasurement_kit/common/error_or.hpp"
+#include "src/libmeasurement_kit/common/logger.hpp"
+#include "src/libmeasurement_kit/common/non_copyable.hpp"
+#include "src/libmeasurement_kit/common/non_movable.hpp"
+#include "src/libmeasurement_kit/common/settings.hpp"
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+
+namespace mk {
+namespace report {
+
+/*
+    The spool is a directory containing the measurements that still need
+    to be submitted to the collector, so that they survive crashes and
+    restarts. Measurements are grouped into reports identified by a local
+    key, which is mapped to the collector's report ID once we know it.
+
+    Data is stored in append-only segment files (`<number>.seg`) holding
+    the following records, where entries carry a checksum so that records
+    torn by a crash are detected and discarded when reopening:
+
+        E <seq> <key> <length> <checksum>\n<length bytes>\n   (entry)
+        A <seq>\n                                             (submitted)
+        R <key> <report_id>\n                                 (report ID)
+        C <key>\n                       (no more entries for this report)
+        X <key>\n                          (report closed at collector)
+
+    The `index` file stores the position of the oldest record that we
+    still need, so reopening only reads what was not submitted yet. Older
+    segments are removed. A lock file prevents concurrent use.
+
+    Settings: `collector/spool_segment_size` (bytes after which we start a
+    new segment, default 4 MiB) and `collector/spool_fsync` (`"always"` to
+    fsync after each record, default `"never"`).
+*/
+class Spool : public NonCopyable, public NonMovable {
+  public:
+    class Entry {
+      public:
+        uint64_t seq = 0;
+        std::string key;
+    };
+
+    class Report {
+      public:
+        std::string report_id; // Empty until the report is created
+        bool closing = false;  // No more entries will be added
+        size_t pending = 0;    // Number of entries not yet submitted
+        uint64_t first_seq = 0;
+    };
+
+    static ErrorOr<SharedPtr<Spool>> open(std::string dirpath,
+                                          Settings settings,
+                                          SharedPtr<Logger> logger);
+
+    /// `append()` stores \p entry for the report identified by \p key.
+    ErrorOr<uint64_t> append(const std::string &key,
+                             const SerializedEntry &entry);
+
+    Error set_report_id(const std::string &key, const std::string &report_id);
+
+    /// `close_report()` records that no more entries will be appended.
+    Error close_report(const std::string &key);
+
+    /// `ack()` records that the entry with \p seq was submitted.
+    Error ack(uint64_t seq);
+
+    /// `report_closed()` records that the report was closed at the
+    /// collector, thus allowing us to forget about it.
+    Error report_closed(const std::string &key);
+
+    /// `next_entry()` returns the first pending entry after \p seq.
+    ErrorOr<Entry> next_entry(uint64_t seq) const;
+
+    ErrorOr<SerializedEntry> read_entry(uint64_t seq);
+
+    const std::map<std::string, Report> &reports() const { return reports_; }
+
+    size_t pending() const { return entries_.size(); }
+
+    ~Spool();
+
+  private:
+    class Position {
+      public:
+        uint64_t segment = 0;
+        uint64_t offset = 0;
+    };
+
+    class EntryInfo {
+      public:
+        std::string key;
+        Position payload;
+        size_t length = 0;
+    };
+
+    Spool(std::string dirpath, Settings settings, SharedPtr<Logger> logger);
+    Error lock();
+    Error recover();
+    Error replay(uint64_t segment, uint64_t offset, bool last);
+    Error process_record(char type, const std::string &key, uint64_t seq,
+                         const std::string &value, Position position);
+    Error write_record(const std::string &header, const std::string *payload,
+                       Position *position);
+    Error write_index();
+    std::string segment_path(uint64_t segment) const;
+
+    std::string dirpath_;
+    uint64_t segment_size_ = 4 * 1024 * 1024;
+    bool fsync_ = false;
+    SharedPtr<Logger> logger_;
+
+    int lock_fd_ = -1;
+    FILE *filep_ = nullptr;
+    Position end_;           // Where the next record will be written
+    uint64_t first_segment_ = 0;
+    uint64_t next_seq_ = 1;
+    Error error_;            // Sticky error caused by a failed write
+
+    std::map<uint64_t, EntryInfo> entries_;
+    std::map<std::string, Report> reports_;
+    std::map<std::string, Position> first_record_;
+};
+
+} // namespace report
+} // namespace mk
+#endif
@@ -0,0 +1,21 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "src/libmeasurement_kit/report/spool_uploader_impl.hpp"
+
+namespace mk {
+namespace report {
+
+/* static */ SharedPtr<SpoolUploader> SpoolUploader::make(
+      SharedPtr<Spool> spool, Settings settings, SharedPtr<Reactor> reactor,
+      SharedPtr<Logger> logger) {
+    return SharedPtr<SpoolUploader>{std::make_shared<SpoolUploaderImpl<>>(
+          std::move(spool), std::move(settings), std::move(reactor),
+          std::move(logger))};
+}
+
+SpoolUploader::~SpoolUploader() {}
+
+} // namespace report
+} // namespace mk
@@ -0,0 +1,38 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_UPLOADER_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_UPLOADER_HPP
+
+#include "src/libmeasurement_kit/common/reactor.hpp"
+#include "src/libmeasurement_kit/report/spool.hpp"
+
+namespace mk {
+namespace report {
+
+/*
+    The spool uploader submits the entries stored in a spool in background,
+    creating and closing the corresponding reports as needed. It uses up to
+    `collector/spool_parallelism` (default: 2) persistent connections with
+    the collector. After a failure, it waits `collector/spool_retry_interval`
+    seconds (default: 1.0), doubled at each attempt, before trying again, and
+    gives up after `collector/spool_max_retries` (default: 3) attempts so as
+    not to keep the reactor running; the next drain() starts over. Entries
+    are acknowledged in the spool after the collector has accepted them, so
+    an entry may be submitted twice if we crash in between.
+*/
+class SpoolUploader : public NonCopyable, public NonMovable {
+  public:
+    static SharedPtr<SpoolUploader> make(SharedPtr<Spool>, Settings,
+                                         SharedPtr<Reactor>, SharedPtr<Logger>);
+
+    /// `drain()` starts submitting pending entries, unless we are already
+    /// doing that. Call it after adding entries to the spool.
+    virtual void drain() = 0;
+
+    virtual ~SpoolUploader();
+};
+
+} // namespace report
+} // namespace mk
+#endif
@@ -0,0 +1,254 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+#ifndef SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_UPLOADER_IMPL_HPP
+#define SRC_LIBMEASUREMENT_KIT_REPORT_SPOOL_UPLOADER_IMPL_HPP
+
+#include "src/libmeasurement_kit/common/enable_shared_from_this.hpp"
+#include "src/libmeasurement_kit/common/mock.hpp"
+#include "src/libmeasurement_kit/ooni/collector_client.hpp"
+#include "src/libmeasurement_kit/ooni/error.hpp"
+#include "src/libmeasurement_kit/report/spool_uploader.hpp"
+
+#include <cmath>
+#include <set>
+#include <vector>
+
+namespace mk {
+namespace report {
+
+template <MK_MOCK_AS(ooni::collector::Session::make, collector_session_make),
+          MK_MOCK_AS(ooni::collector::connect_and_create_report,
+                     collector_create_report)>
+class SpoolUploaderImpl
+    : public SpoolUploader,
+      public EnableSharedFromThis<SpoolUploaderImpl<collector_session_make,
+                                                    collector_create_report>> {
+  public:
+    SpoolUploaderImpl(SharedPtr<Spool> spool, Settings settings,
+                      SharedPtr<Reactor> reactor, SharedPtr<Logger> logger)
+        : spool_{std::move(spool)}, settings_{std::move(settings)},
+          reactor_{std::move(reactor)}, logger_{std::move(logger)} {
+        size_t parallelism = settings_.get("collector/spool_parallelism", 2U);
+        slots_.resize((parallelism > 0) ? parallelism : 1);
+    }
+
+    void drain() override {
+        if (gave_up_) {
+            gave_up_ = false;
+            failures_ = 0;
+            scan_after_ = 0;
+        }
+        pump();
+    }
+
+  private:
+    // Each slot uses a persistent connection for one operation at a time
+    class Slot {
+      public:
+        SharedPtr<ooni::collector::Session> session;
+        bool busy = false;
+    };
+
+    SharedPtr<Spool> spool_;
+    Settings settings_;
+    SharedPtr<Reactor> reactor_;
+    SharedPtr<Logger> logger_;
+    std::vector<Slot> slots_;
+    std::set<uint64_t> submitting_;
+    std::set<std::string> creating_;
+    std::set<std::string> closing_;
+    uint64_t scan_after_ = 0;
+    bool paused_ = false;
+    bool gave_up_ = false;
+    unsigned failures_ = 0;
+
+    // Errors that would happen again if we submit the same entry
+    static bool is_permanent(Error error) {
+        return error == ooni::MissingMandatoryKeyError() ||
+               error == ooni::InvalidMandatoryValueError();
+    }
+
+    void pump() {
+        if (paused_ || gave_up_) {
+            return;
+        }
+        create_reports();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (!slots_[i].busy && !start_close(i) && !start_update(i)) {
+                break;
+            }
+        }
+    }
+
+    SharedPtr<ooni::collector::Session> session(size_t i) {
+        if (!slots_[i].session) {
+            slots_[i].session =
+                  collector_session_make(settings_, reactor_, logger_);
+        }
+        return slots_[i].session;
+    }
+
+    // Creates the reports that we could not create when measuring
+    void create_reports() {
+        auto self = this->shared_from_this();
+        // Note: callbacks may modify the reports, hence the copy
+        std::vector<std::pair<std::string, uint64_t>> todo;
+        for (auto &kv : spool_->reports()) {
+            if (kv.second.report_id == "" && kv.second.first_seq != 0 &&
+                creating_.count(kv.first) == 0) {
+                todo.push_back({kv.first, kv.second.first_seq});
+            }
+        }
+        for (auto &pair : todo) {
+            std::string key = pair.first;
+            ErrorOr<SerializedEntry> entry = spool_->read_entry(pair.second);
+            if (!entry) {
+                logger_->warn("spool: cannot read entry: %s",
+                              entry.as_error().what());
+                continue;
+            }
+            creating_.insert(key);
+            logger_->debug("spool: creating report for %s", key.c_str());
+            collector_create_report(
+                  entry->json(),
+                  [self, key](Error error, std::string report_id) {
+                      self->creating_.erase(key);
+                      if (!error) {
+                          error = self->spool_->set_report_id(key, report_id);
+                      }
+                      if (error) {
+                          self->backoff(error);
+                          return;
+                      }
+                      self->failures_ = 0;
+                      self->scan_after_ = 0; // Entries are now submittable
+                      self->pump();
+                  },
+                  settings_, reactor_, logger_);
+        }
+    }
+
+    // Closes a report whose entries have all been submitted
+    bool start_close(size_t i) {
+        auto self = this->shared_from_this();
+        for (auto &kv : spool_->reports()) {
+            std::string key = kv.first;
+            const Spool::Report &report = kv.second;
+            if (!report.closing || report.pending != 0 ||
+                report.report_id == "" || closing_.count(key) != 0) {
+                continue;
+            }
+            closing_.insert(key);
+            slots_[i].busy = true;
+            session(i)->close_report(report.report_id, [self, i,
+                                                        key](Error error) {
+                self->closing_.erase(key);
+                self->slots_[i].busy = false;
+                if (!error) {
+                    error = self->spool_->report_closed(key);
+                }
+                if (error) {
+                    self->backoff(error);
+                    return;
+                }
+                self->failures_ = 0;
+                self->pump();
+            });
+            return true;
+        }
+        return false;
+    }
+
+    bool start_update(size_t i) {
+        auto self = this->shared_from_this();
+        ErrorOr<Spool::Entry> next;
+        while ((next = spool_->next_entry(scan_after_))) {
+            scan_after_ = next->seq;
+            uint64_t seq = next->seq;
+            auto report = spool_->reports().find(next->key);
+            if (submitting_.count(seq) != 0 ||
+                report == spool_->reports().end() ||
+                report->second.report_id == "") {
+                continue;
+            }
+            std::string report_id = report->second.report_id;
+            ErrorOr<SerializedEntry> entry = spool_->read_entry(seq);
+            if (!entry) {
+                if (entry.as_error() == JsonProcessingError()) {
+                    drop(seq, entry.as_error());
+                    continue;
+                }
+                backoff(entry.as_error());
+                return false;
+            }
+            // The report may have been created after the measurement
+            SerializedEntry serialized = *entry;
+            auto it = serialized.json().find("report_id");
+            if (it == serialized.json().end() || *it != report_id) {
+                nlohmann::json copy = serialized.json();
+                copy["report_id"] = report_id;
+                serialized = SerializedEntry::make(std::move(copy));
+            }
+            submitting_.insert(seq);
+            slots_[i].busy = true;
+            session(i)->update_report(report_id, serialized, [self, i,
+                                                              seq](Error error) {
+                self->submitting_.erase(seq);
+                self->slots_[i].busy = false;
+                if (error && is_permanent(error)) {
+                    self->drop(seq, error);
+                    error = NoError();
+                } else if (!error) {
+                    error = self->spool_->ack(seq);
+                }
+                if (error) {
+                    self->backoff(error);
+                    return;
+                }
+                self->failures_ = 0;
+                self->pump();
+            });
+            return true;
+        }
+        return false;
+    }
+
+    void drop(uint64_t seq, Error reason) {
+        logger_->warn("spool: dropping entry %llu: %s",
+                      (unsigned long long)seq, reason.what());
+        Error error = spool_->ack(seq);
+        if (error) {
+            logger_->warn("spool: cannot drop entry: %s", error.what());
+        }
+    }
+
+    void backoff(Error error) {
+        if (paused_ || gave_up_) {
+            return;
+        }
+        // Give up eventually, otherwise we would keep the reactor running
+        if (failures_ >= settings_.get("collector/spool_max_retries", 3U)) {
+            logger_->warn("spool: %s; giving up until next drain()",
+                          error.what());
+            gave_up_ = true;
+            return;
+        }
+        paused_ = true;
+        double interval = std::ldexp(
+              settings_.get("collector/spool_retry_interval", 1.0), failures_);
+        failures_ += 1;
+        logger_->warn("spool: %s; retrying in %.1f seconds", error.what(),
+                      interval);
+        auto self = this->shared_from_this();
+        reactor_->call_later(interval, [self]() {
+            self->paused_ = false;
+            self->scan_after_ = 0;
+            self->pump();
+        });
+    }
+};
+
+} // namespace report
+} // namespace mk
+#endif
@@ -0,0 +1,26 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/fast_uuid4.hpp"
+
+#include <regex>
+#include <set>
+
+using namespace mk;
+
+TEST_CASE("fast_uuid4() returns version 4 UUIDs") {
+    std::regex pattern{"[0-9a-f]{8}-[0-9a-f]{4}-4[0-9a-f]{3}-[89ab][0-9a-f]{3}-"
+                       "[0-9a-f]{12}"};
+    std::set<std::string> seen;
+    // More than fits in the buffer, so that we also test refilling it
+    for (size_t i = 0; i < 1000; ++i) {
+        std::string uuid = fast_uuid4();
+        REQUIRE(std::regex_match(uuid, pattern));
+        REQUIRE(seen.insert(uuid).second);
+    }
+}
@@ -0,0 +1,45 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/lru_cache.hpp"
+
+#include <string>
+
+using namespace mk;
+
+TEST_CASE("LruCache discards the least recently used value") {
+    LruCache<std::string, int> cache{2};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    REQUIRE(*cache.get("a") == 1); // Now "b" is the least recently used
+    cache.put("c", 3);
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.get("b") == nullptr);
+    REQUIRE(*cache.get("a") == 1);
+    REQUIRE(*cache.get("c") == 3);
+}
+
+TEST_CASE("LruCache replaces the value of an existing key") {
+    LruCache<std::string, int> cache{2};
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("a", 10); // Now "b" is the least recently used
+    cache.put("c", 3);
+    REQUIRE(*cache.get("a") == 10);
+    REQUIRE(cache.get("b") == nullptr);
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.get("a") == nullptr);
+}
+
+TEST_CASE("LruCache with zero capacity does not store values") {
+    LruCache<int, int> cache{0};
+    cache.put(1, 1);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.get(1) == nullptr);
+}
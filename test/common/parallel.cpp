@@ -89,3 +89,133 @@ TEST_CASE("mk::parallel() works as expected with all failures") {
         });
     });
 }
+
+TEST_CASE("mk::parallel() gives the next item to the first free lane") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    std::vector<size_t> order;
+    reactor->run_with_initial_event([&]() {
+        std::vector<Continuation<Error>> input;
+        for (size_t i = 0; i < 6; ++i) {
+            input.push_back([&, i](Callback<Error> callback) {
+                order.push_back(i);
+                // The first item is much slower than the others
+                reactor->call_later((i == 0) ? 0.5 : 0.01, [=]() {
+                    callback(NoError());
+                });
+            });
+        }
+        mk::parallel(input, [&](Error error) {
+            REQUIRE((error == NoError()));
+            // With static striping, item 2 would wait for item 0
+            REQUIRE((order == std::vector<size_t>{0, 1, 2, 3, 4, 5}));
+            reactor->stop();
+        }, 2);
+    });
+}
+
+TEST_CASE("mk::parallel() never exceeds the parallelism") {
+    size_t in_flight = 0, max_in_flight = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        std::vector<Continuation<Error>> input;
+        for (size_t i = 0; i < 16; ++i) {
+            input.push_back([&, i](Callback<Error> callback) {
+                max_in_flight = std::max(max_in_flight, ++in_flight);
+                reactor->call_later((i % 3) * 0.01, [&, callback]() {
+                    in_flight -= 1;
+                    callback(NoError());
+                });
+            });
+        }
+        mk::parallel(input, [&](Error error) {
+            REQUIRE((error == NoError()));
+            reactor->stop();
+        }, 3);
+    });
+    REQUIRE(max_in_flight == 3);
+}
+
+TEST_CASE("mk::parallel() does not recurse with immediate completions") {
+    std::vector<Continuation<Error>> input;
+    size_t count = 0;
+    for (size_t i = 0; i < 100000; ++i) {
+        input.push_back([&](Callback<Error> callback) {
+            count += 1;
+            callback(NoError());
+        });
+    }
+    bool called = false;
+    mk::parallel(input, [&](Error error) {
+        REQUIRE((error == NoError()));
+        called = true;
+    }, 2);
+    REQUIRE(called);
+    REQUIRE(count == 100000);
+}
+
+TEST_CASE("mk::parallel() can stop after the first error") {
+    ParallelPolicy policy;
+    policy.parallelism = 2;
+    policy.abort_on_error = true;
+    std::vector<Continuation<Error>> input;
+    for (size_t i = 0; i < 8; ++i) {
+        input.push_back([=](Callback<Error> callback) {
+            callback((i == 2) ? Error{MockedError()} : Error{NoError()});
+        });
+    }
+    bool called = false;
+    mk::parallel(input, [&](Error error) {
+        REQUIRE((error == ParallelOperationError()));
+        REQUIRE((error.child_errors[1] == NoError()));
+        REQUIRE((error.child_errors[2] == MockedError()));
+        for (size_t i = 3; i < 8; ++i) {
+            REQUIRE((error.child_errors[i] == OperationCancelledError()));
+        }
+        called = true;
+    }, policy);
+    REQUIRE(called);
+}
+
+TEST_CASE("mk::parallel() honours the deadline") {
+    ParallelPolicy policy;
+    policy.parallelism = 1;
+    policy.deadline = 0.15;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([&]() {
+        std::vector<Continuation<Error>> input;
+        for (size_t i = 0; i < 10; ++i) {
+            input.push_back([=](Callback<Error> callback) {
+                reactor->call_later(0.1, [=]() { callback(NoError()); });
+            });
+        }
+        mk::parallel(input, [=](Error error) {
+            REQUIRE((error == ParallelOperationError()));
+            REQUIRE((error.child_errors[0] == NoError()));
+            REQUIRE((error.child_errors[1] == NoError()));
+            REQUIRE((error.child_errors[9] == OperationCancelledError()));
+            reactor->stop();
+        }, policy);
+    });
+}
+
+TEST_CASE("mk::parallel() can be cancelled") {
+    ParallelPolicy policy;
+    policy.parallelism = 2;
+    *policy.cancelled = true;
+    std::vector<Continuation<Error>> input;
+    for (size_t i = 0; i < 4; ++i) {
+        input.push_back([](Callback<Error> callback) {
+            REQUIRE(false); // Should not be called
+            callback(NoError());
+        });
+    }
+    size_t called = 0;
+    mk::parallel(input, [&](Error error) {
+        REQUIRE((error == ParallelOperationError()));
+        for (auto &sub_error : error.child_errors) {
+            REQUIRE((sub_error == OperationCancelledError()));
+        }
+        called += 1;
+    }, policy);
+    REQUIRE(called == 1);
+}
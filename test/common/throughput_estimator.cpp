@@ -0,0 +1,156 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/throughput_estimator.hpp"
+
+using namespace mk;
+
+using Clock = ThroughputEstimator::Clock;
+
+static Clock::time_point after(Clock::time_point begin, double seconds) {
+    return begin + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(seconds));
+}
+
+TEST_CASE("RateStats works as expected") {
+    SECTION("With no rates") {
+        RateStats stats;
+        ThroughputSummary summary = stats.summary();
+        REQUIRE(summary.count == 0);
+        REQUIRE(summary.p50 == 0.0);
+    }
+
+    SECTION("The EWMA starts from the first rate") {
+        RateStats stats{0.5};
+        stats.add(100.0);
+        REQUIRE(stats.ewma() == 100.0);
+        stats.add(200.0);
+        REQUIRE(stats.ewma() == 150.0);
+    }
+
+    SECTION("Percentiles are computed correctly") {
+        RateStats stats;
+        for (int i = 10; i >= 0; --i) {
+            stats.add(i * 10.0);
+        }
+        ThroughputSummary summary = stats.summary();
+        REQUIRE(summary.count == 11);
+        REQUIRE(summary.average == Approx(50.0));
+        REQUIRE(summary.p10 == Approx(10.0));
+        REQUIRE(summary.p50 == Approx(50.0));
+        REQUIRE(summary.p90 == Approx(90.0));
+        // Computing the summary must not reorder the rates
+        REQUIRE(stats.rates()[0] == 100.0);
+    }
+
+    SECTION("The window selects the last rates") {
+        RateStats stats;
+        for (int i = 0; i < 10; ++i) {
+            stats.add((i < 5) ? 1.0 : 2.0);
+        }
+        ThroughputSummary summary = stats.summary(5);
+        REQUIRE(summary.count == 5);
+        REQUIRE(summary.p10 == 2.0);
+        REQUIRE(stats.summary(100).count == 10);
+    }
+}
+
+TEST_CASE("ThroughputEstimator works as expected") {
+    SECTION("Bins are completed when time passes") {
+        ThroughputEstimator estimator{0.5};
+        Clock::time_point begin = Clock::now();
+        REQUIRE(estimator.add(1000, 0, after(begin, 0.6)) == 1);
+        REQUIRE(estimator.add(1000, 0, after(begin, 0.7)) == 0);
+        REQUIRE(estimator.add(1000, 0, after(begin, 1.1)) == 1);
+        REQUIRE(estimator.rates().size() == 2);
+        REQUIRE(estimator.rates()[0] == Approx(0.0));
+        REQUIRE(estimator.rates()[1] == Approx(32.0)); // 4000 bit in 0.5 s
+        REQUIRE(estimator.bin_end(0) == Approx(0.5));
+        REQUIRE(estimator.bin_end(1) == Approx(1.0));
+        REQUIRE(estimator.total() == 3000);
+    }
+
+    SECTION("Idle periods produce zero-rate bins") {
+        ThroughputEstimator estimator{0.5};
+        Clock::time_point begin = Clock::now();
+        REQUIRE(estimator.add(1000, 0, after(begin, 0.1)) == 0);
+        REQUIRE(estimator.add(1000, 0, after(begin, 2.1)) == 4);
+        REQUIRE(estimator.rates()[0] == Approx(16.0));
+        REQUIRE(estimator.rates()[1] == 0.0);
+        REQUIRE(estimator.rates()[3] == 0.0);
+    }
+
+    SECTION("The rate of each flow is tracked") {
+        ThroughputEstimator estimator{1.0, 2};
+        Clock::time_point begin = Clock::now();
+        estimator.add(1000, 0, after(begin, 0.1));
+        estimator.add(3000, 1, after(begin, 0.2));
+        REQUIRE(estimator.advance(after(begin, 1.1)) == 1);
+        REQUIRE(estimator.num_flows() == 2);
+        REQUIRE(estimator.rates()[0] == Approx(32.0));
+        REQUIRE(estimator.flow_rate(0, 0) == Approx(8.0));
+        REQUIRE(estimator.flow_rate(0, 1) == Approx(24.0));
+    }
+
+    SECTION("finish() completes the partial bin") {
+        ThroughputEstimator estimator{1.0};
+        Clock::time_point begin = Clock::now();
+        estimator.add(1000, 0, after(begin, 0.5));
+        estimator.add(1000, 0, after(begin, 1.2));
+        estimator.finish(after(begin, 1.5));
+        REQUIRE(estimator.rates().size() == 2);
+        REQUIRE(estimator.rates()[1] == Approx(16.0)); // 8000 bit in 0.5 s
+        REQUIRE(estimator.bin_end(1) == Approx(1.5));
+        REQUIRE(estimator.elapsed() == Approx(1.5));
+        // Calling it again has no effect
+        estimator.finish(after(begin, 5.0));
+        REQUIRE(estimator.rates().size() == 2);
+    }
+
+    SECTION("finish() drops a short partial bin") {
+        ThroughputEstimator estimator{1.0};
+        Clock::time_point begin = Clock::now();
+        estimator.add(1000, 0, after(begin, 0.5));
+        estimator.add(1000, 0, after(begin, 1.2));
+        estimator.finish(after(begin, 1.25));
+        REQUIRE(estimator.rates().size() == 1);
+        REQUIRE(estimator.summary().ewma == Approx(8.0));
+        // The bytes of the dropped bin still count for the average
+        REQUIRE(estimator.summary().average == Approx(12.8));
+    }
+
+    SECTION("finish() keeps a short partial bin if it's the only one") {
+        ThroughputEstimator estimator{1.0};
+        Clock::time_point begin = Clock::now();
+        estimator.add(1000, 0, after(begin, 0.1));
+        estimator.finish(after(begin, 0.25));
+        REQUIRE(estimator.rates().size() == 1);
+        REQUIRE(estimator.rates()[0] == Approx(32.0));
+    }
+
+    SECTION("add() rejects invalid flows") {
+        ThroughputEstimator estimator{1.0, 2};
+        Clock::time_point begin = Clock::now();
+        REQUIRE_THROWS_AS(estimator.add(1000, 2, after(begin, 1.5)),
+                          ValueError);
+        REQUIRE(estimator.total() == 0);
+        REQUIRE(estimator.rates().size() == 0);
+    }
+
+    SECTION("The average is over all bytes and all time") {
+        ThroughputEstimator estimator{0.5};
+        Clock::time_point begin = Clock::now();
+        estimator.add(10000, 0, after(begin, 0.1));
+        estimator.finish(after(begin, 1.6));
+        ThroughputSummary summary = estimator.summary();
+        REQUIRE(summary.average == Approx(50.0));
+        REQUIRE(summary.count == 3); // The last 0.1 s are too short
+        nlohmann::json json = estimator.summary_json();
+        REQUIRE(json["bin_width"] == 0.5);
+        REQUIRE(json["count"] == 3);
+        REQUIRE(json["average"].get<double>() == Approx(50.0));
+    }
+}
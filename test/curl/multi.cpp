@@ -0,0 +1,196 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/curl/multi.hpp"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#endif
+
+using namespace mk;
+
+TEST_CASE("curl::Multi fails asynchronously with invalid requests") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<curl::Multi> multi = curl::Multi::make(reactor, Logger::make());
+        SharedPtr<bool> called{new bool{false}};
+        curl::Request request;
+        request.method = "NONEXISTENT";
+        request.url = "http://www.example.com/";
+        multi->perform(request, [=](curl::TransferResponse response) {
+            REQUIRE(response.error != 0);
+            *called = true;
+            reactor->stop();
+        });
+        REQUIRE(*called == false);
+        REQUIRE(multi->pending() == 0);
+    });
+}
+
+TEST_CASE("curl::Multi deals with unsupported protocols") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<curl::Multi> multi = curl::Multi::make(reactor, Logger::make());
+    reactor->run_with_initial_event([=]() {
+        curl::Request request;
+        request.url = "antani://www.example.com/";
+        multi->perform(request, [=](curl::TransferResponse response) {
+            REQUIRE(response.error != 0);
+            reactor->stop();
+        });
+    });
+}
+
+TEST_CASE("curl::response_error() maps errors correctly") {
+    curl::Response response;
+    REQUIRE(curl::response_error(response) == NoError());
+    response.error = 28; // CURLE_OPERATION_TIMEDOUT
+    REQUIRE(curl::response_error(response) == TimeoutError());
+    response.error = 7; // CURLE_COULDNT_CONNECT
+    REQUIRE(curl::response_error(response) == GenericError());
+}
+
+#if defined __linux__ && !defined MK_WITHOUT_CURL
+
+// Serves `count` requests, one per connection, using HTTP/1.1. When
+// `respond` is false, it reads the request and then waits for the client
+// to close the connection without sending any response.
+static void loopback_server(int listener, int count, bool respond) {
+    for (int i = 0; i < count; ++i) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd == -1) {
+            return;
+        }
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                break;
+            }
+            request.append(buf, (size_t)n);
+        }
+        if (respond) {
+            std::string response = "HTTP/1.1 200 OK\r\n";
+            response += "Content-Type: text/plain\r\n";
+            response += "Content-Length: 5\r\n";
+            response += "Connection: close\r\n";
+            response += "\r\n";
+            response += "hello";
+            (void)send(fd, response.data(), response.size(), 0);
+        } else {
+            while (recv(fd, buf, sizeof(buf), 0) > 0) {
+                /* Wait for the client to give up */;
+            }
+        }
+        close(fd);
+    }
+}
+
+static int make_listener(std::string *url) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    REQUIRE(bind(listener, (sockaddr *)&sin, len) == 0);
+    REQUIRE(listen(listener, 8) == 0);
+    REQUIRE(getsockname(listener, (sockaddr *)&sin, &len) == 0);
+    *url = "http://127.0.0.1:" + std::to_string(ntohs(sin.sin_port)) + "/";
+    return listener;
+}
+
+TEST_CASE("curl::Multi runs many requests concurrently") {
+    std::string url;
+    int listener = make_listener(&url);
+    std::thread server{loopback_server, listener, 4, true};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<curl::Multi> multi = curl::Multi::make(reactor, Logger::make());
+    int count = 0;
+    reactor->run_with_initial_event([&]() {
+        for (int i = 0; i < 4; ++i) {
+            curl::Request request;
+            request.url = url;
+            multi->perform(request, [&](curl::TransferResponse response) {
+                REQUIRE(response.error == 0);
+                REQUIRE(response.status_code == 200);
+                REQUIRE(response.body == "hello");
+                REQUIRE(response.bytes_recv > 0);
+                if (++count == 4) {
+                    reactor->stop();
+                }
+            });
+        }
+        REQUIRE(multi->pending() == 4);
+    });
+    server.join();
+    close(listener);
+    REQUIRE(count == 4);
+    REQUIRE(multi->pending() == 0);
+}
+
+TEST_CASE("curl::Multi::perform_http2() works as expected") {
+    std::string url;
+    int listener = make_listener(&url);
+    std::thread server{loopback_server, listener, 2, true};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<curl::Multi> multi = curl::Multi::make(reactor, Logger::make());
+    int count = 0;
+    reactor->run_with_initial_event([&]() {
+        for (int i = 0; i < 2; ++i) {
+            curl::Request request;
+            request.url = url;
+            multi->perform_http2(request, [&](curl::TransferResponse response) {
+                REQUIRE(response.error == 0);
+                REQUIRE(response.status_code == 200);
+                // The server does not speak HTTP/2 hence cURL sticks
+                // to HTTP/1.1, ignoring the upgrade it asked for
+                REQUIRE(response.http_version == "HTTP/1.1");
+                REQUIRE(response.download_size == 5);
+                REQUIRE(response.total_time_us > 0);
+                if (++count == 2) {
+                    reactor->stop();
+                }
+            });
+        }
+    });
+    server.join();
+    close(listener);
+    REQUIRE(count == 2);
+}
+
+TEST_CASE("curl::Multi is not kept alive by its pending transfers") {
+    std::string url;
+    int listener = make_listener(&url);
+    std::thread server{loopback_server, listener, 1, false};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<curl::Multi> multi = curl::Multi::make(reactor, Logger::make());
+    bool called = false;
+    reactor->run_with_initial_event([&]() {
+        curl::Request request;
+        request.url = url;
+        multi->perform(request, [&](curl::TransferResponse) { called = true; });
+        reactor->call_later(0.5, [&]() {
+            REQUIRE(multi->pending() == 1);
+            REQUIRE(multi.use_count() == 1);
+            // Aborts the transfer and unregisters its events, hence the
+            // reactor returns because it has nothing left to do
+            multi.reset();
+        });
+    });
+    server.join();
+    close(listener);
+    REQUIRE(called == false);
+}
+
+#endif
@@ -0,0 +1,53 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/curl/transfer.hpp"
+
+using namespace mk;
+
+#ifndef MK_WITHOUT_CURL
+
+static bool has_log(const curl::Response &response, std::string prefix) {
+    for (auto &log : response.logs) {
+        if (log.line.find(prefix) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST_CASE("curl::perform() fails with invalid requests") {
+    curl::Request request;
+    request.method = "NONEXISTENT";
+    request.url = "http://www.example.com/";
+    curl::Response response = curl::perform(request);
+    REQUIRE(response.error != 0);
+    REQUIRE(has_log(response, "unsupported request method"));
+    REQUIRE(response.bytes_sent == 0);
+}
+
+TEST_CASE("curl::perform() deals with unsupported protocols") {
+    curl::Request request;
+    request.url = "antani://www.example.com/";
+    curl::Response response = curl::perform(request);
+    REQUIRE(response.error != 0);
+    REQUIRE(has_log(response, "curl_easy_perform: "));
+}
+
+TEST_CASE("curl::Transfer::perform() does not retry other errors") {
+    curl::Request request;
+    request.url = "antani://www.example.com/";
+    request.retries = 3;
+    curl::Transfer transfer{request};
+    REQUIRE(transfer.prepare());
+    curl::TransferResponse response = transfer.perform();
+    REQUIRE(response.error != 0);
+    REQUIRE(!has_log(response, "Transient failure"));
+}
+
+#endif
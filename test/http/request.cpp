@@ -103,6 +103,100 @@ TEST_CASE("HTTP Request class works as expected with explicit path") {
     REQUIRE(serialized == expect);
 }
 
+TEST_CASE("HTTP RequestTemplate class works as expected") {
+    ErrorOr<SharedPtr<RequestTemplate>> tmpl = RequestTemplate::make(
+        {
+            {"http/url", "http://www.example.com:8080/antani?clacsonato=yes"},
+            {"http/method", "POST"},
+            {"http/http_version", "HTTP/1.0"},
+        },
+        {
+            {"User-Agent", "Antani/1.0.0.0"},
+        });
+    REQUIRE(!!tmpl);
+
+    SECTION("The output matches the one of Request::serialize()") {
+        Request request;
+        REQUIRE(request.init(
+            {
+                {"http/url",
+                 "http://www.example.com:8080/antani?clacsonato=yes"},
+                {"http/method", "POST"},
+                {"http/http_version", "HTTP/1.0"},
+            },
+            {
+                {"User-Agent", "Antani/1.0.0.0"},
+            },
+            "0123456789") == NoError());
+        Buffer expect;
+        request.serialize(expect, Logger::make());
+        Buffer buffer;
+        (*tmpl)->serialize(buffer, "", "", "0123456789", Logger::make());
+        REQUIRE(buffer.read() == expect.read());
+    }
+
+    SECTION("Slots are correctly filled") {
+        Buffer buffer;
+        (*tmpl)->serialize(buffer, "/foo", "www.example.org", "",
+                           Logger::make());
+        (*tmpl)->serialize(buffer, "/bar", "", "01234", Logger::make());
+        std::string expect = "POST /foo HTTP/1.0\r\n";
+        expect += "User-Agent: Antani/1.0.0.0\r\n";
+        expect += "Host: www.example.org\r\n";
+        expect += "\r\n";
+        expect += "POST /bar HTTP/1.0\r\n";
+        expect += "User-Agent: Antani/1.0.0.0\r\n";
+        expect += "Host: www.example.com:8080\r\n";
+        expect += "Content-Length: 5\r\n";
+        expect += "\r\n";
+        expect += "01234";
+        REQUIRE(buffer.read() == expect);
+    }
+
+    SECTION("Paths without leading slash are normalized") {
+        Buffer buffer;
+        (*tmpl)->serialize(buffer, "foo", "", "", Logger::make());
+        std::string expect = "POST /foo HTTP/1.0\r\n";
+        expect += "User-Agent: Antani/1.0.0.0\r\n";
+        expect += "Host: www.example.com:8080\r\n";
+        expect += "\r\n";
+        REQUIRE(buffer.read() == expect);
+        SharedPtr<Request> request = (*tmpl)->make_request("foo", "");
+        REQUIRE(request->url_path == "/foo");
+    }
+
+    SECTION("make_request() fills path and body") {
+        SharedPtr<Request> request = (*tmpl)->make_request("/foo", "01234");
+        REQUIRE(request->method == "POST");
+        REQUIRE(request->url.address == "www.example.com");
+        REQUIRE(request->url_path == "/foo");
+        REQUIRE(request->body == "01234");
+    }
+}
+
+TEST_CASE("HTTP RequestTemplate class honours explicit Host header") {
+    ErrorOr<SharedPtr<RequestTemplate>> tmpl = RequestTemplate::make(
+        {
+            {"http/url", "http://www.example.com/"},
+        },
+        {
+            {"Host", "www.antani.org"},
+        });
+    REQUIRE(!!tmpl);
+    Buffer buffer;
+    (*tmpl)->serialize(buffer, "", "www.example.org", "", Logger::make());
+    std::string expect = "GET / HTTP/1.1\r\n";
+    expect += "Host: www.antani.org\r\n";
+    expect += "\r\n";
+    REQUIRE(buffer.read() == expect);
+}
+
+TEST_CASE("HTTP RequestTemplate class fails without url") {
+    ErrorOr<SharedPtr<RequestTemplate>> tmpl = RequestTemplate::make({}, {});
+    REQUIRE(!tmpl);
+    REQUIRE(tmpl.as_error() == MissingUrlError());
+}
+
 /*
  _             _
 | | ___   __ _(_) ___
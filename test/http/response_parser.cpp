@@ -8,6 +8,8 @@
 
 #include "src/libmeasurement_kit/http/response_parser.hpp"
 
+#include <vector>
+
 using namespace mk;
 using namespace mk::net;
 using namespace mk::http;
@@ -209,3 +211,64 @@ TEST_CASE("ResponseParserNg eof() works as expected") {
 
     REQUIRE(called);
 }
+
+TEST_CASE("ResponseParserNg on_body_size() works as expected") {
+    ResponseParserNg parser{Logger::make()};
+    size_t body_size = 0;
+    bool called = false;
+    std::string data;
+
+    data = "";
+    data += "HTTP/1.1 200 Ok\r\n";
+    data += "Content-Type: text/plain\r\n";
+    data += "Transfer-Encoding: chunked\r\n";
+    data += "\r\n";
+    data += "3\r\nabc\r\n4\r\ndefg\r\n0\r\n\r\n";
+
+    parser.on_body_size([&body_size](size_t n) { body_size += n; });
+    parser.on_end([&called]() { called = true; });
+    parser.feed(data);
+
+    REQUIRE(called);
+    REQUIRE(body_size == 7);
+}
+
+TEST_CASE("ResponseParserNg works with pipelined responses") {
+    ResponseParserNg parser{Logger::make()};
+    std::vector<std::string> bodies;
+    int ended = 0;
+    std::string data;
+
+    data = "";
+    data += "HTTP/1.1 200 Ok\r\n";
+    data += "Content-Length: 3\r\n";
+    data += "\r\n";
+    data += "abc";
+    data += "HTTP/1.1 200 Ok\r\n";
+    data += "Transfer-Encoding: chunked\r\n";
+    data += "\r\n";
+    data += "4\r\ndefg\r\n0\r\n\r\n";
+    data += "HTTP/1.1 200 Ok\r\n";
+    data += "Content-Length: 2\r\n";
+
+    parser.pipeline(true);
+    parser.on_begin([&bodies]() { bodies.push_back(""); });
+    parser.on_body([&bodies](std::string s) { bodies.back() += s; });
+    parser.on_end([&ended]() { ended += 1; });
+
+    parser.feed(data);
+    REQUIRE(ended == 1);
+    REQUIRE(bodies.size() == 1);
+
+    parser.resume();
+    REQUIRE(ended == 2);
+    REQUIRE(bodies.size() == 2);
+
+    // Data arriving while we're paused is buffered as well
+    parser.feed(std::string{"\r\nhi"});
+    REQUIRE(ended == 2);
+
+    parser.resume();
+    REQUIRE(ended == 3);
+    REQUIRE(bodies == std::vector<std::string>{"abc", "defg", "hi"});
+}
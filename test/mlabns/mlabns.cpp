@@ -7,6 +7,7 @@
 #include "include/private/catch.hpp"
 
 #include "src/libmeasurement_kit/mlabns/mlabns_impl.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
 
 using namespace mk;
 
@@ -237,3 +238,135 @@ TEST_CASE("Make sure that an error is passed to callback if the response "
             settings, reactor, Logger::make());
     });
 }
+
+TEST_CASE("The latency policy asks mlab-ns for several candidates") {
+    Settings settings;
+    settings["mlabns/policy"] = "latency";
+    ErrorOr<std::string> query = mlabns::as_query(settings);
+    REQUIRE(!!query);
+    REQUIRE(*query == "?policy=geo_options");
+}
+
+static void get_candidates(
+      std::string, std::string url, http::Headers,
+      Callback<Error, SharedPtr<http::Response>, nlohmann::json> cb, Settings,
+      SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(url.find("policy=geo_options") != std::string::npos);
+    nlohmann::json node = nlohmann::json::array();
+    for (std::string site : {"mil01", "trn01", "fra01"}) {
+        node.push_back({
+              {"city", "City"},
+              {"country", "IT"},
+              {"fqdn", "ndt.mlab1." + site + ".measurement-lab.org"},
+              {"ip", {"127.0.0.1"}},
+              {"site", site},
+              {"url", "http://ndt.mlab1." + site +
+                            ".measurement-lab.org:7123"},
+        });
+    }
+    cb(NoError(), SharedPtr<http::Response>::make(), node);
+}
+
+static int num_connects = 0;
+
+static void connect_with_rtt(std::string address, int port,
+                             Callback<Error, SharedPtr<net::Transport>> cb,
+                             Settings settings, SharedPtr<Reactor> reactor,
+                             SharedPtr<Logger> logger) {
+    num_connects += 1;
+    REQUIRE(port == 3001);
+    REQUIRE(settings.get("net/timeout", 0.0) == 0.5);
+    if (address.find("fra01") != std::string::npos) {
+        cb(TimeoutError(), {});
+        return;
+    }
+    SharedPtr<net::Transport> txp{new net::Emitter{reactor, logger}};
+    txp->set_connect_time_(
+          (address.find("trn01") != std::string::npos) ? 0.01 : 0.05);
+    cb(NoError(), txp);
+}
+
+static void connect_fail(std::string, int,
+                         Callback<Error, SharedPtr<net::Transport>> cb,
+                         Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    num_connects += 1;
+    cb(TimeoutError(), {});
+}
+
+static Settings latency_settings(std::string probe_ip) {
+    Settings settings;
+    settings["mlabns/policy"] = "latency";
+    settings["mlabns/probe_port"] = 3001;
+    settings["mlabns/probe_timeout"] = 0.5;
+    settings["real_probe_ip_"] = probe_ip; // Each test needs its own entry
+    return settings;
+}
+
+TEST_CASE("The latency policy selects the server with the lowest RTT") {
+    Settings settings = latency_settings("10.0.0.1");
+    SharedPtr<Reactor> reactor = Reactor::make();
+    num_connects = 0;
+    mlabns::Reply reply;
+    reactor->run_with_initial_event([&]() {
+        mlabns::query_impl<get_candidates, connect_with_rtt>(
+              "ndt",
+              [&](Error error, mlabns::Reply r) {
+                  REQUIRE(!error);
+                  reply = r;
+                  reactor->stop();
+              },
+              settings, reactor, Logger::make());
+    });
+    REQUIRE(num_connects == 3);
+    REQUIRE(reply.fqdn == "ndt.mlab1.trn01.measurement-lab.org");
+    REQUIRE(reply.selection["cached"] == false);
+    REQUIRE(reply.selection["selected"] == reply.fqdn);
+    nlohmann::json candidates = reply.selection["candidates"];
+    REQUIRE(candidates.size() == 3);
+    REQUIRE(candidates[0]["connect_time"] == 0.05);
+    REQUIRE(candidates[1]["connect_time"] == 0.01);
+    REQUIRE(candidates[2]["connect_time"] == nullptr);
+    REQUIRE(candidates[2]["failure"] == "generic_timeout_error");
+
+    // We remember the choice for the same network
+    mlabns::query_impl<get_candidates, connect_with_rtt>(
+          "ndt",
+          [&](Error error, mlabns::Reply r) {
+              REQUIRE(!error);
+              reply = r;
+          },
+          settings, reactor, Logger::make());
+    REQUIRE(num_connects == 3);
+    REQUIRE(reply.fqdn == "ndt.mlab1.trn01.measurement-lab.org");
+    REQUIRE(reply.selection["cached"] == true);
+
+    // We probe again for another network
+    settings["real_probe_ip_"] = "10.0.0.2";
+    reactor->run_with_initial_event([&]() {
+        mlabns::query_impl<get_candidates, connect_with_rtt>(
+              "ndt",
+              [&](Error error, mlabns::Reply r) {
+                  REQUIRE(!error);
+                  reply = r;
+                  reactor->stop();
+              },
+              settings, reactor, Logger::make());
+    });
+    REQUIRE(num_connects == 6);
+    REQUIRE(reply.selection["cached"] == false);
+}
+
+TEST_CASE("The latency policy trusts mlab-ns when all probes fail") {
+    Settings settings = latency_settings("10.0.0.3");
+    num_connects = 0;
+    for (int i = 0; i < 2; ++i) {
+        mlabns::query_impl<get_candidates, connect_fail>(
+              "ndt",
+              [&](Error error, mlabns::Reply reply) {
+                  REQUIRE(!error);
+                  REQUIRE(reply.fqdn == "ndt.mlab1.mil01.measurement-lab.org");
+              },
+              settings, Reactor::make(), Logger::make());
+    }
+    REQUIRE(num_connects == 6); // We do not remember the fallback
+}
@@ -12,35 +12,84 @@ using namespace mk;
 using namespace mk::ndt;
 using namespace mk::net;
 
-static void fail(SharedPtr<Transport>, SharedPtr<Buffer>, size_t, Callback<Error> cb,
-                 SharedPtr<Reactor> = Reactor::make()) {
+static void fail(SharedPtr<Transport>, SharedPtr<Buffer>, Callback<Error> cb,
+                 SharedPtr<Reactor>) {
     cb(MockedError());
 }
 
-static void succeed(SharedPtr<Transport>, SharedPtr<Buffer>, size_t, Callback<Error> cb,
-                    SharedPtr<Reactor> = Reactor::make()) {
-    cb(NoError());
-}
-
-TEST_CASE("read_ndt() deals with the first readn() error") {
+TEST_CASE("read_ndt() deals with error when reading type and length") {
     SharedPtr<Context> ctx(new Context);
     messages::read_ll_impl<fail>(ctx, [](Error err, uint8_t, std::string) {
         REQUIRE(err == ReadingMessageTypeLengthError());
     }, Reactor::make());
 }
 
-TEST_CASE("read_ndt() deals with the second readn() error") {
+TEST_CASE("read_ndt() deals with error when reading the payload") {
     SharedPtr<Context> ctx(new Context);
-    // Now we have enough bytes to read type and lenght such that we
-    // arrive to invoke readn() one second time
+    // Now we have enough bytes to read type and lenght but not the payload
     ctx->buff->write_uint8(1);
     ctx->buff->write_uint16(3);
-    messages::read_ll_impl<succeed, fail>(
+    messages::read_ll_impl<fail>(
         ctx, [](Error err, uint8_t, std::string) {
             REQUIRE(err == ReadingMessagePayloadError());
         }, Reactor::make());
 }
 
+static void one_byte(SharedPtr<Transport>, SharedPtr<Buffer> buff,
+                     Callback<Error> cb, SharedPtr<Reactor>) {
+    static const std::string data{"\x05\x00\x02" "ok" "\x06\x00\x00", 8};
+    static size_t count = 0;
+    REQUIRE(count < data.size());
+    buff->write(data.substr(count++, 1));
+    cb(NoError());
+}
+
+TEST_CASE("read_ndt() reads messages arriving in pieces") {
+    SharedPtr<Context> ctx(new Context);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    std::vector<std::pair<uint8_t, std::string>> messages;
+    reactor->run_with_initial_event([&]() {
+        messages::read_ll_impl<one_byte>(
+            ctx, [&](Error err, uint8_t type, std::string s) {
+                REQUIRE(!err);
+                messages.push_back({type, s});
+                messages::read_ll_impl<one_byte>(
+                    ctx, [&](Error err, uint8_t type, std::string s) {
+                        REQUIRE(!err);
+                        messages.push_back({type, s});
+                        reactor->stop();
+                    }, reactor);
+            }, reactor);
+    });
+    REQUIRE(messages.size() == 2);
+    REQUIRE(messages[0].first == 5);
+    REQUIRE(messages[0].second == "ok");
+    REQUIRE(messages[1].first == 6);
+    REQUIRE(messages[1].second == "");
+}
+
+TEST_CASE("read_ndt() uses messages already in the buffer") {
+    SharedPtr<Context> ctx(new Context);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    ctx->buff->write(std::string{"\x05\x00\x02" "ok" "\x06\x00\x01" "x", 9});
+    std::string received;
+    reactor->run_with_initial_event([&]() {
+        messages::read_ll_impl<fail>(
+            ctx, [&](Error err, uint8_t, std::string s) {
+                REQUIRE(!err);
+                received += s;
+                messages::read_ll_impl<fail>(
+                    ctx, [&](Error err, uint8_t, std::string s) {
+                        REQUIRE(!err);
+                        received += s;
+                        reactor->stop();
+                    }, reactor);
+            }, reactor);
+    });
+    REQUIRE(received == "okx");
+    REQUIRE(ctx->buff->length() == 0);
+}
+
 static void fail(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
                  SharedPtr<Reactor> = Reactor::make()) {
     cb(MockedError(), 0, "");
@@ -65,17 +114,12 @@ TEST_CASE("read_json() deals with invalid JSON") {
     }, Reactor::make());
 }
 
-static void fail(SharedPtr<Context>, Callback<Error, uint8_t, nlohmann::json> cb,
-                 SharedPtr<Reactor> = Reactor::make()) {
-    cb(MockedError(), 0, {});
-}
-
-static void invalid(SharedPtr<Context>, Callback<Error, uint8_t, nlohmann::json> cb,
-                    SharedPtr<Reactor> = Reactor::make()) {
-    cb(NoError(), 0, {{"foo", "baz"}, {"baz", 1}});
+static void no_msg(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
+                   SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), 0, "{\"foo\": \"baz\", \"baz\": 1}");
 }
 
-TEST_CASE("read() deals with read_json() error") {
+TEST_CASE("read() deals with read_ll() error") {
     SharedPtr<Context> ctx(new Context);
     messages::read_msg_impl<fail>(ctx, [](Error err, uint8_t, std::string) {
         REQUIRE(err == MockedError());
@@ -84,14 +128,14 @@ TEST_CASE("read() deals with read_json() error") {
 
 TEST_CASE("read() deals with json without 'msg' field") {
     SharedPtr<Context> ctx(new Context);
-    messages::read_msg_impl<invalid>(ctx, [](Error err, uint8_t, std::string) {
+    messages::read_msg_impl<no_msg>(ctx, [](Error err, uint8_t, std::string) {
         REQUIRE(err == JsonProcessingError());
     }, Reactor::make());
 }
 
-static void bad_type(SharedPtr<Context>, Callback<Error, uint8_t, nlohmann::json> cb,
+static void bad_type(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
                     SharedPtr<Reactor> = Reactor::make()) {
-    cb(NoError(), 0, 3.14);
+    cb(NoError(), 0, "{\"msg\": 3.14}");
 }
 
 TEST_CASE("read() deals with json with 'msg' field of the wrong type") {
@@ -101,6 +145,134 @@ TEST_CASE("read() deals with json with 'msg' field of the wrong type") {
     }, Reactor::make());
 }
 
+TEST_CASE("extract_msg() works as expected") {
+    SECTION("For simple messages") {
+        ErrorOr<std::string> s = messages::extract_msg("{\"msg\": \"v3.7.0\"}");
+        REQUIRE(!!s);
+        REQUIRE(*s == "v3.7.0");
+    }
+
+    SECTION("When there are other fields") {
+        ErrorOr<std::string> s = messages::extract_msg(
+            " { \"tests\" : \"63\", \"x\": {\"y\": [1, \"}\"]}, \"msg\" : \"a\"} ");
+        REQUIRE(!!s);
+        REQUIRE(*s == "a");
+    }
+
+    SECTION("With escapes") {
+        ErrorOr<std::string> s = messages::extract_msg(
+            "{\"msg\": \"a\\nb\\t\\\"c\\\\\\u00e8\\ud83d\\ude00\"}");
+        REQUIRE(!!s);
+        REQUIRE(*s == nlohmann::json::parse(
+            "\"a\\nb\\t\\\"c\\\\\\u00e8\\ud83d\\ude00\"").get<std::string>());
+    }
+
+    SECTION("With duplicate keys") {
+        ErrorOr<std::string> s = messages::extract_msg(
+            "{\"msg\": \"a\", \"msg\": \"b\"}");
+        REQUIRE(!!s);
+        REQUIRE(*s == "b");
+        s = messages::extract_msg("{\"msg\": 1, \"msg\": \"b\"}");
+        REQUIRE(!!s);
+        REQUIRE(*s == "b");
+        REQUIRE(messages::extract_msg("{\"msg\": \"a\", \"msg\": 1}")
+                      .as_error() == JsonProcessingError());
+    }
+
+    SECTION("With trailing data") {
+        REQUIRE(!!messages::extract_msg("{\"msg\": \"a\"} \r\n"));
+        for (std::string s : {"{\"msg\": \"a\"}x", "{\"msg\": \"a\"}{}",
+                              "{\"msg\": \"a\", \"b\": 1} 1"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+
+    SECTION("With unpaired surrogates") {
+        for (std::string s : {"{\"msg\": \"\\udc00\"}",
+                              "{\"msg\": \"a\\ude00b\"}",
+                              "{\"msg\": \"\\ud83d\"}",
+                              "{\"msg\": \"\\ud83dx\"}"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+
+    SECTION("With other values of any type") {
+        ErrorOr<std::string> s = messages::extract_msg(
+            "{\"a\": [true, false, null, -0, 1.5e+3, 2E-1, {}, [], {\"b\":"
+            " [[{\"c\": 10}]]}], \"msg\": \"x\"}");
+        REQUIRE(!!s);
+        REQUIRE(*s == "x");
+    }
+
+    SECTION("With invalid literals") {
+        for (std::string s : {"{\"a\": foo, \"msg\": \"x\"}",
+                              "{\"a\": tru, \"msg\": \"x\"}",
+                              "{\"a\": nulls, \"msg\": \"x\"}"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+
+    SECTION("With invalid numbers") {
+        for (std::string s : {"{\"a\": 01, \"msg\": \"x\"}",
+                              "{\"a\": +1, \"msg\": \"x\"}",
+                              "{\"a\": 1., \"msg\": \"x\"}",
+                              "{\"a\": .5, \"msg\": \"x\"}",
+                              "{\"a\": 1e, \"msg\": \"x\"}",
+                              "{\"a\": -, \"msg\": \"x\"}"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+
+    SECTION("With unbalanced brackets") {
+        for (std::string s : {"{\"a\": [}, \"msg\": \"x\"}",
+                              "{\"a\": [1}], \"msg\": \"x\"}",
+                              "{\"a\": {\"b\": 1]}, \"msg\": \"x\"}",
+                              "{\"a\": [1,], \"msg\": \"x\"}",
+                              "{\"a\": {1: 2}, \"msg\": \"x\"}",
+                              "{\"a\": [[[, \"msg\": \"x\"}"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+
+    SECTION("With invalid input") {
+        for (std::string s : {"", "[]", "{\"msg\"}", "{\"msg\": \"a}",
+                              "{\"msg\": \"\\x\"}", "{\"a\": 1}",
+                              "{\"a\": , \"msg\": \"b\"}"}) {
+            REQUIRE(messages::extract_msg(s).as_error() ==
+                    JsonProcessingError());
+        }
+    }
+}
+
+TEST_CASE("Web100Table works as expected") {
+    messages::Web100Table table;
+    table.add_lines("CurMSS: 1448\nMinRTT: 0.5\nbroken\n\nName: x\n");
+    table.add_lines("a:b:c\nCurMSS: 1460");
+    REQUIRE(table.size() == 4);
+    nlohmann::json json = table.as_json();
+    REQUIRE(json.size() == 3);
+    REQUIRE(json["CurMSS"] == 1460);
+    REQUIRE(json["MinRTT"] == 0.5);
+    REQUIRE(json["Name"] == " x");
+}
+
+TEST_CASE("Web100Table parses lines like add_to_report()") {
+    std::string lines = "Empty:\n:Empty\nTwo::1\nTrailing:2:\n::Leading:3";
+    messages::Web100Table table;
+    table.add_lines(lines);
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    for (auto line : split(lines, "\n")) {
+        (void)messages::add_to_report(entry, "web100_data", line);
+    }
+    REQUIRE(table.as_json() == (*entry)["web100_data"]);
+    REQUIRE(table.size() == 3);
+}
+
 TEST_CASE("format_any() deals with too large input") {
     ErrorOr<Buffer> x = messages::format_any(1, std::string(131072, 'x'));
     REQUIRE(!x);
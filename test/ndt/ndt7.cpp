@@ -0,0 +1,311 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/ndt/ndt7_impl.hpp"
+#include "src/libmeasurement_kit/ndt/utils.hpp"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#endif
+
+using namespace mk;
+using namespace mk::ndt;
+
+/*
+             _ _
+ _   _ _ __ (_) |_
+| | | | '_ \| | __|
+| |_| | | | | | |_
+ \__,_|_| |_|_|\__|
+
+*/
+
+static void fail_connect(SharedPtr<Context>, std::string,
+                         Callback<Error, SharedPtr<Transport>,
+                                  SharedPtr<Buffer>> cb) {
+    cb(MockedError(), {}, Buffer::make());
+}
+
+static SharedPtr<Context> make_context(Settings settings = {}) {
+    SharedPtr<Context> ctx{std::make_shared<Context>()};
+    ctx->address = "127.0.0.1";
+    ctx->entry.reset(new nlohmann::json);
+    ctx->logger = Logger::make();
+    ctx->port = NDT7_TLS_PORT;
+    ctx->reactor = Reactor::make();
+    ctx->settings = settings;
+    return ctx;
+}
+
+TEST_CASE("ndt7::download() deals with connect error") {
+    ndt7::download_impl<fail_connect>(make_context(), [](Error err) {
+        REQUIRE(err == ConnectTestConnectionError());
+        REQUIRE(err.child_errors.size() == 1);
+        REQUIRE(err.child_errors[0] == MockedError());
+    });
+}
+
+TEST_CASE("ndt7::upload() deals with connect error") {
+    ndt7::upload_impl<fail_connect>(make_context(), [](Error err) {
+        REQUIRE(err == ConnectTestConnectionError());
+    });
+}
+
+TEST_CASE("ndt7::upload() rejects invalid durations") {
+    for (std::string duration : {"foo", "0", "-1"}) {
+        ndt7::upload_impl<fail_connect>(
+              make_context({{"ndt7/upload_duration", duration}}),
+              [](Error err) { REQUIRE(err == InvalidDurationError()); });
+    }
+}
+
+static int num_downloads = 0;
+static int num_uploads = 0;
+
+static void download_ok(SharedPtr<Context>, Callback<Error> cb) {
+    ++num_downloads;
+    cb(NoError());
+}
+
+static void download_fail(SharedPtr<Context>, Callback<Error> cb) {
+    ++num_downloads;
+    cb(MockedError());
+}
+
+static void upload_ok(SharedPtr<Context>, Callback<Error> cb) {
+    ++num_uploads;
+    cb(NoError());
+}
+
+TEST_CASE("ndt7::run_with_specific_server() honours the test suite") {
+    num_downloads = num_uploads = 0;
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+
+    SECTION("By default we run both subtests") {
+        ndt7::run_with_specific_server_impl<download_ok, upload_ok>(
+              entry, "127.0.0.1", 443, [](Error err) { REQUIRE(!err); }, {},
+              Reactor::make(), Logger::make());
+        REQUIRE(num_downloads == 1);
+        REQUIRE(num_uploads == 1);
+        REQUIRE((*entry)["protocol"] == "ndt7");
+        REQUIRE((*entry)["server_port"] == 443);
+    }
+
+    SECTION("We can only run the upload") {
+        ndt7::run_with_specific_server_impl<download_ok, upload_ok>(
+              entry, "127.0.0.1", 443, [](Error err) { REQUIRE(!err); },
+              {{"test_suite", TEST_C2S}}, Reactor::make(), Logger::make());
+        REQUIRE(num_downloads == 0);
+        REQUIRE(num_uploads == 1);
+    }
+
+    SECTION("We stop if the download fails") {
+        ndt7::run_with_specific_server_impl<download_fail, upload_ok>(
+              entry, "127.0.0.1", 443,
+              [](Error err) { REQUIRE(err == MockedError()); }, {},
+              Reactor::make(), Logger::make());
+        REQUIRE(num_downloads == 1);
+        REQUIRE(num_uploads == 0);
+    }
+}
+
+#ifdef __linux__
+
+/*
+ _                   _                _
+| | ___   ___  _ __ | |__   __ _  ___| | __
+| |/ _ \ / _ \| '_ \| '_ \ / _` |/ __| |/ /
+| | (_) | (_) | |_) | |_) | (_| | (__|   <
+|_|\___/ \___/| .__/|_.__/ \__,_|\___|_|\_\
+              |_|
+*/
+
+// Minimal blocking ndt7 server speaking plain WebSocket on loopback
+
+static bool send_all(int fd, const std::string &data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = send(fd, data.data() + off, data.size() - off, 0);
+        if (n <= 0) {
+            return false;
+        }
+        off += (size_t)n;
+    }
+    return true;
+}
+
+static std::string accept_handshake(int fd) {
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return "";
+        }
+        request.append(buf, (size_t)n);
+    }
+    std::string path = request.substr(4, request.find(' ', 4) - 4);
+    size_t pos = request.find("Sec-WebSocket-Key: ");
+    std::string key = request.substr(pos + 19, 24);
+    send_all(fd, "HTTP/1.1 101 Switching Protocols\r\n"
+                 "Upgrade: websocket\r\n"
+                 "Connection: Upgrade\r\n"
+                 "Sec-WebSocket-Accept: " + net::ws_accept_key(key) + "\r\n"
+                 "Sec-WebSocket-Protocol: " NDT7_PROTOCOL "\r\n"
+                 "\r\n");
+    return path;
+}
+
+// Reads and parses what the client sends until it closes the WebSocket
+static void serve_until_close(int fd, size_t *binary, size_t *texts) {
+    net::WsParser parser{MK_WS_MAX_MESSAGE_SIZE, true};
+    bool closed = false;
+    parser.on_binary([&](size_t count) { *binary += count; });
+    parser.on_message([&](uint8_t opcode, std::string) {
+        if (opcode == MK_WS_OPCODE_TEXT) {
+            *texts += 1;
+        } else if (opcode == MK_WS_OPCODE_CLOSE) {
+            closed = true;
+        }
+    });
+    char buf[65536];
+    Buffer data;
+    while (!closed) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return;
+        }
+        data.write(buf, (size_t)n);
+        if (parser.feed(data) != NoError()) {
+            return;
+        }
+    }
+}
+
+struct LoopbackResults {
+    std::string download_path;
+    std::string upload_path;
+    size_t download_texts = 0;
+    size_t upload_binary = 0;
+    size_t upload_texts = 0;
+};
+
+static void loopback_server(int listener, LoopbackResults *results) {
+    int fd = accept(listener, nullptr, nullptr);
+    results->download_path = accept_handshake(fd);
+    std::string payload(8192, 'x');
+    auto begin = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - begin <
+           std::chrono::milliseconds(1200)) {
+        send_all(fd, *net::ws_frame(MK_WS_OPCODE_BINARY, payload, false));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    nlohmann::json measurement{
+          {"Origin", "server"},
+          {"Test", "download"},
+          {"TCPInfo",
+           {{"BusyTime", 1000000},
+            {"MinRTT", 100},
+            {"RTT", 250},
+            {"RWndLimited", 250000},
+            {"SegsOut", 1000},
+            {"SndBufLimited", 0},
+            {"SndMSS", 65483},
+            {"TotalRetrans", 10}}}};
+    send_all(fd, *net::ws_frame(MK_WS_OPCODE_TEXT, measurement.dump(), false));
+    send_all(fd, *net::ws_frame(MK_WS_OPCODE_CLOSE,
+                                net::ws_close_payload(MK_WS_CLOSE_NORMAL),
+                                false));
+    size_t ignored = 0;
+    serve_until_close(fd, &ignored, &results->download_texts);
+    close(fd);
+
+    fd = accept(listener, nullptr, nullptr);
+    results->upload_path = accept_handshake(fd);
+    serve_until_close(fd, &results->upload_binary, &results->upload_texts);
+    send_all(fd, *net::ws_frame(MK_WS_OPCODE_CLOSE,
+                                net::ws_close_payload(MK_WS_CLOSE_NORMAL),
+                                false));
+    close(fd);
+}
+
+TEST_CASE("ndt7 works with a loopback server") {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    REQUIRE(bind(listener, (sockaddr *)&sin, len) == 0);
+    REQUIRE(listen(listener, 8) == 0);
+    REQUIRE(getsockname(listener, (sockaddr *)&sin, &len) == 0);
+    LoopbackResults results;
+    std::thread server{loopback_server, listener, &results};
+
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["ndt7/tls"] = false;
+    settings["ndt7/upload_duration"] = 1.0;
+    Error error = MockedError();
+    reactor->run_with_initial_event([&]() {
+        ndt7::run_with_specific_server(entry, "127.0.0.1", ntohs(sin.sin_port),
+                                       [&](Error err) {
+                                           error = err;
+                                           reactor->stop();
+                                       },
+                                       settings, reactor, Logger::make());
+    });
+    server.join();
+    close(listener);
+
+    REQUIRE(!error);
+    REQUIRE(results.download_path == NDT7_DOWNLOAD_PATH);
+    REQUIRE(results.upload_path == NDT7_UPLOAD_PATH);
+    REQUIRE((*entry)["protocol"] == "ndt7");
+
+    REQUIRE((*entry)["test_s2c"].size() == 1);
+    nlohmann::json download = (*entry)["test_s2c"][0];
+    REQUIRE(download["receiver_data"].size() >= 2);
+    REQUIRE(download["client_measurements"].size() >= 2);
+    REQUIRE(download["server_measurements"].size() == 1);
+    REQUIRE(download["throughput"]["average"].get<double>() > 0.0);
+    REQUIRE(download["connect_times"].size() == 1);
+    for (auto &m : download["client_measurements"]) {
+        // TCPInfo uses the names and the microseconds of the specification
+        if (m.count("TCPInfo") != 0) {
+            REQUIRE(m["TCPInfo"].count("rtt") == 0);
+            REQUIRE(m["TCPInfo"]["RTT"].is_number_integer());
+            REQUIRE(m["TCPInfo"]["ElapsedTime"] == m["AppInfo"]["ElapsedTime"]);
+        }
+    }
+
+    REQUIRE((*entry)["test_c2s"].size() == 1);
+    nlohmann::json upload = (*entry)["test_c2s"][0];
+    REQUIRE(upload["sender_data"].size() >= 1);
+    REQUIRE(upload["client_measurements"].size() >= 1);
+    REQUIRE(upload["throughput"]["average"].get<double>() > 0.0);
+    REQUIRE(results.upload_binary > 0);
+    REQUIRE(results.upload_texts == upload["client_measurements"].size());
+
+    nlohmann::json advanced =
+          utils::compute_advanced_stats_throws(*entry, Logger::make());
+    REQUIRE(advanced["avg_rtt"] == Approx(0.25));
+    REQUIRE(advanced["min_rtt"] == Approx(0.1));
+    REQUIRE(advanced["mss"] == 65483);
+    REQUIRE(advanced["packet_loss"] == Approx(0.01));
+    REQUIRE(advanced["receiver_limited"] == Approx(0.25));
+}
+
+#endif
@@ -113,6 +113,45 @@ TEST_CASE("run() deals with mlab-ns query error") {
         Reactor::make(), Logger::make());
 }
 
+TEST_CASE("run() deals with invalid protocol error") {
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    run(entry, [](Error err) { REQUIRE(err == InvalidProtocolError()); },
+        {
+            {"protocol", "ndt8"},
+        }, Reactor::make(), Logger::make());
+}
+
+static void ndt7_query(std::string tool, Callback<Error, mlabns::Reply> cb,
+                       Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(tool == "ndt7");
+    mlabns::Reply reply;
+    reply.fqdn = "ndt.example.com";
+    cb(NoError(), reply);
+}
+
+static void legacy_die(SharedPtr<nlohmann::json>, std::string, int,
+                       Callback<Error>, Settings, SharedPtr<Reactor>,
+                       SharedPtr<Logger>) {
+    REQUIRE(false);
+}
+
+static void ndt7_check(SharedPtr<nlohmann::json>, std::string address,
+                       int port, Callback<Error> cb, Settings,
+                       SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(address == "ndt.example.com");
+    REQUIRE(port == 443);
+    cb(MockedError());
+}
+
+TEST_CASE("run() dispatches to ndt7 when requested") {
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    run_impl<legacy_die, ndt7_query, ndt7_check>(
+        entry, [](Error err) { REQUIRE(err == MockedError()); },
+        {
+            {"protocol", "ndt7"},
+        }, Reactor::make(), Logger::make());
+}
+
 /*
  _       _                       _   _
 (_)_ __ | |_ ___  __ _ _ __ __ _| |_(_) ___  _ __
@@ -11,15 +11,16 @@
 using namespace mk;
 using namespace mk::ndt;
 
-static void fail(std::string, int, Callback<Error, SharedPtr<Transport>> cb, Settings,
+static void fail(std::string, int, int,
+                 Callback<Error, std::vector<SharedPtr<Transport>>> cb, Settings,
                  SharedPtr<Reactor>, SharedPtr<Logger>) {
-    cb(MockedError(), nullptr);
+    cb(MockedError(), {});
 }
 
 TEST_CASE("coroutine() is robust to connect error") {
     SharedPtr<nlohmann::json> entry{new nlohmann::json};
     test_c2s::coroutine_impl<fail>(
-        entry, "www.google.com", 3301, 10.0,
+        entry, "www.google.com", 3301,
         [](Error err, Continuation<Error>) { REQUIRE(err == MockedError()); },
         2.0, {}, Reactor::make(), Logger::make());
 }
@@ -58,6 +59,26 @@ TEST_CASE("run() deals with receiving invalid port") {
         ctx, [](Error err) { REQUIRE(err == InvalidPortError()); });
 }
 
+static void empty_port(SharedPtr<Context>,
+                       Callback<Error, uint8_t, std::string> cb,
+                       SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "");
+}
+
+static void blank_port(SharedPtr<Context>,
+                       Callback<Error, uint8_t, std::string> cb,
+                       SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "  ");
+}
+
+TEST_CASE("run() deals with receiving an empty TEST_PREPARE") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<empty_port>(
+        ctx, [](Error err) { REQUIRE(err == InvalidPortError()); });
+    test_c2s::run_impl<blank_port>(
+        ctx, [](Error err) { REQUIRE(err == InvalidPortError()); });
+}
+
 static void too_large(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
                       SharedPtr<Reactor> = Reactor::make()) {
     cb(NoError(), TEST_PREPARE, "65536");
@@ -86,7 +107,7 @@ static void test_prepare(SharedPtr<Context>,
     cb(NoError(), TEST_PREPARE, "3010");
 }
 
-static void fail(SharedPtr<nlohmann::json>, std::string, int, double,
+static void fail(SharedPtr<nlohmann::json>, std::string, test_c2s::Params,
                  Callback<Error, Continuation<Error>> cb, double, Settings,
                  SharedPtr<Reactor>, SharedPtr<Logger>) {
     cb(MockedError(), [](Callback<Error>) {
@@ -94,13 +115,48 @@ static void fail(SharedPtr<nlohmann::json>, std::string, int, double,
     });
 }
 
+static void test_prepare_ext(SharedPtr<Context>,
+                             Callback<Error, uint8_t, std::string> cb,
+                             SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "3010 5000.0 0 250.0 0.0 4");
+}
+
+static void check_params(SharedPtr<nlohmann::json> entry, std::string,
+                         test_c2s::Params params,
+                         Callback<Error, Continuation<Error>> cb, double,
+                         Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(params.port == 3010);
+    REQUIRE(params.duration == 5.0);
+    REQUIRE(params.num_streams == 4);
+    REQUIRE((*entry)["params"]["num_streams"] == 4);
+    cb(MockedError(), nullptr);
+}
+
+TEST_CASE("run() parses the parameters of C2S_EXT") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<test_prepare_ext, check_params>(
+        ctx, [](Error err) { REQUIRE(err == ConnectTestConnectionError()); });
+}
+
+static void invalid_num_streams(SharedPtr<Context>,
+                                Callback<Error, uint8_t, std::string> cb,
+                                SharedPtr<Reactor> = Reactor::make()) {
+    cb(NoError(), TEST_PREPARE, "3010 5000.0 0 250.0 0.0 9");
+}
+
+TEST_CASE("run() deals with receiving invalid num-streams") {
+    SharedPtr<Context> ctx(new Context);
+    test_c2s::run_impl<invalid_num_streams>(
+        ctx, [](Error err) { REQUIRE(err == InvalidNumStreamsError()); });
+}
+
 TEST_CASE("run() deals with coroutine fail") {
     SharedPtr<Context> ctx(new Context);
     test_c2s::run_impl<test_prepare, fail>(
         ctx, [](Error err) { REQUIRE(err == ConnectTestConnectionError()); });
 }
 
-static void connect_but_fail_later(SharedPtr<nlohmann::json>, std::string, int, double,
+static void connect_but_fail_later(SharedPtr<nlohmann::json>, std::string, test_c2s::Params,
                                    Callback<Error, Continuation<Error>> cb,
                                    double, Settings, SharedPtr<Reactor>,
                                    SharedPtr<Logger>) {
@@ -130,7 +186,7 @@ TEST_CASE("run() deals with coroutine terminating with error") {
         ctx, [](Error err) { REQUIRE(err == MockedError()); });
 }
 
-static void coro_ok(SharedPtr<nlohmann::json>, std::string, int, double,
+static void coro_ok(SharedPtr<nlohmann::json>, std::string, test_c2s::Params,
                     Callback<Error, Continuation<Error>> cb, double, Settings,
                     SharedPtr<Reactor>, SharedPtr<Logger>) {
     cb(NoError(), [](Callback<Error> cb) { cb(NoError()); });
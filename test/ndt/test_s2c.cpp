@@ -69,6 +69,35 @@ TEST_CASE("finalizing_test() deals with receiving invalid json") {
         ctx, entry, [](Error err) { REQUIRE(err == NoError()); });
 }
 
+static void web100(SharedPtr<Context>, Callback<Error, uint8_t, std::string> cb,
+                   SharedPtr<Reactor> = Reactor::make()) {
+    static int count = 0;
+    switch (count++) {
+    case 0:
+        cb(NoError(), TEST_MSG, "CurMSS: 1448\nMinRTT: 4\n");
+        break;
+    case 1:
+        cb(NoError(), TEST_MSG, "MaxRTT: 12.5\nCurMSS: 1460\n");
+        break;
+    default:
+        cb(NoError(), TEST_FINALIZE, "");
+        break;
+    }
+}
+
+TEST_CASE("finalizing_test() saves web100 data when the test is over") {
+    SharedPtr<Context> ctx(new Context);
+    ctx->entry.reset(new nlohmann::json);
+    SharedPtr<nlohmann::json> entry(new nlohmann::json);
+    test_s2c::finalizing_test_impl<web100>(
+        ctx, entry, [](Error err) { REQUIRE(err == NoError()); });
+    REQUIRE((*ctx->entry)["test_s2c"].size() == 1);
+    nlohmann::json data = (*ctx->entry)["test_s2c"][0]["web100_data"];
+    REQUIRE(data["CurMSS"] == 1460);
+    REQUIRE(data["MaxRTT"] == 12.5);
+    REQUIRE(data["MinRTT"] == 4);
+}
+
 TEST_CASE("run() deals with messages::read() failure") {
     SharedPtr<Context> ctx(new Context);
     test_s2c::run_impl<failure>(
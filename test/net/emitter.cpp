@@ -92,3 +92,37 @@ TEST_CASE("The record-sent-data feature works") {
         REQUIRE(transport.sent_data().read() == "foo");
     }
 }
+
+TEST_CASE("The drain feature works") {
+    SECTION("Data is discarded and only its size is reported") {
+        Emitter emitter(Reactor::make(), Logger::make());
+        Transport &transport = emitter;
+        size_t total = 0;
+        transport.on_data([](Buffer) { REQUIRE(false); });
+        transport.on_drain([&total](size_t count) { total += count; });
+        transport.emit_data(Buffer("foobar"));
+        transport.emit_drain(17);
+        REQUIRE(total == 23);
+    }
+
+    SECTION("Draining does not prevent recording received data") {
+        Emitter emitter(Reactor::make(), Logger::make());
+        Transport &transport = emitter;
+        size_t total = 0;
+        transport.record_received_data();
+        transport.on_drain([&total](size_t count) { total += count; });
+        transport.emit_data(Buffer("foobar"));
+        REQUIRE(total == 6);
+        REQUIRE(transport.received_data().peek() == "foobar");
+    }
+
+    SECTION("Setting a data handler stops draining") {
+        Emitter emitter(Reactor::make(), Logger::make());
+        Transport &transport = emitter;
+        std::string data;
+        transport.on_drain([](size_t) { REQUIRE(false); });
+        transport.on_data([&data](Buffer buff) { data += buff.read(); });
+        transport.emit_data(Buffer("foobar"));
+        REQUIRE(data == "foobar");
+    }
+}
@@ -6,8 +6,92 @@
 
 #include "include/private/catch.hpp"
 
+#include "src/libmeasurement_kit/net/connect.hpp"
 #include "src/libmeasurement_kit/net/libevent_emitter.hpp"
 
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#endif
+
 using namespace mk;
 
-// TODO: Write tests for the LibeventEmitter class
+#ifdef __linux__
+
+// Sends `size` bytes to the first accepted connection and closes it
+static void send_and_close(int listener, size_t size) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd == -1) {
+        return;
+    }
+    std::string data(size, 'x');
+    (void)send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    close(fd);
+}
+
+static int make_listener(int *port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    REQUIRE(bind(listener, (sockaddr *)&sin, len) == 0);
+    REQUIRE(listen(listener, 8) == 0);
+    REQUIRE(getsockname(listener, (sockaddr *)&sin, &len) == 0);
+    *port = ntohs(sin.sin_port);
+    return listener;
+}
+
+// Drains a connection to a server sending `size` bytes, using `on_drain`
+// as drain handler, and returns the errors emitted in the first second
+static std::vector<Error> drain_with(size_t size,
+                                     std::function<void(size_t)> on_drain) {
+    int port = 0;
+    int listener = make_listener(&port);
+    std::thread server{send_and_close, listener, size};
+    SharedPtr<Reactor> reactor = Reactor::make();
+    std::vector<Error> errors;
+    reactor->run_with_initial_event([&]() {
+        net::connect("127.0.0.1", port, [&](Error err,
+                                            SharedPtr<net::Transport> txp) {
+            REQUIRE(!err);
+            txp->on_error([&](Error error) { errors.push_back(error); });
+            txp->on_drain(on_drain);
+            // Would keep firing the error if the persistent drain event
+            // were not deleted when the error is emitted
+            reactor->call_later(1.0, [=]() {
+                txp->close([=]() { reactor->stop(); });
+            });
+        }, {}, reactor, Logger::make());
+    });
+    server.join();
+    close(listener);
+    return errors;
+}
+
+TEST_CASE("LibeventEmitter emits EOF once when draining") {
+    size_t total = 0;
+    std::vector<Error> errors = drain_with(
+          1 << 20, [&](size_t count) { total += count; });
+    REQUIRE(total == 1 << 20);
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == net::EofError());
+}
+
+TEST_CASE("LibeventEmitter routes errors thrown by the drain handler") {
+    size_t calls = 0;
+    std::vector<Error> errors = drain_with(1 << 20, [&](size_t) {
+        calls += 1;
+        throw ValueError();
+    });
+    REQUIRE(calls == 1);
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == ValueError());
+}
+
+#endif
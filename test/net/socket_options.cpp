@@ -0,0 +1,123 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/net/connect.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
+#include "src/libmeasurement_kit/net/socket_options.hpp"
+#include "src/libmeasurement_kit/net/utils.hpp"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace mk;
+using namespace mk::net;
+
+TEST_CASE("SocketOptions::from_settings() works as expected") {
+    SECTION("By default we keep the OS defaults") {
+        ErrorOr<SocketOptions> options = SocketOptions::from_settings({});
+        REQUIRE(!!options);
+        REQUIRE(options->tcp_nodelay == true);
+        REQUIRE(options->needs_socket() == false);
+    }
+
+    SECTION("Options are parsed correctly") {
+        Settings settings;
+        settings["net/rcvbuf"] = 65536;
+        settings["net/tcp_nodelay"] = false;
+        settings["net/tcp_congestion"] = "bbr";
+        settings["net/tcp_fastopen"] = true;
+        ErrorOr<SocketOptions> options = SocketOptions::from_settings(settings);
+        REQUIRE(!!options);
+        REQUIRE(options->rcvbuf == 65536);
+        REQUIRE(options->sndbuf == 0);
+        REQUIRE(options->tcp_nodelay == false);
+        REQUIRE(options->tcp_congestion == "bbr");
+        REQUIRE(options->tcp_fastopen == true);
+        REQUIRE(options->needs_socket() == true);
+    }
+
+    SECTION("Invalid values are rejected") {
+        Settings settings;
+        settings["net/sndbuf"] = -1;
+        REQUIRE(!SocketOptions::from_settings(settings));
+        settings["net/sndbuf"] = "foo";
+        REQUIRE(!SocketOptions::from_settings(settings));
+    }
+}
+
+TEST_CASE("socket_options_copy() only copies socket options") {
+    Settings from, to;
+    from["net/rcvbuf"] = 1024;
+    from["net/tcp_congestion"] = "reno";
+    from["net/timeout"] = 3.0;
+    socket_options_copy(from, to);
+    REQUIRE(to.size() == 2);
+    REQUIRE(to["net/rcvbuf"].as<int>() == 1024);
+    REQUIRE(to["net/tcp_congestion"].as_string() == "reno");
+}
+
+TEST_CASE("socket_options_effective() returns null without a socket") {
+    SharedPtr<Transport> txp{
+          std::make_shared<Emitter>(Reactor::make(), Logger::make())};
+    REQUIRE(socket_options_effective(txp) == nullptr);
+}
+
+#ifdef __linux__
+
+TEST_CASE("socket_options_apply() sets the options") {
+    socket_t sockfd = socket_create(AF_INET, SOCK_STREAM, 0, Logger::make());
+    REQUIRE(sockfd != -1);
+    SocketOptions options;
+    options.sndbuf = 65536;
+    options.tcp_congestion = "reno"; // Always available on Linux
+    options.tcp_notsent_lowat = 16384;
+    socket_options_apply(sockfd, options, Logger::make());
+    nlohmann::json effective = socket_options_read(sockfd);
+    // Linux doubles the value to account for bookkeeping overhead
+    REQUIRE(effective.at("sndbuf").get<int>() >= 65536);
+    REQUIRE(effective.at("tcp_congestion") == "reno");
+    REQUIRE(effective.at("tcp_notsent_lowat") == 16384);
+    REQUIRE(effective.at("tcp_nodelay") == false);
+    close(sockfd);
+}
+
+TEST_CASE("net::connect() applies the socket options") {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener != -1);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    REQUIRE(bind(listener, (sockaddr *)&sin, len) == 0);
+    REQUIRE(listen(listener, 8) == 0);
+    REQUIRE(getsockname(listener, (sockaddr *)&sin, &len) == 0);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["net/rcvbuf"] = 131072;
+    settings["net/tcp_congestion"] = "reno";
+    nlohmann::json effective;
+    reactor->run_with_initial_event([&]() {
+        connect("127.0.0.1", ntohs(sin.sin_port),
+                [&](Error err, SharedPtr<Transport> txp) {
+                    REQUIRE(!err);
+                    effective = socket_options_effective(txp);
+                    txp->close([&]() { reactor->stop(); });
+                },
+                settings, reactor, Logger::make());
+    });
+    close(listener);
+    REQUIRE(effective.at("rcvbuf").get<int>() >= 131072);
+    REQUIRE(effective.at("tcp_congestion") == "reno");
+    REQUIRE(effective.at("tcp_nodelay") == true);
+}
+
+#endif
@@ -0,0 +1,162 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/net/connect.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
+#include "src/libmeasurement_kit/net/tcp_info.hpp"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace mk;
+using namespace mk::net;
+
+TEST_CASE("tcp_info_socket() returns -1 for transports without a socket") {
+    SharedPtr<Transport> txp{
+          std::make_shared<Emitter>(Reactor::make(), Logger::make())};
+    REQUIRE(tcp_info_socket(txp) == (socket_t)-1);
+}
+
+TEST_CASE("TcpInfoSampler skips flows without a socket") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Transport> txp{std::make_shared<Emitter>(reactor, Logger::make())};
+    Settings settings;
+    settings["net/tcp_info_interval"] = 0.01;
+    auto sampler = TcpInfoSampler::make({txp}, settings, reactor, Logger::make());
+    reactor->run_with_initial_event([&]() {
+        sampler->start();
+        reactor->call_later(0.1, [&]() {
+            sampler->stop();
+            reactor->stop();
+        });
+    });
+    nlohmann::json samples = sampler->take();
+    REQUIRE(samples.size() == 1);
+    REQUIRE(samples[0].size() == 0);
+}
+
+TEST_CASE("TcpInfoSampler is disabled by default") {
+    auto sampler = TcpInfoSampler::make({}, {}, Reactor::make(),
+                                        Logger::make());
+    REQUIRE(!sampler->enabled());
+}
+
+TEST_CASE("TcpInfoSampler does nothing when the interval is not positive") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["net/tcp_info_interval"] = 0.0;
+    auto sampler = TcpInfoSampler::make({}, settings, reactor, Logger::make());
+    sampler->start();
+    sampler->stop();
+    REQUIRE(sampler->take() == nlohmann::json::array());
+}
+
+#ifdef __linux__
+
+static int listen_loopback(int *port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(fd != -1);
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(sin);
+    REQUIRE(bind(fd, (sockaddr *)&sin, len) == 0);
+    REQUIRE(listen(fd, 8) == 0);
+    REQUIRE(getsockname(fd, (sockaddr *)&sin, &len) == 0);
+    *port = ntohs(sin.sin_port);
+    return fd;
+}
+
+TEST_CASE("tcp_info_sample() fails for sockets that are not TCP") {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    REQUIRE(fd != -1);
+    REQUIRE(!tcp_info_sample(fd));
+    close(fd);
+}
+
+TEST_CASE("TcpInfoSampler samples a loopback connection") {
+    int port = 0;
+    int listener = listen_loopback(&port);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["net/tcp_info_interval"] = 0.01;
+    SharedPtr<TcpInfoSampler> sampler;
+    reactor->run_with_initial_event([&]() {
+        connect("127.0.0.1", port, [&](Error err, SharedPtr<Transport> txp) {
+            REQUIRE(!err);
+            REQUIRE(tcp_info_socket(txp) != (socket_t)-1);
+            sampler = TcpInfoSampler::make({txp}, settings, reactor,
+                                           Logger::make());
+            sampler->start();
+            reactor->call_later(0.1, [&, txp]() {
+                sampler->stop();
+                txp->close([&]() { reactor->stop(); });
+            });
+        }, settings, reactor, Logger::make());
+    });
+    close(listener);
+    nlohmann::json samples = sampler->take();
+    REQUIRE(samples.size() == 1);
+    REQUIRE(samples[0].size() >= 2); // One when starting, one when stopping
+    for (auto &sample : samples[0]) {
+        REQUIRE(sample.at("elapsed").get<double>() >= 0.0);
+        REQUIRE(sample.at("rtt").get<double>() >= 0.0);
+        REQUIRE(sample.at("snd_cwnd").get<uint32_t>() > 0);
+        REQUIRE(sample.count("total_retrans") == 1);
+    }
+    REQUIRE(sampler->take()[0].size() == 0);
+}
+
+TEST_CASE("TcpInfoSampler keeps sampling the flows that were not removed") {
+    int port = 0;
+    int listener = listen_loopback(&port);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["net/tcp_info_interval"] = 0.01;
+    std::vector<SharedPtr<Transport>> flows;
+    SharedPtr<TcpInfoSampler> sampler;
+    auto on_connect = [&](Error err, SharedPtr<Transport> txp) {
+        REQUIRE(!err);
+        flows.push_back(txp);
+        if (flows.size() < 2) {
+            return;
+        }
+        sampler = TcpInfoSampler::make(flows, settings, reactor,
+                                       Logger::make());
+        flows.clear();
+        sampler->start();
+        reactor->call_later(0.05, [&]() {
+            sampler->remove(0);
+            sampler->remove(7); // Ignored
+        });
+        reactor->call_later(0.2, [&]() {
+            sampler->stop();
+            reactor->stop();
+        });
+    };
+    reactor->run_with_initial_event([&]() {
+        connect("127.0.0.1", port, on_connect, settings, reactor,
+                Logger::make());
+        connect("127.0.0.1", port, on_connect, settings, reactor,
+                Logger::make());
+    });
+    close(listener);
+    nlohmann::json samples = sampler->take();
+    REQUIRE(samples.size() == 2);
+    REQUIRE(samples[0].size() >= 2);
+    REQUIRE(samples[1].size() > samples[0].size());
+    for (auto &sample : samples[0]) {
+        REQUIRE(sample.at("elapsed").get<double>() < 0.2);
+    }
+}
+
+#endif
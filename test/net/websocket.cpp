@@ -0,0 +1,183 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/net/websocket.hpp"
+
+#include <vector>
+
+using namespace mk;
+using namespace mk::net;
+
+TEST_CASE("ws_accept_key() works as expected") {
+    // See the example in RFC 6455, Sect. 1.3
+    REQUIRE(ws_accept_key("dGhlIHNhbXBsZSBub25jZQ==") ==
+            "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST_CASE("ws_handshake_key() returns a base64 encoded 16 byte nonce") {
+    std::string key = ws_handshake_key();
+    REQUIRE(key.size() == 24);
+    REQUIRE(key != ws_handshake_key());
+}
+
+TEST_CASE("ws_frame() formats frames correctly") {
+    SECTION("For short unmasked frames") {
+        SharedPtr<std::string> frame = ws_frame(MK_WS_OPCODE_TEXT, "abc", false);
+        REQUIRE(*frame == std::string{"\x81\x03" "abc"});
+    }
+
+    SECTION("For 16 bit lengths") {
+        SharedPtr<std::string> frame =
+              ws_frame(MK_WS_OPCODE_BINARY, std::string(300, 'x'), false);
+        REQUIRE(frame->size() == 4 + 300);
+        REQUIRE((uint8_t)(*frame)[1] == 126);
+        REQUIRE((uint8_t)(*frame)[2] == 1);
+        REQUIRE((uint8_t)(*frame)[3] == 44);
+    }
+
+    SECTION("Using a new masking key for each frame") {
+        SharedPtr<std::string> first = ws_frame(MK_WS_OPCODE_TEXT, "ab", true);
+        SharedPtr<std::string> second = ws_frame(MK_WS_OPCODE_TEXT, "ab", true);
+        REQUIRE(first->size() == 8);
+        // Keys are random, so they collide with probability 2^-32
+        REQUIRE(first->substr(2, 4) != second->substr(2, 4));
+    }
+
+    SECTION("For 64 bit lengths") {
+        SharedPtr<std::string> frame =
+              ws_frame(MK_WS_OPCODE_BINARY, std::string(70000, 'x'), true);
+        REQUIRE(frame->size() == 10 + 4 + 70000);
+        REQUIRE((uint8_t)(*frame)[1] == (0x80 | 127));
+        REQUIRE((uint8_t)(*frame)[7] == 0x01);
+        REQUIRE((uint8_t)(*frame)[8] == 0x11);
+        REQUIRE((uint8_t)(*frame)[9] == 0x70);
+    }
+}
+
+class Collector {
+  public:
+    explicit Collector(bool masked = false)
+        : parser{MK_WS_MAX_MESSAGE_SIZE, masked} {
+        parser.on_binary([this](size_t count) { binary += count; });
+        parser.on_message([this](uint8_t opcode, std::string payload) {
+            messages.push_back({opcode, payload});
+        });
+    }
+
+    WsParser parser;
+    size_t binary = 0;
+    std::vector<std::pair<uint8_t, std::string>> messages;
+};
+
+TEST_CASE("ws_remask() masks a frame again with a new key") {
+    SECTION("For frames that are not masked") {
+        SharedPtr<std::string> frame = ws_frame(MK_WS_OPCODE_TEXT, "ab", false);
+        REQUIRE_THROWS(ws_remask(*frame));
+    }
+
+    for (size_t size : {2, 300, 70000}) {
+        SECTION("For payloads of " + std::to_string(size) + " bytes") {
+            std::string payload = random_printable(size);
+            SharedPtr<std::string> frame =
+                  ws_frame(MK_WS_OPCODE_TEXT, payload, true);
+            std::string before = *frame;
+            ws_remask(*frame);
+            REQUIRE(frame->size() == before.size());
+            REQUIRE(*frame != before);
+            Collector collector{true};
+            Buffer data;
+            data.write(*frame);
+            REQUIRE(collector.parser.feed(data) == NoError());
+            REQUIRE(collector.messages.size() == 1);
+            REQUIRE(collector.messages[0].second == payload);
+        }
+    }
+}
+
+TEST_CASE("WsParser works as expected") {
+    SECTION("It unmasks messages and counts binary bytes") {
+        Collector collector{true};
+        Buffer data;
+        data.write_reference(ws_frame(MK_WS_OPCODE_TEXT, "hello", true));
+        data.write_reference(
+              ws_frame(MK_WS_OPCODE_BINARY, std::string(70000, 'x'), true));
+        data.write_reference(
+              ws_frame(MK_WS_OPCODE_CLOSE, ws_close_payload(1000), true));
+        REQUIRE(collector.parser.feed(data) == NoError());
+        REQUIRE(data.length() == 0);
+        REQUIRE(collector.binary == 70000);
+        REQUIRE(collector.messages.size() == 2);
+        REQUIRE(collector.messages[0].first == MK_WS_OPCODE_TEXT);
+        REQUIRE(collector.messages[0].second == "hello");
+        REQUIRE(collector.messages[1].first == MK_WS_OPCODE_CLOSE);
+        REQUIRE(collector.messages[1].second == ws_close_payload(1000));
+    }
+
+    SECTION("It deals with data arriving one byte at a time") {
+        Collector collector{true};
+        std::string frames =
+              *ws_frame(MK_WS_OPCODE_TEXT, std::string(200, 'y'), true) +
+              *ws_frame(MK_WS_OPCODE_BINARY, std::string(300, 'z'), true);
+        Buffer data;
+        for (char c : frames) {
+            data.write(&c, 1);
+            REQUIRE(collector.parser.feed(data) == NoError());
+        }
+        REQUIRE(collector.binary == 300);
+        REQUIRE(collector.messages.size() == 1);
+        REQUIRE(collector.messages[0].second == std::string(200, 'y'));
+    }
+
+    SECTION("It reassembles fragmented text messages") {
+        Collector collector;
+        Buffer data;
+        data.write(std::string{"\x01\x02" "ab", 4}); // !FIN, TEXT
+        data.write(std::string{"\x89\x00", 2});      // PING
+        data.write(std::string{"\x80\x02" "cd", 4}); // FIN, CONTINUATION
+        REQUIRE(collector.parser.feed(data) == NoError());
+        REQUIRE(collector.messages.size() == 2);
+        REQUIRE(collector.messages[0].first == MK_WS_OPCODE_PING);
+        REQUIRE(collector.messages[1].second == "abcd");
+    }
+
+    SECTION("It rejects protocol violations") {
+        for (std::string frame : {
+                   std::string{"\xc1\x00", 2},     // RSV1 set
+                   std::string{"\x80\x00", 2},     // Unexpected continuation
+                   std::string{"\x09\x00", 2},     // Fragmented control frame
+                   std::string{"\x83\x00", 2},     // Reserved opcode
+             }) {
+            Collector collector;
+            Buffer data{frame};
+            REQUIRE(collector.parser.feed(data) == WebSocketProtocolError());
+        }
+    }
+
+    SECTION("It rejects masked frames from the server") {
+        Collector collector;
+        Buffer data;
+        data.write_reference(ws_frame(MK_WS_OPCODE_TEXT, "hello", true));
+        REQUIRE(collector.parser.feed(data) == WebSocketProtocolError());
+        REQUIRE(collector.messages.size() == 0);
+    }
+
+    SECTION("It rejects unmasked frames from the client") {
+        Collector collector{true};
+        Buffer data;
+        data.write_reference(ws_frame(MK_WS_OPCODE_TEXT, "hello", false));
+        REQUIRE(collector.parser.feed(data) == WebSocketProtocolError());
+        REQUIRE(collector.messages.size() == 0);
+    }
+
+    SECTION("It rejects text messages that are too big") {
+        WsParser parser{16};
+        Buffer data;
+        data.write_reference(
+              ws_frame(MK_WS_OPCODE_TEXT, std::string(17, 'x'), false));
+        REQUIRE(parser.feed(data) == WebSocketMessageTooBigError());
+    }
+}
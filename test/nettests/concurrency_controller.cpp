@@ -0,0 +1,140 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/nettests/concurrency_controller.hpp"
+#include "src/libmeasurement_kit/nettests/runnable.hpp"
+
+using namespace mk::nettests;
+using namespace mk;
+
+TEST_CASE("ConcurrencyController grows by about one for each round") {
+    SharedPtr<ConcurrencyController> cc = ConcurrencyController::make({
+          {"parallelism/initial", 2},
+    });
+    REQUIRE(cc->limit() == 2);
+    for (int i = 0; i < 3; ++i) {
+        cc->on_measurement_done(1.0, false);
+    }
+    REQUIRE(cc->limit() == 3);
+    for (int i = 0; i < 3; ++i) {
+        cc->on_measurement_done(1.0, false);
+    }
+    REQUIRE(cc->limit() == 4);
+}
+
+TEST_CASE("ConcurrencyController stays within bounds") {
+    SharedPtr<ConcurrencyController> cc = ConcurrencyController::make({
+          {"parallelism/min", 2},
+          {"parallelism/max", 5},
+          {"parallelism/initial", 100},
+    });
+    REQUIRE(cc->limit() == 5);
+    for (int i = 0; i < 100; ++i) {
+        cc->on_measurement_done(1.0, false);
+    }
+    REQUIRE(cc->limit() == 5);
+    for (int i = 0; i < 100; ++i) {
+        cc->on_loop_lag(1.0);
+        cc->on_measurement_done(1.0, true);
+    }
+    REQUIRE(cc->limit() == 2);
+}
+
+TEST_CASE("ConcurrencyController halves the limit once per round") {
+    SharedPtr<ConcurrencyController> cc = ConcurrencyController::make({
+          {"parallelism/initial", 8},
+    });
+    cc->on_measurement_done(1.0, true);
+    REQUIRE(cc->limit() == 8); // A single timeout is not enough
+    cc->on_measurement_done(1.0, true);
+    REQUIRE(cc->limit() == 4);
+    // Measurements started with the old limit do not shrink it again
+    cc->on_loop_lag(1.0);
+    cc->on_measurement_done(1.0, true);
+    REQUIRE(cc->limit() == 4);
+    cc->on_loop_lag(0.01);
+    REQUIRE(cc->limit() == 4);
+}
+
+TEST_CASE("ConcurrencyController forgets old timeouts") {
+    SharedPtr<ConcurrencyController> cc = ConcurrencyController::make({
+          {"parallelism/initial", 8},
+    });
+    cc->on_measurement_done(1.0, true);
+    for (int i = 0; i < 10; ++i) {
+        cc->on_measurement_done(1.0, false);
+    }
+    size_t limit = cc->limit();
+    REQUIRE(limit > 8);
+    // The first timeout is out of the window by now
+    cc->on_measurement_done(1.0, true);
+    REQUIRE(cc->limit() >= limit);
+    cc->on_measurement_done(1.0, true);
+    REQUIRE(cc->limit() < limit);
+}
+
+TEST_CASE("ConcurrencyController shrinks when measurements slow down") {
+    SharedPtr<ConcurrencyController> cc = ConcurrencyController::make({
+          {"parallelism/initial", 8},
+    });
+    for (int i = 0; i < 16; ++i) {
+        cc->on_measurement_done(1.0, false);
+    }
+    size_t limit = cc->limit();
+    REQUIRE(limit > 8);
+    cc->on_measurement_done(10.0, false);
+    REQUIRE(cc->limit() == limit / 2);
+}
+
+class CountingRunnable : public Runnable {
+  public:
+    size_t in_flight = 0;
+    size_t max_in_flight = 0;
+    size_t done = 0;
+
+  protected:
+    void main(std::string, Settings,
+              Callback<SharedPtr<nlohmann::json>> cb) override {
+        in_flight += 1;
+        max_in_flight = std::max(max_in_flight, in_flight);
+        reactor->call_later(0.01, [=]() {
+            in_flight -= 1;
+            done += 1;
+            cb(SharedPtr<nlohmann::json>{new nlohmann::json});
+        });
+    }
+};
+
+TEST_CASE("Runnable adapts the number of parallel measurements") {
+    CountingRunnable runnable;
+    runnable.reactor = Reactor::make();
+    runnable.use_bouncer = false;
+    runnable.needs_input = true;
+    for (int i = 0; i < 64; ++i) {
+        runnable.inputs.push_back(std::to_string(i));
+    }
+    runnable.options = {
+          {"parallelism", "auto"},
+          {"parallelism/max", 6},
+          {"no_collector", true},
+          {"no_file_report", true},
+          {"no_geoip", true},
+          {"no_resolver_lookup", true},
+    };
+    Error result = GenericError();
+    runnable.reactor->run_with_initial_event([&]() {
+        runnable.begin([&](Error error) {
+            result = error;
+            runnable.end([&](Error) {});
+        });
+    });
+    REQUIRE(result == NoError());
+    REQUIRE(runnable.done == 64);
+    REQUIRE(runnable.max_in_flight > 3);
+    REQUIRE(runnable.max_in_flight <= 6);
+}
@@ -0,0 +1,70 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/nettests/input_source.hpp"
+#include "src/libmeasurement_kit/ooni/error.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace mk::nettests;
+using namespace mk;
+
+static std::vector<std::string> drain(SharedPtr<InputSource> source) {
+    std::vector<std::string> result;
+    std::string input;
+    while (source->next(input)) {
+        result.push_back(input);
+    }
+    return result;
+}
+
+static const char *input_path = "input_source_test.txt";
+
+static void write_input_file(const std::string &data) {
+    std::ofstream file{input_path, std::ios::binary};
+    file << data;
+}
+
+TEST_CASE("InputSource reads files lazily and in order") {
+    write_input_file("a\nb\n\nc\nd\ne\nf");
+    SharedPtr<InputSource> source = InputSource::make({"x", "y"}, 2);
+    REQUIRE(source->add_file(input_path) == NoError());
+    REQUIRE(source->add_file("/nonexistent") ==
+            ooni::CannotOpenInputFileError());
+    REQUIRE(source->size() == 9);
+    REQUIRE((drain(source) == std::vector<std::string>{
+                  "x", "y", "a", "b", "", "c", "d", "e", "f"}));
+    std::string input;
+    REQUIRE(!source->next(input));
+    REQUIRE(::remove(input_path) == 0);
+}
+
+TEST_CASE("InputSource shuffles blocks and lines within blocks") {
+    std::string data;
+    std::vector<std::string> expect;
+    for (int i = 0; i < 100; ++i) {
+        data += std::to_string(i) + "\n";
+        expect.push_back(std::to_string(i));
+    }
+    write_input_file(data);
+    auto shuffled = [&](uint32_t seed) {
+        SharedPtr<InputSource> source = InputSource::make({}, 8);
+        REQUIRE(source->add_file(input_path) == NoError());
+        source->randomize(seed);
+        REQUIRE(source->size() == 100);
+        return drain(source);
+    };
+    std::vector<std::string> first = shuffled(17);
+    REQUIRE(first != expect);
+    REQUIRE(first == shuffled(17)); // The seed makes it reproducible
+    std::sort(first.begin(), first.end());
+    std::sort(expect.begin(), expect.end());
+    REQUIRE(first == expect);
+    REQUIRE(::remove(input_path) == 0);
+}
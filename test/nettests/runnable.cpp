@@ -9,6 +9,13 @@
 #include <measurement_kit/common/nlohmann/json.hpp>
 #include <measurement_kit/ffi.h>
 
+#include "src/libmeasurement_kit/mlabns/mlabns_impl.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
+#include "src/libmeasurement_kit/nettests/runnable.hpp"
+
+#include <fstream>
+#include <set>
+
 //#include <iostream>  // to debug
 
 // TODO(bassosimone): compare options here with with_runnable ones
@@ -239,3 +246,194 @@ TEST_CASE("Make sure that 'randomize_input' works") {
         REQUIRE(repeat(false, 8) == 9);
     }
 }
+
+TEST_CASE("Runnable emits the duration of each startup phase") {
+    static const char *path = "runnable_startup_phases.njson";
+    mk::nettests::Runnable runnable;
+    runnable.reactor = mk::Reactor::make();
+    runnable.use_bouncer = false;
+    runnable.output_filepath = path;
+    runnable.inputs = {"a", "b"};
+    runnable.needs_input = true;
+    runnable.options = {
+          {"no_collector", true},
+          {"no_geoip", true},
+          {"no_resolver_lookup", true},
+    };
+    std::set<std::string> phases;
+    runnable.logger->on_event_ex("status.startup_phase",
+                                 [&](nlohmann::json &&event) {
+        const nlohmann::json &value = event.at("value");
+        REQUIRE(value.at("duration") >= 0.0);
+        REQUIRE(value.at("elapsed") >= value.at("duration"));
+        phases.insert(value.at("phase").get<std::string>());
+    });
+    mk::Error result = mk::GenericError();
+    runnable.reactor->run_with_initial_event([&]() {
+        runnable.begin([&](mk::Error error) {
+            result = error;
+            runnable.end([&](mk::Error) {});
+        });
+    });
+    REQUIRE(result == mk::NoError());
+    REQUIRE((phases == std::set<std::string>{
+                           "bouncer", "first_measurement", "geoip_lookup",
+                           "open_report", "report_file", "resolver_lookup"}));
+    std::ifstream file{path};
+    std::string line;
+    size_t count = 0;
+    while (std::getline(file, line)) {
+        count += 1;
+    }
+    REQUIRE(count == 2);
+    (void)::remove(path);
+}
+
+TEST_CASE("Runnable does not create the report file if the bouncer fails") {
+    static const char *path = "runnable_bouncer_failure.njson";
+    mk::nettests::Runnable runnable;
+    runnable.reactor = mk::Reactor::make();
+    runnable.output_filepath = path;
+    runnable.inputs = {"a"};
+    runnable.needs_input = true;
+    runnable.options = {
+          {"bouncer_base_url", "http://127.0.0.1:9/"}, // Discard port
+          {"no_collector", true},
+          {"no_geoip", true},
+          {"no_resolver_lookup", true},
+    };
+    std::set<std::string> phases;
+    runnable.logger->on_event_ex("status.startup_phase",
+                                 [&](nlohmann::json &&event) {
+        phases.insert(event.at("value").at("phase").get<std::string>());
+    });
+    mk::Error result = mk::NoError();
+    runnable.reactor->run_with_initial_event([&]() {
+        runnable.begin([&](mk::Error error) {
+            result = error;
+            runnable.end([&](mk::Error) {});
+        });
+    });
+    REQUIRE(result != mk::NoError());
+    REQUIRE(phases.count("bouncer") == 1);
+    // The other phases completed before begin() reported the failure
+    REQUIRE(phases.count("geoip_lookup") == 1);
+    REQUIRE(phases.count("resolver_lookup") == 1);
+    REQUIRE(phases.count("report_file") == 0);
+    REQUIRE(phases.count("open_report") == 0);
+    REQUIRE(!std::ifstream{path}.good());
+}
+
+TEST_CASE("Runnable emits the concurrency with parallelism=auto") {
+    static const char *path = "runnable_concurrency.njson";
+    mk::nettests::Runnable runnable;
+    runnable.reactor = mk::Reactor::make();
+    runnable.use_bouncer = false;
+    runnable.output_filepath = path;
+    runnable.inputs = {"a", "b", "c"};
+    runnable.needs_input = true;
+    runnable.options = {
+          {"no_collector", true},
+          {"no_geoip", true},
+          {"no_resolver_lookup", true},
+          {"parallelism", "auto"},
+          {"parallelism/max", 2},
+    };
+    size_t count = 0;
+    runnable.logger->on_event_ex("status.measurement_start",
+                                 [&](nlohmann::json &&event) {
+        const nlohmann::json &value = event.at("value");
+        REQUIRE(value.at("concurrency") >= 1);
+        REQUIRE(value.at("concurrency") <= 2);
+        count += 1;
+    });
+    mk::Error result = mk::GenericError();
+    runnable.reactor->run_with_initial_event([&]() {
+        runnable.begin([&](mk::Error error) {
+            result = error;
+            runnable.end([&](mk::Error) {});
+        });
+    });
+    REQUIRE(result == mk::NoError());
+    REQUIRE(count == 3);
+    (void)::remove(path);
+}
+
+static int mlabns_probes = 0;
+
+static void mlabns_candidates(
+      std::string, std::string, mk::http::Headers,
+      mk::Callback<mk::Error, mk::SharedPtr<mk::http::Response>,
+                   nlohmann::json> cb,
+      mk::Settings, mk::SharedPtr<mk::Reactor>, mk::SharedPtr<mk::Logger>) {
+    cb(mk::NoError(), mk::SharedPtr<mk::http::Response>::make(),
+       nlohmann::json{
+             {"city", "City"},
+             {"country", "IT"},
+             {"fqdn", "ndt.mlab1.mil01.measurement-lab.org"},
+             {"ip", {"127.0.0.1"}},
+             {"site", "mil01"},
+             {"url", "http://ndt.mlab1.mil01.measurement-lab.org:7123"},
+       });
+}
+
+static void mlabns_connect(
+      std::string, int,
+      mk::Callback<mk::Error, mk::SharedPtr<mk::net::Transport>> cb,
+      mk::Settings, mk::SharedPtr<mk::Reactor> reactor,
+      mk::SharedPtr<mk::Logger> logger) {
+    mlabns_probes += 1;
+    cb(mk::NoError(), mk::SharedPtr<mk::net::Transport>{
+                            new mk::net::Emitter{reactor, logger}});
+}
+
+// Selects a server using the latency policy, like NDT and DASH do
+class MlabnsRunnable : public mk::nettests::Runnable {
+  public:
+    void main(std::string, mk::Settings settings,
+              mk::Callback<mk::SharedPtr<nlohmann::json>> cb) override {
+        settings["mlabns/policy"] = "latency";
+        mk::mlabns::query_impl<mlabns_candidates, mlabns_connect>(
+              "ndt",
+              [=](mk::Error error, mk::mlabns::Reply reply) {
+                  REQUIRE(!error);
+                  cb(mk::SharedPtr<nlohmann::json>{
+                        new nlohmann::json(reply.selection)});
+              },
+              settings, reactor, logger);
+    }
+};
+
+static void run_mlabns_runnable(std::string probe_asn) {
+    MlabnsRunnable runnable;
+    runnable.reactor = mk::Reactor::make();
+    runnable.use_bouncer = false;
+    runnable.options = {
+          {"no_collector", true},
+          {"no_file_report", true},
+          {"no_geoip", true},
+          {"no_resolver_lookup", true},
+          {"probe_asn", probe_asn},
+          {"probe_ip", "10.1.2.3"},
+    };
+    mk::Error result = mk::GenericError();
+    runnable.reactor->run_with_initial_event([&]() {
+        runnable.begin([&](mk::Error error) {
+            result = error;
+            runnable.end([&](mk::Error) {});
+        });
+    });
+    REQUIRE(result == mk::NoError());
+    REQUIRE(runnable.options["real_probe_ip_"] == "10.1.2.3");
+    REQUIRE(runnable.options["real_probe_asn_"] == probe_asn);
+}
+
+TEST_CASE("Runnable tells mlab-ns code the network we are in") {
+    mlabns_probes = 0;
+    run_mlabns_runnable("AS65001");
+    REQUIRE(mlabns_probes == 1);
+    run_mlabns_runnable("AS65001");
+    REQUIRE(mlabns_probes == 1); // Same network, cached selection
+    run_mlabns_runnable("AS65002");
+    REQUIRE(mlabns_probes == 2);
+}
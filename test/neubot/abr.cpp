@@ -0,0 +1,127 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/neubot/abr.hpp"
+
+using namespace mk;
+using namespace mk::neubot::dash;
+
+static SharedPtr<AbrStrategy> make(std::string name) {
+    ErrorOr<SharedPtr<AbrStrategy>> abr = make_abr_strategy(name, {});
+    REQUIRE(!!abr);
+    return *abr;
+}
+
+// Records with a segment downloaded at each of the given speeds
+static nlohmann::json make_trace(std::vector<double> speeds_kbit) {
+    nlohmann::json receiver_data = nlohmann::json::array();
+    for (double speed : speeds_kbit) {
+        receiver_data.push_back({
+              {"elapsed", 2.0},
+              {"received", speed * 1000 / 8 * 2.0},
+        });
+    }
+    return receiver_data;
+}
+
+TEST_CASE("make_abr_strategy() validates its arguments") {
+    REQUIRE(make_abr_strategy("antani", {}).as_error() == InvalidAbrError());
+    AbrParams params;
+    params.segment_duration = 0.0;
+    REQUIRE(make_abr_strategy("bola", params).as_error() ==
+            InvalidAbrError());
+    params = {};
+    params.rates = {300, 200};
+    REQUIRE(make_abr_strategy("throughput", params).as_error() ==
+            InvalidAbrError());
+}
+
+TEST_CASE("PlayoutBuffer works as expected") {
+    PlayoutBuffer buffer{6.0};
+    // We don't stall while waiting for the first segment
+    REQUIRE(buffer.add_segment(5.0, 2.0) == 0.0);
+    REQUIRE(buffer.level() == 2.0);
+    REQUIRE(buffer.add_segment(1.0, 2.0) == 0.0);
+    REQUIRE(buffer.level() == 3.0);
+    REQUIRE(buffer.add_segment(4.5, 2.0) == 1.5);
+    REQUIRE(buffer.level() == 2.0);
+    REQUIRE(buffer.add_segment(0.0, 8.0) == 0.0);
+    REQUIRE(buffer.level() == 6.0);
+}
+
+TEST_CASE("The throughput strategy leaves some headroom") {
+    SharedPtr<AbrStrategy> abr = make("throughput");
+    REQUIRE(abr->select_rate(0.0) == 3000);
+    abr->add_sample(5000.0);
+    REQUIRE(abr->select_rate(0.0) == 4000);
+    abr->add_sample(50.0);
+    REQUIRE(abr->select_rate(0.0) == 3000); // 0.9 * EWMA = 3163.5
+    for (int i = 0; i < 20; ++i) {
+        abr->add_sample(10.0);
+    }
+    REQUIRE(abr->select_rate(0.0) == 100); // Never below the lowest rate
+}
+
+TEST_CASE("The bola strategy depends on the buffer level") {
+    SharedPtr<AbrStrategy> abr = make("bola");
+    REQUIRE(abr->select_rate(0.0) == 100);
+    REQUIRE(abr->select_rate(DASH_ABR_BUFFER_CAPACITY) == 50000);
+    int prev = 0;
+    for (double level = 0.0; level <= DASH_ABR_BUFFER_CAPACITY; level += 1.0) {
+        int rate = abr->select_rate(level);
+        REQUIRE(rate >= prev);
+        prev = rate;
+    }
+}
+
+TEST_CASE("The hybrid strategy uses the throughput while the buffer is low") {
+    SharedPtr<AbrStrategy> hybrid = make("hybrid");
+    SharedPtr<AbrStrategy> throughput = make("throughput");
+    hybrid->add_sample(5000.0);
+    throughput->add_sample(5000.0);
+    REQUIRE(hybrid->select_rate(2.0) == throughput->select_rate(2.0));
+    REQUIRE(hybrid->select_rate(DASH_ABR_BUFFER_CAPACITY) == 50000);
+    // We keep using bola until the buffer is really low
+    REQUIRE(hybrid->select_rate(8.0) == make("bola")->select_rate(8.0));
+    REQUIRE(hybrid->select_rate(2.0) == throughput->select_rate(2.0));
+}
+
+TEST_CASE("simulate_abr() works as expected") {
+    SECTION("It deals with invalid input") {
+        REQUIRE(simulate_abr(make_trace({1000.0}), "antani").as_error() ==
+                InvalidAbrError());
+        REQUIRE(simulate_abr({{{"elapsed", 1.0}}}, "legacy").as_error() ==
+                ValueError());
+        REQUIRE(simulate_abr(make_trace({0.0}), "legacy").as_error() ==
+                ValueError());
+    }
+
+    SECTION("It replays a trace") {
+        nlohmann::json trace = make_trace({5000.0, 5000.0, 5000.0});
+        ErrorOr<nlohmann::json> result = simulate_abr(trace, "throughput");
+        REQUIRE(!!result);
+        REQUIRE((*result)["abr"] == "throughput");
+        REQUIRE((*result)["rates"] == nlohmann::json({3000, 4000, 4000}));
+        REQUIRE((*result)["average_rate"].get<double>() == Approx(11000.0 / 3));
+        REQUIRE((*result)["rebuffer_time"] == 0.0);
+        REQUIRE((*result)["startup_delay"].get<double>() == Approx(1.2));
+        REQUIRE((*result)["switches"] == 1);
+    }
+
+    SECTION("It is deterministic and allows to compare strategies") {
+        // On a link whose speed oscillates, the legacy strategy follows
+        // the oscillation while the throughput one smooths it
+        nlohmann::json trace = make_trace(
+              {6000.0, 2000.0, 6000.0, 2000.0, 6000.0, 2000.0, 6000.0, 2000.0});
+        nlohmann::json legacy = *simulate_abr(trace, "legacy");
+        nlohmann::json throughput = *simulate_abr(trace, "throughput");
+        REQUIRE(legacy == *simulate_abr(trace, "legacy"));
+        REQUIRE(throughput == *simulate_abr(trace, "throughput"));
+        REQUIRE(legacy["switches"] == 7);
+        REQUIRE(throughput["switches"].get<int>() <
+                legacy["switches"].get<int>());
+    }
+}
@@ -0,0 +1,201 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/neubot/dash_impl.hpp"
+#include "src/libmeasurement_kit/net/emitter.hpp"
+#include "src/libmeasurement_kit/net/error.hpp"
+
+#include <chrono>
+#include <thread>
+
+using namespace mk;
+using namespace mk::neubot::dash;
+
+// Returns the context of a pipelined loop using a transport that does no
+// I/O, so that we can feed it responses and inspect what it sends
+static SharedPtr<DashLoopCtx> make_ctx(int prefetch_depth, int max_iterations,
+                                       std::vector<Error> *errors) {
+    SharedPtr<DashLoopCtx> ctx = SharedPtr<DashLoopCtx>::make();
+    ctx->options.prefetch_depth = prefetch_depth;
+    ctx->options.max_iterations = max_iterations;
+    ctx->entry.reset(new nlohmann::json);
+    ctx->logger = Logger::make();
+    ctx->reactor = Reactor::make();
+    ctx->settings["http/url"] = "http://127.0.0.1/";
+    ctx->txp.reset(new net::Emitter(ctx->reactor, ctx->logger));
+    ctx->txp->record_sent_data();
+    ctx->cb = [errors](Error error) { errors->push_back(error); };
+    return ctx;
+}
+
+static size_t requests_sent(SharedPtr<DashLoopCtx> ctx) {
+    std::string data = ctx->txp->sent_data().peek();
+    size_t count = 0;
+    for (size_t pos = data.find("GET "); pos != std::string::npos;
+         pos = data.find("GET ", pos + 1)) {
+        count += 1;
+    }
+    return count;
+}
+
+static std::string response(size_t size, std::string status = "200 Ok",
+                            std::string headers = "") {
+    return "HTTP/1.1 " + status + "\r\nContent-Length: " +
+           std::to_string(size) + "\r\n" + headers + "\r\n" +
+           std::string(size, 'x');
+}
+
+static void emit(SharedPtr<DashLoopCtx> ctx, std::string data) {
+    ctx->txp->emit_data(net::Buffer{data});
+}
+
+TEST_CASE("run_pipelined_loop_() sends prefetch_depth requests") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(3, 5, &errors);
+    run_pipelined_loop_(ctx);
+    REQUIRE(requests_sent(ctx) == 3);
+    REQUIRE(ctx->segments.size() == 3);
+    REQUIRE(ctx->segments[0].iteration == 1);
+    REQUIRE(ctx->segments[2].iteration == 3);
+    REQUIRE(errors.size() == 0);
+    ctx->txp->emit_error(net::EofError()); // Break the reference cycle
+}
+
+TEST_CASE("run_pipelined_loop_() deals with back to back responses") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(2, 3, &errors);
+    run_pipelined_loop_(ctx);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    emit(ctx, response(100) + response(200));
+    // We sent the third request once the first segment was complete
+    REQUIRE(requests_sent(ctx) == 3);
+    REQUIRE(errors.size() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    emit(ctx, response(300));
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == NoError());
+    nlohmann::json &receiver_data = (*ctx->entry)["receiver_data"];
+    REQUIRE(receiver_data.size() == 3);
+    for (size_t i = 0; i < 3; ++i) {
+        REQUIRE(receiver_data[i]["iteration"] == i + 1);
+        REQUIRE(receiver_data[i]["received"] == (i + 1) * 100);
+        REQUIRE(receiver_data[i]["prefetch_depth"] == 2);
+    }
+    // Both responses in the same read may have started arriving right
+    // after the previous read, while the third one after its request
+    REQUIRE(receiver_data[0]["elapsed"].get<double>() >= 0.1);
+    REQUIRE(receiver_data[1]["elapsed"].get<double>() >= 0.1);
+    REQUIRE(receiver_data[2]["elapsed"].get<double>() >= 0.05);
+    REQUIRE(receiver_data[2]["elapsed"].get<double>() < 0.1);
+    REQUIRE((*ctx->entry)["simple"].count("median_bitrate") == 1);
+}
+
+TEST_CASE("run_pipelined_loop_() deals with responses split across reads") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(1, 2, &errors);
+    run_pipelined_loop_(ctx);
+    std::string first = response(1000);
+    emit(ctx, first.substr(0, 10));
+    emit(ctx, first.substr(10, 100));
+    REQUIRE(requests_sent(ctx) == 1);
+    emit(ctx, first.substr(110));
+    REQUIRE(requests_sent(ctx) == 2);
+    for (char c : response(500)) {
+        emit(ctx, std::string{c});
+    }
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == NoError());
+    nlohmann::json &receiver_data = (*ctx->entry)["receiver_data"];
+    REQUIRE(receiver_data.size() == 2);
+    REQUIRE(receiver_data[0]["received"] == 1000);
+    REQUIRE(receiver_data[1]["received"] == 500);
+}
+
+TEST_CASE("run_pipelined_loop_() deals with unexpected responses") {
+    SECTION("When a response follows the last one") {
+        std::vector<Error> errors;
+        SharedPtr<DashLoopCtx> ctx = make_ctx(1, 1, &errors);
+        run_pipelined_loop_(ctx);
+        emit(ctx, response(100) + response(100));
+        emit(ctx, response(100));
+        REQUIRE(errors.size() == 1);
+        REQUIRE(errors[0] == NoError());
+        REQUIRE((*ctx->entry)["receiver_data"].size() == 1);
+        REQUIRE(requests_sent(ctx) == 1);
+    }
+
+    SECTION("When there is no request in flight") {
+        std::vector<Error> errors;
+        SharedPtr<DashLoopCtx> ctx = make_ctx(1, 2, &errors);
+        run_pipelined_loop_(ctx);
+        // We always have a request in flight until the last segment, so
+        // pretend that the server answered before we sent the request
+        ctx->segments.clear();
+        emit(ctx, response(100));
+        REQUIRE(errors.size() == 1);
+        REQUIRE(errors[0] == GenericError());
+        REQUIRE(errors[0].reason.find("unexpected_response") !=
+                std::string::npos);
+        REQUIRE((*ctx->entry)["receiver_data"].size() == 0);
+    }
+}
+
+TEST_CASE("run_pipelined_loop_() fails on non-200 responses") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(2, 3, &errors);
+    run_pipelined_loop_(ctx);
+    emit(ctx, response(100) + response(100, "500 Internal Server Error"));
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == http::HttpRequestFailedError());
+    REQUIRE((*ctx->entry)["receiver_data"].size() == 1);
+    emit(ctx, response(100)); // No more callbacks after the failure
+    REQUIRE(errors.size() == 1);
+}
+
+TEST_CASE("run_pipelined_loop_() fails on Connection: close") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(2, 3, &errors);
+    run_pipelined_loop_(ctx);
+    emit(ctx, response(100, "200 Ok", "Connection: close\r\n"));
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == MiddleboxDetectedError());
+    REQUIRE((*ctx->entry)["receiver_data"].size() == 0);
+}
+
+TEST_CASE("run_pipelined_loop_() fails on EOF in the middle of a segment") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(2, 3, &errors);
+    run_pipelined_loop_(ctx);
+    emit(ctx, response(100) + response(1000).substr(0, 200));
+    REQUIRE(errors.size() == 0);
+    ctx->txp->emit_error(net::EofError());
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == net::EofError());
+    REQUIRE((*ctx->entry)["receiver_data"].size() == 1);
+}
+
+TEST_CASE("run_pipelined_loop_() times queued segments from the previous read") {
+    std::vector<Error> errors;
+    SharedPtr<DashLoopCtx> ctx = make_ctx(2, 2, &errors);
+    run_pipelined_loop_(ctx);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    emit(ctx, response(100));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    emit(ctx, response(100));
+    REQUIRE(errors.size() == 1);
+    REQUIRE(errors[0] == NoError());
+    nlohmann::json &receiver_data = (*ctx->entry)["receiver_data"];
+    REQUIRE(receiver_data.size() == 2);
+    // Both requests were sent together at the beginning
+    REQUIRE(receiver_data[1]["request_ticks"].get<double>() -
+                  receiver_data[0]["request_ticks"].get<double>() <
+            0.05);
+    // The first segment waited for the server, while the second one could
+    // only start arriving after the previous read, which ended the first
+    REQUIRE(receiver_data[0]["elapsed"].get<double>() >= 0.2);
+    REQUIRE(receiver_data[1]["elapsed"].get<double>() >= 0.05);
+    REQUIRE(receiver_data[1]["elapsed"].get<double>() < 0.2);
+}
@@ -8,6 +8,8 @@
 
 #include "src/libmeasurement_kit/ooni/bouncer_impl.hpp"
 
+#include <fstream>
+
 using namespace mk;
 
 TEST_CASE("BouncerReply::create() works") {
@@ -160,3 +162,121 @@ TEST_CASE("post_net_tests() works") {
         });
     }
 }
+
+static int post_net_tests_calls = 0;
+
+static void post_net_tests_ok(std::string, std::string, std::string,
+                              std::list<std::string>,
+                              Callback<Error, SharedPtr<ooni::BouncerReply>> cb,
+                              Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    post_net_tests_calls += 1;
+    cb(NoError(), *ooni::BouncerReply::create(
+                        R"({"net-tests": [{"name": "web-connectivity"}]})",
+                        Logger::make()));
+}
+
+static void post_net_tests_error(
+      std::string, std::string, std::string, std::list<std::string>,
+      Callback<Error, SharedPtr<ooni::BouncerReply>> cb, Settings,
+      SharedPtr<Reactor>, SharedPtr<Logger>) {
+    post_net_tests_calls += 1;
+    cb(MockedError(), {});
+}
+
+template <MK_MOCK_AS(ooni::bouncer::post_net_tests, mocked)>
+static Error post_net_tests_cached(Settings settings) {
+    Error result = NotInitializedError();
+    ooni::bouncer::post_net_tests_cached_impl<mocked>(
+          ooni::bouncer::production_bouncer_url(), "web-connectivity",
+          "0.0.1", {"web-connectivity"},
+          [&](Error error, SharedPtr<ooni::BouncerReply> reply) {
+              result = error;
+              if (!error) {
+                  REQUIRE(*reply->get_name() == "web-connectivity");
+              }
+          },
+          settings, Reactor::make(), Logger::make());
+    return result;
+}
+
+TEST_CASE("post_net_tests_cached() works") {
+    Settings settings;
+    settings["bouncer/cache_dir"] = ".";
+    std::string path = ooni::bouncer::cache_path(
+          ".", ooni::bouncer::cache_key(ooni::bouncer::production_bouncer_url(),
+                                        "web-connectivity", "0.0.1",
+                                        {"web-connectivity"}));
+    (void)::remove(path.c_str());
+    post_net_tests_calls = 0;
+
+    SECTION("It does not cache when there is no cache_dir") {
+        settings["bouncer/cache_dir"] = "";
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        REQUIRE(post_net_tests_calls == 2);
+    }
+
+    SECTION("It reuses a fresh reply") {
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        REQUIRE(post_net_tests_cached<post_net_tests_error>(settings) ==
+                NoError());
+        REQUIRE(post_net_tests_calls == 1);
+    }
+
+    SECTION("It refreshes a reply older than half of the TTL") {
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        nlohmann::json entry;
+        {
+            std::ifstream file{path};
+            entry = nlohmann::json::parse(file);
+        }
+        entry["fetched"] = mk::time_now() - 60.0;
+        {
+            std::ofstream file{path};
+            file << entry.dump();
+        }
+        settings["bouncer/cache_ttl"] = 100.0;
+        // Called back with the cached reply but also refreshing the cache
+        REQUIRE(post_net_tests_cached<post_net_tests_error>(settings) ==
+                NoError());
+        REQUIRE(post_net_tests_calls == 2);
+        settings["bouncer/cache_ttl"] = 1000.0;
+        REQUIRE(post_net_tests_cached<post_net_tests_error>(settings) ==
+                NoError());
+        REQUIRE(post_net_tests_calls == 2);
+    }
+
+    SECTION("It uses a stale reply when the bouncer fails") {
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        settings["bouncer/cache_ttl"] = 0.0;
+        REQUIRE(post_net_tests_cached<post_net_tests_error>(settings) ==
+                NoError());
+        REQUIRE(post_net_tests_calls == 2);
+    }
+
+    SECTION("It replaces the cache using a per process temporary file") {
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        settings["bouncer/cache_ttl"] = 0.0;
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        REQUIRE(post_net_tests_calls == 2);
+        REQUIRE(std::ifstream{path}.good());
+        REQUIRE(!std::ifstream{path + "." + std::to_string(getpid()) +
+                               ".tmp"}.good());
+    }
+
+    SECTION("It fails when the bouncer fails and nothing is cached") {
+        REQUIRE(post_net_tests_cached<post_net_tests_error>(settings) ==
+                MockedError());
+    }
+
+    SECTION("It ignores a corrupt cache") {
+        {
+            std::ofstream file{path};
+            file << "{";
+        }
+        REQUIRE(post_net_tests_cached<post_net_tests_ok>(settings) == NoError());
+        REQUIRE(post_net_tests_calls == 1);
+    }
+
+    (void)::remove(path.c_str());
+}
@@ -11,6 +11,7 @@
 #include "src/libmeasurement_kit/common/non_copyable.hpp"
 #include "src/libmeasurement_kit/common/non_movable.hpp"
 
+#include <fstream>
 #include <sstream>
 
 using namespace mk::http;
@@ -150,6 +151,38 @@ TEST_CASE("collector::post deals with empty response") {
     });
 }
 
+static void connection_close(SharedPtr<Transport>, Settings, Headers,
+                             std::string,
+                             Callback<Error, SharedPtr<Response>> cb,
+                             SharedPtr<Reactor>, SharedPtr<Logger>) {
+    SharedPtr<Response> resp(new Response);
+    resp->status_code = 200;
+    headers_push_back(resp->headers, "Connection", "close");
+    cb(NoError(), resp);
+}
+
+TEST_CASE("collector::post reports EOF when the collector closes") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<Transport> txp = MockConnection::make(reactor);
+        SharedPtr<bool> replied{std::make_shared<bool>(false)};
+        collector::post_impl<connection_close>(
+              txp, "", "",
+              [=](Error err, nlohmann::json) {
+                  REQUIRE(err == NoError());
+                  *replied = true;
+                  txp->on_error([=](Error error) {
+                      REQUIRE(error == EofError());
+                      reactor->call_soon([=]() {
+                          txp->close([=]() { reactor->stop(); });
+                      });
+                  });
+              },
+              SETTINGS, reactor, Logger::make());
+        REQUIRE(*replied);
+    });
+}
+
 static void invalid_json(SharedPtr<Transport>, Settings, Headers, std::string,
                          Callback<Error, SharedPtr<Response>> cb, SharedPtr<Reactor>,
                          SharedPtr<Logger>) {
@@ -337,6 +370,37 @@ TEST_CASE("collector::update_report deals with entry with missing key") {
     });
 }
 
+static void check_spliced_body(SharedPtr<Transport>, std::string url_extra,
+                               std::string body,
+                               Callback<Error, nlohmann::json> cb, Settings,
+                               SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(url_extra == "/report/xx");
+    nlohmann::json request = nlohmann::json::parse(body);
+    REQUIRE(request.at("format") == "json");
+    REQUIRE(request.at("content").at("report_id") == "xx");
+    // Same bytes we would have obtained by serializing the whole request
+    REQUIRE(body == request.dump());
+    cb(NoError(), nullptr);
+}
+
+TEST_CASE("collector::update_report_entry splices the serialized entry") {
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        std::ifstream file{"test/fixtures/report.njson"};
+        std::string line;
+        REQUIRE(std::getline(file, line));
+        nlohmann::json entry = nlohmann::json::parse(line);
+        entry["report_id"] = "xx";
+        collector::update_report_entry_impl<check_spliced_body>(
+            nullptr, "xx", SerializedEntry::make(std::move(entry)),
+            [=](Error err) {
+                REQUIRE(err == NoError());
+                reactor->stop();
+            },
+            {}, reactor, Logger::make());
+    });
+}
+
 TEST_CASE("collector::get_next_entry() works correctly at EOF") {
     SharedPtr<std::istream> input(new std::istringstream(""));
     ErrorOr<nlohmann::json> entry = collector::get_next_entry(input, Logger::make());
@@ -477,6 +541,215 @@ TEST_CASE("submit_report() deals with collector_create_report error") {
     });
 }
 
+static int session_connects = 0;
+static int session_updates = 0;
+static int session_closes = 0;
+
+static SerializedEntry session_entry(int idx) {
+    return SerializedEntry::make({{"idx", idx}});
+}
+
+static void session_connect(Settings, Callback<Error, SharedPtr<Transport>> cb,
+                            SharedPtr<Reactor> reactor, SharedPtr<Logger>) {
+    session_connects += 1;
+    cb(NoError(), MockConnection::make(reactor));
+}
+
+static void session_update(SharedPtr<Transport> txp, std::string report_id,
+                           SerializedEntry entry, Callback<Error> cb, Settings,
+                           SharedPtr<Reactor>, SharedPtr<Logger>) {
+    REQUIRE(!!txp);
+    REQUIRE(report_id == "xx");
+    REQUIRE(entry.json().at("idx") == session_updates);
+    session_updates += 1;
+    cb(NoError());
+}
+
+static void session_close(SharedPtr<Transport> txp, std::string report_id,
+                          Callback<Error> cb, Settings, SharedPtr<Reactor>,
+                          SharedPtr<Logger>) {
+    REQUIRE(!!txp);
+    REQUIRE(report_id == "xx");
+    session_closes += 1;
+    cb(NoError());
+}
+
+TEST_CASE("collector::Session uses a single connection") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update,
+                                     session_close>>(
+              Settings{}, reactor, Logger::make())};
+        SharedPtr<int> completed{std::make_shared<int>(0)};
+        for (int i = 0; i < 4; ++i) {
+            session->update_report("xx", session_entry(i), [=](Error err) {
+                REQUIRE(err == NoError());
+                REQUIRE(*completed == i); // FIFO order
+                *completed += 1;
+            });
+        }
+        session->close_report("xx", [=](Error err) {
+            REQUIRE(err == NoError());
+            REQUIRE(*completed == 4);
+            reactor->stop();
+        });
+    });
+    REQUIRE(session_connects == 1);
+    REQUIRE(session_updates == 4);
+    REQUIRE(session_closes == 1);
+}
+
+static void session_update_then_eof(SharedPtr<Transport> txp,
+                                    std::string report_id,
+                                    SerializedEntry entry, Callback<Error> cb,
+                                    Settings settings,
+                                    SharedPtr<Reactor> reactor,
+                                    SharedPtr<Logger> logger) {
+    session_update(txp, report_id, entry, cb, settings, reactor, logger);
+    if (session_updates == 1) {
+        txp->emit_error(EofError()); // The collector closes the connection
+    }
+}
+
+TEST_CASE("collector::Session reconnects if the collector closes when idle") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["collector/max_retries"] = 0;
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update_then_eof,
+                                     session_close>>(
+              settings, reactor, Logger::make())};
+        session->update_report("xx", session_entry(0), [=](Error err) {
+            REQUIRE(err == NoError());
+        });
+        session->update_report("xx", session_entry(1), [=](Error err) {
+            REQUIRE(err == NoError());
+            reactor->stop();
+        });
+    });
+    REQUIRE(session_connects == 2);
+    REQUIRE(session_updates == 2);
+}
+
+static void session_update_stale(SharedPtr<Transport> txp,
+                                 std::string report_id, SerializedEntry entry,
+                                 Callback<Error> cb, Settings settings,
+                                 SharedPtr<Reactor> reactor,
+                                 SharedPtr<Logger> logger) {
+    if (session_connects == 1 && session_updates == 1) {
+        cb(MockedError()); // Closed by the collector before we noticed
+        return;
+    }
+    session_update(txp, report_id, entry, cb, settings, reactor, logger);
+}
+
+TEST_CASE("collector::Session reconnects at once if a reused connection fails") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["collector/retry_delay"] = 3600.0;
+    settings["collector/max_retries"] = 0;
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update_stale,
+                                     session_close>>(
+              settings, reactor, Logger::make())};
+        session->update_report("xx", session_entry(0), [=](Error err) {
+            REQUIRE(err == NoError());
+        });
+        session->update_report("xx", session_entry(1), [=](Error err) {
+            REQUIRE(err == NoError());
+            reactor->stop();
+        });
+    });
+    REQUIRE(session_connects == 2);
+    REQUIRE(session_updates == 2);
+}
+
+static void session_update_flaky(SharedPtr<Transport> txp,
+                                 std::string report_id, SerializedEntry entry,
+                                 Callback<Error> cb, Settings settings,
+                                 SharedPtr<Reactor> reactor,
+                                 SharedPtr<Logger> logger) {
+    if (session_connects < 3) {
+        cb(MockedError());
+        return;
+    }
+    session_update(txp, report_id, entry, cb, settings, reactor, logger);
+}
+
+TEST_CASE("collector::Session reconnects and retries on failure") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["collector/retry_delay"] = 0.0;
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update_flaky,
+                                     session_close>>(
+              settings, reactor, Logger::make())};
+        session->update_report("xx", session_entry(0), [=](Error err) {
+            REQUIRE(err == NoError());
+            reactor->stop();
+        });
+    });
+    REQUIRE(session_connects == 3);
+    REQUIRE(session_updates == 1);
+}
+
+TEST_CASE("collector::Session gives up after too many retries") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings;
+    settings["collector/retry_delay"] = 0.0;
+    settings["collector/max_retries"] = 1;
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update_flaky,
+                                     session_close>>(
+              settings, reactor, Logger::make())};
+        session->update_report("xx", session_entry(0), [=](Error err) {
+            REQUIRE(err == MockedError());
+            // The next operation starts over with a new connection
+            session->update_report("xx", session_entry(0), [=](Error err) {
+                REQUIRE(err == NoError());
+                reactor->stop();
+            });
+        });
+    });
+    REQUIRE(session_connects == 3);
+    REQUIRE(session_updates == 1);
+}
+
+static void session_update_invalid(SharedPtr<Transport>, std::string,
+                                   SerializedEntry, Callback<Error> cb,
+                                   Settings, SharedPtr<Reactor>,
+                                   SharedPtr<Logger>) {
+    session_updates += 1;
+    cb(MissingMandatoryKeyError());
+}
+
+TEST_CASE("collector::Session does not retry invalid entries") {
+    session_connects = session_updates = session_closes = 0;
+    SharedPtr<Reactor> reactor = Reactor::make();
+    reactor->run_with_initial_event([=]() {
+        SharedPtr<collector::Session> session{std::make_shared<
+              collector::SessionImpl<session_connect, session_update_invalid,
+                                     session_close>>(
+              Settings{}, reactor, Logger::make())};
+        session->update_report("xx", session_entry(0), [=](Error err) {
+            REQUIRE(err == MissingMandatoryKeyError());
+            reactor->stop();
+        });
+    });
+    REQUIRE(session_connects == 1);
+    REQUIRE(session_updates == 1);
+}
+
 /*
  _       _                       _   _
 (_)_ __ | |_ ___  __ _ _ __ __ _| |_(_) ___  _ __
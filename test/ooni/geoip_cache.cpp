@@ -0,0 +1,74 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/ooni/geoip_cache.hpp"
+
+#include <fstream>
+
+using namespace mk::ooni;
+using namespace mk;
+
+TEST_CASE("GeoipCache shares the open databases") {
+    SharedPtr<GeoipCache> cache = GeoipCache::make();
+    std::vector<std::string> logs;
+    SharedPtr<mmdb::Handle> first = cache->database("asn.mmdb", logs);
+    REQUIRE(!!first);
+    SharedPtr<mmdb::Handle> second = cache->database("asn.mmdb", logs);
+    REQUIRE(first.get() == second.get());
+}
+
+TEST_CASE("GeoipCache looks up all fields at once") {
+    SharedPtr<GeoipCache> cache = GeoipCache::make();
+    std::vector<std::string> logs;
+    GeoipInfo info = cache->lookup("country.mmdb", "asn.mmdb", "8.8.8.8", logs);
+    REQUIRE(info.cc_ok);
+    REQUIRE(info.cc == "US");
+    REQUIRE(info.asn_ok);
+    REQUIRE(info.asn == "AS15169");
+    REQUIRE(info.org_ok);
+    GeoipInfo cached = cache->lookup("country.mmdb", "asn.mmdb", "8.8.8.8", logs);
+    REQUIRE(cached.cc == info.cc);
+    REQUIRE(cached.asn == info.asn);
+    REQUIRE(cached.org == info.org);
+    // Empty paths skip the related lookups
+    GeoipInfo asn_only = cache->lookup("", "asn.mmdb", "8.8.8.8", logs);
+    REQUIRE(!asn_only.cc_ok);
+    REQUIRE(asn_only.asn == "AS15169");
+    // So does not needing the organization
+    GeoipInfo no_org = cache->lookup("", "asn.mmdb", "8.8.8.8", logs, false);
+    REQUIRE(no_org.asn == "AS15169");
+    REQUIRE(!no_org.org_ok);
+}
+
+TEST_CASE("GeoipCache does not use results of removed databases") {
+    static const char *path = "geoip_cache_asn.mmdb";
+    {
+        std::ifstream src{"asn.mmdb", std::ios::binary};
+        std::ofstream dst{path, std::ios::binary};
+        dst << src.rdbuf();
+    }
+    SharedPtr<GeoipCache> cache = GeoipCache::make();
+    std::vector<std::string> logs;
+    REQUIRE(cache->lookup("", path, "8.8.8.8", logs).asn_ok);
+    REQUIRE(::remove(path) == 0);
+    logs.clear();
+    REQUIRE(!cache->lookup("", path, "8.8.8.8", logs).asn_ok);
+    REQUIRE(!logs.empty());
+}
+
+TEST_CASE("GeoipCache deals with missing databases") {
+    SharedPtr<GeoipCache> cache = GeoipCache::make();
+    std::vector<std::string> logs;
+    REQUIRE(!cache->database("/nonexistent.mmdb", logs));
+    REQUIRE(!logs.empty());
+    GeoipInfo info = cache->lookup("/nonexistent.mmdb", "/nonexistent.mmdb",
+                                   "8.8.8.8", logs);
+    REQUIRE(!info.cc_ok);
+    REQUIRE(!info.asn_ok);
+    REQUIRE(!info.org_ok);
+}
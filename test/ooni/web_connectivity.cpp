@@ -7,9 +7,94 @@
 #include "include/private/catch.hpp"
 
 #include "src/libmeasurement_kit/ooni/nettests.hpp"
+#include "src/libmeasurement_kit/ooni/web_connectivity_impl.hpp"
 
 using namespace mk;
 
+static curl::Request last_request;
+
+static void perform_http2_ok(SharedPtr<curl::Multi>, curl::Request request,
+                             Callback<curl::TransferResponse> callback) {
+    last_request = request;
+    curl::TransferResponse response;
+    response.status_code = 200;
+    response.http_version = "HTTP/2";
+    response.connection_reused = true;
+    response.download_size = 27;
+    response.total_time_us = 1500000;
+    response.body = "{\"dns\": {}, \"tcp_connect\": {}}";
+    callback(response);
+}
+
+static void perform_http2_timeout(SharedPtr<curl::Multi>, curl::Request,
+                                  Callback<curl::TransferResponse> callback) {
+    curl::TransferResponse response;
+    response.error = 28; // CURLE_OPERATION_TIMEDOUT
+    callback(response);
+}
+
+static void perform_http2_not_json(SharedPtr<curl::Multi>, curl::Request,
+                                   Callback<curl::TransferResponse> callback) {
+    curl::TransferResponse response;
+    response.status_code = 200;
+    response.body = "<html></html>";
+    callback(response);
+}
+
+TEST_CASE("The HTTP/2 control request works as expected") {
+    SharedPtr<nlohmann::json> entry{new nlohmann::json};
+    Settings settings{
+        {"backend", "https://a.web-connectivity.th.ooni.io:4442"},
+        {"net/ca_bundle_path", "cacert.pem"},
+        {"net/timeout", 30.0},
+    };
+
+    SECTION("It forwards the settings and saves the control") {
+        settings["net/socks5_proxy"] = "127.0.0.1:9050";
+        Error error = MockedError();
+        ooni::control_request_http2_impl<perform_http2_ok>(
+              entry, "{}", [&](Error err) { error = err; }, settings, {},
+              Logger::make());
+        REQUIRE(error == NoError());
+        REQUIRE(last_request.method == "POST");
+        REQUIRE(last_request.url ==
+                "https://a.web-connectivity.th.ooni.io:4442");
+        REQUIRE(last_request.body == "{}");
+        REQUIRE(last_request.timeout == 30);
+        REQUIRE(last_request.ca_path == "cacert.pem");
+        REQUIRE(last_request.proxy_url == "socks5h://127.0.0.1:9050");
+        REQUIRE((*entry)["control"]["dns"] == nlohmann::json::object());
+        REQUIRE((*entry)["control_transfer"]["http_version"] == "HTTP/2");
+        REQUIRE((*entry)["control_transfer"]["connection_reused"] == true);
+        REQUIRE((*entry)["control_transfer"]["t_total"] == 1.5);
+    }
+
+    SECTION("It does not use a proxy by default") {
+        ooni::control_request_http2_impl<perform_http2_ok>(
+              entry, "{}", [](Error) {}, settings, {}, Logger::make());
+        REQUIRE(last_request.proxy_url == "");
+    }
+
+    SECTION("It deals with transfer errors") {
+        Error error;
+        ooni::control_request_http2_impl<perform_http2_timeout>(
+              entry, "{}", [&](Error err) { error = err; }, settings, {},
+              Logger::make());
+        REQUIRE(error == TimeoutError());
+        REQUIRE((*entry)["control_failure"] == "generic_timeout_error");
+        REQUIRE((*entry)["control"] == nullptr);
+    }
+
+    SECTION("It deals with invalid JSON") {
+        Error error;
+        ooni::control_request_http2_impl<perform_http2_not_json>(
+              entry, "{}", [&](Error err) { error = err; }, settings, {},
+              Logger::make());
+        REQUIRE(error == JsonProcessingError());
+        REQUIRE((*entry)["control_failure"] == "json_parse_error");
+    }
+}
+
 TEST_CASE("Web connectivity works as expected") {
     auto logger = Logger::make();
 
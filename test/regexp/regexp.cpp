@@ -0,0 +1,118 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/regexp/regexp.hpp"
+
+using namespace mk;
+
+TEST_CASE("Validators work as expected") {
+    SECTION("valid_country_code") {
+        REQUIRE(regexp::valid_country_code("IT"));
+        REQUIRE(!regexp::valid_country_code("It"));
+        REQUIRE(!regexp::valid_country_code("ITA"));
+        REQUIRE(!regexp::valid_country_code(""));
+    }
+
+    SECTION("valid_airport_iata_code") {
+        REQUIRE(regexp::valid_airport_iata_code("trn"));
+        REQUIRE(!regexp::valid_airport_iata_code("TRN"));
+        REQUIRE(!regexp::valid_airport_iata_code("tr"));
+    }
+
+    SECTION("lowercase_letters_only") {
+        REQUIRE(regexp::lowercase_letters_only("abc"));
+        REQUIRE(!regexp::lowercase_letters_only("ab1"));
+        REQUIRE(!regexp::lowercase_letters_only(""));
+    }
+
+    SECTION("valid_mlabns_tool_name") {
+        REQUIRE(regexp::valid_mlabns_tool_name("ndt"));
+        REQUIRE(regexp::valid_mlabns_tool_name("ndt7"));
+        REQUIRE(!regexp::valid_mlabns_tool_name("7ndt"));
+        REQUIRE(!regexp::valid_mlabns_tool_name("ndt_ssl"));
+        REQUIRE(!regexp::valid_mlabns_tool_name(""));
+    }
+
+    SECTION("replace_probe_cc") {
+        REQUIRE(regexp::replace_probe_cc("a${probe_cc}b${probe_cc}", "IT") ==
+                "aITbIT");
+        REQUIRE(regexp::replace_probe_cc("${probe_cc}", "${probe_cc}") ==
+                "${probe_cc}");
+        REQUIRE(regexp::replace_probe_cc("$probe_cc", "IT") == "$probe_cc");
+    }
+
+    SECTION("valid_nettest_name") {
+        REQUIRE(regexp::valid_nettest_name("web_connectivity-2.0"));
+        REQUIRE(!regexp::valid_nettest_name("web connectivity"));
+        REQUIRE(!regexp::valid_nettest_name(""));
+    }
+
+    SECTION("valid_nettest_version") {
+        REQUIRE(regexp::valid_nettest_version("0.1.0"));
+        REQUIRE(regexp::valid_nettest_version("v0.1.0-beta.1+git"));
+        // Digits past the eighth one are part of the suffix
+        REQUIRE(regexp::valid_nettest_version("1.2.123456789"));
+        REQUIRE(!regexp::valid_nettest_version("1.123456789.3"));
+        REQUIRE(!regexp::valid_nettest_version("0.1"));
+        REQUIRE(!regexp::valid_nettest_version("0.1.0_beta"));
+        REQUIRE(!regexp::valid_nettest_version("0.1.0" + std::string(33, 'a')));
+    }
+
+    SECTION("valid_probe_asn") {
+        REQUIRE(regexp::valid_probe_asn("AS0"));
+        REQUIRE(!regexp::valid_probe_asn("AS"));
+        REQUIRE(!regexp::valid_probe_asn("as30722"));
+        REQUIRE(!regexp::valid_probe_asn("AS307x22"));
+    }
+
+    SECTION("valid_test_start_time") {
+        REQUIRE(regexp::valid_test_start_time("2016-06-04 17:53:13"));
+        REQUIRE(!regexp::valid_test_start_time("2016-06-04T17:53:13"));
+        REQUIRE(!regexp::valid_test_start_time("2016-06-04 17:53:13Z"));
+    }
+}
+
+TEST_CASE("private_ipv4() works as expected") {
+    REQUIRE(regexp::private_ipv4("localhost"));
+    REQUIRE(regexp::private_ipv4("127.0.0.1"));
+    REQUIRE(regexp::private_ipv4("10.0.0.1"));
+    REQUIRE(regexp::private_ipv4("192.168.1.1"));
+    REQUIRE(regexp::private_ipv4("172.16.0.1"));
+    REQUIRE(regexp::private_ipv4("172.31.255.255"));
+    // Like the original regular expression, we do not check the range
+    REQUIRE(regexp::private_ipv4("127.999.999.999"));
+    REQUIRE(!regexp::private_ipv4("172.15.0.1"));
+    REQUIRE(!regexp::private_ipv4("172.32.0.1"));
+    REQUIRE(!regexp::private_ipv4("172.016.0.1"));
+    REQUIRE(!regexp::private_ipv4("192.169.1.1"));
+    REQUIRE(!regexp::private_ipv4("8.8.8.8"));
+    REQUIRE(!regexp::private_ipv4("127.0.0"));
+    REQUIRE(!regexp::private_ipv4("127.0.0.1.1"));
+    REQUIRE(!regexp::private_ipv4("127.0.0.1000"));
+    REQUIRE(!regexp::private_ipv4("localhost.localdomain"));
+}
+
+TEST_CASE("html_extract_title() works as expected") {
+    REQUIRE(regexp::html_extract_title("<TITLE>x</Title>") == "x");
+    REQUIRE(regexp::html_extract_title("<title></title>") == "");
+    REQUIRE(regexp::html_extract_title("<title></title><title>y</title>") ==
+            "y");
+    REQUIRE(regexp::html_extract_title("<title>a<b</title>") == "");
+    REQUIRE(regexp::html_extract_title("<title>a</titl><title>b</title>") ==
+            "b");
+    REQUIRE(regexp::html_extract_title("<<title>c</title>") == "c");
+    REQUIRE(regexp::html_extract_title("<title>a<title>b</title>") == "b");
+    REQUIRE(regexp::html_extract_title(
+                  "<title>" + std::string(128, 'x') + "</title>") ==
+            std::string(128, 'x'));
+    REQUIRE(regexp::html_extract_title(
+                  "<title>" + std::string(129, 'x') + "</title>") == "");
+    REQUIRE(regexp::html_extract_title(
+                  "<html><head><title></title><title>a</titl><<TiTlE>"
+                  "Hello, world!</tItLe><title>b</title></head></html>") ==
+            "Hello, world!");
+    REQUIRE(regexp::html_extract_title("<title>partial") == "");
+}
@@ -0,0 +1,75 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/common/utils.hpp"
+#include "src/libmeasurement_kit/report/entry_builder.hpp"
+
+using namespace mk;
+using namespace mk::report;
+
+TEST_CASE("EntryBuilder builds the same entry as ReportLegacy::fill_entry") {
+    ReportLegacy report;
+    report.test_name = "web_connectivity";
+    report.test_version = "0.0.1";
+    report.probe_ip = "127.0.0.1";
+    report.probe_asn = "AS0";
+    report.probe_cc = "ZZ";
+    mk::utc_time_now(&report.test_start_time);
+    report.report_id = "xx";
+    std::map<std::string, std::string> annotations{{"foo", "bar"}};
+    EntryBuilder builder{report, annotations, {{"backend", "https://x.org"}}};
+
+    tm start_time{};
+    mk::utc_time_now(&start_time);
+    nlohmann::json test_keys{{"failure", nullptr}};
+    nlohmann::json entry = builder.build("https://www.google.com/",
+                                         std::move(test_keys), "8.8.8.8",
+                                         start_time, 1.5, "yy");
+
+    nlohmann::json expected;
+    expected["annotations"] = annotations;
+    report.fill_entry(expected);
+    REQUIRE(entry["annotations"] == expected["annotations"]);
+    REQUIRE(entry["test_start_time"] == expected["test_start_time"]);
+    REQUIRE(entry["software_name"] == expected["software_name"]);
+    REQUIRE(entry["report_id"] == "yy");
+    REQUIRE(entry["input"] == "https://www.google.com/");
+    REQUIRE(entry["test_keys"]["failure"] == nullptr);
+    REQUIRE(entry["test_keys"]["client_resolver"] == "8.8.8.8");
+    REQUIRE(entry["measurement_start_time"] == *mk::timestamp(&start_time));
+    REQUIRE(entry["test_runtime"] == 1.5);
+    REQUIRE(entry["test_helpers"]["backend"] == "https://x.org");
+    REQUIRE(entry["options"] == nlohmann::json::array());
+    REQUIRE(entry["input_hashes"] == nlohmann::json::array());
+    REQUIRE(entry["probe_city"] == nullptr);
+    REQUIRE(entry["id"].get<std::string>().size() == 36);
+
+    SECTION("Empty input is null and ids differ") {
+        nlohmann::json other = builder.build("", {}, "8.8.8.8", start_time,
+                                             1.5, "yy");
+        REQUIRE(other["input"] == nullptr);
+        REQUIRE(other["id"] != entry["id"]);
+    }
+}
+
+TEST_CASE("format_timestamp() is consistent with mk::timestamp()") {
+    tm t{};
+    t.tm_year = 2017 - 1900;
+    t.tm_mon = 0;
+    t.tm_mday = 9;
+    t.tm_hour = 3;
+    t.tm_min = 4;
+    t.tm_sec = 5;
+    REQUIRE(format_timestamp(t) == "2017-01-09 03:04:05");
+    REQUIRE(format_timestamp(t) == *mk::timestamp(&t));
+
+    SECTION("It throws when the date is not valid") {
+        t.tm_mday = 0;
+        REQUIRE_THROWS(format_timestamp(t));
+    }
+}
@@ -10,6 +10,8 @@
 
 #include "src/libmeasurement_kit/report/file_reporter.hpp"
 
+#include <fstream>
+
 using namespace mk::report;
 using namespace mk;
 
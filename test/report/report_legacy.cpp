@@ -29,7 +29,7 @@ class CountedReporter : public BaseReporter {
         });
     }
 
-    Continuation<Error> write_entry(nlohmann::json e) override {
+    Continuation<Error> write_entry(SerializedEntry e) override {
         return do_write_entry_(e, [=](Callback<Error> cb) {
             ++write_count;
             return cb(NoError());
@@ -68,7 +68,7 @@ class FailingReporter : public BaseReporter {
         });
     }
 
-    Continuation<Error> write_entry(nlohmann::json e) override {
+    Continuation<Error> write_entry(SerializedEntry e) override {
         return do_write_entry_(e, [=](Callback<Error> cb) {
             if (write_count++ == 0) {
                 cb(MockedError());
@@ -290,3 +290,63 @@ TEST_CASE("We can override software name and version") {
         REQUIRE(entry["software_version"] == "1.0.1");
     }
 }
+
+// Like OoniReporter when `collector/open_in_background` is true
+class BackgroundReporter : public BaseReporter {
+  public:
+    static SharedPtr<BackgroundReporter> make() {
+        return SharedPtr<BackgroundReporter>(new BackgroundReporter);
+    }
+
+    ~BackgroundReporter() override;
+
+    Continuation<Error> open(ReportLegacy &report) override {
+        return do_open_([=, &report](Callback<Error> cb) {
+            report_ = &report;
+            cb(NoError());
+        });
+    }
+
+    void wait_for_open(Callback<> cb) override {
+        if (report_ != nullptr && report_->report_id == "") {
+            waiters_.push_back(cb);
+            return;
+        }
+        cb();
+    }
+
+    void created(std::string report_id) {
+        report_->report_id = report_id;
+        for (auto &cb : waiters_) {
+            cb();
+        }
+        waiters_.clear();
+    }
+
+  private:
+    ReportLegacy *report_ = nullptr;
+    std::vector<Callback<>> waiters_;
+};
+
+BackgroundReporter::~BackgroundReporter() {}
+
+TEST_CASE("wait_for_open() waits for reporters opening in background") {
+    ReportLegacy report;
+    auto background_reporter = BackgroundReporter::make();
+    report.add_reporter(CountedReporter::make().as<BaseReporter>());
+    report.add_reporter(background_reporter.as<BaseReporter>());
+    report.open([](Error err) { REQUIRE(err == NoError()); });
+    std::string report_id = "";
+    bool called = false;
+    report.wait_for_open([&]() {
+        called = true;
+        report_id = report.report_id;
+    });
+    REQUIRE(!called);
+    background_reporter->created("20261018T000000Z_AS0_x");
+    REQUIRE(called);
+    REQUIRE(report_id == "20261018T000000Z_AS0_x");
+    called = false;
+    report.wait_for_open([&]() { called = true; });
+    REQUIRE(called);
+}
@@ -0,0 +1,210 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/report/error.hpp"
+#include "src/libmeasurement_kit/report/report_writer.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifndef MK_WITHOUT_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace mk::report;
+using namespace mk;
+
+static std::string slurp(std::string path) {
+    std::ifstream file{path, std::ios::binary};
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+TEST_CASE("ReportWriter writes lines to a plain file") {
+    std::string path = "report_writer_test.njson";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {});
+    REQUIRE(writer->open() == NoError());
+    REQUIRE(writer->open() == ReportAlreadyOpenError());
+    REQUIRE(writer->write_line("{\"foo\":1}") == NoError());
+    REQUIRE(writer->write_line("{\"foo\":2}") == NoError());
+    REQUIRE(writer->close() == NoError());
+    REQUIRE(slurp(path) == "{\"foo\":1}\n{\"foo\":2}\n");
+    REQUIRE(writer->write_line("{\"foo\":3}") == ReportNotOpenError());
+    REQUIRE(writer->close() == ReportAlreadyClosedError());
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("ReportWriter writes when the buffer is full") {
+    std::string path = "report_writer_test.njson";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {
+        {"report/buffer_size", 16},
+        {"report/flush_interval", 60.0},
+        {"report/fsync", "always"},
+    });
+    REQUIRE(writer->open() == NoError());
+    REQUIRE(writer->write_line(std::string(32, 'x')) == NoError());
+    // Wait for the background thread to write the line
+    for (int i = 0; i < 100 && slurp(path).empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(slurp(path) == std::string(32, 'x') + "\n");
+    REQUIRE(writer->close() == NoError());
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("ReportWriter periodically flushes buffered lines") {
+    std::string path = "report_writer_test.njson";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {
+        {"report/flush_interval", 0.1},
+    });
+    REQUIRE(writer->open() == NoError());
+    REQUIRE(writer->write_line("{}") == NoError());
+    for (int i = 0; i < 100 && slurp(path).empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    REQUIRE(slurp(path) == "{}\n");
+    REQUIRE(writer->close() == NoError());
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("ReportWriter flushes every line with a zero flush interval") {
+    std::string path = "report_writer_test.njson";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {
+        {"report/flush_interval", 0.0},
+    });
+    REQUIRE(writer->open() == NoError());
+    for (int i = 0; i < 3; ++i) {
+        std::string expect = slurp(path) + "{}\n";
+        REQUIRE(writer->write_line("{}") == NoError());
+        for (int j = 0; j < 100 && slurp(path) != expect; ++j) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        REQUIRE(slurp(path) == expect);
+    }
+    REQUIRE(writer->close() == NoError());
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("ReportWriter fails to open a file in a nonexistent directory") {
+    SharedPtr<ReportWriter> writer = ReportWriter::make(
+        "/nonexistent/foobar.njson", {});
+    REQUIRE(writer->open() == ReportIoError());
+    REQUIRE(writer->write_line("{}") == ReportNotOpenError());
+    REQUIRE(writer->close() == ReportNotOpenError());
+}
+
+TEST_CASE("ReportWriter closes the file in the background") {
+    std::string path = "report_writer_test.njson";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {
+        {"report/fsync", "close"},
+    });
+    REQUIRE(writer->open() == NoError());
+    REQUIRE(writer->write_line("{}") == NoError());
+    SharedPtr<Reactor> reactor = Reactor::make();
+    SharedPtr<Logger> logger = Logger::make();
+    std::thread::id reactor_thread, callback_thread;
+    Error result = GenericError(), second_result = NoError();
+    reactor->run_with_initial_event([&]() {
+        reactor_thread = std::this_thread::get_id();
+        writer->close(reactor, logger, [&](Error err) {
+            callback_thread = std::this_thread::get_id();
+            result = err;
+            writer->close(reactor, logger, [&](Error err) {
+                second_result = err;
+            });
+        });
+    });
+    REQUIRE(result == NoError());
+    REQUIRE(second_result == ReportAlreadyClosedError());
+    REQUIRE(callback_thread == reactor_thread);
+    REQUIRE(slurp(path) == "{}\n");
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("ReportWriter rejects unknown fsync policies") {
+    SharedPtr<ReportWriter> writer = ReportWriter::make(
+        "report_writer_test.njson", {{"report/fsync", "sometimes"}});
+    REQUIRE(writer->open() == ValueError());
+    REQUIRE(writer->close() == ReportNotOpenError());
+}
+
+TEST_CASE("ReportWriter does not write plain text to .zst files") {
+    std::string path = "report_writer_test.njson.zst";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {});
+    REQUIRE(writer->open() == NotImplementedError());
+    REQUIRE(!std::ifstream{path}.good());
+}
+
+#ifndef MK_WITHOUT_ZLIB
+
+TEST_CASE("ReportWriter compresses reports ending in .gz") {
+    std::string path = "report_writer_test.njson.gz";
+    SharedPtr<ReportWriter> writer = ReportWriter::make(path, {
+        {"report/fsync", "close"},
+    });
+    REQUIRE(writer->open() == NoError());
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE(writer->write_line("{\"foo\":" + std::to_string(i) + "}") ==
+                NoError());
+    }
+    REQUIRE(writer->close() == NoError());
+    std::string data = slurp(path);
+    REQUIRE(data.size() > 2);
+    REQUIRE((unsigned char)data[0] == 0x1f); // gzip magic
+    REQUIRE((unsigned char)data[1] == 0x8b);
+    gzFile gzfp = gzopen(path.c_str(), "rb");
+    REQUIRE(gzfp != nullptr);
+    char line[128];
+    int count = 0;
+    while (gzgets(gzfp, line, sizeof(line)) != nullptr) {
+        REQUIRE(std::string{line} ==
+                "{\"foo\":" + std::to_string(count++) + "}\n");
+    }
+    REQUIRE(count == 1000);
+    REQUIRE(gzclose(gzfp) == Z_OK);
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+TEST_CASE("A gzip ReportSink has a complete trailer before closing") {
+    std::string path = "report_writer_test.njson.gz";
+    std::unique_ptr<ReportSink> sink;
+    REQUIRE(open_report_sink(path, &sink) == NoError());
+    std::string data;
+    for (int i = 0; i < 1000; ++i) {
+        data += "{\"foo\":" + std::to_string(i) + "}\n";
+    }
+    REQUIRE(sink->write(data) == NoError());
+    // This is what ReportWriter does before closing with report/fsync set
+    REQUIRE(sink->finish() == NoError());
+    REQUIRE(sink->sync() == NoError());
+    std::string raw = slurp(path);
+    REQUIRE(raw.size() > 8);
+    // The trailer ends with the uncompressed size modulo 2^32
+    uint32_t isize = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        isize |= (uint32_t)(unsigned char)raw[raw.size() - 4 + i] << (8 * i);
+    }
+    REQUIRE(isize == (uint32_t)data.size());
+    gzFile gzfp = gzopen(path.c_str(), "rb");
+    REQUIRE(gzfp != nullptr);
+    std::string decompressed(data.size() + 1, '\0');
+    REQUIRE(gzread(gzfp, &decompressed[0], (unsigned)decompressed.size()) ==
+            (int)data.size());
+    REQUIRE(gzclose(gzfp) == Z_OK); // Also checks the CRC32
+    decompressed.resize(data.size());
+    REQUIRE(decompressed == data);
+    // Closing does not write anything else
+    REQUIRE(sink->close() == NoError());
+    REQUIRE(slurp(path) == raw);
+    REQUIRE(::remove(path.c_str()) == 0);
+}
+
+#endif
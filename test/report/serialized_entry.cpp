@@ -0,0 +1,48 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/report/serialized_entry.hpp"
+
+using namespace mk::report;
+
+TEST_CASE("SerializedEntry works as expected") {
+    SECTION("make() serializes the entry once") {
+        nlohmann::json doc{{"foo", 17}, {"bar", "baz"}};
+        SerializedEntry entry = SerializedEntry::make(doc);
+        REQUIRE(entry.str() == doc.dump());
+        REQUIRE(entry.json() == doc);
+        REQUIRE(entry.hash() == std::hash<std::string>{}(doc.dump()));
+    }
+
+    SECTION("Copies share the same bytes") {
+        SerializedEntry entry = SerializedEntry::make({{"foo", 17}});
+        SerializedEntry copy = entry;
+        REQUIRE(&copy.str() == &entry.str());
+        REQUIRE(copy == entry);
+    }
+
+    SECTION("Equality depends on the serialization") {
+        SerializedEntry a = SerializedEntry::make({{"foo", 17}});
+        SerializedEntry b = SerializedEntry::make({{"foo", 17}});
+        SerializedEntry c = SerializedEntry::make({{"foo", 18}});
+        REQUIRE(a == b);
+        REQUIRE(a != c);
+    }
+
+    SECTION("A failed make() does not move the entry") {
+        nlohmann::json doc{{"foo", "\xff"}, {"bar", 1}};
+        REQUIRE_THROWS(SerializedEntry::make(std::move(doc)));
+        REQUIRE(doc.at("bar") == 1);
+    }
+
+    SECTION("The default entry is null") {
+        SerializedEntry entry;
+        REQUIRE(entry.str() == "null");
+        REQUIRE(entry.json() == nullptr);
+    }
+}
@@ -0,0 +1,289 @@
+// Part of Measurement Kit <https://measurement-kit.github.io/>.
+// Measurement Kit is free software under the BSD license. See AUTHORS
+// and LICENSE for more information on the copying conditions.
+
+#include "test/winsock.hpp"
+
+#include "include/private/catch.hpp"
+
+#include "src/libmeasurement_kit/report/error.hpp"
+#include "src/libmeasurement_kit/report/ooni_reporter.hpp"
+#include "src/libmeasurement_kit/report/spool_uploader_impl.hpp"
+
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace mk::report;
+using namespace mk;
+
+static const std::string spool_dir = "spool_test_dir";
+
+static std::string segment(int number) {
+    char name[32];
+    snprintf(name, sizeof(name), "/%010d.seg", number);
+    return spool_dir + name;
+}
+
+static void remove_spool() {
+    for (int i = 0; i < 64; ++i) {
+        (void)::remove(segment(i).c_str());
+    }
+    (void)::remove((spool_dir + "/index").c_str());
+    (void)::remove((spool_dir + "/lock").c_str());
+#ifdef _WIN32
+    (void)::_rmdir(spool_dir.c_str());
+#else
+    (void)::rmdir(spool_dir.c_str());
+#endif
+}
+
+static bool exists(std::string path) { return std::ifstream{path}.good(); }
+
+static SharedPtr<Spool> open_spool(Settings settings = {}) {
+    ErrorOr<SharedPtr<Spool>> spool =
+          Spool::open(spool_dir, settings, Logger::make());
+    REQUIRE(!!spool);
+    return *spool;
+}
+
+static SerializedEntry make_entry(int value) {
+    return SerializedEntry::make({{"input", value}, {"report_id", ""}});
+}
+
+TEST_CASE("Spool persists entries across reopening") {
+    remove_spool();
+    {
+        SharedPtr<Spool> spool = open_spool();
+        REQUIRE(*spool->append("k1", make_entry(1)) == 1);
+        REQUIRE(*spool->append("k1", make_entry(2)) == 2);
+        REQUIRE(*spool->append("k2", make_entry(3)) == 3);
+        REQUIRE(spool->set_report_id("k2", "rid2") == NoError());
+        REQUIRE(spool->ack(1) == NoError());
+        REQUIRE(spool->ack(1) == SpoolEntryNotFoundError());
+        REQUIRE(spool->close_report("k1") == NoError());
+        REQUIRE(spool->reports().at("k1").closing);
+        REQUIRE(!spool->reports().at("k2").closing);
+    }
+    SharedPtr<Spool> spool = open_spool();
+    REQUIRE(spool->pending() == 2);
+    REQUIRE(spool->next_entry(0)->seq == 2);
+    REQUIRE(spool->next_entry(2)->key == "k2");
+    REQUIRE(!spool->next_entry(3));
+    REQUIRE(spool->read_entry(2)->json()["input"] == 2);
+    REQUIRE(spool->read_entry(3)->str() == make_entry(3).str());
+    REQUIRE(spool->reports().at("k1").pending == 1);
+    REQUIRE(spool->reports().at("k2").report_id == "rid2");
+    // The writer of the reports is gone, hence no more entries
+    REQUIRE(spool->reports().at("k2").closing);
+    REQUIRE(*spool->append("k3", make_entry(4)) == 4);
+    spool = {};
+    remove_spool();
+}
+
+TEST_CASE("Spool is locked while it is open") {
+#ifndef _WIN32
+    remove_spool();
+    SharedPtr<Spool> spool = open_spool();
+    ErrorOr<SharedPtr<Spool>> other =
+          Spool::open(spool_dir, {}, Logger::make());
+    REQUIRE(other.as_error() == SpoolLockedError());
+    spool = {};
+    remove_spool();
+#endif
+}
+
+TEST_CASE("Spool discards records torn by a crash") {
+    remove_spool();
+    {
+        SharedPtr<Spool> spool = open_spool();
+        REQUIRE(*spool->append("k1", make_entry(1)) == 1);
+        REQUIRE(*spool->append("k1", make_entry(2)) == 2);
+    }
+    std::string data;
+    {
+        std::ifstream file{segment(0), std::ios::binary};
+        data.assign(std::istreambuf_iterator<char>{file}, {});
+    }
+    {
+        std::ofstream file{segment(0), std::ios::binary | std::ios::trunc};
+        file << data.substr(0, data.size() - 5); // Cut the last entry
+    }
+    {
+        SharedPtr<Spool> spool = open_spool();
+        REQUIRE(spool->pending() == 1);
+        REQUIRE(*spool->append("k1", make_entry(3)) == 2);
+    }
+    SharedPtr<Spool> spool = open_spool();
+    REQUIRE(spool->pending() == 2);
+    REQUIRE(spool->read_entry(2)->json()["input"] == 3);
+    spool = {};
+    remove_spool();
+}
+
+TEST_CASE("Spool discards records with a corrupt length") {
+    for (std::string length : {"18446744073709551615",
+                               "99999999999999999999", "1000"}) {
+        remove_spool();
+        {
+            SharedPtr<Spool> spool = open_spool();
+            REQUIRE(*spool->append("k1", make_entry(1)) == 1);
+        }
+        {
+            std::ofstream file{segment(0), std::ios::binary | std::ios::app};
+            file << "E 2 k1 " << length << " 0123456789abcdef\n{}\n";
+        }
+        SharedPtr<Spool> spool = open_spool();
+        REQUIRE(spool->pending() == 1);
+        REQUIRE(spool->read_entry(1)->json()["input"] == 1);
+        spool = {};
+    }
+    remove_spool();
+}
+
+TEST_CASE("Spool removes segments that are not needed anymore") {
+    remove_spool();
+    {
+        SharedPtr<Spool> spool = open_spool({
+              {"collector/spool_segment_size", 16},
+        });
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(*spool->append("k1", make_entry(i)) == (uint64_t)i + 1);
+        }
+        REQUIRE(*spool->append("k2", make_entry(4)) == 5);
+        REQUIRE(exists(segment(3)));
+        REQUIRE(spool->set_report_id("k1", "rid1") == NoError());
+        for (int i = 1; i <= 4; ++i) {
+            REQUIRE(spool->ack(i) == NoError());
+        }
+        REQUIRE(spool->report_closed("k1") == NoError());
+        REQUIRE(!exists(segment(0)));
+        REQUIRE(!exists(segment(3)));
+        REQUIRE(exists(segment(4)));
+    }
+    // Resuming only needs the records of the report that is still open
+    SharedPtr<Spool> spool = open_spool();
+    REQUIRE(spool->pending() == 1);
+    REQUIRE(spool->reports().size() == 1);
+    REQUIRE(spool->next_entry(0)->seq == 5);
+    REQUIRE(*spool->append("k2", make_entry(5)) == 6);
+    spool = {};
+    remove_spool();
+}
+
+class FakeSession : public ooni::collector::Session {
+  public:
+    void update_report(std::string report_id, SerializedEntry entry,
+                       Callback<Error> callback) override {
+        REQUIRE(entry.json()["report_id"] == report_id);
+        updates.push_back(entry.json()["input"]);
+        callback(NoError());
+    }
+
+    void close_report(std::string report_id,
+                      Callback<Error> callback) override {
+        closes.push_back(report_id);
+        callback(NoError());
+    }
+
+    size_t pending() override { return 0; }
+
+    static std::vector<int> updates;
+    static std::vector<std::string> closes;
+};
+
+std::vector<int> FakeSession::updates;
+std::vector<std::string> FakeSession::closes;
+
+static SharedPtr<ooni::collector::Session> make_fake_session(
+      Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    return SharedPtr<ooni::collector::Session>{
+          std::make_shared<FakeSession>()};
+}
+
+static void create_report_ok(nlohmann::json, Callback<Error, std::string> cb,
+                             Settings, SharedPtr<Reactor>, SharedPtr<Logger>) {
+    cb(NoError(), "rid-created");
+}
+
+static int create_report_failures = 0;
+
+static void create_report_fail(nlohmann::json, Callback<Error, std::string> cb,
+                               Settings, SharedPtr<Reactor>,
+                               SharedPtr<Logger>) {
+    create_report_failures += 1;
+    cb(GenericError(), "");
+}
+
+TEST_CASE("SpoolUploader submits spooled entries and closes reports") {
+    remove_spool();
+    FakeSession::updates.clear();
+    FakeSession::closes.clear();
+    SharedPtr<Spool> spool = open_spool();
+    REQUIRE(*spool->append("k1", make_entry(1)) == 1);
+    REQUIRE(*spool->append("k1", make_entry(2)) == 2);
+    REQUIRE(spool->close_report("k1") == NoError());
+    REQUIRE(spool->set_report_id("k2", "rid2") == NoError());
+    REQUIRE(*spool->append("k2", make_entry(3)) == 3);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    auto uploader = std::make_shared<
+          SpoolUploaderImpl<make_fake_session, create_report_ok>>(
+          spool, Settings{}, reactor, Logger::make());
+    uploader->drain();
+    REQUIRE(spool->pending() == 0);
+    REQUIRE((FakeSession::updates == std::vector<int>{1, 2, 3}));
+    // The report k2 is still open, hence it is not closed
+    REQUIRE((FakeSession::closes == std::vector<std::string>{"rid-created"}));
+    REQUIRE(spool->reports().size() == 1);
+    REQUIRE(spool->close_report("k2") == NoError());
+    uploader->drain();
+    REQUIRE(FakeSession::closes.size() == 2);
+    REQUIRE(spool->reports().empty());
+    uploader = {};
+    spool = {};
+    remove_spool();
+}
+
+TEST_CASE("SpoolUploader retries a bounded number of times") {
+    remove_spool();
+    FakeSession::updates.clear();
+    create_report_failures = 0;
+    SharedPtr<Spool> spool = open_spool();
+    REQUIRE(*spool->append("k1", make_entry(1)) == 1);
+    SharedPtr<Reactor> reactor = Reactor::make();
+    auto uploader = std::make_shared<
+          SpoolUploaderImpl<make_fake_session, create_report_fail>>(
+          spool, Settings{{"collector/spool_retry_interval", 0.01},
+                          {"collector/spool_max_retries", 2}},
+          reactor, Logger::make());
+    // The reactor returns once the uploader gives up
+    reactor->run_with_initial_event([&]() { uploader->drain(); });
+    REQUIRE(create_report_failures == 3);
+    REQUIRE(spool->pending() == 1);
+    REQUIRE(FakeSession::updates.empty());
+    uploader->drain();
+    REQUIRE(create_report_failures == 4);
+    spool = {};
+    remove_spool();
+}
+
+TEST_CASE("ReportLegacy knows whether entries are spooled") {
+    remove_spool();
+    SharedPtr<Reactor> reactor = Reactor::make();
+    Settings settings{{"collector_base_url", "https://127.0.0.1:4444"}};
+    ReportLegacy direct;
+    direct.add_reporter(OoniReporter::make(settings, reactor, Logger::make()));
+    REQUIRE(!direct.spools_entries());
+    settings["collector/spool_dir"] = spool_dir;
+    {
+        ReportLegacy spooled;
+        spooled.add_reporter(
+              OoniReporter::make(settings, reactor, Logger::make()));
+        REQUIRE(spooled.spools_entries());
+    }
+    remove_spool();
+}